@@ -15,15 +15,25 @@
 struct Material {
     // Different obj files will use differing numbers of textures 
     // Smart pointers, dynamic allocation I know, meet me in Mesh.cpp, I'll explain
-    std::vector<std::unique_ptr<Texture>>   diffuseMaps;
-    std::vector<std::unique_ptr<Texture>>   normalMaps;
-    std::vector<std::unique_ptr<Texture>>   specularMaps;
+    // (indexed by material, null where the material has no texture of that type or it didn't load).
+    // Shared, other materials and meshes may be holding the same texture.
+    std::vector<TextureHandle>              diffuseMaps;
+    std::vector<TextureHandle>              normalMaps;
+    std::vector<TextureHandle>              specularMaps;
 
     // Only accounting for a vertex and fragment shader right now
     Shader                                  vertexShader;
     Shader                                  fragmentShader;
 
-    unsigned int                            GetTextureCount() const { return diffuseMaps.size() + normalMaps.size() + specularMaps.size(); }
+    unsigned int                            GetTextureCount() const {
+                                                unsigned int count = 0;
+                                                for (const auto *maps : { &diffuseMaps, &normalMaps, &specularMaps }) {
+                                                    for (const auto& map : *maps) {
+                                                        count += map ? 1 : 0;
+                                                    }
+                                                }
+                                                return count;
+                                            }
 };
 
 
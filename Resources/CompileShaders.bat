@@ -1,3 +1,4 @@
 C:\VulkanSDK\1.0.21.1\Bin\glslangValidator.exe -V Shader0.vert
 C:\VulkanSDK\1.0.21.1\Bin\glslangValidator.exe -V Shader0.frag
+C:\VulkanSDK\1.0.21.1\Bin\glslangValidator.exe -V Shader0Compact.vert -o vertCompact.spv
 pause
\ No newline at end of file
@@ -1,19 +1,22 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
 //#extension GL_ARB_shading_language_420pack : enable
 
 
 layout(location = 0) in vec3 inColour;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec3 inTangent;
-layout(location = 3) in vec2 inTexCoord;
+layout(location = 3) in vec3 inBiTangent;
+layout(location = 4) in vec2 inTexCoord;
+// The draw's texture table indices (diffuse, normal, specular), from its DrawData - -1 for none
+layout(location = 5) flat in ivec3 inTextures;
 
 layout(location = 0) out vec4 outColor;
 
 /* Bindings must match descriptor set and pipeline layout */
-layout(set = 0, binding = 1) uniform sampler2D texSampler[2];
-layout(set = 0, binding = 2) uniform sampler2D normalMapSampler[2];
-layout(set = 0, binding = 3) uniform sampler2D specularMapSampler[2];
+// Every registered texture (XOF_TextureTable.hpp). The indices are the same for the whole draw.
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 layout(set = 0, binding = 4) uniform DirectionalLight { 
     vec4    colour;
     vec4    direction;
@@ -21,19 +24,20 @@ layout(set = 0, binding = 4) uniform DirectionalLight {
     float    diffuseIntensity;
 } dl;
 
-layout(push_constant) uniform PushConstants {
-    int textureIndex;
-} pushConstants;
-
 
 vec3 CalculateNormalFromMap() {
+    // The frame is orthogonalised per vertex on load, interpolation only needs renormalising
     vec3 normal = normalize( inNormal );
     vec3 tangent = normalize( inTangent );
+    vec3 biTangent = normalize( inBiTangent );
+    if( inTextures.y < 0 ) {
+        return normal;
+    }
 
-    tangent = normalize( tangent - dot( tangent, normal ) * normal );
-    vec3 biTangent = cross( tangent, normal );
-    vec3 bumpNormal = texture( normalMapSampler[pushConstants.textureIndex], inTexCoord ).xyz;
-    bumpNormal = 2.f * bumpNormal - vec3( 1.f, 1.f, 1.f );
+    // Only X and Y are stored (BC5 has two channels), Z is rebuilt from the normal being unit length - which
+    // holds for uncompressed maps too, so they go down the same path
+    vec2 bumpXY = 2.f * texture( textures[inTextures.y], inTexCoord ).xy - vec2( 1.f, 1.f );
+    vec3 bumpNormal = vec3( bumpXY, sqrt( max( 1.f - dot( bumpXY, bumpXY ), 0.f ) ) );
 
     mat3 TBN = mat3( tangent, biTangent, normal );
     return normalize( TBN * bumpNormal );
@@ -51,5 +55,6 @@ void main() {
         diffuseColour = vec4( 0.f, 0.f, 0.f, 0.f );
     }
 
-    outColor = texture( texSampler[pushConstants.textureIndex], inTexCoord ) * ( ambientColour + diffuseColour );
+    vec4 albedo = ( inTextures.x >= 0 ) ? texture( textures[inTextures.x], inTexCoord ) : vec4( 1.f );
+    outColor = albedo * ( ambientColour + diffuseColour );
 }
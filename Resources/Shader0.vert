@@ -1,5 +1,6 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shader_draw_parameters : require
 //#extension GL_ARB_shading_language_420pack : enable
 
 
@@ -12,13 +13,32 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
 layout(location = 0) in vec3 inPos;
 layout(location = 1) in vec3 inColour;
 layout(location = 2) in vec3 inNormal;
-layout(location = 3) in vec3 inTangent;
+layout(location = 3) in vec4 inTangent; // w is the handedness
 layout(location = 4) in vec2 inTexCoord;
 
+// Per instance (XOF_InstanceBuffer.hpp), placed by ubo.model on top. Takes locations 5 to 8.
+layout(location = 5) in mat4 inInstanceModel;
+
+// Per draw (XOF_IndirectDrawBuffer.hpp), the draw's index is the batch's first draw plus gl_DrawIDARB
+struct DrawData {
+    int diffuseTexture;     // Indices into the texture table, -1 for none
+    int normalTexture;
+    int specularTexture;
+};
+layout(std430, set = 0, binding = 5) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+} drawData;
+
+layout(push_constant) uniform PushConstants {
+    int drawOffset;
+} pushConstants;
+
 layout(location = 0) out vec3 outColour;
 layout(location = 1) out vec3 outNormal;
 layout(location = 2) out vec3 outTangent;
-layout(location = 3) out vec2 outTexCoord;
+layout(location = 3) out vec3 outBiTangent;
+layout(location = 4) out vec2 outTexCoord;
+layout(location = 5) flat out ivec3 outTextures;    // Diffuse, normal, specular
 
 out gl_PerVertex {
     vec4 gl_Position;
@@ -26,12 +46,19 @@ out gl_PerVertex {
 
 
 void main() {
-    gl_Position = ( ubo.projection * ubo.view * ubo.model ) * vec4( inPos, 1.0 );
+    mat4 model = ubo.model * inInstanceModel;
+    gl_Position = ( ubo.projection * ubo.view * model ) * vec4( inPos, 1.0 );
     outColour = inColour;
 
+    DrawData draw = drawData.draws[pushConstants.drawOffset + gl_DrawIDARB];
+    outTextures = ivec3( draw.diffuseTexture, draw.normalTexture, draw.specularTexture );
+
     outTexCoord = inTexCoord;
     outTexCoord.y = 1.f - outTexCoord.y;
 
-    outNormal = ( ubo.model * vec4( inNormal, 0.f ) ).xyz;
-    outTangent = ( ubo.model * vec4( inTangent, 0.f ) ).xyz;
+    outNormal = ( model * vec4( inNormal, 0.f ) ).xyz;
+    outTangent = ( model * vec4( inTangent.xyz, 0.f ) ).xyz;
+    // The tangent arrives already orthogonalised against the normal. cross( tangent, normal ) rather than
+    // cross( normal, tangent ) as V is flipped above.
+    outBiTangent = cross( outTangent, outNormal ) * inTangent.w;
 }
@@ -0,0 +1,74 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shader_draw_parameters : require
+//#extension GL_ARB_shading_language_420pack : enable
+
+// Shader0.vert for CompactVertexLayout (XOF_VertexLayout.hpp) - half positions, octahedral snorm16
+// normals/tangents and unorm16 texture coordinates. There's no colour attribute.
+
+
+layout(set = 0, binding = 0) uniform UniformBufferObject { 
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+} ubo;
+
+layout(location = 0) in vec4 inPos;       // w is 1
+layout(location = 2) in vec2 inNormal;    // Octahedral
+layout(location = 3) in vec4 inTangent;   // xy octahedral, z is the handedness
+layout(location = 4) in vec2 inTexCoord;
+
+// Per instance (XOF_InstanceBuffer.hpp), placed by ubo.model on top. Takes locations 5 to 8.
+layout(location = 5) in mat4 inInstanceModel;
+
+// Per draw, see Shader0.vert
+struct DrawData {
+    int diffuseTexture;     // Indices into the texture table, -1 for none
+    int normalTexture;
+    int specularTexture;
+};
+layout(std430, set = 0, binding = 5) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+} drawData;
+
+layout(push_constant) uniform PushConstants {
+    int drawOffset;
+} pushConstants;
+
+layout(location = 0) out vec3 outColour;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec3 outTangent;
+layout(location = 3) out vec3 outBiTangent;
+layout(location = 4) out vec2 outTexCoord;
+layout(location = 5) flat out ivec3 outTextures;    // Diffuse, normal, specular
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+
+vec3 OctahedralDecode( vec2 e ) {
+    vec3 v = vec3( e.xy, 1.0 - abs( e.x ) - abs( e.y ) );
+    if( v.z < 0.0 ) {
+        v.xy = ( 1.0 - abs( v.yx ) ) * vec2( v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0 );
+    }
+    return normalize( v );
+}
+
+
+void main() {
+    mat4 model = ubo.model * inInstanceModel;
+    gl_Position = ( ubo.projection * ubo.view * model ) * vec4( inPos.xyz, 1.0 );
+    outColour = vec3( 0.0 );
+
+    DrawData draw = drawData.draws[pushConstants.drawOffset + gl_DrawIDARB];
+    outTextures = ivec3( draw.diffuseTexture, draw.normalTexture, draw.specularTexture );
+
+    outTexCoord = inTexCoord;
+    outTexCoord.y = 1.f - outTexCoord.y;
+
+    outNormal = ( model * vec4( OctahedralDecode( inNormal ), 0.f ) ).xyz;
+    outTangent = ( model * vec4( OctahedralDecode( inTangent.xy ), 0.f ) ).xyz;
+    // See Shader0.vert for the cross order
+    outBiTangent = cross( outTangent, outNormal ) * ( inTangent.z < 0.0 ? -1.0 : 1.0 );
+}
@@ -0,0 +1,110 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    LodChainReport.cpp
+    Desc    :    Standalone report of the LOD chains BuildLodChain makes for our
+                 assets, no GPU needed - triangles, reduction and error per level
+                 for each OBJ given.
+
+                 Build alongside XOF_MeshSimplifier.cpp, XOF_MeshOptimizer.cpp,
+                 XOF_ObjParser.cpp, XOF_VertexWelder.cpp, XOF_VertexLayout.cpp,
+                 XOF_ThreadPool.cpp and XOF_MappedFile.cpp:
+                 LodChainReport file.obj...
+
+===============================================================================
+*/
+#include "../XOF_MeshSimplifier.hpp"
+#include "../XOF_ObjParser.hpp"
+#include "../XOF_ThreadPool.hpp"
+#include "../XOF_VertexWelder.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+// Same corner expansion and weld as Mesh::LoadFromObj, one range per run of same-material triangles
+static bool LoadWelded(const char *fileName, ThreadPool& pool, std::vector<Vertex>& vertices,
+                       std::vector<unsigned int>& indices, std::vector<IndexRange>& ranges) {
+    std::string path(fileName);
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+    ObjData obj;
+    std::string error;
+    if (!ParseObj(fileName, directory.c_str(), obj, error, &pool)) {
+        fprintf(stderr, "%s: %s\n", fileName, error.c_str());
+        return false;
+    }
+
+    std::vector<Vertex> corners(obj.indices.size());
+    for (size_t i = 0; i < obj.indices.size(); ++i) {
+        const ObjIndex& index = obj.indices[i];
+        Vertex& v = corners[i];
+        v.pos = glm::vec3(obj.positions[3 * index.position + 0], obj.positions[3 * index.position + 1],
+                          obj.positions[3 * index.position + 2]);
+        if (index.normal >= 0) {
+            v.normal = glm::vec3(obj.normals[3 * index.normal + 0], obj.normals[3 * index.normal + 1],
+                                 obj.normals[3 * index.normal + 2]);
+        }
+        if (index.texCoord >= 0) {
+            v.texCoord = glm::vec2(obj.texCoords[2 * index.texCoord + 0], obj.texCoords[2 * index.texCoord + 1]);
+        }
+    }
+    WeldVertices(corners.data(), static_cast<uint32_t>(corners.size()), vertices, indices, &pool);
+
+    ranges.clear();
+    for (uint32_t t = 0; t < obj.materialIds.size(); ++t) {
+        if (t == 0 || obj.materialIds[t] != obj.materialIds[t - 1]) {
+            ranges.push_back({ t * 3, 0 });
+        }
+        ranges.back().indexCount += 3;
+    }
+
+    return true;
+}
+
+
+
+// ---
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: LodChainReport file.obj...\n");
+        return 1;
+    }
+
+    ThreadPool pool;
+    pool.Create(0);
+
+    for (int i = 1; i < argc; ++i) {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<IndexRange> ranges;
+        if (!LoadWelded(argv[i], pool, vertices, indices, ranges)) {
+            continue;
+        }
+        if (ranges.empty()) {
+            ranges.push_back({ 0, static_cast<uint32_t>(indices.size()) });
+        }
+
+        const uint32_t sourceTriangles = static_cast<uint32_t>(indices.size() / 3);
+        std::vector<LodLevel> levels;
+        auto start = std::chrono::high_resolution_clock::now();
+        BuildLodChain(vertices.data(), static_cast<uint32_t>(vertices.size()), indices, ranges.data(),
+                      static_cast<uint32_t>(ranges.size()), DEFAULT_LOD_CHAIN_DESC, &pool, levels);
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        printf("%s - %zu ranges, built in %.1fms\n", argv[i], ranges.size(), seconds * 1000.0);
+        printf("  %-6s %10s %8s %10s\n", "level", "triangles", "of LOD0", "error");
+        printf("  %-6u %10u %7.1f%% %10.5f\n", 0u, sourceTriangles, 100.0, 0.0);
+        for (uint32_t level = 0; level < levels.size(); ++level) {
+            printf("  %-6u %10u %7.1f%% %10.5f\n", level + 1, levels[level].triangleCount,
+                   100.0 * levels[level].triangleCount / sourceTriangles, levels[level].error);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,275 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    MemoryAllocatorTest.cpp
+    Desc    :    Standalone MemoryAllocator checks, no GPU needed - runs the allocator
+                 in its CPU-only mode over fake memory types and checks the properties
+                 the renderer relies on. Returns non-zero if any fail.
+
+                 Build alongside XOF_MemoryAllocator.cpp, linked with the Vulkan loader (nothing
+                 is called on a device):
+                 MemoryAllocatorTest
+
+===============================================================================
+*/
+#include "../XOF_MemoryAllocator.hpp"
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+
+static const VkDeviceSize BLOCK_SIZE = 1024 * 1024;
+static const VkDeviceSize GRANULARITY = 4096;
+static const VkMemoryPropertyFlags HOST_MEMORY = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+static uint32_t gFailedCount = 0;
+
+
+#define CHECK(condition) Check((condition), #condition, __LINE__)
+
+static void Check(bool condition, const char *expression, int line) {
+    if (!condition) {
+        printf("    FAILED line %d: %s\n", line, expression);
+        ++gFailedCount;
+    }
+}
+
+// A device-local and a host-visible type, each on its own heap. Both blocks come out host backed in
+// CPU-only mode, the host-visible type is there so FindMemoryTypeIndex has something to choose between.
+static void CreateAllocator(MemoryAllocator& allocator, VkDeviceSize bufferImageGranularity) {
+    MemoryAllocatorDesc desc;
+    desc.blockSize = BLOCK_SIZE;
+    desc.cpuOnly = true;
+    desc.fakeBufferImageGranularity = bufferImageGranularity;
+
+    VkPhysicalDeviceMemoryProperties& properties = desc.fakeMemoryProperties;
+    properties.memoryHeapCount = 2;
+    properties.memoryHeaps[0].size = 1024 * BLOCK_SIZE;
+    properties.memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    properties.memoryHeaps[1].size = 1024 * BLOCK_SIZE;
+    properties.memoryTypeCount = 2;
+    properties.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    properties.memoryTypes[0].heapIndex = 0;
+    properties.memoryTypes[1].propertyFlags = HOST_MEMORY;
+    properties.memoryTypes[1].heapIndex = 1;
+
+    allocator.Create(desc);
+}
+
+static VkMemoryRequirements MakeRequirements(VkDeviceSize size, VkDeviceSize alignment) {
+    VkMemoryRequirements requirements = {};
+    requirements.size = size;
+    requirements.alignment = alignment;
+    requirements.memoryTypeBits = ~0u;
+    return requirements;
+}
+
+// Blocks are plain host memory in CPU-only mode and memory stays VK_NULL_HANDLE, so the mapped pointer
+// minus the offset is what tells two allocations' blocks apart
+static const char* GetBlockBase(const Allocation& allocation) {
+    return static_cast<const char*>(allocation.mappedData) - allocation.offset;
+}
+
+
+// ---
+
+
+static void TestRoundTrip() {
+    MemoryAllocator allocator;
+    CreateAllocator(allocator, 1);
+
+    // Odd sizes so the splits leave remainders, each filled with its own byte to catch any overlap
+    std::vector<Allocation> allocations(64);
+    for (size_t i = 0; i < allocations.size(); ++i) {
+        VkDeviceSize size = 1000 + i * 97;
+        CHECK(allocator.Allocate(MakeRequirements(size, 16), HOST_MEMORY, RESOURCE_TILING_LINEAR, allocations[i]));
+        CHECK(allocations[i].IsValid());
+        CHECK(allocations[i].size == size);
+        CHECK(allocations[i].memoryTypeIndex == 1);
+        CHECK(allocations[i].mappedData != nullptr);
+        memset(allocations[i].mappedData, static_cast<int>(i), static_cast<size_t>(size));
+    }
+    CHECK(allocator.GetStats().allocationCount == allocations.size());
+    CHECK(allocator.GetStats().deviceAllocationCount == 1);
+
+    for (size_t i = 0; i < allocations.size(); ++i) {
+        const uint8_t *bytes = static_cast<const uint8_t*>(allocations[i].mappedData);
+        bool isIntact = true;
+        for (VkDeviceSize j = 0; j < allocations[i].size; ++j) {
+            isIntact = isIntact && (bytes[j] == static_cast<uint8_t>(i));
+        }
+        CHECK(isIntact);
+    }
+
+    for (Allocation& allocation : allocations) {
+        allocator.Free(allocation);
+        CHECK(!allocation.IsValid());
+    }
+    CHECK(allocator.GetStats().allocationCount == 0);
+    CHECK(allocator.GetStats().usedBytes == 0);
+
+    // The last shared block is kept around rather than handed back
+    CHECK(allocator.GetStats().deviceAllocationCount == 1);
+    CHECK(allocator.GetStats().reservedBytes == BLOCK_SIZE);
+
+    allocator.Destroy();
+    CHECK(allocator.GetStats().deviceAllocationCount == 0);
+}
+
+static void TestAlignment() {
+    MemoryAllocator allocator;
+    CreateAllocator(allocator, 1);
+
+    // Each odd-sized allocation knocks the next free offset off every power of two
+    const VkDeviceSize alignments[] = { 1, 4, 16, 256, 1024, 4096, 65536, 4, 65536, 256 };
+    std::vector<Allocation> allocations;
+    for (VkDeviceSize alignment : alignments) {
+        Allocation padding, allocation;
+        CHECK(allocator.Allocate(MakeRequirements(333, 1), 0, RESOURCE_TILING_LINEAR, padding));
+        CHECK(allocator.Allocate(MakeRequirements(5000, alignment), 0, RESOURCE_TILING_LINEAR, allocation));
+        CHECK(allocation.offset % alignment == 0);
+        allocations.push_back(padding);
+        allocations.push_back(allocation);
+    }
+
+    for (Allocation& allocation : allocations) {
+        allocator.Free(allocation);
+    }
+    CHECK(allocator.GetStats().allocationCount == 0);
+}
+
+static void TestCoalescing() {
+    MemoryAllocator allocator;
+    CreateAllocator(allocator, 1);
+
+    // Fill the first half of the block in sixteenths
+    const uint32_t count = 8;
+    std::vector<Allocation> allocations(count);
+    for (Allocation& allocation : allocations) {
+        CHECK(allocator.Allocate(MakeRequirements(BLOCK_SIZE / 16, 256), 0, RESOURCE_TILING_LINEAR, allocation));
+    }
+    const char *blockBase = GetBlockBase(allocations[0]);
+
+    // Odd ones first so every later free has to merge with the ranges on both sides
+    for (uint32_t i = 1; i < count; i += 2) {
+        allocator.Free(allocations[i]);
+    }
+    for (uint32_t i = 0; i < count; i += 2) {
+        allocator.Free(allocations[i]);
+    }
+    CHECK(allocator.GetStats().usedBytes == 0);
+    CHECK(allocator.GetStats().deviceAllocationCount == 1);
+
+    // Half a block is the most a shared block takes (more gets a dedicated one, see below), and with the search
+    // padding it only fits the kept block if all of the ranges above have merged back with the free half
+    Allocation whole;
+    CHECK(allocator.Allocate(MakeRequirements(BLOCK_SIZE / 2, 256), 0, RESOURCE_TILING_LINEAR, whole));
+    CHECK(allocator.GetStats().deviceAllocationCount == 1);
+    CHECK(whole.offset == 0);
+    CHECK(GetBlockBase(whole) == blockBase);
+
+    allocator.Free(whole);
+    CHECK(allocator.GetStats().allocationCount == 0);
+}
+
+static void TestGranularity() {
+    MemoryAllocator allocator;
+    CreateAllocator(allocator, GRANULARITY);
+
+    // Interleaved, as buffers and images tend to be created, and small enough for any page to be shared
+    std::vector<Allocation> linear(32), optimal(32);
+    for (size_t i = 0; i < linear.size(); ++i) {
+        CHECK(allocator.Allocate(MakeRequirements(300 + i * 40, 4), 0, RESOURCE_TILING_LINEAR, linear[i]));
+        CHECK(allocator.Allocate(MakeRequirements(700 + i * 40, 256), 0, RESOURCE_TILING_OPTIMAL, optimal[i]));
+    }
+
+    bool isSeparated = true;
+    for (const Allocation& a : linear) {
+        for (const Allocation& b : optimal) {
+            if (GetBlockBase(a) != GetBlockBase(b)) {
+                continue;
+            }
+            VkDeviceSize aFirstPage = a.offset / GRANULARITY, aLastPage = (a.offset + a.size - 1) / GRANULARITY;
+            VkDeviceSize bFirstPage = b.offset / GRANULARITY, bLastPage = (b.offset + b.size - 1) / GRANULARITY;
+            isSeparated = isSeparated && (aLastPage < bFirstPage || bLastPage < aFirstPage);
+        }
+    }
+    CHECK(isSeparated);
+
+    for (size_t i = 0; i < linear.size(); ++i) {
+        allocator.Free(linear[i]);
+        allocator.Free(optimal[i]);
+    }
+    CHECK(allocator.GetStats().allocationCount == 0);
+}
+
+static void TestDedicated() {
+    MemoryAllocator allocator;
+    CreateAllocator(allocator, 1);
+
+    Allocation shared;
+    CHECK(allocator.Allocate(MakeRequirements(1024, 256), 0, RESOURCE_TILING_LINEAR, shared));
+    CHECK(allocator.GetStats().deviceAllocationCount == 1);
+
+    // Up to half a block still goes in a shared one...
+    Allocation half;
+    CHECK(allocator.Allocate(MakeRequirements(BLOCK_SIZE / 2 - 4096, 256), 0, RESOURCE_TILING_LINEAR, half));
+    CHECK(allocator.GetStats().deviceAllocationCount == 1);
+    CHECK(GetBlockBase(half) == GetBlockBase(shared));
+
+    // ...anything more gets a block of its own, sized to fit rather than to the block size
+    Allocation big;
+    CHECK(allocator.Allocate(MakeRequirements(BLOCK_SIZE / 2 + 1, 256), 0, RESOURCE_TILING_LINEAR, big));
+    CHECK(allocator.GetStats().deviceAllocationCount == 2);
+    CHECK(big.offset == 0);
+    CHECK(GetBlockBase(big) != GetBlockBase(shared));
+    CHECK(allocator.GetStats().reservedBytes < 2 * BLOCK_SIZE);
+
+    Allocation bigger;
+    CHECK(allocator.Allocate(MakeRequirements(3 * BLOCK_SIZE, 256), 0, RESOURCE_TILING_LINEAR, bigger));
+    CHECK(allocator.GetStats().deviceAllocationCount == 3);
+    CHECK(bigger.offset == 0);
+
+    // Dedicated blocks go back as soon as their allocation does
+    allocator.Free(big);
+    allocator.Free(bigger);
+    CHECK(allocator.GetStats().deviceAllocationCount == 1);
+
+    allocator.Free(half);
+    allocator.Free(shared);
+    CHECK(allocator.GetStats().allocationCount == 0);
+}
+
+
+// ---
+
+
+int main() {
+    struct Test {
+        const char *name;
+        void      (*function)();
+    };
+    const Test tests[] = {
+        { "allocate/free round trip", TestRoundTrip },
+        { "alignment", TestAlignment },
+        { "coalescing", TestCoalescing },
+        { "buffer/image granularity", TestGranularity },
+        { "dedicated blocks", TestDedicated },
+    };
+
+    for (const Test& test : tests) {
+        uint32_t failedBefore = gFailedCount;
+        try {
+            test.function();
+        } catch (const std::exception& e) {
+            printf("    THREW: %s\n", e.what());
+            ++gFailedCount;
+        }
+        printf("%s: %s\n", test.name, (gFailedCount == failedBefore) ? "passed" : "FAILED");
+    }
+
+    return (gFailedCount == 0) ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    MeshOptimizerReport.cpp
+    Desc    :    Standalone report of what OptimizeMesh does to our assets, no GPU
+                 needed - ACMR/ATVR before and after for each OBJ given.
+
+                 Build alongside XOF_MeshOptimizer.cpp, XOF_ObjParser.cpp,
+                 XOF_VertexWelder.cpp, XOF_VertexLayout.cpp, XOF_ThreadPool.cpp and XOF_MappedFile.cpp:
+                 MeshOptimizerReport file.obj...
+
+===============================================================================
+*/
+#include "../XOF_MeshOptimizer.hpp"
+#include "../XOF_ObjParser.hpp"
+#include "../XOF_ThreadPool.hpp"
+#include "../XOF_VertexWelder.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+// Same corner expansion and weld as Mesh::LoadFromObj, one range per run of same-material triangles
+static bool LoadWelded(const char *fileName, ThreadPool& pool, std::vector<Vertex>& vertices,
+                       std::vector<unsigned int>& indices, std::vector<IndexRange>& ranges) {
+    std::string path(fileName);
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+    ObjData obj;
+    std::string error;
+    if (!ParseObj(fileName, directory.c_str(), obj, error, &pool)) {
+        fprintf(stderr, "%s: %s\n", fileName, error.c_str());
+        return false;
+    }
+
+    std::vector<Vertex> corners(obj.indices.size());
+    for (size_t i = 0; i < obj.indices.size(); ++i) {
+        const ObjIndex& index = obj.indices[i];
+        Vertex& v = corners[i];
+        v.pos = glm::vec3(obj.positions[3 * index.position + 0], obj.positions[3 * index.position + 1],
+                          obj.positions[3 * index.position + 2]);
+        if (index.normal >= 0) {
+            v.normal = glm::vec3(obj.normals[3 * index.normal + 0], obj.normals[3 * index.normal + 1],
+                                 obj.normals[3 * index.normal + 2]);
+        }
+        if (index.texCoord >= 0) {
+            v.texCoord = glm::vec2(obj.texCoords[2 * index.texCoord + 0], obj.texCoords[2 * index.texCoord + 1]);
+        }
+    }
+    WeldVertices(corners.data(), static_cast<uint32_t>(corners.size()), vertices, indices, &pool);
+
+    ranges.clear();
+    for (uint32_t t = 0; t < obj.materialIds.size(); ++t) {
+        if (t == 0 || obj.materialIds[t] != obj.materialIds[t - 1]) {
+            ranges.push_back({ t * 3, 0 });
+        }
+        ranges.back().indexCount += 3;
+    }
+
+    return true;
+}
+
+
+// ---
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: MeshOptimizerReport file.obj...\n");
+        return 1;
+    }
+
+    ThreadPool pool;
+    pool.Create(0);
+
+    printf("%-40s %10s %10s %15s %15s %10s\n", "mesh", "triangles", "vertices", "ACMR", "ATVR", "time");
+    for (int i = 1; i < argc; ++i) {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<IndexRange> ranges;
+        if (!LoadWelded(argv[i], pool, vertices, indices, ranges)) {
+            continue;
+        }
+
+        MeshOptimizationStats stats;
+        auto start = std::chrono::high_resolution_clock::now();
+        OptimizeMesh(vertices, indices, ranges.data(), static_cast<uint32_t>(ranges.size()), &pool, &stats);
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        printf("%-40s %10zu %10zu %6.3f -> %5.3f %6.3f -> %5.3f %8.1fms\n", argv[i], indices.size() / 3, vertices.size(),
+               stats.before.acmr, stats.after.acmr, stats.before.atvr, stats.after.atvr, seconds * 1000.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    MeshletCullBenchmark.cpp
+    Desc    :    Standalone meshlet culling benchmark, no GPU needed - meshlets
+                 culled per millisecond by CullMeshlets from cameras orbiting the
+                 mesh, plus how much of it was rejected. Uses a synthetic sphere
+                 when no OBJ is given.
+
+                 Build alongside XOF_Meshlets.cpp, XOF_Frustum.cpp, XOF_MeshOptimizer.cpp,
+                 XOF_ObjParser.cpp, XOF_VertexWelder.cpp, XOF_VertexLayout.cpp,
+                 XOF_ThreadPool.cpp and XOF_MappedFile.cpp:
+                 MeshletCullBenchmark [file.obj...]
+
+===============================================================================
+*/
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../XOF_Meshlets.hpp"
+#include "../XOF_ObjParser.hpp"
+#include "../XOF_ThreadPool.hpp"
+#include "../XOF_VertexWelder.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+static const uint32_t CAMERA_COUNT = 64;
+static const uint32_t RUNS_PER_CAMERA = 16;
+static const uint32_t SPHERE_SEGMENTS = 512;
+
+
+// Same corner expansion and weld as Mesh::LoadFromObj, one range per run of same-material triangles
+static bool LoadWelded(const char *fileName, ThreadPool& pool, std::vector<Vertex>& vertices,
+                       std::vector<unsigned int>& indices, std::vector<IndexRange>& ranges) {
+    std::string path(fileName);
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+    ObjData obj;
+    std::string error;
+    if (!ParseObj(fileName, directory.c_str(), obj, error, &pool)) {
+        fprintf(stderr, "%s: %s\n", fileName, error.c_str());
+        return false;
+    }
+
+    std::vector<Vertex> corners(obj.indices.size());
+    for (size_t i = 0; i < obj.indices.size(); ++i) {
+        const ObjIndex& index = obj.indices[i];
+        Vertex& v = corners[i];
+        v.pos = glm::vec3(obj.positions[3 * index.position + 0], obj.positions[3 * index.position + 1],
+                          obj.positions[3 * index.position + 2]);
+        if (index.normal >= 0) {
+            v.normal = glm::vec3(obj.normals[3 * index.normal + 0], obj.normals[3 * index.normal + 1],
+                                 obj.normals[3 * index.normal + 2]);
+        }
+        if (index.texCoord >= 0) {
+            v.texCoord = glm::vec2(obj.texCoords[2 * index.texCoord + 0], obj.texCoords[2 * index.texCoord + 1]);
+        }
+    }
+    WeldVertices(corners.data(), static_cast<uint32_t>(corners.size()), vertices, indices, &pool);
+
+    ranges.clear();
+    for (uint32_t t = 0; t < obj.materialIds.size(); ++t) {
+        if (t == 0 || obj.materialIds[t] != obj.materialIds[t - 1]) {
+            ranges.push_back({ t * 3, 0 });
+        }
+        ranges.back().indexCount += 3;
+    }
+
+    return true;
+}
+
+// Unit UV sphere, counter-clockwise seen from outside
+static void GenerateSphere(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+                           std::vector<IndexRange>& ranges) {
+    const uint32_t rings = SPHERE_SEGMENTS / 2;
+    const float pi = 3.14159265f;
+
+    vertices.clear();
+    for (uint32_t ring = 0; ring <= rings; ++ring) {
+        float theta = pi * ring / rings;
+        for (uint32_t segment = 0; segment <= SPHERE_SEGMENTS; ++segment) {
+            float phi = 2.f * pi * segment / SPHERE_SEGMENTS;
+            Vertex v = {};
+            v.pos = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), -std::sin(theta) * std::sin(phi));
+            v.normal = v.pos;
+            vertices.push_back(v);
+        }
+    }
+
+    indices.clear();
+    for (uint32_t ring = 0; ring < rings; ++ring) {
+        for (uint32_t segment = 0; segment < SPHERE_SEGMENTS; ++segment) {
+            unsigned int i0 = ring * (SPHERE_SEGMENTS + 1) + segment;
+            unsigned int i1 = i0 + SPHERE_SEGMENTS + 1;
+            indices.insert(indices.end(), { i0, i1, i0 + 1, i0 + 1, i1, i1 + 1 });
+        }
+    }
+
+    ranges.assign(1, { 0, static_cast<uint32_t>(indices.size()) });
+}
+
+static void RunBenchmark(const char *name, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+                         std::vector<IndexRange>& ranges, ThreadPool& pool) {
+    if (ranges.empty()) {
+        ranges.push_back({ 0, static_cast<uint32_t>(indices.size()) });
+    }
+    OptimizeMesh(vertices, indices, ranges.data(), static_cast<uint32_t>(ranges.size()), &pool, nullptr);
+
+    std::vector<Meshlet> meshlets;
+    BuildMeshlets(vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), ranges.data(),
+                  static_cast<uint32_t>(ranges.size()), meshlets);
+
+    glm::vec3 boundsMin = vertices[0].pos;
+    glm::vec3 boundsMax = vertices[0].pos;
+    for (const auto& vertex : vertices) {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = glm::length(boundsMax - center);
+
+    // Orbiting cameras, every other one close enough that the mesh overflows the view
+    std::vector<Frustum> frustums(CAMERA_COUNT);
+    std::vector<glm::vec3> eyes(CAMERA_COUNT);
+    for (uint32_t c = 0; c < CAMERA_COUNT; ++c) {
+        float angle = 6.2831853f * c / CAMERA_COUNT;
+        float distance = radius * ((c % 2) ? 0.8f : 3.f);
+        eyes[c] = center + glm::vec3(std::cos(angle) * distance, radius * 0.5f, std::sin(angle) * distance);
+        glm::mat4 view = glm::lookAt(eyes[c], center, glm::vec3(0.f, 1.f, 0.f));
+        glm::mat4 projection = glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.01f * radius, 10.f * radius);
+        projection[1][1] *= -1.f;
+        frustums[c] = ExtractFrustum(projection * view);
+    }
+
+    std::vector<MeshletDrawRange> drawRanges;
+    uint64_t visible = 0;
+    uint64_t frustumCulled = 0;
+    uint64_t coneCulled = 0;
+    uint64_t drawCount = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t run = 0; run < RUNS_PER_CAMERA; ++run) {
+        for (uint32_t c = 0; c < CAMERA_COUNT; ++c) {
+            MeshletCullStats stats;
+            visible += CullMeshlets(meshlets.data(), static_cast<uint32_t>(meshlets.size()), frustums[c], eyes[c],
+                                    drawRanges, &stats);
+            frustumCulled += stats.frustumCulled;
+            coneCulled += stats.coneCulled;
+            drawCount += drawRanges.size();
+        }
+    }
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    const double cullCount = double(RUNS_PER_CAMERA) * CAMERA_COUNT;
+    const double tested = cullCount * meshlets.size();
+    double meshletVertices = 0.0;
+    for (const auto& meshlet : meshlets) {
+        meshletVertices += meshlet.vertexCount;
+    }
+
+    printf("%s\n", name);
+    printf("  %zu triangles, %zu meshlets (%.1f triangles, %.1f vertices each)\n", indices.size() / 3, meshlets.size(),
+           indices.size() / 3.0 / meshlets.size(), meshletVertices / meshlets.size());
+    printf("  %.0f meshlets culled/ms, %.3f ms per cull\n", tested / milliseconds, milliseconds / cullCount);
+    printf("  %.1f%% visible (frustum rejected %.1f%%, cone %.1f%%), %.1f draw ranges per cull\n",
+           100.0 * visible / tested, 100.0 * frustumCulled / tested, 100.0 * coneCulled / tested, drawCount / cullCount);
+}
+
+
+// ---
+
+
+int main(int argc, char **argv) {
+    ThreadPool pool;
+    pool.Create(0);
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<IndexRange> ranges;
+
+    if (argc < 2) {
+        GenerateSphere(vertices, indices, ranges);
+        RunBenchmark("synthetic sphere", vertices, indices, ranges, pool);
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (LoadWelded(argv[i], pool, vertices, indices, ranges)) {
+            RunBenchmark(argv[i], vertices, indices, ranges, pool);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,195 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    ObjParserBenchmark.cpp
+    Desc    :    Standalone ParseObj throughput benchmark - generates synthetic OBJ
+                 files (10MB, 100MB and 1GB by default) and reports MB/s per thread count.
+                 Checks that a CRLF .mtl parses correctly first.
+
+                 Build alongside XOF_ObjParser.cpp, XOF_ThreadPool.cpp and XOF_MappedFile.cpp:
+                 ObjParserBenchmark [outputDir] [sizeInMB...]
+
+===============================================================================
+*/
+#include "../XOF_ObjParser.hpp"
+#include "../XOF_ThreadPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+static const uint32_t RUNS_PER_THREAD_COUNT = 3;
+
+
+// A tessellated grid written the way exporters usually lay things out - every attribute up front,
+// then the faces as v/vt/vn triangles split across a few materials
+static bool GenerateObj(const std::string& fileName, uint64_t targetSize) {
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    // Roughly 120 bytes of attributes per grid vertex and 2 * 35 bytes of faces per quad
+    uint32_t gridSize = 2;
+    while (static_cast<uint64_t>(gridSize) * gridSize * 190 < targetSize) {
+        ++gridSize;
+    }
+
+    char line[256];
+    file << "# Synthetic benchmark mesh\nmtllib benchmark.mtl\n";
+
+    for (uint32_t y = 0; y < gridSize; ++y) {
+        for (uint32_t x = 0; x < gridSize; ++x) {
+            float u = static_cast<float>(x) / (gridSize - 1);
+            float v = static_cast<float>(y) / (gridSize - 1);
+            int length = snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                                  u * 100.f - 50.f, 0.25f * (x % 7), v * 100.f - 50.f, u, v, 0.f, 1.f, 0.f);
+            file.write(line, length);
+        }
+    }
+
+    const uint32_t materialCount = 4;
+    uint32_t rowsPerMaterial = (gridSize - 1 + materialCount - 1) / materialCount;
+
+    for (uint32_t y = 0; y + 1 < gridSize; ++y) {
+        if (y % rowsPerMaterial == 0) {
+            file << "usemtl material" << (y / rowsPerMaterial) << "\n";
+        }
+        for (uint32_t x = 0; x + 1 < gridSize; ++x) {
+            uint32_t i0 = y * gridSize + x + 1;
+            uint32_t i1 = i0 + 1;
+            uint32_t i2 = i0 + gridSize;
+            uint32_t i3 = i2 + 1;
+            int length = snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\nf %u/%u/%u %u/%u/%u %u/%u/%u\n",
+                                  i0, i0, i0, i2, i2, i2, i1, i1, i1, i1, i1, i1, i2, i2, i2, i3, i3, i3);
+            file.write(line, length);
+        }
+    }
+
+    return file.good();
+}
+
+static bool GenerateMtl(const std::string& fileName) {
+    std::ofstream file(fileName);
+    for (uint32_t i = 0; i < 4; ++i) {
+        file << "newmtl material" << i << "\nmap_Kd diffuse" << i << ".png\n";
+    }
+    return file.good();
+}
+
+// Windows exporters write CRLF .mtl files, with texture options and trailing blanks before the line end - the
+// names have to come out without the '\r' (and the parse has to finish at all)
+static bool CheckCrlfMtl(const std::string& outputDir) {
+    std::string objName = outputDir + "crlf.obj";
+    std::string mtlName = outputDir + "crlf.mtl";
+    {
+        std::ofstream obj(objName, std::ios::binary);
+        obj << "mtllib crlf.mtl\r\nv 0 0 0\r\nv 1 0 0\r\nv 0 1 0\r\nusemtl brick\r\nf 1 2 3\r\n";
+        std::ofstream mtl(mtlName, std::ios::binary);
+        mtl << "newmtl brick\r\nmap_Kd -bm 1.0 brick_diffuse.png\r\nnorm brick_normal.png \t\r\n"
+               "map_Ks brick_specular.png\r\n\r\nnewmtl empty\r\nmap_Kd\r\n";
+        if (!obj.good() || !mtl.good()) {
+            return false;
+        }
+    }
+
+    ObjData data;
+    std::string error;
+    bool isParsed = ParseObj(objName.c_str(), outputDir.c_str(), data, error, nullptr);
+    remove(objName.c_str());
+    remove(mtlName.c_str());
+
+    return isParsed && data.materials.size() == 2 && data.materials[0].name == "brick" &&
+        data.materials[0].diffuseTexName == "brick_diffuse.png" && data.materials[0].normalTexName == "brick_normal.png" &&
+        data.materials[0].specularTexName == "brick_specular.png" && data.materials[1].name == "empty" &&
+        data.materials[1].diffuseTexName.empty();
+}
+
+static double TimeParse(const std::string& fileName, const std::string& materialBasePath, ThreadPool *pool, ObjData& data) {
+    std::string error;
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!ParseObj(fileName.c_str(), materialBasePath.c_str(), data, error, pool)) {
+        std::cerr << "PARSE FAILED: " << error << std::endl;
+        return -1.0;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+
+// ---
+
+
+int main(int argc, char **argv) {
+    std::string outputDir = (argc > 1) ? std::string(argv[1]) + "/" : std::string("./");
+
+    std::vector<uint64_t> sizesInMB;
+    for (int i = 2; i < argc; ++i) {
+        sizesInMB.push_back(strtoull(argv[i], nullptr, 10));
+    }
+    if (sizesInMB.empty()) {
+        sizesInMB = { 10, 100, 1024 };
+    }
+
+    if (!CheckCrlfMtl(outputDir)) {
+        std::cerr << "CRLF .mtl PARSED INCORRECTLY" << std::endl;
+        return 1;
+    }
+
+    if (!GenerateMtl(outputDir + "benchmark.mtl")) {
+        std::cerr << "UNABLE TO WRITE " << outputDir << "benchmark.mtl" << std::endl;
+        return 1;
+    }
+
+    uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    for (uint64_t sizeInMB : sizesInMB) {
+        std::string fileName = outputDir + "benchmark_" + std::to_string(sizeInMB) + "MB.obj";
+        if (!GenerateObj(fileName, sizeInMB * 1024 * 1024)) {
+            std::cerr << "UNABLE TO WRITE " << fileName << std::endl;
+            return 1;
+        }
+
+        std::ifstream generated(fileName, std::ios::binary | std::ios::ate);
+        double fileSizeInMB = static_cast<double>(generated.tellg()) / (1024.0 * 1024.0);
+        std::cout << fileName << " (" << fileSizeInMB << " MB)" << std::endl;
+
+        for (uint32_t threads : threadCounts) {
+            // The calling thread takes part, so n threads is n - 1 workers (and no pool at all for 1)
+            ThreadPool pool;
+            if (threads > 1) {
+                pool.Create(threads - 1);
+            }
+
+            double best = 0.0;
+            ObjData data;
+            for (uint32_t run = 0; run < RUNS_PER_THREAD_COUNT; ++run) {
+                double seconds = TimeParse(fileName, outputDir, (threads > 1) ? &pool : nullptr, data);
+                if (seconds < 0.0) {
+                    return 1;
+                }
+                best = (run == 0) ? seconds : std::min(best, seconds);
+            }
+
+            printf("  %2u thread(s): %8.1f MB/s  (%.3f s, %zu triangles)\n", threads, fileSizeInMB / best, best,
+                   data.materialIds.size());
+        }
+
+        remove(fileName.c_str());
+    }
+
+    remove((outputDir + "benchmark.mtl").c_str());
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    TextureDecodeBenchmark.cpp
+    Desc    :    Standalone texture decode benchmark, no GPU needed - decodes a set
+                 of images the way a mesh's materials are loaded (DecodeTextures,
+                 one image per task, into pooled buffers) and reports MB/s per thread
+                 count. Uses synthetic TGAs when no images are given.
+
+                 Build alongside XOF_TextureDecoder.cpp, XOF_TextureFile.cpp, XOF_MipGenerator.cpp,
+                 XOF_ThreadPool.cpp and XOF_MappedFile.cpp, linked with the Vulkan loader (nothing
+                 is called on a device):
+                 TextureDecodeBenchmark [-mips] [-kaiser] [image...]
+
+===============================================================================
+*/
+#include "../XOF_TextureDecoder.hpp"
+#include "../XOF_TextureFile.hpp"
+#include "../XOF_ThreadPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+static const uint32_t RUNS_PER_THREAD_COUNT = 3;
+static const uint32_t SYNTHETIC_IMAGE_COUNT = 16;
+static const uint32_t SYNTHETIC_IMAGE_SIZE = 2048;
+
+
+// Uncompressed 32-bit TGA of hashed noise over a gradient - stb reads it without inflating anything, so this
+// mostly measures the copies and allocations around the decode. Real PNGs/JPGs are the better test.
+static bool GenerateTga(const std::string& fileName, uint32_t size, uint32_t seed) {
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    uint8_t header[18] = {};
+    header[2] = 2;
+    header[12] = static_cast<uint8_t>(size & 0xff);
+    header[13] = static_cast<uint8_t>(size >> 8);
+    header[14] = static_cast<uint8_t>(size & 0xff);
+    header[15] = static_cast<uint8_t>(size >> 8);
+    header[16] = 32;
+    header[17] = 8;
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    std::vector<uint8_t> row(size * 4);
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            uint32_t hash = (x * 73856093u) ^ (y * 19349663u) ^ (seed * 83492791u);
+            hash ^= hash >> 13;
+            hash *= 0x5bd1e995u;
+            row[x * 4 + 0] = static_cast<uint8_t>((x * 255 / size + (hash & 31)) & 0xff);
+            row[x * 4 + 1] = static_cast<uint8_t>((y * 255 / size + ((hash >> 8) & 31)) & 0xff);
+            row[x * 4 + 2] = static_cast<uint8_t>(hash >> 16);
+            row[x * 4 + 3] = 255;
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+
+    return file.good();
+}
+
+static uint64_t GetFileSize(const std::string& fileName) {
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    return file.is_open() ? static_cast<uint64_t>(file.tellg()) : 0;
+}
+
+
+// ---
+
+
+int main(int argc, char **argv) {
+    MipGeneration mipGeneration = MIP_GENERATION_NONE;
+    MipFilter mipFilter = MIP_FILTER_BOX;
+    std::vector<std::string> fileNames;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument(argv[i]);
+        if (argument == "-mips") {
+            mipGeneration = MIP_GENERATION_CPU;
+        } else if (argument == "-kaiser") {
+            mipFilter = MIP_FILTER_KAISER;
+        } else if (IsTextureFileName(argument)) {
+            // Those are read, not decoded, and the format check needs a device
+            std::cerr << "SKIPPING " << argument << ", only images are decoded" << std::endl;
+        } else {
+            fileNames.push_back(argument);
+        }
+    }
+
+    bool isSynthetic = fileNames.empty();
+    if (isSynthetic) {
+        for (uint32_t i = 0; i < SYNTHETIC_IMAGE_COUNT; ++i) {
+            std::string fileName = "decode_benchmark_" + std::to_string(i) + ".tga";
+            if (!GenerateTga(fileName, SYNTHETIC_IMAGE_SIZE, i)) {
+                std::cerr << "UNABLE TO WRITE " << fileName << std::endl;
+                return 1;
+            }
+            fileNames.push_back(fileName);
+        }
+    }
+
+    // What Mesh hands the decoder, minus the device - no blits, no baked files
+    std::vector<ImageDesc> descs(fileNames.size());
+    uint64_t sourceBytes = 0;
+    for (size_t i = 0; i < fileNames.size(); ++i) {
+        descs[i].format = VK_FORMAT_R8G8B8A8_UNORM;
+        descs[i].tiling = VK_IMAGE_TILING_OPTIMAL;
+        descs[i].fileName = const_cast<char*>(fileNames[i].c_str());
+        descs[i].mipGeneration = mipGeneration;
+        descs[i].mipFilter = mipFilter;
+        sourceBytes += GetFileSize(fileNames[i]);
+    }
+
+    uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    printf("%zu images, %.1f MB on disk%s\n", fileNames.size(), sourceBytes / (1024.0 * 1024.0),
+           (mipGeneration == MIP_GENERATION_CPU) ? ", with CPU mips" : "");
+
+    PixelBufferPool buffers;
+    std::vector<DecodedTexture> decoded(descs.size());
+    for (uint32_t threads : threadCounts) {
+        // The calling thread takes part, so n threads is n - 1 workers (and no pool at all for 1)
+        ThreadPool pool;
+        if (threads > 1) {
+            pool.Create(threads - 1);
+        }
+
+        double best = 0.0;
+        uint64_t decodedBytes = 0;
+        uint32_t failedCount = 0;
+        for (uint32_t run = 0; run < RUNS_PER_THREAD_COUNT; ++run) {
+            auto start = std::chrono::high_resolution_clock::now();
+            DecodeTextures(descs.data(), static_cast<uint32_t>(descs.size()), buffers, (threads > 1) ? &pool : nullptr,
+                           decoded.data());
+            double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            best = (run == 0) ? seconds : std::min(best, seconds);
+
+            // Handed back like the texture cache does once they're staged, so later runs reuse them
+            decodedBytes = 0;
+            failedCount = 0;
+            for (DecodedTexture& texture : decoded) {
+                decodedBytes += texture.data.size();
+                failedCount += texture.isDecoded ? 0 : 1;
+                buffers.Release(texture.data);
+            }
+        }
+
+        printf("  %2u thread(s): %8.1f MB/s decoded  %8.1f MB/s source  (%.3f s%s)\n", threads,
+               decodedBytes / (1024.0 * 1024.0) / best, sourceBytes / (1024.0 * 1024.0) / best, best,
+               failedCount ? ", some images failed" : "");
+    }
+
+    if (isSynthetic) {
+        for (const std::string& fileName : fileNames) {
+            remove(fileName.c_str());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,251 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    TextureEncoder.cpp
+    Desc    :    Offline texture baker - decodes PNG/JPG/TGA images, generates
+                 their mip chains and block-compresses every level, writing a
+                 .ktx2 next to each source that Texture loads in its place.
+
+                 Given an .obj, bakes every texture its materials reference, picked
+                 by use: normal maps (norm) go BC5, diffuse and specular maps BC7
+                 (BC1, or BC3 with alpha, when -fast). Images given directly are
+                 treated as diffuse unless -normal is set or the name looks like a
+                 normal map (_n, _nrm, _ddn, normal).
+
+                 Build alongside XOF_BlockCompression.cpp, XOF_MipGenerator.cpp,
+                 XOF_TextureFile.cpp, XOF_ObjParser.cpp, XOF_ThreadPool.cpp and XOF_MappedFile.cpp:
+                 TextureEncoder [-fast] [-kaiser] [-normal] file.obj|image...
+
+===============================================================================
+*/
+#include "../XOF_BlockCompression.hpp"
+#include "../XOF_MipGenerator.hpp"
+#include "../XOF_ObjParser.hpp"
+#include "../XOF_TextureFile.hpp"
+#include "../XOF_ThreadPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+
+enum TextureUsage {
+    TEXTURE_USAGE_COLOUR,
+    TEXTURE_USAGE_NORMAL,
+};
+
+struct EncoderOptions {
+    bool                        fast;
+    MipFilter                   mipFilter;
+    bool                        forceNormal;
+};
+
+struct EncodeJob {
+    std::string                 fileName;
+    TextureUsage                usage;
+};
+
+
+static std::string ToLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](char c) {
+        return static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    });
+    return text;
+}
+
+static bool LooksLikeNormalMap(const std::string& fileName) {
+    std::string name = ToLower(fileName.substr(fileName.find_last_of("/\\") + 1));
+    name = name.substr(0, name.find_last_of('.'));
+
+    static const char *suffixes[] = { "_n", "_nrm", "_norm", "_ddn", "_normal" };
+    for (const char *suffix : suffixes) {
+        size_t length = strlen(suffix);
+        if (name.size() >= length && name.compare(name.size() - length, length, suffix) == 0) {
+            return true;
+        }
+    }
+    return name.find("normal") != std::string::npos;
+}
+
+// Box/Kaiser filtered normals come out short, and BC5 only keeps X and Y - put them back on the unit sphere
+// so the Z the shader rebuilds matches
+static void RenormaliseNormals(uint8_t *texels, size_t texelCount) {
+    for (size_t i = 0; i < texelCount; ++i) {
+        uint8_t *texel = texels + i * 4;
+        float normal[3];
+        for (uint32_t c = 0; c < 3; ++c) {
+            normal[c] = texel[c] / 127.5f - 1.f;
+        }
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length < 1e-4f) {
+            continue;
+        }
+        for (uint32_t c = 0; c < 3; ++c) {
+            float value = (normal[c] / length + 1.f) * 127.5f + 0.5f;
+            texel[c] = static_cast<uint8_t>(std::min(std::max(value, 0.f), 255.f));
+        }
+    }
+}
+
+static bool Encode(const EncodeJob& job, const EncoderOptions& options, ThreadPool& pool) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    int width, height, channels;
+    stbi_uc *pixels = stbi_load(job.fileName.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels) {
+        fprintf(stderr, "%s: %s\n", job.fileName.c_str(), stbi_failure_reason());
+        return false;
+    }
+
+    uint32_t levelCount = MipLevelCount(width, height);
+    std::vector<MipLevelDesc> levels(levelCount);
+    std::vector<uint8_t> chain(ComputeMipChainLayout(width, height, levelCount, 4, levels.data()));
+    memcpy(chain.data(), pixels, static_cast<size_t>(width) * height * 4);
+    stbi_image_free(pixels);
+
+    GenerateMipChain(chain.data(), width, height, levelCount, options.mipFilter, &pool);
+
+    bool hasAlpha = false;
+    for (size_t i = 3; i < static_cast<size_t>(width) * height * 4 && !hasAlpha; i += 4) {
+        hasAlpha = (chain[i] != 255);
+    }
+
+    BlockFormat blockFormat;
+    VkFormat format;
+    if (job.usage == TEXTURE_USAGE_NORMAL) {
+        for (uint32_t level = 1; level < levelCount; ++level) {
+            RenormaliseNormals(&chain[levels[level].offset], static_cast<size_t>(levels[level].width) * levels[level].height);
+        }
+        blockFormat = BLOCK_FORMAT_BC5;
+        format = VK_FORMAT_BC5_UNORM_BLOCK;
+    } else if (!options.fast) {
+        blockFormat = BLOCK_FORMAT_BC7;
+        format = VK_FORMAT_BC7_UNORM_BLOCK;
+    } else if (hasAlpha) {
+        blockFormat = BLOCK_FORMAT_BC3;
+        format = VK_FORMAT_BC3_UNORM_BLOCK;
+    } else {
+        blockFormat = BLOCK_FORMAT_BC1;
+        format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    }
+
+    TextureFile texture;
+    texture.format = format;
+    texture.width = width;
+    texture.height = height;
+    texture.levels.resize(levelCount);
+
+    size_t offset = 0;
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        TextureFileLevel& textureLevel = texture.levels[level];
+        textureLevel.offset = offset;
+        textureLevel.size = GetCompressedSize(levels[level].width, levels[level].height, blockFormat);
+        textureLevel.width = levels[level].width;
+        textureLevel.height = levels[level].height;
+        offset += textureLevel.size;
+    }
+    texture.data.resize(offset);
+
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        CompressImage(&chain[levels[level].offset], levels[level].width, levels[level].height, blockFormat,
+                      &texture.data[texture.levels[level].offset], &pool);
+    }
+
+    std::string bakedName = GetBakedTextureName(job.fileName);
+    std::string error;
+    if (!WriteKtx2(bakedName.c_str(), texture, error)) {
+        fprintf(stderr, "%s: %s\n", job.fileName.c_str(), error.c_str());
+        return false;
+    }
+
+    static const char *formatNames[] = { "BC1", "BC3", "BC5", "BC7" };
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    printf("%-48s %5dx%-5d %4u %-4s %9.1fKB -> %8.1fKB %8.1fms\n", job.fileName.c_str(), width, height, levelCount,
+           formatNames[blockFormat], chain.size() / 1024.0, texture.data.size() / 1024.0, seconds * 1000.0);
+    return true;
+}
+
+// Every texture the model's materials use, paths taken relative to the model like Mesh does with Resources/
+static bool CollectObjTextures(const char *fileName, ThreadPool& pool, std::vector<EncodeJob>& jobs) {
+    std::string path(fileName);
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+    ObjData obj;
+    std::string error;
+    if (!ParseObj(fileName, directory.c_str(), obj, error, &pool)) {
+        fprintf(stderr, "%s: %s\n", fileName, error.c_str());
+        return false;
+    }
+
+    auto add = [&](const std::string& name, TextureUsage usage) {
+        if (!name.empty()) {
+            jobs.push_back({ directory + name, usage });
+        }
+    };
+    for (const ObjMaterial& material : obj.materials) {
+        add(material.diffuseTexName, TEXTURE_USAGE_COLOUR);
+        add(material.normalTexName, TEXTURE_USAGE_NORMAL);
+        add(material.specularTexName, TEXTURE_USAGE_COLOUR);
+    }
+    return true;
+}
+
+
+// ---
+
+
+int main(int argc, char **argv) {
+    EncoderOptions options = { false, MIP_FILTER_BOX, false };
+    std::vector<EncodeJob> jobs;
+
+    ThreadPool pool;
+    pool.Create(0);
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument(argv[i]);
+        if (argument == "-fast") {
+            options.fast = true;
+        } else if (argument == "-kaiser") {
+            options.mipFilter = MIP_FILTER_KAISER;
+        } else if (argument == "-normal") {
+            options.forceNormal = true;
+        } else if (ToLower(argument.substr(std::min(argument.find_last_of('.'), argument.size()))) == ".obj") {
+            CollectObjTextures(argv[i], pool, jobs);
+        } else {
+            bool isNormal = options.forceNormal || LooksLikeNormalMap(argument);
+            jobs.push_back({ argument, isNormal ? TEXTURE_USAGE_NORMAL : TEXTURE_USAGE_COLOUR });
+        }
+    }
+
+    if (jobs.empty()) {
+        printf("Usage: TextureEncoder [-fast] [-kaiser] [-normal] file.obj|image...\n");
+        return 1;
+    }
+
+    // Materials share textures, each is baked once (as a normal map if anything uses it as one)
+    std::sort(jobs.begin(), jobs.end(), [](const EncodeJob& a, const EncodeJob& b) {
+        return (a.fileName != b.fileName) ? (a.fileName < b.fileName) : (a.usage > b.usage);
+    });
+    jobs.erase(std::unique(jobs.begin(), jobs.end(), [](const EncodeJob& a, const EncodeJob& b) {
+        return a.fileName == b.fileName;
+    }), jobs.end());
+
+    // Blocks and mip rows are spread over the pool, images go one after another
+    printf("%-48s %11s %4s %-4s %11s    %10s %10s\n", "texture", "size", "mips", "fmt", "source", "baked", "time");
+    uint32_t failedCount = 0;
+    for (const EncodeJob& job : jobs) {
+        if (!Encode(job, options, pool)) {
+            ++failedCount;
+        }
+    }
+
+    return (failedCount == 0) ? 0 : 1;
+}
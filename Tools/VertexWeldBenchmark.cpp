@@ -0,0 +1,136 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    VertexWeldBenchmark.cpp
+    Desc    :    Standalone vertex welding benchmark - std::unordered_map (the old
+                 Mesh::Load path) against VertexWelder and sharded WeldVertices, on
+                 synthetic million-triangle meshes.
+
+                 Build alongside XOF_VertexWelder.cpp, XOF_VertexLayout.cpp and XOF_ThreadPool.cpp:
+                 VertexWeldBenchmark [triangleCountInMillions...]
+
+===============================================================================
+*/
+#include "../XOF_VertexWelder.hpp"
+#include "../XOF_ThreadPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+
+
+static const uint32_t RUNS_PER_METHOD = 3;
+
+
+// Corners of a smooth grid - each interior vertex is shared by six triangles, the usual ratio for closed meshes.
+// Every few rows get a hard edge (same position, different normal), which the old hash can't tell apart.
+static void GenerateCorners(uint32_t triangleCount, std::vector<Vertex>& corners) {
+    uint32_t gridSize = 2;
+    while (2ull * (gridSize - 1) * (gridSize - 1) < triangleCount) {
+        ++gridSize;
+    }
+
+    auto makeVertex = [gridSize](uint32_t x, uint32_t y, bool isHardEdge) {
+        Vertex v = {};
+        v.pos = glm::vec3(static_cast<float>(x), 0.25f * (x % 7), static_cast<float>(y));
+        v.normal = isHardEdge ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+        v.texCoord = glm::vec2(static_cast<float>(x) / gridSize, static_cast<float>(y) / gridSize);
+        return v;
+    };
+
+    corners.clear();
+    corners.reserve(static_cast<size_t>(triangleCount) * 3);
+    for (uint32_t y = 0; y + 1 < gridSize && corners.size() < triangleCount * 3ull; ++y) {
+        bool isHardEdge = (y % 8) == 0;
+        for (uint32_t x = 0; x + 1 < gridSize && corners.size() < triangleCount * 3ull; ++x) {
+            corners.push_back(makeVertex(x, y, isHardEdge));
+            corners.push_back(makeVertex(x, y + 1, false));
+            corners.push_back(makeVertex(x + 1, y, isHardEdge));
+            corners.push_back(makeVertex(x + 1, y, isHardEdge));
+            corners.push_back(makeVertex(x, y + 1, false));
+            corners.push_back(makeVertex(x + 1, y + 1, false));
+        }
+    }
+}
+
+// What Mesh::Load used to do
+static void WeldWithUnorderedMap(const std::vector<Vertex>& corners, std::vector<Vertex>& vertices,
+                                 std::vector<unsigned int>& indices) {
+    std::unordered_map<Vertex, unsigned int> uniqueVertices;
+    vertices.clear();
+    indices.clear();
+
+    for (const Vertex& v : corners) {
+        if (uniqueVertices.count(v) == 0) {
+            uniqueVertices[v] = static_cast<unsigned int>(vertices.size());
+            vertices.push_back(v);
+        }
+        indices.push_back(uniqueVertices[v]);
+    }
+}
+
+template<typename Func>
+static double TimeBest(Func func) {
+    double best = 0.0;
+    for (uint32_t run = 0; run < RUNS_PER_METHOD; ++run) {
+        auto start = std::chrono::high_resolution_clock::now();
+        func();
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        best = (run == 0) ? seconds : std::min(best, seconds);
+    }
+    return best;
+}
+
+
+// ---
+
+
+int main(int argc, char **argv) {
+    std::vector<uint32_t> triangleCounts;
+    for (int i = 1; i < argc; ++i) {
+        triangleCounts.push_back(static_cast<uint32_t>(strtod(argv[i], nullptr) * 1000000.0));
+    }
+    if (triangleCounts.empty()) {
+        triangleCounts = { 1000000, 4000000 };
+    }
+
+    uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (uint32_t triangleCount : triangleCounts) {
+        std::vector<Vertex> corners;
+        GenerateCorners(triangleCount, corners);
+        uint32_t cornerCount = static_cast<uint32_t>(corners.size());
+
+        std::vector<Vertex> referenceVertices, vertices;
+        std::vector<unsigned int> referenceIndices, indices;
+
+        double mapSeconds = TimeBest([&]() { WeldWithUnorderedMap(corners, referenceVertices, referenceIndices); });
+        printf("%u triangles, %u corners -> %zu vertices\n", cornerCount / 3, cornerCount, referenceVertices.size());
+        printf("  unordered_map          : %7.1f ms\n", mapSeconds * 1000.0);
+
+        for (uint32_t threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+            ThreadPool pool;
+            if (threads > 1) {
+                pool.Create(threads - 1);
+            }
+
+            double seconds = TimeBest([&]() {
+                WeldVertices(corners.data(), cornerCount, vertices, indices, (threads > 1) ? &pool : nullptr);
+            });
+
+            bool matches = (vertices.size() == referenceVertices.size()) && (indices == referenceIndices);
+            printf("  WeldVertices, %2u thread(s): %7.1f ms  (%.1fx)%s\n", threads, seconds * 1000.0, mapSeconds / seconds,
+                   matches ? "" : "  OUTPUT DIFFERS");
+
+            if (threads == maxThreads) {
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
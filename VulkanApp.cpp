@@ -12,17 +12,63 @@
 static const unsigned int INITIAL_WINDOW_WIDTH = 800;
 static const unsigned int INITIAL_WINDOW_HEIGHT = 600;
 
+// Vertex buffer packing for the scene meshes, the vertex shader has to be the one written against it. Compact
+// (with "../vertCompact.spv") halves the vertex size but is lossy - only for meshes that fit its ranges.
+typedef FullVertexLayout MeshVertexLayout;
+static const char *MESH_VERTEX_SHADER = "../vert.spv";
+// Coarser LODs are used for as long as their error stays under this on screen
+static const float LOD_MAX_PIXEL_ERROR = 1.f;
+// The instance benchmark's grid when none is given (10K instances), and the frames it lets settle and then times
+// for each of the two draw paths
+static const uint32_t INSTANCE_BENCHMARK_GRID_SIZE = 100;
+static const uint32_t INSTANCE_BENCHMARK_WARMUP_FRAMES = 60;
+static const uint32_t INSTANCE_BENCHMARK_FRAMES = 500;
+// The instance stream follows the mesh's vertices, the vertex shaders take it from location 5 up
+static const uint32_t MESH_VERTEX_BINDING = 0;
+static const uint32_t MESH_INSTANCE_BINDING = 1;
+static const uint32_t MESH_INSTANCE_FIRST_LOCATION = 5;
+// Room in the shared mesh buffers (in vertices, and bytes of indices), meshes that don't fit get their own
+static const uint32_t GEOMETRY_POOL_VERTEX_CAPACITY = 1024 * 1024;
+static const VkDeviceSize GEOMETRY_POOL_INDEX_CAPACITY = 32 * 1024 * 1024;
+// Textures the bindless table has room for, across every mesh
+static const uint32_t TEXTURE_TABLE_CAPACITY = 4096;
+// Print the texture cache's hits and savings each time a mesh's textures are registered
+static const bool LOG_TEXTURE_CACHE_STATS = false;
+// Indirect draws a frame can hold (dropped past it), and the push constant that carries each batch's first one
+static const uint32_t MESH_MAX_DRAW_COUNT = 16 * 1024;
+static const uint32_t DRAW_OFFSET_PUSH_CONSTANT = 0;
+
 
 static unsigned int fps;
 static double lastTime;
+static double recordTime;
 
 
 void VulkanApp::Run() { 
+    if( mIsInstanceBenchmark && mInstanceGridSize == 1 ) {
+        mInstanceGridSize = INSTANCE_BENCHMARK_GRID_SIZE;
+    }
     InitWindow();
     InitVulkan();
     MainLoop();
 }
 
+void VulkanApp::SetFramesInFlight( uint32_t count ) {
+    mFramesInFlight = std::max( 1u, std::min( count, MAX_FRAMES_IN_FLIGHT ) );
+}
+
+void VulkanApp::SetInstanceGridSize( uint32_t size ) {
+    mInstanceGridSize = std::max( 1u, size );
+}
+
+void VulkanApp::SetPerObjectDraws( bool isPerObject ) {
+    mIsPerObjectDraws = isPerObject;
+}
+
+void VulkanApp::SetInstanceBenchmark( bool isEnabled ) {
+    mIsInstanceBenchmark = isEnabled;
+}
+
 VkBool32 VulkanApp::DebugCallback( VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT objType,
                                    uint64_t obj, size_t location, int32_t code,
                                    const char *layerPrefix, const char *msg, void *userData ) {
@@ -44,6 +90,9 @@ std::vector<const char*> VulkanApp::GetRequiredExtensions() {
         extensions.push_back( VK_EXT_DEBUG_REPORT_EXTENSION_NAME );
     }
 
+    // Querying the descriptor indexing features (device extensions chain their feature structs through it)
+    extensions.push_back( "VK_KHR_get_physical_device_properties2" );
+
     return extensions;
 }
 
@@ -168,35 +217,135 @@ void VulkanApp::CreateLogicalDevice() {
     QueueFamilyDesc queueFamilyDesc = FindQueueFamilies( &mPhysicalDevice );
 
     std::set<int> uniqueQueueFamies = {queueFamilyDesc.graphicsFamily, queueFamilyDesc.presentationFamily};
-    std::unique_ptr<VkDeviceQueueCreateInfo> createQueueInfo( new VkDeviceQueueCreateInfo[uniqueQueueFamies.size()] );
+    if( queueFamilyDesc.transferFamily >= 0 ) {
+        uniqueQueueFamies.insert( queueFamilyDesc.transferFamily );
+    }
+    std::unique_ptr<VkDeviceQueueCreateInfo[]> createQueueInfo( new VkDeviceQueueCreateInfo[uniqueQueueFamies.size()] );
 
     float priority = 1.f;
+    unsigned int queueInfoIndex = 0;
     for( auto queueFamily : uniqueQueueFamies ) {
-        memset( &createQueueInfo.get()[queueFamily], 0x00, sizeof( VkDeviceQueueCreateInfo ) );
-        createQueueInfo.get()[queueFamily].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        createQueueInfo.get()[queueFamily].queueFamilyIndex = queueFamily;
-        createQueueInfo.get()[queueFamily].queueCount = 1;
-        createQueueInfo.get()[queueFamily].pQueuePriorities = &priority;
+        VkDeviceQueueCreateInfo &queueInfo = createQueueInfo[queueInfoIndex++];
+        memset( &queueInfo, 0x00, sizeof( VkDeviceQueueCreateInfo ) );
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = queueFamily;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &priority;
     }
 
+    // Multi-draw indirect lets a whole batch of indirect draws go in one call, and the count variant reads the
+    // number of draws from a buffer - neither is required, IndirectDrawBuffer falls back to one call per draw
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures( mPhysicalDevice, &supportedFeatures );
     VkPhysicalDeviceFeatures physicaDeviceFeatures = {};
+    physicaDeviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    mSupportsMultiDrawIndirect = ( supportedFeatures.multiDrawIndirect == VK_TRUE );
+    // Per-object draws pick their instance with firstInstance, recorded directly without this
+    physicaDeviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    mSupportsDrawIndirectFirstInstance = ( supportedFeatures.drawIndirectFirstInstance == VK_TRUE );
+    // For the BC textures baked by Tools/TextureEncoder.cpp, without it Texture decodes the source images instead
+    physicaDeviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+    std::vector<const char*> extensions( gRequiredExtensions, gRequiredExtensions + REQUIRED_EXTENSION_COUNT );
+    bool hasDrawIndirectCount = false;
+    {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties( mPhysicalDevice, nullptr, &extensionCount, nullptr );
+        std::vector<VkExtensionProperties> supportedExtensions( extensionCount );
+        vkEnumerateDeviceExtensionProperties( mPhysicalDevice, nullptr, &extensionCount, supportedExtensions.data() );
+        for( const auto& extension : supportedExtensions ) {
+            if( strcmp( extension.extensionName, "VK_KHR_draw_indirect_count" ) == 0 ) {
+                hasDrawIndirectCount = true;
+                extensions.push_back( "VK_KHR_draw_indirect_count" );
+            }
+        }
+    }
+
+    // Picked for supporting them, see IsPhysicalDeviceSuitable
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures;
+    CheckDescriptorIndexingSupport( &mPhysicalDevice, &descriptorIndexingFeatures );
 
     VkDeviceCreateInfo deviceCreateInfo = {};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceCreateInfo.pNext = &descriptorIndexingFeatures;
     deviceCreateInfo.pQueueCreateInfos = createQueueInfo.get();
     deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>( uniqueQueueFamies.size() );
     deviceCreateInfo.pEnabledFeatures = &physicaDeviceFeatures;
     deviceCreateInfo.enabledLayerCount = enableValidationLayers? VALIDATION_LAYER_COUNT : 0;
     deviceCreateInfo.ppEnabledLayerNames = enableValidationLayers? gValidationLayers : nullptr;
-    deviceCreateInfo.enabledExtensionCount = REQUIRED_EXTENSION_COUNT;
-    deviceCreateInfo.ppEnabledExtensionNames = gRequiredExtensions;
+    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>( extensions.size() );
+    deviceCreateInfo.ppEnabledExtensionNames = extensions.data();
 
     if( vkCreateDevice( mPhysicalDevice, &deviceCreateInfo, nullptr, &mLogicalDevice ) != VK_SUCCESS ) {
         throw std::runtime_error( "Could not create logical device!" );
     }
 
+    if( hasDrawIndirectCount ) {
+        mDrawIndexedIndirectCount = vkGetDeviceProcAddr( mLogicalDevice, "vkCmdDrawIndexedIndirectCountKHR" );
+    }
+
     vkGetDeviceQueue( mLogicalDevice, queueFamilyDesc.graphicsFamily, 0, &mGraphicsQueue );
     vkGetDeviceQueue( mLogicalDevice, queueFamilyDesc.presentationFamily, 0, &mPresentationQueue );
+
+    if( queueFamilyDesc.transferFamily >= 0 ) {
+        vkGetDeviceQueue( mLogicalDevice, queueFamilyDesc.transferFamily, 0, &mTransferQueue );
+    } else {
+        mTransferQueue = mGraphicsQueue;
+    }
+}
+
+void VulkanApp::CreateMemoryAllocator() {
+    MemoryAllocatorDesc allocatorDesc;
+    allocatorDesc.physicalDevice = mPhysicalDevice;
+    allocatorDesc.logicalDevice = mLogicalDevice;
+
+    if( !mMemoryAllocator.Create( allocatorDesc ) ) {
+        throw std::runtime_error( "Could not create memory allocator!" );
+    }
+}
+
+void VulkanApp::CreateUploadContext() {
+    QueueFamilyDesc queueFamilyDesc = FindQueueFamilies( &mPhysicalDevice );
+
+    UploadContextDesc uploadContextDesc;
+    uploadContextDesc.physicalDevice = mPhysicalDevice;
+    uploadContextDesc.logicalDevice = mLogicalDevice;
+    // Streaming copies go through the transfer queue when there is one so they don't compete with rendering,
+    // the upload context then handles handing ownership back to the graphics family
+    bool hasTransferFamily = ( queueFamilyDesc.transferFamily >= 0 );
+    uploadContextDesc.queue = mTransferQueue;
+    uploadContextDesc.queueFamilyIndex = hasTransferFamily ? queueFamilyDesc.transferFamily : queueFamilyDesc.graphicsFamily;
+    uploadContextDesc.ownerQueueFamilyIndex = queueFamilyDesc.graphicsFamily;
+    uploadContextDesc.allocator = &mMemoryAllocator;
+
+    if( !mUploadContext.Create( uploadContextDesc ) ) {
+        throw std::runtime_error( "Could not create upload context!" );
+    }
+}
+
+void VulkanApp::CreateGeometryPool() {
+    GeometryPoolDesc geometryPoolDesc;
+    geometryPoolDesc.physicalDevice = mPhysicalDevice;
+    geometryPoolDesc.logicalDevice = mLogicalDevice;
+    geometryPoolDesc.allocator = &mMemoryAllocator;
+    geometryPoolDesc.vertexStride = GetVertexLayoutInfo<MeshVertexLayout>().stride;
+    geometryPoolDesc.vertexCapacity = GEOMETRY_POOL_VERTEX_CAPACITY;
+    geometryPoolDesc.indexCapacity = GEOMETRY_POOL_INDEX_CAPACITY;
+
+    if( !mGeometryPool.Create( geometryPoolDesc ) ) {
+        throw std::runtime_error( "Could not create geometry pool!" );
+    }
+}
+
+void VulkanApp::CreateAssetLoader() {
+    AssetLoaderDesc assetLoaderDesc;
+    assetLoaderDesc.uploadContext = &mUploadContext;
+    assetLoaderDesc.threadPool = nullptr;
+    assetLoaderDesc.logLoadTimes = false;
+
+    if( !mAssetLoader.Create( assetLoaderDesc ) ) {
+        throw std::runtime_error( "Could not create asset loader!" );
+    }
 }
 
 void VulkanApp::CreateSwapChain() {
@@ -342,8 +491,8 @@ void VulkanApp::CreateDescriptorSetLayout() {
     VkDescriptorSetLayoutBinding uboLayoutBinding = {};
     // Corresponds to the binding used in the shader
     uboLayoutBinding.binding = 0;
-    // Corresponds to the type used in the shader
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    // Corresponds to the type used in the shader (dynamic so the per-frame slice of the uniform ring is picked at bind time)
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     // NOTE: Could store a matrix here for each bone in a skeleton;
     // (for now we're using a single object so we set it to 1)
     uboLayoutBinding.descriptorCount = 1;
@@ -352,35 +501,26 @@ void VulkanApp::CreateDescriptorSetLayout() {
     // Only relevant to texture sampling
     uboLayoutBinding.pImmutableSamplers = nullptr;
 
-    VkDescriptorSetLayoutBinding samplerBinding[3] = {};
-    samplerBinding[0].binding = 1;
-    samplerBinding[0].descriptorCount = 2; // 2 diffuse, 2 normal and 2 specular maps for the barrel model
-    samplerBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerBinding[0].pImmutableSamplers = nullptr;
-    samplerBinding[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    samplerBinding[1].binding = 2;
-    samplerBinding[1].descriptorCount = 2;
-    samplerBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerBinding[1].pImmutableSamplers = nullptr;
-    samplerBinding[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    samplerBinding[2].binding = 3;
-    samplerBinding[2].descriptorCount = 2;
-    samplerBinding[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerBinding[2].pImmutableSamplers = nullptr;
-    samplerBinding[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    // Textures are bound separately, as set 1 (mTextureTable)
 
     // Directional light specific
     VkDescriptorSetLayoutBinding directionalLightBinding = {};
     directionalLightBinding.binding = 4;
     directionalLightBinding.descriptorCount = 1;
-    directionalLightBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    directionalLightBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     directionalLightBinding.pImmutableSamplers = nullptr;
     directionalLightBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
     // -----------------------
 
-    VkDescriptorSetLayoutBinding bindings[] = {uboLayoutBinding, samplerBinding[0], samplerBinding[1], samplerBinding[2], directionalLightBinding};
+    // Per-draw data, indexed by the draw (dynamic, the per-frame slice of the indirect draw buffer is picked at bind time)
+    VkDescriptorSetLayoutBinding drawDataBinding = {};
+    drawDataBinding.binding = 5;
+    drawDataBinding.descriptorCount = 1;
+    drawDataBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    drawDataBinding.pImmutableSamplers = nullptr;
+    drawDataBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutBinding bindings[] = {uboLayoutBinding, directionalLightBinding, drawDataBinding};
 
     VkDescriptorSetLayoutCreateInfo descriptorSetlayoutCreateInfo = {};
     descriptorSetlayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -394,18 +534,31 @@ void VulkanApp::CreateDescriptorSetLayout() {
 
 void VulkanApp::CreateGraphicsPipeline() {
     VkPipelineShaderStageCreateInfo shaderStages[] = { 
-        mTempMesh.GetTempMaterial().vertexShader.GetPipelineCreationInfo(),
-        mTempMesh.GetTempMaterial().fragmentShader.GetPipelineCreationInfo(),
+        mTempMesh->GetTempMaterial().vertexShader.GetPipelineCreationInfo(),
+        mTempMesh->GetTempMaterial().fragmentShader.GetPipelineCreationInfo(),
     };
 
     // Vertex input
     VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
     vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
-    vertexInputCreateInfo.pVertexBindingDescriptions = &Vertex::GetBindingDescription();
-    auto attributeDescs = Vertex::GetVertexInputAttributeDescriptions();
-    vertexInputCreateInfo.vertexAttributeDescriptionCount = (uint32_t)attributeDescs.size();
-    vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescs.data();
+    // The mesh's vertices, then the per-instance transforms
+    const VertexLayoutInfo& vertexLayout = mTempMesh->GetVertexLayout();
+    VkVertexInputBindingDescription bindingDescriptions[] = {
+        vertexLayout.bindingDescription,
+        InstanceBuffer::GetBindingDescription( MESH_INSTANCE_BINDING ),
+    };
+    bindingDescriptions[0].binding = MESH_VERTEX_BINDING;
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions( vertexLayout.attributeDescriptions );
+    for( auto& attributeDescription : attributeDescriptions ) {
+        attributeDescription.binding = MESH_VERTEX_BINDING;
+    }
+    auto instanceAttributeDescriptions = InstanceBuffer::GetAttributeDescriptions( MESH_INSTANCE_BINDING, MESH_INSTANCE_FIRST_LOCATION );
+    attributeDescriptions.insert( attributeDescriptions.end(), instanceAttributeDescriptions.begin(), instanceAttributeDescriptions.end() );
+
+    vertexInputCreateInfo.vertexBindingDescriptionCount = sizeof( bindingDescriptions ) / sizeof( VkVertexInputBindingDescription );
+    vertexInputCreateInfo.pVertexBindingDescriptions = bindingDescriptions;
+    vertexInputCreateInfo.vertexAttributeDescriptionCount = (uint32_t)attributeDescriptions.size();
+    vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
     // Input assembly
     VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
@@ -506,18 +659,19 @@ void VulkanApp::CreateGraphicsPipeline() {
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
     pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 
-    VkDescriptorSetLayout descriptorSetLayouts[] = {mDescriptorSetLayout};
-    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    // Set 0 is per frame, set 1 the texture table
+    VkDescriptorSetLayout descriptorSetLayouts[] = {mDescriptorSetLayout, mTextureTable.GetLayout()};
+    pipelineLayoutCreateInfo.setLayoutCount = sizeof( descriptorSetLayouts ) / sizeof( VkDescriptorSetLayout );
     pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayouts;
 
-    // Push constants
-    VkPushConstantRange textureIndexPushConstant = { 0 };
-    textureIndexPushConstant.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    textureIndexPushConstant.offset = 0;
-    textureIndexPushConstant.size = sizeof(int);
+    // Push constants (the first draw of the indirect batch being drawn, see IndirectDrawBuffer::RecordBatch)
+    VkPushConstantRange drawOffsetPushConstant = { 0 };
+    drawOffsetPushConstant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    drawOffsetPushConstant.offset = DRAW_OFFSET_PUSH_CONSTANT;
+    drawOffsetPushConstant.size = sizeof(int);
     // Add to pipeline layout
     pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-    pipelineLayoutCreateInfo.pPushConstantRanges = &textureIndexPushConstant;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &drawOffsetPushConstant;
 
     if( vkCreatePipelineLayout( mLogicalDevice, &pipelineLayoutCreateInfo, nullptr, &mPipelineLayout ) != VK_SUCCESS ) {
         throw std::runtime_error( "Failed to create pipeline layout!" );
@@ -597,8 +751,9 @@ void VulkanApp::CreateCommandBuffers() {
         vkFreeCommandBuffers( mLogicalDevice, mCommandPool, (uint32_t)mCommandBuffers.size(), mCommandBuffers.data() );
     }
 
-    // Allocate and record commands for each swap-chain image
-    mCommandBuffers.resize( mFramebuffers.size() );
+    // Allocate one command buffer per frame in flight, they're recorded in DrawFrame once the
+    // target swap-chain image is known (the pool allows individual resets)
+    mCommandBuffers.resize( mFramesInFlight );
 
     VkCommandBufferAllocateInfo cbAllocateInfo = {};
     cbAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -609,98 +764,221 @@ void VulkanApp::CreateCommandBuffers() {
     if( vkAllocateCommandBuffers( mLogicalDevice, &cbAllocateInfo, mCommandBuffers.data() ) != VK_SUCCESS ) {
         throw std::runtime_error( "Failed to allocate command buffers!" );
     }
+}
+
+// CommandBufferBegin + RenderPassBegin  + BindPipeline + Draw + EndRenderPass + EndCommandBuffer
+void VulkanApp::RecordCommandBuffer( VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameIndex ) {
+    VkCommandBufferBeginInfo cbBeginInfo = {};
+    cbBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cbBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    // Optional (only relevant for secondary command buffers)
+    //cbBeginInfo.pInheritanceInfo = nullptr;
+
+    // Implicitly resets the command buffer
+    vkBeginCommandBuffer( commandBuffer, &cbBeginInfo );
+
+    // Take ownership of anything the transfer queue has finished uploading since the last frame
+    mUploadContext.RecordAcquireBarriers( commandBuffer );
+
+    VkRenderPassBeginInfo renderPassBeginInfo = {};
+    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassBeginInfo.renderPass = mRenderPass;
+    renderPassBeginInfo.framebuffer = mFramebuffers[imageIndex];
+    renderPassBeginInfo.renderArea.offset = {0, 0};
+    renderPassBeginInfo.renderArea.extent = mSwapChainExtents;
+    
+    // One for the colour attachment, one for the depth/stencil (you need one clearValue for each attachment)
+    VkClearValue clearValues[2] = {};
+    clearValues[0].color = {0.25f, 0.25f, 0.25f, 1.f};
+    clearValues[1].depthStencil = {1.f, 0};
+
+    renderPassBeginInfo.clearValueCount = sizeof( clearValues ) / sizeof( VkClearValue );
+    renderPassBeginInfo.pClearValues = clearValues;
+
+    vkCmdBeginRenderPass( commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE );
+        // Nothing to draw (or a pipeline to draw it with) until the mesh has loaded, the frame is just cleared
+        if( mTempMesh ) {
+            RecordMeshDraws( commandBuffer, frameIndex );
+        }
+    vkCmdEndRenderPass( commandBuffer );
+
+    if( vkEndCommandBuffer( commandBuffer ) != VK_SUCCESS ) {
+        throw std::runtime_error( "Failed to record command buffer!" );
+    }
+}
 
-    // CommandBufferBegin + RenderPassBegin  + BindPipeline + Draw + EndRenderPass + EndCommandBuffer
-    for( size_t i=0; i<mCommandBuffers.size(); ++i ) {
-        VkCommandBufferBeginInfo cbBeginInfo = {};
-        cbBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        cbBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-        // Optional (only relevant for secondary command buffers)
-        //cbBeginInfo.pInheritanceInfo = nullptr;
-
-        vkBeginCommandBuffer( mCommandBuffers[i], &cbBeginInfo );
-
-        VkRenderPassBeginInfo renderPassBeginInfo = {};
-        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassBeginInfo.renderPass = mRenderPass;
-        renderPassBeginInfo.framebuffer = mFramebuffers[i];
-        renderPassBeginInfo.renderArea.offset = {0, 0};
-        renderPassBeginInfo.renderArea.extent = mSwapChainExtents;
-        
-        // One for the colour attachment, one for the depth/stencil (you need one clearValue for each attachment)
-        VkClearValue clearValues[2] = {};
-        clearValues[0].color = {0.25f, 0.25f, 0.25f, 1.f};
-        clearValues[1].depthStencil = {1.f, 0};
-
-        renderPassBeginInfo.clearValueCount = sizeof( clearValues ) / sizeof( VkClearValue );
-        renderPassBeginInfo.pClearValues = clearValues;
-
-        vkCmdBeginRenderPass( mCommandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE );
-            vkCmdBindPipeline( mCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline );
-
-            VkBuffer vertexBuffers[] = {mTempMesh.GetVertexBuffer().GetBuffer()};
-            VkDeviceSize offsets[] = {0};
-
-            vkCmdBindVertexBuffers( mCommandBuffers[i], 0, 1, vertexBuffers, offsets );
-            vkCmdBindIndexBuffer( mCommandBuffers[i], mTempMesh.GetIndexBuffer().GetBuffer(), 0, VK_INDEX_TYPE_UINT32 );
-            vkCmdBindDescriptorSets( mCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &mDescriptorSet, 0, nullptr );
-
-            for (unsigned int submeshIndex = 0; submeshIndex < mTempMesh.GetSubMeshCount(); ++submeshIndex) {
-                vkCmdPushConstants(mCommandBuffers[i], mPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int), &mTempMesh.GetSubMeshData()[submeshIndex].textureIndex);
-                vkCmdDrawIndexed(mCommandBuffers[i], mTempMesh.GetSubMeshData()[submeshIndex].indexCount, 1, mTempMesh.GetSubMeshData()[submeshIndex].baseIndex, 0, 0);
+void VulkanApp::RecordMeshDraws( VkCommandBuffer commandBuffer, uint32_t frameIndex ) {
+    const uint32_t instanceCount = mMeshInstances.GetCount();
+    if( instanceCount == 0 ) {
+        return;
+    }
+    VkDeviceSize instanceOffset = mMeshInstances.Prepare( frameIndex );
+
+    vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline );
+
+    // Pooled meshes all share these, so binding once here would cover every mesh drawn after it
+    VkBuffer vertexBuffers[] = {mTempMesh->GetVertexBuffer().GetBuffer(), mMeshInstances.GetBuffer()};
+    VkDeviceSize offsets[] = {0, instanceOffset};
+
+    vkCmdBindVertexBuffers( commandBuffer, MESH_VERTEX_BINDING, 2, vertexBuffers, offsets );
+    // One dynamic offset per dynamic binding, in binding order (ubo, directional light, draw data)
+    uint32_t sliceOffset = static_cast<uint32_t>( frameIndex * mUniformRingSliceSize );
+    uint32_t dynamicOffsets[] = { sliceOffset, sliceOffset, static_cast<uint32_t>( mMeshDraws.GetSliceOffset( frameIndex ) ) };
+    // The texture table has no dynamic bindings, the offsets are all set 0's
+    VkDescriptorSet descriptorSets[] = { mDescriptorSet, mTextureTable.GetDescriptorSet() };
+    vkCmdBindDescriptorSets( commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0,
+                             sizeof( descriptorSets ) / sizeof( VkDescriptorSet ), descriptorSets,
+                             sizeof( dynamicOffsets ) / sizeof( uint32_t ), dynamicOffsets );
+
+    uint32_t lod = 0;
+    const auto *subMeshes = mTempMesh->GetLodSubMeshData( lod );
+    const std::vector<Meshlet>& meshlets = mTempMesh->GetMeshlets();
+    mSubMeshVisibility.assign( mTempMesh->GetSubMeshCount(), 1 );
+    mSubMeshCullStats = {};
+    mMeshDrawRanges.clear();
+    bool isMeshletCulled = false;
+
+    if( instanceCount == 1 ) {
+        // A lone instance is culled and LOD'd in its own model space
+        glm::mat4 modelView = mFrameUniforms.view * mFrameUniforms.model * mMeshInstances.GetInstances()[0].model;
+        glm::vec3 eye( glm::inverse( modelView )[3] );
+
+        // LOD by the size of the bounding sphere on screen (the radius around the bounds' centre is never
+        // smaller than the one the errors are relative to, so this errs on the detailed side)
+        const auto& dimensions = mTempMesh->GetDimensions();
+        glm::vec3 center = ( dimensions.min + dimensions.max ) * 0.5f;
+        float radius = glm::length( dimensions.max - center );
+        float distance = glm::length( eye - center );
+        if( distance > radius ) {
+            float projectedRadius = radius / distance * std::abs( mFrameUniforms.projection[1][1] ) * mSwapChainExtents.height * 0.5f;
+            lod = mTempMesh->SelectLod( projectedRadius, LOD_MAX_PIXEL_ERROR );
+        }
+        subMeshes = mTempMesh->GetLodSubMeshData( lod );
+
+        // Whole submeshes are culled first, their bounds hold for every LOD level
+        Frustum frustum = ExtractFrustum( mFrameUniforms.projection * modelView );
+        CullBounds( frustum, mTempMesh->GetSubMeshBounds(), mSubMeshVisibility.data(), &mSubMeshCullStats );
+
+        // Meshlet culling leaves compacted ranges of the visible submeshes to draw. Meshlets only exist for the full
+        // detail level, the coarser ones (and meshes without meshlets) draw the visible submeshes whole.
+        if( lod == 0 && !meshlets.empty() ) {
+            CullMeshlets( meshlets.data(), static_cast<uint32_t>( meshlets.size() ), frustum, eye, mMeshDrawRanges, nullptr,
+                          mSubMeshVisibility.data() );
+            isMeshletCulled = true;
+        }
+    }
+    // Instances share every draw, so with more than one there's no single model space to cull or pick a LOD in -
+    // they all get the full detail submeshes whole
+    if( !isMeshletCulled ) {
+        for( unsigned int submeshIndex = 0; submeshIndex < mTempMesh->GetSubMeshCount(); ++submeshIndex ) {
+            if( mSubMeshVisibility[submeshIndex] ) {
+                mMeshDrawRanges.push_back( { submeshIndex, subMeshes[submeshIndex].baseIndex, subMeshes[submeshIndex].indexCount } );
             }
-        vkCmdEndRenderPass( mCommandBuffers[i] );
+        }
+    }
 
-        if( vkEndCommandBuffer( mCommandBuffers[i] ) != VK_SUCCESS ) {
-            throw std::runtime_error( "Failed to create command buffers!" );
+    // The draws go into the indirect table, a batch per index width - submeshes can mix 16 and 32-bit indices,
+    // and each batch is drawn with the index buffer bound for its width
+    static const VkIndexType indexTypes[] = { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 };
+    mMeshDraws.Clear();
+    for( VkIndexType indexType : indexTypes ) {
+        mMeshDraws.BeginBatch();
+        for( const auto& range : mMeshDrawRanges ) {
+            const auto& subMesh = subMeshes[range.rangeIndex];
+            if( subMesh.indexType != indexType ) {
+                continue;
+            }
+            VkDrawIndexedIndirectCommand command = {};
+            command.indexCount = range.indexCount;
+            // Packing keeps the submesh's index order, so the range's offset into it carries over
+            command.firstIndex = subMesh.firstIndex + ( range.baseIndex - subMesh.baseIndex );
+            command.vertexOffset = subMesh.vertexOffset;
+            DrawData drawData = { INVALID_TEXTURE_INDEX, INVALID_TEXTURE_INDEX, INVALID_TEXTURE_INDEX };
+            if( subMesh.textureIndex >= 0 && static_cast<size_t>( subMesh.textureIndex ) < mMeshMaterials.size() ) {
+                drawData = mMeshMaterials[subMesh.textureIndex];
+            }
+            if( mIsPerObjectDraws ) {
+                // firstInstance picks each one's transform out of the same stream
+                command.instanceCount = 1;
+                for( uint32_t instance = 0; instance < instanceCount; ++instance ) {
+                    command.firstInstance = instance;
+                    mMeshDraws.Add( command, drawData );
+                }
+            } else {
+                command.instanceCount = instanceCount;
+                mMeshDraws.Add( command, drawData );
+            }
         }
     }
+    mMeshDraws.Prepare( frameIndex );
+
+    for( uint32_t batch = 0; batch < mMeshDraws.GetBatchCount(); ++batch ) {
+        vkCmdBindIndexBuffer( commandBuffer, mTempMesh->GetIndexBuffer().GetBuffer(), 0, indexTypes[batch] );
+        mMeshDraws.RecordBatch( commandBuffer, frameIndex, batch, mPipelineLayout, DRAW_OFFSET_PUSH_CONSTANT );
+    }
 }
 
 void VulkanApp::CreateSemaphores() {
+    mImageAvailableSemaphores.resize( mFramesInFlight, VulkanDeleter<VkSemaphore>{ mLogicalDevice, vkDestroySemaphore } );
+    mRenderFinishedSemaphores.resize( mFramesInFlight, VulkanDeleter<VkSemaphore>{ mLogicalDevice, vkDestroySemaphore } );
+
     VkSemaphoreCreateInfo semaphoreCreateInfo = {};
     semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    if( vkCreateSemaphore( mLogicalDevice, &semaphoreCreateInfo, nullptr, &mImageAvailableSemaphore ) != VK_SUCCESS  || 
-        vkCreateSemaphore( mLogicalDevice, &semaphoreCreateInfo, nullptr, &mRenderFinishedSemaphore ) != VK_SUCCESS ) {
-        throw std::runtime_error( "Failed to create semaphores!" );
+    for( uint32_t i=0; i<mFramesInFlight; ++i ) {
+        if( vkCreateSemaphore( mLogicalDevice, &semaphoreCreateInfo, nullptr, &mImageAvailableSemaphores[i] ) != VK_SUCCESS  || 
+            vkCreateSemaphore( mLogicalDevice, &semaphoreCreateInfo, nullptr, &mRenderFinishedSemaphores[i] ) != VK_SUCCESS ) {
+            throw std::runtime_error( "Failed to create semaphores!" );
+        }
     }
 }
 
-void VulkanApp::CreateUniformBuffer() {
-    VkDeviceSize bufferSize = sizeof( UniformBufferObject );
+void VulkanApp::CreateFences() {
+    mInFlightFences.resize( mFramesInFlight, VulkanDeleter<VkFence>{ mLogicalDevice, vkDestroyFence } );
+    // No frame owns any swap-chain image yet
+    mImagesInFlight.assign( mSwapChainImages.size(), VK_NULL_HANDLE );
+
+    // Start signalled so the first wait on each frame returns immediately
+    VkFenceCreateInfo fenceCreateInfo = {};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    for( uint32_t i=0; i<mFramesInFlight; ++i ) {
+        if( vkCreateFence( mLogicalDevice, &fenceCreateInfo, nullptr, &mInFlightFences[i] ) != VK_SUCCESS ) {
+            throw std::runtime_error( "Failed to create fences!" );
+        }
+    }
+}
 
-    // Setup uniform buffer
+void VulkanApp::CreateUniformBuffer() {
+    // Each slice holds the ubo followed by the directional light, both offsets have to respect the device's
+    // minimum alignment for dynamic uniform buffer offsets
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties( mPhysicalDevice, &properties );
+    VkDeviceSize alignment = std::max<VkDeviceSize>( properties.limits.minUniformBufferOffsetAlignment, 1 );
+    auto alignUp = [alignment]( VkDeviceSize size ) { return ( size + alignment - 1 ) / alignment * alignment; };
+
+    mUniformRingLightOffset = alignUp( sizeof( UniformBufferObject ) );
+    mUniformRingSliceSize = alignUp( mUniformRingLightOffset + sizeof( DirectionalLight ) );
+
+    // No device-local copy - the shaders read straight from host-visible memory, the data is tiny
+    // and rewritten every frame so a staging copy would only add a submit
     BufferDesc bufferDesc;
-    bufferDesc.size = sizeof(UniformBufferObject);
-    bufferDesc.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferDesc.size = mUniformRingSliceSize * mFramesInFlight;
+    bufferDesc.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
     bufferDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
     bufferDesc.logicalDevice = mLogicalDevice;
     bufferDesc.physicalDevice = mPhysicalDevice;
+    bufferDesc.allocator = &mMemoryAllocator;
 
-    mUniformStagingBuffer.Create(bufferDesc);
-
-    bufferDesc.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-    bufferDesc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-
-    mUniformBuffer.Create(bufferDesc);
-
-    // Directional light uniform
-    bufferDesc.size = sizeof(DirectionalLight);
-    bufferDesc.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-    mDirectionalLightUniformStagingBuffer.Create(bufferDesc);
-
-    bufferDesc.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-    bufferDesc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-
-    mDirectionalLightUniformBuffer.Create(bufferDesc);
+    mUniformRingBuffer.Create( bufferDesc );
+    mUniformRingBuffer.Map();
 }
 
 void VulkanApp::CreateDescriptorPool() {
+    // Textures aren't in this set, they're in mTextureTable's
     VkDescriptorPoolSize descriptorPoolSizes[] = {
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 }, // mvp matrix + directional light 
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, mTempMesh.GetTempMaterial().GetTextureCount() }
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2 }, // mvp matrix + directional light 
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 }, // per-draw data
     };
 
     VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
@@ -726,97 +1004,156 @@ void VulkanApp::CreateDescriptorSet() {
         throw std::runtime_error( "Failed to allocate descriptor sets!" );
     }
 
+    // Offsets are relative to the start of a slice, the slice itself is selected with a dynamic offset
     VkDescriptorBufferInfo descBufferInfo = {};
-    descBufferInfo.buffer = mUniformBuffer.GetBuffer();
+    descBufferInfo.buffer = mUniformRingBuffer.GetBuffer();
     descBufferInfo.offset = 0;
     descBufferInfo.range = sizeof( UniformBufferObject );
 
     // Directional light specific
     VkDescriptorBufferInfo directionalLightDescBufferInfo = {};
-    directionalLightDescBufferInfo.buffer = mDirectionalLightUniformBuffer.GetBuffer();
-    directionalLightDescBufferInfo.offset = 0;
+    directionalLightDescBufferInfo.buffer = mUniformRingBuffer.GetBuffer();
+    directionalLightDescBufferInfo.offset = mUniformRingLightOffset;
     directionalLightDescBufferInfo.range = sizeof( DirectionalLight );
     // ---
 
-    // texture specific
-    std::vector<VkDescriptorImageInfo> descImageInfo;
-    descImageInfo.resize(mTempMesh.GetTempMaterial().GetTextureCount());
-
-    Material *mat = &(mTempMesh.GetTempMaterial());
-    size_t diffuseMapCount = mat->diffuseMaps.size();
-    unsigned int descIndex = 0;
-    for (unsigned int i = 0; i < diffuseMapCount; ++i) {
-        descImageInfo[descIndex].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        descImageInfo[descIndex].imageView = mat->diffuseMaps[i]->GetImageViewTEMP();
-        descImageInfo[descIndex].sampler = mat->diffuseMaps[i]->GetSamplerTEMP();
-        ++descIndex;
-    }
-
-    size_t normalMapCount = mat->normalMaps.size();
-    for (unsigned int i = 0; i < normalMapCount; ++i) {
-        descImageInfo[descIndex].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        descImageInfo[descIndex].imageView = mat->normalMaps[i]->GetImageViewTEMP();
-        descImageInfo[descIndex].sampler = mat->normalMaps[i]->GetSamplerTEMP();
-        ++descIndex;
-    }
-
-    size_t specularMapCount = mat->specularMaps.size();
-    for (unsigned int i = 0; i < specularMapCount; ++i) {
-        descImageInfo[descIndex].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        descImageInfo[descIndex].imageView = mat->specularMaps[i]->GetImageViewTEMP();
-        descImageInfo[descIndex].sampler = mat->specularMaps[i]->GetSamplerTEMP();
-        ++descIndex;
-    }
+    // Per-draw data, the frame's slice is likewise selected with a dynamic offset
+    VkDescriptorBufferInfo drawDataDescBufferInfo = {};
+    drawDataDescBufferInfo.buffer = mMeshDraws.GetBuffer();
+    drawDataDescBufferInfo.offset = mMeshDraws.GetDrawDataOffset();
+    drawDataDescBufferInfo.range = mMeshDraws.GetDrawDataRange();
 
     // Configure descriptor sets
-    VkWriteDescriptorSet writeDescSets[5] = {};
+    VkWriteDescriptorSet writeDescSets[3] = {};
     // ubo
     writeDescSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     writeDescSets[0].dstSet = mDescriptorSet;
     writeDescSets[0].dstBinding = 0;
     writeDescSets[0].dstArrayElement = 0;
-    writeDescSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    writeDescSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     writeDescSets[0].descriptorCount = 1;
     writeDescSets[0].pBufferInfo = &descBufferInfo;
-    // diffuse maps
+
+    // directional light
     writeDescSets[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     writeDescSets[1].dstSet = mDescriptorSet;
-    writeDescSets[1].dstBinding = 1;
+    writeDescSets[1].dstBinding = 4;
     writeDescSets[1].dstArrayElement = 0;
-    writeDescSets[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    writeDescSets[1].descriptorCount = diffuseMapCount;
-    writeDescSets[1].pImageInfo = &descImageInfo[0];
-    // normal maps
+    writeDescSets[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    writeDescSets[1].descriptorCount = 1;
+    writeDescSets[1].pBufferInfo = &directionalLightDescBufferInfo;
+
+    // draw data
     writeDescSets[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     writeDescSets[2].dstSet = mDescriptorSet;
-    writeDescSets[2].dstBinding = 2;
+    writeDescSets[2].dstBinding = 5;
     writeDescSets[2].dstArrayElement = 0;
-    writeDescSets[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    writeDescSets[2].descriptorCount = normalMapCount;
-    // normal maps are inserted after the diffuse maps, so we can use diffuseMapCount as a starting index for normals
-    writeDescSets[2].pImageInfo = &descImageInfo[diffuseMapCount];
-    // specular maps
-    writeDescSets[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writeDescSets[3].dstSet = mDescriptorSet;
-    writeDescSets[3].dstBinding = 3;
-    writeDescSets[3].dstArrayElement = 0;
-    writeDescSets[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    writeDescSets[3].descriptorCount = specularMapCount;
-    // same thing for specular, add diffuse and normal map counts to get the correct offset
-    writeDescSets[3].pImageInfo = &descImageInfo[diffuseMapCount + normalMapCount];
-
-    // directional light
-    writeDescSets[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writeDescSets[4].dstSet = mDescriptorSet;
-    writeDescSets[4].dstBinding = 4;
-    writeDescSets[4].dstArrayElement = 0;
-    writeDescSets[4].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    writeDescSets[4].descriptorCount = 1;
-    writeDescSets[4].pBufferInfo = &directionalLightDescBufferInfo;
+    writeDescSets[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    writeDescSets[2].descriptorCount = 1;
+    writeDescSets[2].pBufferInfo = &drawDataDescBufferInfo;
 
     vkUpdateDescriptorSets( mLogicalDevice, sizeof( writeDescSets ) / sizeof( VkWriteDescriptorSet ), writeDescSets, 0, nullptr );
 }
 
+void VulkanApp::CreateTextureTable() {
+    TextureTableDesc textureTableDesc;
+    textureTableDesc.logicalDevice = mLogicalDevice;
+    textureTableDesc.capacity = TEXTURE_TABLE_CAPACITY;
+    textureTableDesc.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    if( !mTextureTable.Create( textureTableDesc ) ) {
+        throw std::runtime_error( "Could not create texture table!" );
+    }
+}
+
+void VulkanApp::CreateMeshResources() {
+    CreateGraphicsPipeline();
+    RegisterMeshTextures();
+    CreateMeshInstances();
+}
+
+void VulkanApp::RegisterMeshTextures() {
+    // Each material's textures get slots in the table, the draws of its submeshes carry the slots. Written while
+    // earlier frames may still be using the set, which update-after-bind allows.
+    Material& material = mTempMesh->GetTempMaterial();
+    auto registerTexture = [this]( const std::vector<TextureHandle>& maps, size_t materialIndex ) {
+        if( materialIndex >= maps.size() || !maps[materialIndex] ) {
+            return INVALID_TEXTURE_INDEX;
+        }
+        // A texture shared between materials (or meshes) keeps the one slot
+        Texture *texture = maps[materialIndex].get();
+        auto slot = mTextureSlots.find( texture );
+        if( slot != mTextureSlots.end() ) {
+            return slot->second;
+        }
+        int32_t index = mTextureTable.Register( texture->GetImageViewTEMP(), texture->GetSamplerTEMP() );
+        if( index == INVALID_TEXTURE_INDEX ) {
+            throw std::runtime_error( "Texture table is full!" );
+        }
+        mTextureSlots[texture] = index;
+        return index;
+    };
+
+    size_t materialCount = std::max( { material.diffuseMaps.size(), material.normalMaps.size(), material.specularMaps.size() } );
+    mMeshMaterials.resize( materialCount );
+    for( size_t i = 0; i < materialCount; ++i ) {
+        mMeshMaterials[i].diffuseTexture = registerTexture( material.diffuseMaps, i );
+        mMeshMaterials[i].normalTexture = registerTexture( material.normalMaps, i );
+        mMeshMaterials[i].specularTexture = registerTexture( material.specularMaps, i );
+    }
+
+    if( LOG_TEXTURE_CACHE_STATS ) {
+        const TextureCacheStats& cacheStats = mTextureCache.GetStats();
+        std::cout << "TEXTURE CACHE: " << mTextureCache.GetCount() << " textures, " << cacheStats.hitCount << " hits, "
+                  << cacheStats.missCount << " misses (" << cacheStats.failedCount << " failed), "
+                  << cacheStats.bytesSaved / ( 1024.0 * 1024.0 ) << "MB saved" << std::endl;
+    }
+}
+
+void VulkanApp::CreateInstanceBuffer() {
+    InstanceBufferDesc instanceBufferDesc;
+    instanceBufferDesc.physicalDevice = mPhysicalDevice;
+    instanceBufferDesc.logicalDevice = mLogicalDevice;
+    instanceBufferDesc.allocator = &mMemoryAllocator;
+    instanceBufferDesc.frameCount = mFramesInFlight;
+    instanceBufferDesc.initialCapacity = mInstanceGridSize * mInstanceGridSize;
+
+    if( !mMeshInstances.Create( instanceBufferDesc ) ) {
+        throw std::runtime_error( "Could not create instance buffer!" );
+    }
+}
+
+void VulkanApp::CreateIndirectDrawBuffer() {
+    IndirectDrawBufferDesc indirectDrawBufferDesc;
+    indirectDrawBufferDesc.physicalDevice = mPhysicalDevice;
+    indirectDrawBufferDesc.logicalDevice = mLogicalDevice;
+    indirectDrawBufferDesc.allocator = &mMemoryAllocator;
+    indirectDrawBufferDesc.frameCount = mFramesInFlight;
+    indirectDrawBufferDesc.maxDrawCount = MESH_MAX_DRAW_COUNT;
+    indirectDrawBufferDesc.multiDrawIndirect = mSupportsMultiDrawIndirect;
+    indirectDrawBufferDesc.drawIndirectFirstInstance = mSupportsDrawIndirectFirstInstance;
+    indirectDrawBufferDesc.drawIndexedIndirectCount = mDrawIndexedIndirectCount;
+
+    if( !mMeshDraws.Create( indirectDrawBufferDesc ) ) {
+        throw std::runtime_error( "Could not create indirect draw buffer!" );
+    }
+}
+
+void VulkanApp::CreateMeshInstances() {
+    // A grid on the XZ plane centred on the origin, spaced by the mesh's footprint so no two copies overlap
+    const auto& dimensions = mTempMesh->GetDimensions();
+    float spacing = std::max( dimensions.sizeAlongX, dimensions.sizeAlongZ ) * 1.25f;
+    float gridOffset = ( mInstanceGridSize - 1 ) * spacing * 0.5f;
+
+    mMeshInstances.Clear();
+    for( uint32_t z = 0; z < mInstanceGridSize; ++z ) {
+        for( uint32_t x = 0; x < mInstanceGridSize; ++x ) {
+            glm::vec3 position( x * spacing - gridOffset, 0.f, z * spacing - gridOffset );
+            mMeshInstances.Add( glm::translate( glm::mat4(), position ) );
+        }
+    }
+}
+
 bool VulkanApp::IsPhysicalDeviceSuitable( VkPhysicalDevice *physicalDevice ) {
 #if 0
     VkPhysicalDeviceProperties props;
@@ -837,7 +1174,36 @@ bool VulkanApp::IsPhysicalDeviceSuitable( VkPhysicalDevice *physicalDevice ) {
         swapChainIsSuitable = !swapChainDesc.formats.empty() && !swapChainDesc.presentationModes.empty();
     }
 
-    return queueFamilyDesc.IsComplete() && requiredExtensionsSupported && swapChainIsSuitable;
+    return queueFamilyDesc.IsComplete() && requiredExtensionsSupported && swapChainIsSuitable &&
+           CheckDescriptorIndexingSupport( physicalDevice );
+}
+
+bool VulkanApp::CheckDescriptorIndexingSupport( VkPhysicalDevice *physicalDevice, VkPhysicalDeviceDescriptorIndexingFeaturesEXT *enable ) {
+    auto getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+        vkGetInstanceProcAddr( mInstance, "vkGetPhysicalDeviceFeatures2KHR" ) );
+    if( !getPhysicalDeviceFeatures2 ) {
+        return false;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2KHR features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    features.pNext = &indexingFeatures;
+    getPhysicalDeviceFeatures2( *physicalDevice, &features );
+
+    // Unsized sampler array, most of it unwritten, written to while bound
+    bool isSupported = indexingFeatures.runtimeDescriptorArray && indexingFeatures.descriptorBindingPartiallyBound &&
+                       indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+
+    if( isSupported && enable ) {
+        *enable = {};
+        enable->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        enable->runtimeDescriptorArray = VK_TRUE;
+        enable->descriptorBindingPartiallyBound = VK_TRUE;
+        enable->descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    }
+    return isSupported;
 }
 
 bool VulkanApp::CheckDeviceExtensionSupport( VkPhysicalDevice *physicalDevice ) {
@@ -881,22 +1247,42 @@ QueueFamilyDesc VulkanApp::FindQueueFamilies( VkPhysicalDevice *physicalDevice )
     std::unique_ptr<VkQueueFamilyProperties> familyProperties( new VkQueueFamilyProperties[familyCount] );
     vkGetPhysicalDeviceQueueFamilyProperties( *physicalDevice, &familyCount, familyProperties.get() );
 
+    // Transfer family candidates - a pure transfer (DMA) family is preferred over an async compute one
+    int computeTransferFamily = -1;
+
     for( unsigned int i=0; i<familyCount; ++i ) {
-        if( familyProperties.get()[i].queueCount > 0 && familyProperties.get()[i].queueFlags & VK_QUEUE_GRAPHICS_BIT ) {
+        const VkQueueFamilyProperties &properties = familyProperties.get()[i];
+        if( properties.queueCount == 0 ) {
+            continue;
+        }
+
+        if( familyDesc.graphicsFamily < 0 && properties.queueFlags & VK_QUEUE_GRAPHICS_BIT ) {
             familyDesc.graphicsFamily = i;
         }
 
-        VkBool32 presentationSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR( *physicalDevice, i, mSurface, &presentationSupport );
-        if( familyProperties.get()[i].queueCount > 0 && presentationSupport ) {
-            familyDesc.presentationFamily = i;
+        if( familyDesc.presentationFamily < 0 ) {
+            VkBool32 presentationSupport = false;
+            vkGetPhysicalDeviceSurfaceSupportKHR( *physicalDevice, i, mSurface, &presentationSupport );
+            if( presentationSupport ) {
+                familyDesc.presentationFamily = i;
+            }
         }
 
-        if( familyDesc.IsComplete() ) {
-            break;
+        if( ( properties.queueFlags & VK_QUEUE_TRANSFER_BIT ) && !( properties.queueFlags & VK_QUEUE_GRAPHICS_BIT ) ) {
+            if( !( properties.queueFlags & VK_QUEUE_COMPUTE_BIT ) ) {
+                if( familyDesc.transferFamily < 0 ) {
+                    familyDesc.transferFamily = i;
+                }
+            } else if( computeTransferFamily < 0 ) {
+                computeTransferFamily = i;
+            }
         }
     }
 
+    if( familyDesc.transferFamily < 0 ) {
+        familyDesc.transferFamily = computeTransferFamily;
+    }
+
     return familyDesc;
 }
 
@@ -971,11 +1357,15 @@ void VulkanApp::RecreateSwapChain() {
     CreateSwapChainImageViews();
     CreateRenderPass();
 
-    CreateGraphicsPipeline();
+    // Otherwise it's created against the new render pass once the mesh has loaded
+    if( mTempMesh ) {
+        CreateGraphicsPipeline();
+    }
     SetupDepthBufferingResources();
     CreateFramebuffers();
 
-    CreateCommandBuffers();
+    // Command buffers are recorded per frame, only the image ownership table depends on the swap chain
+    mImagesInFlight.assign( mSwapChainImages.size(), VK_NULL_HANDLE );
 }
 
 void VulkanApp::InitVulkan() {
@@ -991,6 +1381,10 @@ void VulkanApp::InitVulkan() {
     CreateSurface();
     PickPhysicalDevice();
     CreateLogicalDevice();
+    CreateMemoryAllocator();
+    CreateUploadContext();
+    CreateGeometryPool();
+    CreateAssetLoader();
 
     CreateCommandPool();
     PrepSetupCommandBuffer();
@@ -1001,18 +1395,28 @@ void VulkanApp::InitVulkan() {
     // Uniform buffer specific
     CreateDescriptorSetLayout();
     // -----------------------
+    CreateTextureTable();
 
     // MODEL
     MeshDesc desc;
     desc.physicalDevice = mPhysicalDevice;
     desc.logicalDevice = mLogicalDevice;
-    desc.commandBuffer = mSetupCommandBuffer;
-    desc.queue = mGraphicsQueue;
+    desc.allocator = &mMemoryAllocator;
+    desc.uploadContext = &mUploadContext;
     desc.fileName = "../../../Resources/barrel.obj";
+    desc.optimizeIndices = true;
+    desc.shortIndices = true;
+    desc.rebaseSubMeshIndices = true;
+    desc.buildMeshlets = true;
+    desc.lodLevelCount = 3;
+    desc.logStats = false;
+    desc.vertexLayout = &GetVertexLayoutInfo<MeshVertexLayout>();
+    desc.geometryPool = &mGeometryPool;
+    desc.textureCache = &mTextureCache;
     // set shaders - vert
     desc.vertexShaderConfig.logialDevice = mLogicalDevice;
     desc.vertexShaderConfig.shaderType = VK_SHADER_STAGE_VERTEX_BIT;
-    desc.vertexShaderConfig.fileName = "../vert.spv";
+    desc.vertexShaderConfig.fileName = MESH_VERTEX_SHADER;
     desc.vertexShaderConfig.mainFunctionName = "main";
     // frag
     desc.fragmentShaderConfig.logialDevice = mLogicalDevice;
@@ -1023,58 +1427,96 @@ void VulkanApp::InitVulkan() {
     desc.textureConfig.physicalDevice = mPhysicalDevice;
     desc.textureConfig.logicalDevice = mLogicalDevice;
     desc.textureConfig.queue = mGraphicsQueue;
+    desc.textureConfig.allocator = &mMemoryAllocator;
     desc.textureConfig.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
     desc.textureConfig.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     desc.textureConfig.tiling = VK_IMAGE_TILING_OPTIMAL;
     desc.textureConfig.format = VK_FORMAT_R8G8B8A8_UNORM;
     desc.textureConfig.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    desc.textureConfig.commandBuffer = mSetupCommandBuffer;
-    //
-    mTempMesh.Load(desc);
+    desc.textureConfig.uploadContext = &mUploadContext;
+    desc.textureConfig.mipGeneration = MIP_GENERATION_AUTO;
+    desc.textureConfig.mipFilter = MIP_FILTER_BOX;
+    desc.textureConfig.preferBaked = true;
+    // Processed on the pool while the rest of the setup is done and the first frames render,
+    // the pipeline and descriptors that depend on it follow in DrawFrame once it's ready
+    mTempMeshHandle = mAssetLoader.LoadMeshAsync(desc);
     // -----------------------
 
-    CreateGraphicsPipeline();
     SetupDepthBufferingResources();
     CreateFramebuffers();
 
     // Uniform buffer specific
     CreateUniformBuffer();
+    // -----------------------
+    CreateInstanceBuffer();
+    CreateIndirectDrawBuffer();
+    // Nothing in the set depends on the meshes, their textures go in mTextureTable as they load
     CreateDescriptorPool();
     CreateDescriptorSet();
-    // -----------------------
     CreateCommandBuffers();
     CreateSemaphores();
+    CreateFences();
 }
 
 void VulkanApp::DrawFrame() {
+    // Don't get more than mFramesInFlight frames ahead of the GPU - this frame's command buffer,
+    // semaphores and uniform slice are free for reuse once its fence has signalled
+    VkFence frameFence = mInFlightFences[mCurrentFrame];
+    vkWaitForFences( mLogicalDevice, 1, &frameFence, VK_TRUE, std::numeric_limits<uint64_t>::max() );
+
     // Get image from swap-chain
     uint32_t imageIndex;
     VkResult result = vkAcquireNextImageKHR( mLogicalDevice, mSwapChain, std::numeric_limits<uint64_t>::max(), // using uint64_t::max() for timeout disables it
-                                             mImageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex );
+                                             mImageAvailableSemaphores[mCurrentFrame], VK_NULL_HANDLE, &imageIndex );
 
     if( result == VK_ERROR_OUT_OF_DATE_KHR ) {
         RecreateSwapChain();
+        return;
     } else if( result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR ) {
         throw std::runtime_error( "Failed to acquire swap chain image!" );
     }
 
+    // The image can come back while an older frame is still rendering into it (more frames in
+    // flight than swap-chain images, or out-of-order acquires) - wait for that frame too
+    if( mImagesInFlight[imageIndex] != VK_NULL_HANDLE && mImagesInFlight[imageIndex] != frameFence ) {
+        vkWaitForFences( mLogicalDevice, 1, &mImagesInFlight[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max() );
+    }
+    mImagesInFlight[imageIndex] = frameFence;
+
+    vkResetFences( mLogicalDevice, 1, &frameFence );
+
+    // Never blocks - stages meshes that have finished processing and picks up the ones whose uploads
+    // have landed (their ownership acquires go into this frame's command buffer ahead of the draws)
+    if( mAssetLoader.Update() > 0 && !mTempMesh ) {
+        mTempMesh = mAssetLoader.GetMesh( mTempMeshHandle );
+        if( mTempMesh ) {
+            CreateMeshResources();
+        }
+    }
+
+    UpdateUniformBuffer( mCurrentFrame );
+    double recordStart = glfwGetTime();
+    RecordCommandBuffer( mCommandBuffers[mCurrentFrame], imageIndex, mCurrentFrame );
+    double recordSeconds = glfwGetTime() - recordStart;
+    recordTime += recordSeconds;
+
     // Execute the command buffer with that image as attachment in the framebuffer
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = {mImageAvailableSemaphore};
+    VkSemaphore waitSemaphores[] = {mImageAvailableSemaphores[mCurrentFrame]};
     VkPipelineStageFlags pipelineWaitStageFlags[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     submitInfo.waitSemaphoreCount = 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = &pipelineWaitStageFlags[0];
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &mCommandBuffers[imageIndex];
+    submitInfo.pCommandBuffers = &mCommandBuffers[mCurrentFrame];
 
-    VkSemaphore signalSemaphores[] = {mRenderFinishedSemaphore};
+    VkSemaphore signalSemaphores[] = {mRenderFinishedSemaphores[mCurrentFrame]};
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    if( vkQueueSubmit( mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE ) != VK_SUCCESS ) {
+    if( vkQueueSubmit( mGraphicsQueue, 1, &submitInfo, frameFence ) != VK_SUCCESS ) {
         throw std::runtime_error( "Failed to submit draw command buffer!" );
     }
 
@@ -1090,6 +1532,7 @@ void VulkanApp::DrawFrame() {
     presentInfo.pImageIndices = &imageIndex;
 
     result = vkQueuePresentKHR( mPresentationQueue, &presentInfo );
+    mCurrentFrame = ( mCurrentFrame + 1 ) % mFramesInFlight;
     if( result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ) {
         RecreateSwapChain();
     } else if( result != VK_SUCCESS ) {
@@ -1101,18 +1544,72 @@ void VulkanApp::DrawFrame() {
     double thisTime = glfwGetTime();
     if( ( thisTime - lastTime ) >= 1.0 ) {
         //std::cout << "FPS: " << fps << std::endl;
-        std::string fpsCount("Vulkan | FPS: " + std::to_string(fps));
+        double frameTimeMs = ( thisTime - lastTime ) * 1000.0 / fps;
+        double recordTimeMs = recordTime * 1000.0 / fps;
+        std::string fpsCount("Vulkan | FPS: " + std::to_string(fps) + " | Frame: " + std::to_string(frameTimeMs) + " ms" +
+                             " | Record: " + std::to_string(recordTimeMs) + " ms" +
+                             " | Instances: " + std::to_string(mMeshInstances.GetCount()) +
+                             " | Draws: " + std::to_string(mMeshDraws.GetDrawCount()) +
+                             " | Submeshes culled: " + std::to_string(mSubMeshCullStats.culled) + "/" + std::to_string(mSubMeshCullStats.tested));
         glfwSetWindowTitle(mWindow, fpsCount.c_str());
 
         fps = 0;
+        recordTime = 0.0;
         lastTime = thisTime;
     }
+
+    if( mIsInstanceBenchmark ) {
+        UpdateInstanceBenchmark( recordSeconds );
+    }
+}
+
+void VulkanApp::UpdateInstanceBenchmark( double recordSeconds ) {
+    // Nothing to time until the mesh is in
+    if( !mTempMesh ) {
+        return;
+    }
+
+    // Each draw path gets a pass: warm up, then time the frames that follow
+    bool isPerObject = ( mInstanceBenchmarkPass == 1 );
+    ++mInstanceBenchmarkFrames;
+    if( mInstanceBenchmarkFrames == INSTANCE_BENCHMARK_WARMUP_FRAMES ) {
+        mInstanceBenchmarkStart = glfwGetTime();
+        mInstanceBenchmarkRecordTime = 0.0;
+        return;
+    }
+    if( mInstanceBenchmarkFrames <= INSTANCE_BENCHMARK_WARMUP_FRAMES ) {
+        return;
+    }
+    mInstanceBenchmarkRecordTime += recordSeconds;
+    if( mInstanceBenchmarkFrames < INSTANCE_BENCHMARK_WARMUP_FRAMES + INSTANCE_BENCHMARK_FRAMES ) {
+        return;
+    }
+
+    double frameTimeMs = ( glfwGetTime() - mInstanceBenchmarkStart ) * 1000.0 / INSTANCE_BENCHMARK_FRAMES;
+    double recordTimeMs = mInstanceBenchmarkRecordTime * 1000.0 / INSTANCE_BENCHMARK_FRAMES;
+    std::cout << "INSTANCE BENCHMARK: " << ( isPerObject ? "per object" : "instanced" ) << ", "
+              << mMeshInstances.GetCount() << " instances, " << mMeshDraws.GetDrawCount() << " draws, "
+              << frameTimeMs << " ms/frame, " << recordTimeMs << " ms recording" << std::endl;
+    mInstanceBenchmarkResults[mInstanceBenchmarkPass][0] = frameTimeMs;
+    mInstanceBenchmarkResults[mInstanceBenchmarkPass][1] = recordTimeMs;
+
+    mInstanceBenchmarkFrames = 0;
+    if( ++mInstanceBenchmarkPass < 2 ) {
+        mIsPerObjectDraws = true;
+        return;
+    }
+
+    std::cout << "INSTANCE BENCHMARK: per object / instanced = "
+              << mInstanceBenchmarkResults[1][0] / mInstanceBenchmarkResults[0][0] << "x frame time, "
+              << mInstanceBenchmarkResults[1][1] / mInstanceBenchmarkResults[0][1] << "x recording" << std::endl;
+    mIsInstanceBenchmark = false;
+    glfwSetWindowShouldClose( mWindow, GLFW_TRUE );
 }
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-void VulkanApp::UpdateUniformBuffer() {
+void VulkanApp::UpdateUniformBuffer( uint32_t sliceIndex ) {
     static auto startTime = std::chrono::high_resolution_clock::now();
 
     auto currentTime = std::chrono::high_resolution_clock::now();
@@ -1126,22 +1623,21 @@ void VulkanApp::UpdateUniformBuffer() {
     // glm was made for OpenGL which uses inverted Y coordinates
     ubo.projection[1][1] *= -1.f;
 
-    // update uniforms
-    mDirectionalLightUniformStagingBuffer.WriteToBufferMemory((void*)&mDirectionalLight, sizeof(DirectionalLight));
-    CopyBuffer( mDirectionalLightUniformStagingBuffer, mDirectionalLightUniformBuffer, sizeof( DirectionalLight ), mSetupCommandBuffer );
-    FlushSetupCommandBuffer();
+    // Kept for the CPU side of the frame too (meshlet culling)
+    mFrameUniforms = ubo;
 
-    mUniformStagingBuffer.WriteToBufferMemory((void*)&ubo, sizeof(UniformBufferObject));
-    CopyBuffer( mUniformStagingBuffer, mUniformBuffer, sizeof( UniformBufferObject ), mSetupCommandBuffer );
-    FlushSetupCommandBuffer();
+    // update uniforms - the ring is persistently mapped and coherent, so no submit or wait is needed
+    VkDeviceSize sliceOffset = sliceIndex * mUniformRingSliceSize;
+    mUniformRingBuffer.WriteToBufferMemory( (void*)&ubo, sizeof( UniformBufferObject ), sliceOffset );
+    mUniformRingBuffer.WriteToBufferMemory( (void*)&mDirectionalLight, sizeof( DirectionalLight ), sliceOffset + mUniformRingLightOffset );
 }
 
 void VulkanApp::MainLoop() {
     fps = 0;
+    recordTime = 0.0;
     lastTime = glfwGetTime();
     while( !glfwWindowShouldClose( mWindow ) ) {
         glfwPollEvents();
-        UpdateUniformBuffer();
         DrawFrame();
     }
     vkDeviceWaitIdle( mLogicalDevice );
@@ -1199,6 +1695,7 @@ void VulkanApp::SetupDepthBufferingResources() {
     imageDesc.physicalDevice = mPhysicalDevice;
     imageDesc.logicalDevice = mLogicalDevice;
     imageDesc.queue = mGraphicsQueue;
+    imageDesc.allocator = &mMemoryAllocator;
     //
     imageDesc.width = mSwapChainExtents.width;
     imageDesc.height = mSwapChainExtents.height;
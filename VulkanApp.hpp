@@ -6,18 +6,24 @@
 #include <vulkan/vulkan.h>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb/stb_image.h>
 #include <memory>
 #include <algorithm>
 #include <set>
+#include <unordered_map>
 #include <vector>
 #include <iostream>
 #include <stdexcept>
 
 
 #include "XOF_Mesh.hpp"
+#include "XOF_AssetLoader.hpp"
 #include "XOF_Buffer.hpp"
+#include "XOF_GeometryPool.hpp"
+#include "XOF_IndirectDrawBuffer.hpp"
+#include "XOF_InstanceBuffer.hpp"
+#include "XOF_TextureCache.hpp"
+#include "XOF_TextureTable.hpp"
+#include "XOF_UploadContext.hpp"
 #include "XOF_Lights.hpp"
 
 
@@ -33,14 +39,25 @@ static const char* gValidationLayers[] = {
 
 static const char* gRequiredExtensions[] = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+    // gl_DrawIDARB, the shaders find each indirect draw's data with it
+    "VK_KHR_shader_draw_parameters",
+    // The bindless texture table (XOF_TextureTable.hpp)
+    "VK_KHR_maintenance3",
+    "VK_EXT_descriptor_indexing",
 };
 #define REQUIRED_EXTENSION_COUNT sizeof( gRequiredExtensions ) / sizeof( char* )
 
+// How many frames the CPU may record ahead of the GPU - higher values trade latency for throughput
+static const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+static const uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
 
 // Helper structs
 struct QueueFamilyDesc {
     int     graphicsFamily = -1;
     int     presentationFamily = -1;
+            // Transfer-capable family without graphics support (optional, -1 when there isn't one)
+    int     transferFamily = -1;
 
     bool    IsComplete() const {
                 return ( graphicsFamily >= 0 && presentationFamily >= 0 ); 
@@ -57,6 +74,15 @@ struct SwapChainDesc {
 class VulkanApp {
 public:
     void                                        Run();
+                                                // Must be called before Run(), clamped to [1, MAX_FRAMES_IN_FLIGHT]
+    void                                        SetFramesInFlight( uint32_t count );
+                                                // Must be called before Run(), copies of the mesh on a grid this many wide and deep
+    void                                        SetInstanceGridSize( uint32_t size );
+                                                // A draw per instance and submesh rather than one per submesh for all of them
+    void                                        SetPerObjectDraws( bool isPerObject );
+                                                // Must be called before Run(), once the mesh is in draws the grid (100 wide unless set)
+                                                // instanced and then per object, prints the timings of both and closes
+    void                                        SetInstanceBenchmark( bool isEnabled );
 
     static VkBool32                             DebugCallback( VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT objType,
                                                                uint64_t obj, size_t location, int32_t code,
@@ -76,6 +102,16 @@ private:
     QueueFamilyDesc                             queueFamilyDesc;
     VkQueue                                     mGraphicsQueue;
     VkQueue                                     mPresentationQueue;
+                                                // Dedicated transfer queue for uploads, mGraphicsQueue when the device has none
+    VkQueue                                     mTransferQueue;
+                                                // Optional device capabilities the indirect draws make use of
+    bool                                        mSupportsMultiDrawIndirect = false;
+    bool                                        mSupportsDrawIndirectFirstInstance = false;
+    PFN_vkVoidFunction                          mDrawIndexedIndirectCount = nullptr;
+                                                // Backs every buffer and image below, so must outlive them (declared first)
+    MemoryAllocator                             mMemoryAllocator;
+                                                // Batched resource uploads, waited on before a resource's first use
+    UploadContext                               mUploadContext;
 
     VulkanDeleter<VkSwapchainKHR>               mSwapChain{mLogicalDevice, vkDestroySwapchainKHR};
     std::vector<VkImage>                        mSwapChainImages;
@@ -91,6 +127,7 @@ private:
     VulkanDeleter<VkPipeline>                   mPipeline{mLogicalDevice, vkDestroyPipeline};
     
     VulkanDeleter<VkCommandPool>                mCommandPool{mLogicalDevice, vkDestroyCommandPool};
+                                                // One per frame in flight, re-recorded every frame
     std::vector<VkCommandBuffer>                mCommandBuffers;
                                                 // ADDED
                                                 // Remember - command buffers are freed when their respective command pool is destroyed - so no wrapper is needed
@@ -98,16 +135,31 @@ private:
     void                                        PrepSetupCommandBuffer();
     void                                        FlushSetupCommandBuffer();
                                                 // ------------------------
-    VulkanDeleter<VkSemaphore>                  mImageAvailableSemaphore{mLogicalDevice, vkDestroySemaphore};
-    VulkanDeleter<VkSemaphore>                  mRenderFinishedSemaphore{mLogicalDevice, vkDestroySemaphore};
+                                                // Frames-in-flight synchronisation
+    uint32_t                                    mFramesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    uint32_t                                    mCurrentFrame = 0;
+    std::vector<VulkanDeleter<VkSemaphore>>     mImageAvailableSemaphores;
+    std::vector<VulkanDeleter<VkSemaphore>>     mRenderFinishedSemaphores;
+                                                // Signalled when the GPU is done with a frame's command buffer and uniform slice
+    std::vector<VulkanDeleter<VkFence>>         mInFlightFences;
+                                                // Fence of the frame currently rendering to each swap-chain image (not owned)
+    std::vector<VkFence>                        mImagesInFlight;
+                                                // ------------------------
 
     std::vector<VulkanDeleter<VkFramebuffer>>   mFramebuffers;
 
-    Buffer                                      mUniformBuffer;
-    Buffer                                      mUniformStagingBuffer;
+                                                // Per-frame uniform ring - host-visible and persistently mapped, one slice per
+                                                // frame in flight, selected at draw time with dynamic descriptor offsets
+    Buffer                                      mUniformRingBuffer;
+    VkDeviceSize                                mUniformRingSliceSize;
+    VkDeviceSize                                mUniformRingLightOffset;
 
     VulkanDeleter<VkDescriptorPool>             mDescritporPool{mLogicalDevice, vkDestroyDescriptorPool};
     VkDescriptorSet                             mDescriptorSet;
+                                                // Every mesh's textures, bound once as set 1 and picked by index per draw
+    TextureTable                                mTextureTable;
+                                                // The table slot of each texture registered so far (the meshes own the textures)
+    std::unordered_map<Texture*, int32_t>       mTextureSlots;
 
                                                 // Added for depth-buffering
     Image                                       mDepthImageInst;
@@ -116,13 +168,42 @@ private:
     VkFormat                                    FindSuitableFormat( const std::vector<VkFormat>& candidateFormats, VkImageTiling tiling, VkFormatFeatureFlags features );
                                                 // ------------------------
 
-    Mesh                                        mTempMesh;
+                                                // Shared vertex/index buffers the meshes are packed into, bound once for all of
+                                                // them (outlives mAssetLoader, whose meshes free their part on destruction)
+    GeometryPool                                mGeometryPool;
+                                                // Textures shared between the meshes' materials, each file loaded once
+    TextureCache                                mTextureCache;
+                                                // Meshes load in the background, the frame is just cleared until they're ready
+    AssetLoader                                 mAssetLoader;
+    MeshHandle                                  mTempMeshHandle = INVALID_MESH_HANDLE;
+                                                // Null until loaded (owned by mAssetLoader)
+    Mesh                                      * mTempMesh = nullptr;
+                                                // Where the copies of mTempMesh go, all drawn together
+    InstanceBuffer                              mMeshInstances;
+                                                // The frame's draws, filled from what culling left and drawn indirectly
+    IndirectDrawBuffer                          mMeshDraws;
+                                                // mTempMesh's materials as table indices, what its submeshes are drawn with
+    std::vector<DrawData>                       mMeshMaterials;
+                                                // Which submeshes the frame being recorded has in view, and the counts behind it
+    std::vector<uint8_t>                        mSubMeshVisibility;
+    FrustumCullStats                            mSubMeshCullStats = {};
+                                                // What the meshlet culling of the frame being recorded left to draw
+    std::vector<MeshletDrawRange>               mMeshDrawRanges;
+                                                // The instancing setup, and how far the benchmark comparing the two draw paths is
+    uint32_t                                    mInstanceGridSize = 1;
+    bool                                        mIsPerObjectDraws = false;
+    bool                                        mIsInstanceBenchmark = false;
+    uint32_t                                    mInstanceBenchmarkPass = 0;
+    uint32_t                                    mInstanceBenchmarkFrames = 0;
+    double                                      mInstanceBenchmarkStart = 0.0;
+    double                                      mInstanceBenchmarkRecordTime = 0.0;
+    double                                      mInstanceBenchmarkResults[2][2] = {};
+                                                // Transforms of the frame being recorded, as written to its uniform slice
+    UniformBufferObject                         mFrameUniforms;
                                                 // ------------------------
 
                                                 // Added for directional light
     DirectionalLight                            mDirectionalLight;
-    Buffer                                      mDirectionalLightUniformStagingBuffer;
-    Buffer                                      mDirectionalLightUniformBuffer;
                                                 // ------------------------
 
     std::vector<const char*>                    GetRequiredExtensions();
@@ -137,24 +218,42 @@ private:
     void                                        CreateSurface();
     void                                        PickPhysicalDevice();
     void                                        CreateLogicalDevice();
+    void                                        CreateMemoryAllocator();
+    void                                        CreateUploadContext();
+    void                                        CreateGeometryPool();
+    void                                        CreateAssetLoader();
     void                                        CreateSwapChain();
     void                                        CreateSwapChainImageViews();
     void                                        CreateRenderPass();
                                                 // Uniform-buffers specific
     void                                        CreateDescriptorSetLayout();
+    void                                        CreateTextureTable();
     void                                        CreateGraphicsPipeline();
     void                                        CreateFramebuffers();
     void                                        CreateCommandPool();
     void                                        CreateCommandBuffers();
+    void                                        RecordCommandBuffer( VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameIndex );
+    void                                        RecordMeshDraws( VkCommandBuffer commandBuffer, uint32_t frameIndex );
     void                                        CreateSemaphores();
+    void                                        CreateFences();
                                                 // Uniform-buffers specific
     void                                        CreateUniformBuffer();
     void                                        CreateDescriptorPool();
                                                 // ------------------------
     void                                        CreateDescriptorSet();
+                                                // Everything built from the mesh's material, once it has loaded
+    void                                        CreateMeshResources();
+    void                                        RegisterMeshTextures();
+    void                                        CreateInstanceBuffer();
+    void                                        CreateIndirectDrawBuffer();
+    void                                        CreateMeshInstances();
 
     bool                                        IsPhysicalDeviceSuitable( VkPhysicalDevice *physicalDevice );
     bool                                        CheckDeviceExtensionSupport( VkPhysicalDevice *physicalDevice );
+                                                // The descriptor indexing features the texture table needs, the physical
+                                                // device's support when enable is null, otherwise fills enable in
+    bool                                        CheckDescriptorIndexingSupport( VkPhysicalDevice *physicalDevice,
+                                                                                VkPhysicalDeviceDescriptorIndexingFeaturesEXT *enable = nullptr );
     QueueFamilyDesc                             FindQueueFamilies( VkPhysicalDevice *physicalDevice );
 
                                                 // Swap chain
@@ -166,8 +265,9 @@ private:
 
     void                                        InitVulkan();
     void                                        DrawFrame();
+    void                                        UpdateInstanceBenchmark( double recordSeconds );
                                                 // Staging buffer specific
-    void                                        UpdateUniformBuffer();
+    void                                        UpdateUniformBuffer( uint32_t sliceIndex );
                                                 // ------------------------
     void                                        MainLoop();
 };
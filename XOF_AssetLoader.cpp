@@ -0,0 +1,139 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_AssetLoader.cpp
+    Desc    :    Loads meshes in the background - the CPU side runs on the thread
+                 pool and the GPU side is finished off on the render thread, with
+                 handles to poll in between.
+
+===============================================================================
+*/
+#include "XOF_AssetLoader.hpp"
+#include "XOF_ThreadPool.hpp"
+#include <iostream>
+
+
+AssetLoader::AssetLoader() {
+    mDesc.uploadContext = nullptr;
+    mDesc.threadPool = nullptr;
+    mDesc.logLoadTimes = false;
+    mPendingCount = 0;
+    mIsCreated = false;
+}
+
+AssetLoader::~AssetLoader() {
+    Destroy();
+}
+
+bool AssetLoader::Create(const AssetLoaderDesc& desc) {
+    Destroy();
+
+    mDesc = desc;
+    if (!mDesc.threadPool) {
+        mDesc.threadPool = &GetSharedThreadPool();
+    }
+
+    return (mIsCreated = (mDesc.uploadContext != nullptr));
+}
+
+void AssetLoader::Destroy() {
+    // The pool tasks write into the slots, none can be freed while one is still running
+    for (auto& slot : mMeshes) {
+        if (slot->processing.valid()) {
+            slot->processing.wait();
+        }
+    }
+    mMeshes.clear();
+    mPendingCount = 0;
+    mIsCreated = false;
+}
+
+MeshHandle AssetLoader::LoadMeshAsync(const MeshDesc& desc) {
+    if (!mIsCreated) {
+        return INVALID_MESH_HANDLE;
+    }
+
+    std::unique_ptr<MeshSlot> slot(new MeshSlot());
+    slot->fileName = desc.fileName;
+    slot->desc = desc;
+    slot->desc.fileName = slot->fileName.c_str();
+    slot->desc.uploadContext = mDesc.uploadContext;
+    slot->isProcessed = false;
+    slot->state = ASSET_LOAD_PROCESSING;
+    slot->startTime = std::chrono::high_resolution_clock::now();
+
+    // The slot is heap allocated, so the task's pointer survives mMeshes growing
+    MeshSlot *task = slot.get();
+    slot->processing = mDesc.threadPool->Submit([task]() {
+        task->isProcessed = task->mesh.ProcessSource(task->desc);
+    });
+
+    mMeshes.push_back(std::move(slot));
+    ++mPendingCount;
+
+    return static_cast<MeshHandle>(mMeshes.size());
+}
+
+uint32_t AssetLoader::Update() {
+    if (mPendingCount == 0) {
+        return 0;
+    }
+
+    bool hasStaged = false;
+    uint32_t readyCount = 0;
+
+    for (auto& slot : mMeshes) {
+        if (slot->state == ASSET_LOAD_PROCESSING) {
+            if (slot->processing.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                continue;
+            }
+            slot->processing.get();
+
+            // The upload context is only ever recorded into from this thread
+            if (slot->isProcessed && slot->mesh.CreateResources(slot->desc)) {
+                slot->state = ASSET_LOAD_UPLOADING;
+                hasStaged = true;
+            } else {
+                std::cerr << "MESH FAILED TO LOAD: " << slot->fileName << std::endl;
+                slot->state = ASSET_LOAD_FAILED;
+                --mPendingCount;
+            }
+        }
+    }
+
+    // Send the new uploads off now rather than whenever the batch next fills up
+    if (hasStaged) {
+        mDesc.uploadContext->Flush();
+    }
+
+    for (auto& slot : mMeshes) {
+        if (slot->state == ASSET_LOAD_UPLOADING && mDesc.uploadContext->IsComplete(slot->mesh.GetUploadToken())) {
+            slot->state = ASSET_LOAD_READY;
+            --mPendingCount;
+            ++readyCount;
+
+            if (mDesc.logLoadTimes) {
+                double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - slot->startTime).count();
+                std::cout << "MESH READY: " << slot->fileName << " in " << seconds * 1000.0 << "ms" << std::endl;
+            }
+        }
+    }
+
+    return readyCount;
+}
+
+ASSET_LOAD_STATE AssetLoader::GetState(MeshHandle handle) const {
+    if (handle == INVALID_MESH_HANDLE || handle > mMeshes.size()) {
+        return ASSET_LOAD_FAILED;
+    }
+    return mMeshes[handle - 1]->state;
+}
+
+Mesh* AssetLoader::GetMesh(MeshHandle handle) const {
+    if (GetState(handle) != ASSET_LOAD_READY) {
+        return nullptr;
+    }
+    return &mMeshes[handle - 1]->mesh;
+}
@@ -0,0 +1,96 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_AssetLoader.hpp
+    Desc    :    Loads meshes in the background - the CPU side runs on the thread
+                 pool and the GPU side is finished off on the render thread, with
+                 handles to poll in between.
+
+===============================================================================
+*/
+#ifndef XOF_ASSET_LOADER_HPP
+#define XOF_ASSET_LOADER_HPP
+
+
+#include "XOF_Mesh.hpp"
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+class ThreadPool;
+
+
+// Stays valid for the lifetime of the loader, 0 is never handed out
+typedef uint32_t MeshHandle;
+static const MeshHandle INVALID_MESH_HANDLE = 0;
+
+
+enum ASSET_LOAD_STATE {
+    ASSET_LOAD_PROCESSING,      // Reading/processing on the pool
+    ASSET_LOAD_UPLOADING,       // Resources created, waiting on the uploads
+    ASSET_LOAD_READY,
+    ASSET_LOAD_FAILED
+};
+
+
+struct AssetLoaderDesc {
+    UploadContext         * uploadContext;
+                            // Runs the CPU side of the loads, null uses the shared pool
+    ThreadPool            * threadPool;
+                            // Print how long each mesh took to become ready
+    bool                    logLoadTimes;
+};
+
+
+class AssetLoader {
+public:
+                                    AssetLoader();
+                                    ~AssetLoader();
+
+    bool                            Create(const AssetLoaderDesc& desc);
+                                    // Waits for any processing still running on the pool
+    void                            Destroy();
+
+                                    // Returns straight away. The mesh file name is copied, everything else desc
+                                    // points to (shader file names) has to outlive the load.
+    MeshHandle                      LoadMeshAsync(const MeshDesc& desc);
+
+                                    // Render thread, once a frame before recording: creates the resources of the meshes
+                                    // that finished processing, flushes their uploads and marks the ones whose uploads
+                                    // have landed ready. Returns how many became ready.
+    uint32_t                        Update();
+
+    ASSET_LOAD_STATE                GetState(MeshHandle handle) const;
+                                    // Null until the mesh is ready to draw
+    Mesh                          * GetMesh(MeshHandle handle) const;
+    inline uint32_t                 GetPendingCount() const;
+
+private:
+    struct MeshSlot {
+        Mesh                                            mesh;
+        MeshDesc                                        desc;
+        std::string                                     fileName;
+        std::future<void>                               processing;
+        bool                                            isProcessed;    // Written by the pool task, read once it's done
+        ASSET_LOAD_STATE                                state;
+        std::chrono::high_resolution_clock::time_point  startTime;
+    };
+
+    AssetLoaderDesc                 mDesc;
+    std::vector<std::unique_ptr<MeshSlot>>  mMeshes;
+    uint32_t                        mPendingCount;
+    bool                            mIsCreated;
+};
+
+
+inline uint32_t AssetLoader::GetPendingCount() const {
+    return mPendingCount;
+}
+
+
+#endif // XOF_ASSET_LOADER_HPP
@@ -0,0 +1,109 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_BarrierBatch.cpp
+    Desc    :    Gathers pipeline barriers and records them with a single
+                 vkCmdPipelineBarrier, so a set of resources changing state
+                 together costs one call rather than one each.
+
+===============================================================================
+*/
+#include "XOF_BarrierBatch.hpp"
+#include <stdexcept>
+
+
+void GetImageLayoutAccess(VkImageLayout layout, VkPipelineStageFlags& stages, VkAccessFlags& access) {
+    switch (layout) {
+    // Contents don't matter (or haven't been touched by the GPU yet), nothing to wait on
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+        stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        access = 0;
+        break;
+    case VK_IMAGE_LAYOUT_PREINITIALIZED:
+        stages = VK_PIPELINE_STAGE_HOST_BIT;
+        access = VK_ACCESS_HOST_WRITE_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+        stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        access = VK_ACCESS_TRANSFER_READ_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+        stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        access = VK_ACCESS_TRANSFER_WRITE_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+        stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        access = VK_ACCESS_SHADER_READ_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+        stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+        stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        break;
+    default:
+        throw std::runtime_error("Failed to handle image layout transition!");
+    }
+}
+
+
+BarrierBatch::BarrierBatch() {
+    Clear();
+}
+
+BarrierBatch::~BarrierBatch() {}
+
+void BarrierBatch::AddImageTransition(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                      const VkImageSubresourceRange& range) {
+    VkPipelineStageFlags srcStages, dstStages;
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = range;
+    GetImageLayoutAccess(oldLayout, srcStages, barrier.srcAccessMask);
+    GetImageLayoutAccess(newLayout, dstStages, barrier.dstAccessMask);
+
+    AddImageBarrier(barrier, srcStages, dstStages);
+}
+
+void BarrierBatch::AddImageBarrier(const VkImageMemoryBarrier& barrier, VkPipelineStageFlags srcStages,
+                                   VkPipelineStageFlags dstStages) {
+    mImageBarriers.push_back(barrier);
+    mSrcStages |= srcStages;
+    mDstStages |= dstStages;
+}
+
+void BarrierBatch::AddBufferBarrier(const VkBufferMemoryBarrier& barrier, VkPipelineStageFlags srcStages,
+                                    VkPipelineStageFlags dstStages) {
+    mBufferBarriers.push_back(barrier);
+    mSrcStages |= srcStages;
+    mDstStages |= dstStages;
+}
+
+void BarrierBatch::Record(VkCommandBuffer commandBuffer) {
+    if (IsEmpty()) {
+        return;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, mSrcStages, mDstStages, 0,
+        0, nullptr,
+        static_cast<uint32_t>(mBufferBarriers.size()), mBufferBarriers.data(),
+        static_cast<uint32_t>(mImageBarriers.size()), mImageBarriers.data());
+
+    Clear();
+}
+
+void BarrierBatch::Clear() {
+    mBufferBarriers.clear();
+    mImageBarriers.clear();
+    mSrcStages = 0;
+    mDstStages = 0;
+}
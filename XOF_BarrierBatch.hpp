@@ -0,0 +1,59 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_BarrierBatch.hpp
+    Desc    :    Gathers pipeline barriers and records them with a single
+                 vkCmdPipelineBarrier, so a set of resources changing state
+                 together costs one call rather than one each.
+
+===============================================================================
+*/
+#ifndef XOF_BARRIER_BATCH_HPP
+#define XOF_BARRIER_BATCH_HPP
+
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+
+// Stage and access a layout is used with - throws for layouts nothing here transitions to or from
+void GetImageLayoutAccess(VkImageLayout layout, VkPipelineStageFlags& stages, VkAccessFlags& access);
+
+
+// The stage masks of everything added are combined, so only batch barriers that belong together - the
+// resources of one copy, one pass. Nothing is recorded for an empty batch.
+class BarrierBatch {
+public:
+                                        BarrierBatch();
+                                        ~BarrierBatch();
+
+                                        // Stages and access masks come from the layouts (see GetImageLayoutAccess)
+    void                                AddImageTransition(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                                           const VkImageSubresourceRange& range);
+    void                                AddImageBarrier(const VkImageMemoryBarrier& barrier, VkPipelineStageFlags srcStages,
+                                                        VkPipelineStageFlags dstStages);
+    void                                AddBufferBarrier(const VkBufferMemoryBarrier& barrier, VkPipelineStageFlags srcStages,
+                                                         VkPipelineStageFlags dstStages);
+
+                                        // Records everything added since the last call and empties the batch
+    void                                Record(VkCommandBuffer commandBuffer);
+    void                                Clear();
+
+    inline bool                         IsEmpty() const;
+
+private:
+    std::vector<VkBufferMemoryBarrier>  mBufferBarriers;
+    std::vector<VkImageMemoryBarrier>   mImageBarriers;
+    VkPipelineStageFlags                mSrcStages;
+    VkPipelineStageFlags                mDstStages;
+};
+
+
+inline bool BarrierBatch::IsEmpty() const {
+    return mBufferBarriers.empty() && mImageBarriers.empty();
+}
+
+
+#endif // XOF_BARRIER_BATCH_HPP
@@ -0,0 +1,504 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_BlockCompression.cpp
+    Desc    :    BC1/BC3/BC5/BC7 encoders for RGBA8 images.
+
+                 Colour endpoints start at the extremes of the block along its
+                 principal axis and are then refit by least squares to the indices
+                 they produced, keeping whichever decodes closer. BC4 channels
+                 (BC3 alpha, BC5) just span their range. BC7 only uses mode 6 -
+                 one subset, RGBA endpoints, 16 index levels - which covers most
+                 content well and keeps the encoder simple.
+
+===============================================================================
+*/
+#include "XOF_BlockCompression.hpp"
+#include "XOF_ThreadPool.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+
+static const uint32_t BLOCK_ROWS_PER_RANGE = 8;
+static const uint32_t POWER_ITERATIONS = 8;
+static const uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+
+// Writes fields LSB first, the way BC7 lays out its bits
+struct BitWriter {
+    uint8_t                   * bytes;
+    uint32_t                    position;
+
+    void Write(uint32_t value, uint32_t bitCount) {
+        for (uint32_t i = 0; i < bitCount; ++i, ++position) {
+            bytes[position >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (position & 7));
+        }
+    }
+};
+
+
+// Mean and dominant direction of the block's texels in their first channelCount channels. The axis is
+// left at zero for a flat block.
+static void FindPrincipalAxis(const float (*texels)[4], uint32_t channelCount, float *mean, float *axis) {
+    for (uint32_t c = 0; c < 4; ++c) {
+        mean[c] = 0.f;
+        axis[c] = 0.f;
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t c = 0; c < channelCount; ++c) {
+            mean[c] += texels[i][c] / 16.f;
+        }
+    }
+
+    float covariance[4][4] = {};
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t a = 0; a < channelCount; ++a) {
+            for (uint32_t b = 0; b < channelCount; ++b) {
+                covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+            }
+        }
+    }
+
+    // Power iteration, starting from the channel that varies the most
+    uint32_t widest = 0;
+    for (uint32_t c = 1; c < channelCount; ++c) {
+        if (covariance[c][c] > covariance[widest][widest]) {
+            widest = c;
+        }
+    }
+    if (covariance[widest][widest] <= 0.f) {
+        return;
+    }
+
+    float vector[4] = {};
+    for (uint32_t c = 0; c < channelCount; ++c) {
+        vector[c] = covariance[widest][c];
+    }
+    for (uint32_t iteration = 0; iteration < POWER_ITERATIONS; ++iteration) {
+        float next[4] = {};
+        float length = 0.f;
+        for (uint32_t a = 0; a < channelCount; ++a) {
+            for (uint32_t b = 0; b < channelCount; ++b) {
+                next[a] += covariance[a][b] * vector[b];
+            }
+            length = std::max(length, std::fabs(next[a]));
+        }
+        if (length <= 0.f) {
+            return;
+        }
+        for (uint32_t c = 0; c < channelCount; ++c) {
+            vector[c] = next[c] / length;
+        }
+    }
+
+    float length = 0.f;
+    for (uint32_t c = 0; c < channelCount; ++c) {
+        length += vector[c] * vector[c];
+    }
+    length = std::sqrt(length);
+    for (uint32_t c = 0; c < channelCount; ++c) {
+        axis[c] = vector[c] / length;
+    }
+}
+
+// Endpoints at the texels' extremes along the axis, pulled in by inset of the range
+static void FindAxisEndpoints(const float (*texels)[4], uint32_t channelCount, float inset, float *high, float *low) {
+    float mean[4], axis[4];
+    FindPrincipalAxis(texels, channelCount, mean, axis);
+
+    float minProjection = FLT_MAX, maxProjection = -FLT_MAX;
+    for (uint32_t i = 0; i < 16; ++i) {
+        float projection = 0.f;
+        for (uint32_t c = 0; c < channelCount; ++c) {
+            projection += (texels[i][c] - mean[c]) * axis[c];
+        }
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+
+    float pull = (maxProjection - minProjection) * inset;
+    for (uint32_t c = 0; c < channelCount; ++c) {
+        high[c] = std::min(std::max(mean[c] + axis[c] * (maxProjection - pull), 0.f), 255.f);
+        low[c] = std::min(std::max(mean[c] + axis[c] * (minProjection + pull), 0.f), 255.f);
+    }
+}
+
+// Least squares endpoints for texels already assigned weights (how much of high each decodes to).
+// Returns false when the weights don't pin the endpoints down (all the same).
+static bool FitEndpoints(const float (*texels)[4], const float *weights, uint32_t channelCount, float *high, float *low) {
+    float highHigh = 0.f, lowLow = 0.f, highLow = 0.f;
+    float highTexel[4] = {}, lowTexel[4] = {};
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        float h = weights[i];
+        float l = 1.f - h;
+        highHigh += h * h;
+        lowLow += l * l;
+        highLow += h * l;
+        for (uint32_t c = 0; c < channelCount; ++c) {
+            highTexel[c] += h * texels[i][c];
+            lowTexel[c] += l * texels[i][c];
+        }
+    }
+
+    float determinant = highHigh * lowLow - highLow * highLow;
+    if (std::fabs(determinant) < 1e-6f) {
+        return false;
+    }
+
+    for (uint32_t c = 0; c < channelCount; ++c) {
+        high[c] = std::min(std::max((highTexel[c] * lowLow - lowTexel[c] * highLow) / determinant, 0.f), 255.f);
+        low[c] = std::min(std::max((lowTexel[c] * highHigh - highTexel[c] * highLow) / determinant, 0.f), 255.f);
+    }
+    return true;
+}
+
+static void LoadBlockTexels(const uint8_t *texels, float (*result)[4]) {
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            result[i][c] = texels[i * 4 + c];
+        }
+    }
+}
+
+
+// --- BC1
+
+
+static uint16_t PackColour565(const float *colour) {
+    uint32_t r = static_cast<uint32_t>(colour[0] * 31.f / 255.f + 0.5f);
+    uint32_t g = static_cast<uint32_t>(colour[1] * 63.f / 255.f + 0.5f);
+    uint32_t b = static_cast<uint32_t>(colour[2] * 31.f / 255.f + 0.5f);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void UnpackColour565(uint16_t packed, int32_t *colour) {
+    int32_t r = (packed >> 11) & 0x1F;
+    int32_t g = (packed >> 5) & 0x3F;
+    int32_t b = packed & 0x1F;
+    colour[0] = (r << 3) | (r >> 2);
+    colour[1] = (g << 2) | (g >> 4);
+    colour[2] = (b << 3) | (b >> 2);
+}
+
+// Picks the closest of the four (opaque mode) colours for each texel, returns the total squared error
+static uint32_t AssignColourIndices(const float (*texels)[4], uint16_t colour0, uint16_t colour1, uint8_t *indices) {
+    int32_t palette[4][3];
+    UnpackColour565(colour0, palette[0]);
+    UnpackColour565(colour1, palette[1]);
+    for (uint32_t c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t totalError = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t bestError = UINT32_MAX;
+        for (uint32_t p = 0; p < 4; ++p) {
+            uint32_t error = 0;
+            for (uint32_t c = 0; c < 3; ++c) {
+                int32_t difference = static_cast<int32_t>(texels[i][c]) - palette[p][c];
+                error += static_cast<uint32_t>(difference * difference);
+            }
+            if (error < bestError) {
+                bestError = error;
+                indices[i] = static_cast<uint8_t>(p);
+            }
+        }
+        totalError += bestError;
+    }
+    return totalError;
+}
+
+void EncodeBlockBC1(const uint8_t *texels, uint8_t *block) {
+    static const float INDEX_WEIGHTS[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+
+    float colours[16][4];
+    LoadBlockTexels(texels, colours);
+
+    float high[4], low[4];
+    FindAxisEndpoints(colours, 3, 1.f / 16.f, high, low);
+    uint16_t colour0 = PackColour565(high);
+    uint16_t colour1 = PackColour565(low);
+
+    uint8_t indices[16];
+    uint32_t error = AssignColourIndices(colours, colour0, colour1, indices);
+
+    // Refit to the indices, a couple of rounds is where it stops paying off
+    for (uint32_t round = 0; round < 2 && error > 0; ++round) {
+        float weights[16];
+        for (uint32_t i = 0; i < 16; ++i) {
+            weights[i] = INDEX_WEIGHTS[indices[i]];
+        }
+        if (!FitEndpoints(colours, weights, 3, high, low)) {
+            break;
+        }
+
+        uint16_t fitColour0 = PackColour565(high);
+        uint16_t fitColour1 = PackColour565(low);
+        uint8_t fitIndices[16];
+        uint32_t fitError = AssignColourIndices(colours, fitColour0, fitColour1, fitIndices);
+        if (fitError >= error) {
+            break;
+        }
+        colour0 = fitColour0;
+        colour1 = fitColour1;
+        memcpy(indices, fitIndices, sizeof(indices));
+        error = fitError;
+    }
+
+    // colour0 > colour1 selects the four colour (opaque) mode, equal endpoints decode the same either way
+    if (colour0 < colour1) {
+        std::swap(colour0, colour1);
+        for (uint32_t i = 0; i < 16; ++i) {
+            indices[i] ^= 1;
+        }
+    } else if (colour0 == colour1) {
+        memset(indices, 0, sizeof(indices));
+    }
+
+    uint32_t packedIndices = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        packedIndices |= static_cast<uint32_t>(indices[i]) << (i * 2);
+    }
+
+    block[0] = static_cast<uint8_t>(colour0);
+    block[1] = static_cast<uint8_t>(colour0 >> 8);
+    block[2] = static_cast<uint8_t>(colour1);
+    block[3] = static_cast<uint8_t>(colour1 >> 8);
+    memcpy(block + 4, &packedIndices, sizeof(uint32_t));
+}
+
+
+// --- BC4 (BC3 alpha, BC5)
+
+
+static void EncodeBlockBC4(const uint8_t *texels, uint32_t channel, uint8_t *block) {
+    uint8_t maxValue = 0, minValue = 255;
+    for (uint32_t i = 0; i < 16; ++i) {
+        maxValue = std::max(maxValue, texels[i * 4 + channel]);
+        minValue = std::min(minValue, texels[i * 4 + channel]);
+    }
+
+    // value0 > value1 selects the eight value mode: the endpoints plus six steps between them
+    int32_t palette[8];
+    palette[0] = maxValue;
+    palette[1] = minValue;
+    for (int32_t i = 2; i < 8; ++i) {
+        palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7;
+    }
+
+    uint64_t packedIndices = 0;
+    if (maxValue != minValue) {
+        for (uint32_t i = 0; i < 16; ++i) {
+            int32_t value = texels[i * 4 + channel];
+            uint32_t bestIndex = 0;
+            int32_t bestError = INT32_MAX;
+            for (uint32_t p = 0; p < 8; ++p) {
+                int32_t error = std::abs(value - palette[p]);
+                if (error < bestError) {
+                    bestError = error;
+                    bestIndex = p;
+                }
+            }
+            packedIndices |= static_cast<uint64_t>(bestIndex) << (i * 3);
+        }
+    }
+
+    block[0] = maxValue;
+    block[1] = minValue;
+    for (uint32_t i = 0; i < 6; ++i) {
+        block[2 + i] = static_cast<uint8_t>(packedIndices >> (i * 8));
+    }
+}
+
+void EncodeBlockBC3(const uint8_t *texels, uint8_t *block) {
+    EncodeBlockBC4(texels, 3, block);
+    EncodeBlockBC1(texels, block + 8);
+}
+
+void EncodeBlockBC5(const uint8_t *texels, uint8_t *block) {
+    EncodeBlockBC4(texels, 0, block);
+    EncodeBlockBC4(texels, 1, block + 8);
+}
+
+
+// --- BC7 (mode 6)
+
+
+// 7-bit endpoint channels sharing one p-bit (the lowest bit once expanded to 8 bits) per endpoint
+struct Bc7Endpoints {
+    uint32_t                    values[2][4];
+    uint32_t                    pBits[2];
+};
+
+static uint32_t AssignBc7Indices(const float (*texels)[4], const Bc7Endpoints& endpoints, uint8_t *indices) {
+    int32_t expanded[2][4];
+    for (uint32_t e = 0; e < 2; ++e) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            expanded[e][c] = static_cast<int32_t>((endpoints.values[e][c] << 1) | endpoints.pBits[e]);
+        }
+    }
+
+    int32_t palette[16][4];
+    for (uint32_t p = 0; p < 16; ++p) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            palette[p][c] = ((64 - BC7_WEIGHTS[p]) * expanded[0][c] + BC7_WEIGHTS[p] * expanded[1][c] + 32) >> 6;
+        }
+    }
+
+    uint32_t totalError = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t bestError = UINT32_MAX;
+        for (uint32_t p = 0; p < 16; ++p) {
+            uint32_t error = 0;
+            for (uint32_t c = 0; c < 4; ++c) {
+                int32_t difference = static_cast<int32_t>(texels[i][c]) - palette[p][c];
+                error += static_cast<uint32_t>(difference * difference);
+            }
+            if (error < bestError) {
+                bestError = error;
+                indices[i] = static_cast<uint8_t>(p);
+            }
+        }
+        totalError += bestError;
+    }
+    return totalError;
+}
+
+// Quantises both endpoints with every p-bit combination and keeps the one that decodes closest
+static uint32_t QuantiseBc7Endpoints(const float (*texels)[4], const float *first, const float *second,
+                                     Bc7Endpoints& endpoints, uint8_t *indices) {
+    const float *source[2] = { first, second };
+    uint32_t bestError = UINT32_MAX;
+
+    for (uint32_t pBits = 0; pBits < 4; ++pBits) {
+        Bc7Endpoints candidate;
+        for (uint32_t e = 0; e < 2; ++e) {
+            candidate.pBits[e] = (pBits >> e) & 1;
+            for (uint32_t c = 0; c < 4; ++c) {
+                float value = (source[e][c] - candidate.pBits[e]) * 0.5f + 0.5f;
+                candidate.values[e][c] = static_cast<uint32_t>(std::min(std::max(value, 0.f), 127.f));
+            }
+        }
+
+        uint8_t candidateIndices[16];
+        uint32_t error = AssignBc7Indices(texels, candidate, candidateIndices);
+        if (error < bestError) {
+            bestError = error;
+            endpoints = candidate;
+            memcpy(indices, candidateIndices, 16);
+        }
+    }
+    return bestError;
+}
+
+void EncodeBlockBC7(const uint8_t *texels, uint8_t *block) {
+    float colours[16][4];
+    LoadBlockTexels(texels, colours);
+
+    float high[4], low[4];
+    FindAxisEndpoints(colours, 4, 0.f, high, low);
+
+    // Index 0 weights the first endpoint fully, so that's the low end
+    Bc7Endpoints endpoints;
+    uint8_t indices[16];
+    uint32_t error = QuantiseBc7Endpoints(colours, low, high, endpoints, indices);
+
+    for (uint32_t round = 0; round < 2 && error > 0; ++round) {
+        float weights[16];
+        for (uint32_t i = 0; i < 16; ++i) {
+            weights[i] = BC7_WEIGHTS[indices[i]] / 64.f;
+        }
+        if (!FitEndpoints(colours, weights, 4, high, low)) {
+            break;
+        }
+
+        Bc7Endpoints fitEndpoints;
+        uint8_t fitIndices[16];
+        uint32_t fitError = QuantiseBc7Endpoints(colours, low, high, fitEndpoints, fitIndices);
+        if (fitError >= error) {
+            break;
+        }
+        endpoints = fitEndpoints;
+        memcpy(indices, fitIndices, sizeof(indices));
+        error = fitError;
+    }
+
+    // The first texel's index is stored with its top bit implied zero - flip the block around if it's set
+    if (indices[0] & 8) {
+        std::swap(endpoints.values[0], endpoints.values[1]);
+        std::swap(endpoints.pBits[0], endpoints.pBits[1]);
+        for (uint32_t i = 0; i < 16; ++i) {
+            indices[i] = static_cast<uint8_t>(15 - indices[i]);
+        }
+    }
+
+    memset(block, 0, 16);
+    BitWriter writer = { block, 0 };
+    writer.Write(1 << 6, 7);    // Mode 6
+    for (uint32_t c = 0; c < 4; ++c) {
+        writer.Write(endpoints.values[0][c], 7);
+        writer.Write(endpoints.values[1][c], 7);
+    }
+    writer.Write(endpoints.pBits[0], 1);
+    writer.Write(endpoints.pBits[1], 1);
+    writer.Write(indices[0], 3);
+    for (uint32_t i = 1; i < 16; ++i) {
+        writer.Write(indices[i], 4);
+    }
+}
+
+
+// ---
+
+
+uint32_t GetBlockFormatSize(BlockFormat format) {
+    return (format == BLOCK_FORMAT_BC1) ? 8 : 16;
+}
+
+size_t GetCompressedSize(uint32_t width, uint32_t height, BlockFormat format) {
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * GetBlockFormatSize(format);
+}
+
+void CompressImage(const uint8_t *rgba, uint32_t width, uint32_t height, BlockFormat format, uint8_t *dst,
+                   ThreadPool *pool) {
+    uint32_t blocksWide = (width + 3) / 4;
+    uint32_t blocksHigh = (height + 3) / 4;
+    uint32_t blockSize = GetBlockFormatSize(format);
+
+    void (*encodeBlock)(const uint8_t*, uint8_t*) =
+        (format == BLOCK_FORMAT_BC1) ? EncodeBlockBC1 :
+        (format == BLOCK_FORMAT_BC3) ? EncodeBlockBC3 :
+        (format == BLOCK_FORMAT_BC5) ? EncodeBlockBC5 : EncodeBlockBC7;
+
+    auto encodeRows = [&](uint32_t range) {
+        uint32_t rowEnd = std::min((range + 1) * BLOCK_ROWS_PER_RANGE, blocksHigh);
+        for (uint32_t blockY = range * BLOCK_ROWS_PER_RANGE; blockY < rowEnd; ++blockY) {
+            for (uint32_t blockX = 0; blockX < blocksWide; ++blockX) {
+                uint8_t texels[16 * 4];
+                for (uint32_t y = 0; y < 4; ++y) {
+                    uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+                    for (uint32_t x = 0; x < 4; ++x) {
+                        uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+                        memcpy(&texels[(y * 4 + x) * 4], &rgba[(static_cast<size_t>(sourceY) * width + sourceX) * 4], 4);
+                    }
+                }
+                encodeBlock(texels, dst + (static_cast<size_t>(blockY) * blocksWide + blockX) * blockSize);
+            }
+        }
+    };
+
+    uint32_t rangeCount = (blocksHigh + BLOCK_ROWS_PER_RANGE - 1) / BLOCK_ROWS_PER_RANGE;
+    if (pool && rangeCount > 1) {
+        pool->ParallelFor(rangeCount, encodeRows);
+    } else {
+        for (uint32_t range = 0; range < rangeCount; ++range) {
+            encodeRows(range);
+        }
+    }
+}
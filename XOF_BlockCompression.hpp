@@ -0,0 +1,48 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_BlockCompression.hpp
+    Desc    :    BC1/BC3/BC5/BC7 encoders for RGBA8 images, used offline by
+                 Tools/TextureEncoder.cpp - the renderer only ever uploads the
+                 compressed blocks.
+
+===============================================================================
+*/
+#ifndef XOF_BLOCK_COMPRESSION_HPP
+#define XOF_BLOCK_COMPRESSION_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+class ThreadPool;
+
+
+enum BlockFormat {
+    BLOCK_FORMAT_BC1,       // RGB, 4bpp, no alpha
+    BLOCK_FORMAT_BC3,       // RGB + separately coded alpha, 8bpp
+    BLOCK_FORMAT_BC5,       // Two independent channels (R, G), 8bpp - normal maps, Z is rebuilt in the shader
+    BLOCK_FORMAT_BC7,       // RGBA, 8bpp, the best quality of the four (mode 6 only here)
+};
+
+
+// Bytes per 4x4 block
+uint32_t GetBlockFormatSize(BlockFormat format);
+size_t GetCompressedSize(uint32_t width, uint32_t height, BlockFormat format);
+
+// texels is a 4x4 block of RGBA8 texels, row by row
+void EncodeBlockBC1(const uint8_t *texels, uint8_t *block);
+void EncodeBlockBC3(const uint8_t *texels, uint8_t *block);
+void EncodeBlockBC5(const uint8_t *texels, uint8_t *block);
+void EncodeBlockBC7(const uint8_t *texels, uint8_t *block);
+
+// Compresses a whole RGBA8 image into dst (GetCompressedSize bytes), blocks row by row. Blocks hanging over
+// the right/bottom edge repeat the edge texels. Rows of blocks are encoded in parallel given a pool.
+void CompressImage(const uint8_t *rgba, uint32_t width, uint32_t height, BlockFormat format, uint8_t *dst,
+                   ThreadPool *pool);
+
+
+#endif // XOF_BLOCK_COMPRESSION_HPP
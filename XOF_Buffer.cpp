@@ -11,18 +11,26 @@
 #include "XOF_Buffer.hpp"
 
 
-Buffer::Buffer() {}
+Buffer::Buffer() : mAllocator(nullptr), mMappedMemory(nullptr) {}
 
-Buffer::Buffer(const BufferDesc& desc) {
+Buffer::Buffer(const BufferDesc& desc) : mAllocator(nullptr), mMappedMemory(nullptr) {
     Create(desc);
 }
 
-Buffer::~Buffer() {}
+Buffer::~Buffer() {
+    Release();
+}
 
 bool Buffer::Create(const BufferDesc& desc) {
+    if (!desc.allocator) {
+        throw std::runtime_error("Failed to create buffer, no memory allocator given!");
+        return false;
+    }
+
+    Release();
     mRendererLogicalDevice = desc.logicalDevice;
+    mAllocator = desc.allocator;
     mBuffer.Set(mRendererLogicalDevice, vkDestroyBuffer);
-    mBufferMemory.Set(mRendererLogicalDevice, vkFreeMemory);
 
     // Create the buffer
     VkBufferCreateInfo bufferCreateInfo = {};
@@ -36,32 +44,51 @@ bool Buffer::Create(const BufferDesc& desc) {
         return false;
     }
 
-    // Allocate the memory
+    // Sub-allocate the memory
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(desc.logicalDevice, mBuffer, &memRequirements);
 
-    VkMemoryAllocateInfo memAllocateInfo = {};
-    memAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAllocateInfo.allocationSize = memRequirements.size;
     // using vkFlushMappedMemoryRanges & vkInvalidateMappedMemoryRanges is potentially faster than VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    memAllocateInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, desc.properties, desc.physicalDevice);
-
-    if (vkAllocateMemory(desc.logicalDevice, &memAllocateInfo, nullptr, &mBufferMemory) != VK_SUCCESS) {
+    if (!mAllocator->Allocate(memRequirements, desc.properties, RESOURCE_TILING_LINEAR, mAllocation)) {
         throw std::runtime_error("Failed to allocate memory for vertex buffer!");
         return false;
     }
 
     // Bind
-    vkBindBufferMemory(desc.logicalDevice, mBuffer, mBufferMemory, 0);
+    vkBindBufferMemory(desc.logicalDevice, mBuffer, mAllocation.memory, mAllocation.offset);
 
     return true;
 }
 
 void Buffer::WriteToBufferMemory(void *data, size_t size) {
-    void *mappedRange;
-    vkMapMemory(mRendererLogicalDevice, mBufferMemory, 0, size, 0, &mappedRange);
-    memcpy(mappedRange, data, size);
-    vkUnmapMemory(mRendererLogicalDevice, mBufferMemory);
+    WriteToBufferMemory(data, size, 0);
+}
+
+void Buffer::WriteToBufferMemory(void *data, size_t size, VkDeviceSize offset) {
+    // Host-visible allocations live in blocks the allocator keeps mapped, so this is always a straight copy
+    if (!mAllocation.mappedData) {
+        throw std::runtime_error("Failed to write to buffer memory, buffer isn't host-visible!");
+    }
+    memcpy(static_cast<char*>(mAllocation.mappedData) + offset, data, size);
+}
+
+void* Buffer::Map() {
+    if (!mAllocation.mappedData) {
+        throw std::runtime_error("Failed to map buffer memory!");
+    }
+    return (mMappedMemory = mAllocation.mappedData);
+}
+
+void Buffer::Unmap() {
+    // The backing block stays mapped, it's shared with other resources
+    mMappedMemory = nullptr;
+}
+
+void Buffer::Release() {
+    Unmap();
+    if (mAllocator) {
+        mAllocator->Free(mAllocation);
+    }
 }
 
 
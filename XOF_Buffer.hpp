@@ -13,15 +13,19 @@
 
 
 #include "VulkanHelpers.hpp"
+#include "XOF_MemoryAllocator.hpp"
 #include <vulkan/vulkan.h>
 
 
 struct BufferDesc {
+                            BufferDesc() { memset(this, 0x00, sizeof(BufferDesc)); }
+
     VkDeviceSize            size;
     VkBufferUsageFlags      usage; 
     VkMemoryPropertyFlags   properties;
     VkDevice                logicalDevice;
     VkPhysicalDevice        physicalDevice;
+    MemoryAllocator       * allocator;
 };
 
 
@@ -34,14 +38,26 @@ public:
     bool                            Create(const BufferDesc& desc);
 
     void                            WriteToBufferMemory(void *data, size_t size);
+    void                            WriteToBufferMemory(void *data, size_t size, VkDeviceSize offset);
+
+                                    // Persistent mapping - the buffer stays mapped until Unmap() or destruction,
+                                    // only valid for host-visible buffers
+    void                          * Map();
+    void                            Unmap();
 
     inline VkBuffer                 GetBuffer();
     inline VkDeviceMemory           GetBufferMemory();
+    inline VkDeviceSize             GetBufferMemoryOffset();
+    inline void                   * GetMappedMemory();
 
 private:
     VkDevice                        mRendererLogicalDevice;
     VulkanDeleter<VkBuffer>         mBuffer;
-    VulkanDeleter<VkDeviceMemory>   mBufferMemory;
+    MemoryAllocator               * mAllocator;
+    Allocation                      mAllocation;
+    void                          * mMappedMemory;
+
+    void                            Release();
 };
 
 
@@ -51,7 +67,15 @@ inline VkBuffer Buffer::GetBuffer() {
 }
 
 inline VkDeviceMemory Buffer::GetBufferMemory() {
-    return mBufferMemory;
+    return mAllocation.memory;
+}
+
+inline VkDeviceSize Buffer::GetBufferMemoryOffset() {
+    return mAllocation.offset;
+}
+
+inline void* Buffer::GetMappedMemory() {
+    return mMappedMemory;
 }
 
 
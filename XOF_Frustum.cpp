@@ -0,0 +1,159 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_Frustum.cpp
+    Desc    :    View frustum planes and the visibility tests run against them.
+
+===============================================================================
+*/
+#include "XOF_Frustum.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XOF_FRUSTUM_SSE 1
+#include <emmintrin.h>
+#endif
+
+
+void BoundsList::Clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+    radius.clear();
+}
+
+void BoundsList::Add(const glm::vec3& min, const glm::vec3& max, float sphereRadius) {
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    extentX.push_back(extent.x);
+    extentY.push_back(extent.y);
+    extentZ.push_back(extent.z);
+    radius.push_back(sphereRadius);
+}
+
+
+// ---
+
+
+
+Frustum ExtractFrustum(const glm::mat4& clipFromSpace) {
+    // Gribb/Hartmann - glm is column major, so row i is m[0][i], m[1][i], m[2][i], m[3][i]
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4(clipFromSpace[0][i], clipFromSpace[1][i], clipFromSpace[2][i], clipFromSpace[3][i]);
+    }
+
+    Frustum frustum;
+    for (int i = 0; i < 4; ++i) {
+        frustum.planes[FRUSTUM_PLANE_LEFT][i] = rows[3][i] + rows[0][i];
+        frustum.planes[FRUSTUM_PLANE_RIGHT][i] = rows[3][i] - rows[0][i];
+        frustum.planes[FRUSTUM_PLANE_BOTTOM][i] = rows[3][i] + rows[1][i];
+        frustum.planes[FRUSTUM_PLANE_TOP][i] = rows[3][i] - rows[1][i];
+        // 0 <= z rather than -w <= z, depth runs from zero to one
+        frustum.planes[FRUSTUM_PLANE_NEAR][i] = rows[2][i];
+        frustum.planes[FRUSTUM_PLANE_FAR][i] = rows[3][i] - rows[2][i];
+    }
+
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+        glm::vec4& plane = frustum.planes[p];
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length > 0.f) {
+            plane = glm::vec4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+        }
+    }
+
+    return frustum;
+}
+
+bool IsSphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius) {
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+        const glm::vec4& plane = frustum.planes[p];
+        if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool IsBoundInFrustum(const Frustum& frustum, const BoundsList& bounds, uint32_t i) {
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+        const glm::vec4& plane = frustum.planes[p];
+        float distance = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w;
+        float boxReach = std::fabs(plane.x) * bounds.extentX[i] + std::fabs(plane.y) * bounds.extentY[i] +
+                         std::fabs(plane.z) * bounds.extentZ[i];
+        if (distance < -std::min(boxReach, bounds.radius[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t CullBounds(const Frustum& frustum, const BoundsList& bounds, uint8_t *visible, FrustumCullStats *stats) {
+    const uint32_t count = bounds.GetCount();
+    uint32_t visibleCount = 0;
+    uint32_t i = 0;
+
+#ifdef XOF_FRUSTUM_SSE
+    // The planes transposed into one register per component, each splatted across the four bounds tested together
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    __m128 planeX[FRUSTUM_PLANE_COUNT], planeY[FRUSTUM_PLANE_COUNT], planeZ[FRUSTUM_PLANE_COUNT], planeW[FRUSTUM_PLANE_COUNT];
+    __m128 absPlaneX[FRUSTUM_PLANE_COUNT], absPlaneY[FRUSTUM_PLANE_COUNT], absPlaneZ[FRUSTUM_PLANE_COUNT];
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+        absPlaneX[p] = _mm_andnot_ps(signMask, planeX[p]);
+        absPlaneY[p] = _mm_andnot_ps(signMask, planeY[p]);
+        absPlaneZ[p] = _mm_andnot_ps(signMask, planeZ[p]);
+    }
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 centerX = _mm_loadu_ps(&bounds.centerX[i]);
+        __m128 centerY = _mm_loadu_ps(&bounds.centerY[i]);
+        __m128 centerZ = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 extentX = _mm_loadu_ps(&bounds.extentX[i]);
+        __m128 extentY = _mm_loadu_ps(&bounds.extentY[i]);
+        __m128 extentZ = _mm_loadu_ps(&bounds.extentZ[i]);
+        __m128 radius = _mm_loadu_ps(&bounds.radius[i]);
+
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], centerX), _mm_mul_ps(planeY[p], centerY)),
+                                         _mm_add_ps(_mm_mul_ps(planeZ[p], centerZ), planeW[p]));
+            __m128 boxReach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absPlaneX[p], extentX), _mm_mul_ps(absPlaneY[p], extentY)),
+                                         _mm_mul_ps(absPlaneZ[p], extentZ));
+            __m128 reach = _mm_min_ps(boxReach, radius);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+        }
+
+        int outsideMask = _mm_movemask_ps(outside);
+        for (uint32_t lane = 0; lane < 4; ++lane) {
+            uint8_t isVisible = ((outsideMask >> lane) & 1) ? 0 : 1;
+            visible[i + lane] = isVisible;
+            visibleCount += isVisible;
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        visible[i] = IsBoundInFrustum(frustum, bounds, i) ? 1 : 0;
+        visibleCount += visible[i];
+    }
+
+    if (stats) {
+        stats->tested = count;
+        stats->culled = count - visibleCount;
+    }
+
+    return visibleCount;
+}
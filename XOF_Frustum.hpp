@@ -0,0 +1,68 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_Frustum.hpp
+    Desc    :    View frustum planes and the visibility tests run against them.
+
+===============================================================================
+*/
+#ifndef XOF_FRUSTUM_HPP
+#define XOF_FRUSTUM_HPP
+
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+
+enum FRUSTUM_PLANES {
+    FRUSTUM_PLANE_LEFT,
+    FRUSTUM_PLANE_RIGHT,
+    FRUSTUM_PLANE_BOTTOM,
+    FRUSTUM_PLANE_TOP,
+    FRUSTUM_PLANE_NEAR,
+    FRUSTUM_PLANE_FAR,
+    FRUSTUM_PLANE_COUNT
+};
+
+
+// Normalised planes (xyz normal pointing inward, w distance), dot(plane, vec4(p, 1)) >= 0 inside
+struct Frustum {
+    glm::vec4                   planes[FRUSTUM_PLANE_COUNT];
+};
+
+
+// Bounds of many objects, one array per component so CullBounds can test several at once. Boxes are
+// stored as centre and half extent, the sphere is around the same centre.
+struct BoundsList {
+    std::vector<float>          centerX, centerY, centerZ;
+    std::vector<float>          extentX, extentY, extentZ;
+    std::vector<float>          radius;
+
+    void                        Clear();
+    void                        Add(const glm::vec3& min, const glm::vec3& max, float sphereRadius);
+    inline uint32_t             GetCount() const { return static_cast<uint32_t>(centerX.size()); }
+};
+
+struct FrustumCullStats {
+    uint32_t                    tested;
+    uint32_t                    culled;
+};
+
+
+// Planes of a Vulkan clip space matrix (depth zero to one), in whatever space the matrix transforms from -
+// pass projection * view * model to get them in model space
+Frustum ExtractFrustum(const glm::mat4& clipFromSpace);
+
+// Conservative, a sphere crossing a frustum corner outside of it can still pass
+bool IsSphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius);
+
+// Sets visible[i] to 1 if bound i may be in the frustum, 0 if it's certainly outside. Against each plane
+// whichever of the box and the sphere reaches less far is used. Four bounds are tested per iteration
+// where SSE is available. Returns the visible count, stats (may be null) is overwritten.
+uint32_t CullBounds(const Frustum& frustum, const BoundsList& bounds, uint8_t *visible, FrustumCullStats *stats);
+
+
+#endif // XOF_FRUSTUM_HPP
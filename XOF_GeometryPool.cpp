@@ -0,0 +1,143 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_GeometryPool.cpp
+    Desc    :    Shared vertex and index buffers that many meshes are packed into,
+                 so every mesh drawn from the pool goes through one binding.
+
+===============================================================================
+*/
+#include "XOF_GeometryPool.hpp"
+#include <iterator>
+
+
+// Keeps 32-bit index ranges aligned wherever an allocation lands
+static const VkDeviceSize INDEX_ALLOCATION_ALIGNMENT = 4;
+
+
+static bool AllocateRange(std::map<uint64_t, uint64_t>& freeRanges, uint64_t size, uint64_t& offset) {
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        if (it->second >= size) {
+            offset = it->first;
+            uint64_t remaining = it->second - size;
+            freeRanges.erase(it);
+            if (remaining > 0) {
+                freeRanges[offset + size] = remaining;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static void FreeRange(std::map<uint64_t, uint64_t>& freeRanges, uint64_t offset, uint64_t size) {
+    auto next = freeRanges.lower_bound(offset);
+    if (next != freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = freeRanges.erase(next);
+    }
+    if (next != freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += size;
+            return;
+        }
+    }
+    freeRanges[offset] = size;
+}
+
+
+// ---
+
+
+GeometryPool::GeometryPool() {
+    mUsedVertexCount = 0;
+    mUsedIndexSize = 0;
+    mIsCreated = false;
+}
+
+GeometryPool::~GeometryPool() {
+    Destroy();
+}
+
+bool GeometryPool::Create(const GeometryPoolDesc& desc) {
+    Destroy();
+
+    mDesc = desc;
+    mDesc.indexCapacity = (mDesc.indexCapacity + INDEX_ALLOCATION_ALIGNMENT - 1) & ~(INDEX_ALLOCATION_ALIGNMENT - 1);
+    if (mDesc.vertexStride == 0 || mDesc.vertexCapacity == 0 || mDesc.indexCapacity == 0) {
+        return false;
+    }
+
+    BufferDesc bufferDesc;
+    bufferDesc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    bufferDesc.logicalDevice = mDesc.logicalDevice;
+    bufferDesc.physicalDevice = mDesc.physicalDevice;
+    bufferDesc.allocator = mDesc.allocator;
+
+    bufferDesc.size = VkDeviceSize(mDesc.vertexStride) * mDesc.vertexCapacity;
+    bufferDesc.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    mVertexBuffer.reset(new Buffer(bufferDesc));
+
+    bufferDesc.size = mDesc.indexCapacity;
+    bufferDesc.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    mIndexBuffer.reset(new Buffer(bufferDesc));
+
+    mFreeVertices[0] = mDesc.vertexCapacity;
+    mFreeIndices[0] = mDesc.indexCapacity;
+
+    return (mIsCreated = true);
+}
+
+void GeometryPool::Destroy() {
+    if (!mIsCreated) {
+        return;
+    }
+
+    mVertexBuffer.reset();
+    mIndexBuffer.reset();
+    mFreeVertices.clear();
+    mFreeIndices.clear();
+    mUsedVertexCount = 0;
+    mUsedIndexSize = 0;
+    mIsCreated = false;
+}
+
+bool GeometryPool::Allocate(uint32_t vertexCount, VkDeviceSize indexSize, GeometryAllocation& allocation) {
+    if (!mIsCreated || vertexCount == 0 || indexSize == 0) {
+        return false;
+    }
+
+    indexSize = (indexSize + INDEX_ALLOCATION_ALIGNMENT - 1) & ~(INDEX_ALLOCATION_ALIGNMENT - 1);
+
+    uint64_t firstVertex, indexOffset;
+    if (!AllocateRange(mFreeVertices, vertexCount, firstVertex)) {
+        return false;
+    }
+    if (!AllocateRange(mFreeIndices, indexSize, indexOffset)) {
+        FreeRange(mFreeVertices, firstVertex, vertexCount);
+        return false;
+    }
+
+    allocation.firstVertex = static_cast<uint32_t>(firstVertex);
+    allocation.vertexCount = vertexCount;
+    allocation.indexOffset = indexOffset;
+    allocation.indexSize = indexSize;
+    mUsedVertexCount += vertexCount;
+    mUsedIndexSize += indexSize;
+
+    return true;
+}
+
+void GeometryPool::Free(const GeometryAllocation& allocation) {
+    if (!mIsCreated || allocation.vertexCount == 0) {
+        return;
+    }
+
+    FreeRange(mFreeVertices, allocation.firstVertex, allocation.vertexCount);
+    FreeRange(mFreeIndices, allocation.indexOffset, allocation.indexSize);
+    mUsedVertexCount -= allocation.vertexCount;
+    mUsedIndexSize -= allocation.indexSize;
+}
@@ -0,0 +1,102 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_GeometryPool.hpp
+    Desc    :    Shared vertex and index buffers that many meshes are packed into,
+                 so every mesh drawn from the pool goes through one binding.
+
+===============================================================================
+*/
+#ifndef XOF_GEOMETRY_POOL_HPP
+#define XOF_GEOMETRY_POOL_HPP
+
+
+#include "XOF_Buffer.hpp"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+
+
+struct GeometryPoolDesc {
+                            GeometryPoolDesc() { memset(this, 0x00, sizeof(GeometryPoolDesc)); }
+
+                            // Renderer pointers
+    VkPhysicalDevice        physicalDevice;
+    VkDevice                logicalDevice;
+    MemoryAllocator       * allocator;
+                            // Every mesh in the pool shares the vertex layout, and so the stride
+    uint32_t                vertexStride;
+    uint32_t                vertexCapacity;     // In vertices
+    VkDeviceSize            indexCapacity;      // In bytes, 16 and 32-bit indices share the buffer
+};
+
+
+// Where a mesh's data went - draw with vertexOffset + firstVertex, and firstIndex + indexOffset / index size
+struct GeometryAllocation {
+    uint32_t                firstVertex;
+    uint32_t                vertexCount;
+    VkDeviceSize            indexOffset;        // In bytes, always 4-byte aligned
+    VkDeviceSize            indexSize;
+};
+
+
+class GeometryPool {
+public:
+                                    GeometryPool();
+                                    ~GeometryPool();
+
+    bool                            Create(const GeometryPoolDesc& desc);
+                                    // The GPU must be done with every draw from the pool
+    void                            Destroy();
+
+                                    // First fit in each buffer, false (and nothing allocated) when either is out of room
+    bool                            Allocate(uint32_t vertexCount, VkDeviceSize indexSize, GeometryAllocation& allocation);
+                                    // The GPU must be done with the allocation's draws
+    void                            Free(const GeometryAllocation& allocation);
+
+    inline uint32_t                 GetVertexStride() const;
+    inline uint32_t                 GetUsedVertexCount() const;
+    inline VkDeviceSize             GetUsedIndexSize() const;
+    inline Buffer&                  GetVertexBuffer();
+    inline Buffer&                  GetIndexBuffer();
+
+private:
+    GeometryPoolDesc                mDesc;
+
+    std::unique_ptr<Buffer>         mVertexBuffer;
+    std::unique_ptr<Buffer>         mIndexBuffer;
+                                    // Offset -> size of the unused ranges, neighbours are merged as they're freed
+    std::map<uint64_t, uint64_t>    mFreeVertices;
+    std::map<uint64_t, uint64_t>    mFreeIndices;
+    uint32_t                        mUsedVertexCount;
+    VkDeviceSize                    mUsedIndexSize;
+
+    bool                            mIsCreated;
+};
+
+
+inline uint32_t GeometryPool::GetVertexStride() const {
+    return mDesc.vertexStride;
+}
+
+inline uint32_t GeometryPool::GetUsedVertexCount() const {
+    return mUsedVertexCount;
+}
+
+inline VkDeviceSize GeometryPool::GetUsedIndexSize() const {
+    return mUsedIndexSize;
+}
+
+inline Buffer& GeometryPool::GetVertexBuffer() {
+    return *mVertexBuffer;
+}
+
+inline Buffer& GeometryPool::GetIndexBuffer() {
+    return *mIndexBuffer;
+}
+
+
+#endif // XOF_GEOMETRY_POOL_HPP
@@ -9,15 +9,20 @@
 ===============================================================================
 */
 #include "XOF_Image.hpp"
+#include <algorithm>
 
 
-Image::Image() {}
-Image::~Image() {}
+Image::Image() : mAllocator(nullptr) {}
+
+Image::~Image() {
+    if (mAllocator) {
+        mAllocator->Free(mImageMemory);
+    }
+}
 
 bool Image::Create(ImageDesc& imageDesc) {
     mImage.Set(imageDesc.logicalDevice, vkDestroyImage);
     mImageView.Set(imageDesc.logicalDevice, vkDestroyImageView);
-    mImageMemory.Set(imageDesc.logicalDevice, vkFreeMemory);
 
     if (CreateImage(imageDesc) && CreateImageView(imageDesc)) {
         return true;
@@ -27,10 +32,21 @@ bool Image::Create(ImageDesc& imageDesc) {
 }
 
 bool Image::CreateImage(const ImageDesc& imageDesc) {
+    if (mAllocator) {
+        mAllocator->Free(mImageMemory);
+    }
+    mAllocator = imageDesc.allocator;
+
     return CreateImage(imageDesc, mImage, mImageMemory);
 }
 
-bool Image::CreateImage(const ImageDesc& imageDesc, VulkanDeleter<VkImage>& image, VulkanDeleter<VkDeviceMemory>& imageMemory) {
+// The caller owns imageMemory and hands it back to imageDesc.allocator once done with the image
+bool Image::CreateImage(const ImageDesc& imageDesc, VulkanDeleter<VkImage>& image, Allocation& imageMemory) {
+    if (!imageDesc.allocator) {
+        throw std::runtime_error("Failed to create image, no memory allocator given!");
+        return false;
+    }
+
     // Parameters for an image
     VkImageCreateInfo imageCreateInfo = {};
     imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -38,7 +54,7 @@ bool Image::CreateImage(const ImageDesc& imageDesc, VulkanDeleter<VkImage>& imag
     imageCreateInfo.extent.width = imageDesc.width;
     imageCreateInfo.extent.height = imageDesc.height;
     imageCreateInfo.extent.depth = 1;
-    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.mipLevels = std::max(imageDesc.mipLevels, 1u);
     imageCreateInfo.arrayLayers = 1;
     imageCreateInfo.format = imageDesc.format;
     imageCreateInfo.tiling = imageDesc.tiling;
@@ -58,17 +74,14 @@ bool Image::CreateImage(const ImageDesc& imageDesc, VulkanDeleter<VkImage>& imag
     VkMemoryRequirements imageMemReqs = {};
     vkGetImageMemoryRequirements(imageDesc.logicalDevice, image, &imageMemReqs);
 
-    VkMemoryAllocateInfo imageMemAllocInfo = {};
-    imageMemAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    imageMemAllocInfo.allocationSize = imageMemReqs.size;
-    imageMemAllocInfo.memoryTypeIndex = FindMemoryType(imageMemReqs.memoryTypeBits, imageDesc.properties, imageDesc.physicalDevice);
-
-    if (vkAllocateMemory(imageDesc.logicalDevice, &imageMemAllocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
+    // Optimally tiled images are kept apart from buffers and linear images to respect bufferImageGranularity
+    ResourceTiling tiling = (imageDesc.tiling == VK_IMAGE_TILING_OPTIMAL) ? RESOURCE_TILING_OPTIMAL : RESOURCE_TILING_LINEAR;
+    if (!imageDesc.allocator->Allocate(imageMemReqs, imageDesc.properties, tiling, imageMemory)) {
         throw std::runtime_error("Failed to allocate image memory!");
         return false;
     }
 
-    vkBindImageMemory(imageDesc.logicalDevice, image, imageMemory, 0);
+    vkBindImageMemory(imageDesc.logicalDevice, image, imageMemory.memory, imageMemory.offset);
 
     return true;
 }
@@ -87,7 +100,7 @@ bool Image::CreateImageView(const ImageDesc& imageDesc) {
     // What is the images' purpose and how will it be accessed?
     imageViewCreateInfo.subresourceRange.aspectMask = imageDesc.aspect;
     imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-    imageViewCreateInfo.subresourceRange.levelCount = 1;
+    imageViewCreateInfo.subresourceRange.levelCount = std::max(imageDesc.mipLevels, 1u);
     // VR could use multiple layers here...
     imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
     imageViewCreateInfo.subresourceRange.layerCount = 1;
@@ -104,46 +117,15 @@ bool Image::CreateImageView(const ImageDesc& imageDesc) {
 
 
 void TransitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer commandBuffer) {
-    VkImageMemoryBarrier barrier = {};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    // VK_IMAGE_LAYOUT_UNDEFINED can be used here if we don't care about the contents
-    barrier.oldLayout = oldLayout;
-    // ---
-    barrier.newLayout = newLayout;
-    // Setting these to queue family indices allows for queue family ownership transfers
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    // ---
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) ?
+    VkImageSubresourceRange range = {};
+    range.aspectMask = (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) ?
         VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    // Handle transition type - Specify which types of operations must happen before the barrier and
-    // which types of operations must wait on the barrier
-    if (oldLayout == VK_IMAGE_LAYOUT_PREINITIALIZED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-    }
-    else if (oldLayout == VK_IMAGE_LAYOUT_PREINITIALIZED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    }
-    else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    }
-    else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    }
-    else {
-        throw std::runtime_error("Failed to handle iamge layout transition!");
-    }
-
-    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
-        0, nullptr, 0, nullptr,
-        1, &barrier);
+    range.baseMipLevel = 0;
+    range.levelCount = VK_REMAINING_MIP_LEVELS;
+    range.baseArrayLayer = 0;
+    range.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+    BarrierBatch barriers;
+    barriers.AddImageTransition(image, oldLayout, newLayout, range);
+    barriers.Record(commandBuffer);
 }
@@ -14,6 +14,19 @@
 
 #include <vulkan/vulkan.h>
 #include "VulkanHelpers.hpp"
+#include "XOF_BarrierBatch.hpp"
+#include "XOF_MemoryAllocator.hpp"
+#include "XOF_MipGenerator.hpp"
+
+
+class UploadContext;
+
+
+enum MipGeneration {
+    MIP_GENERATION_NONE,        // Level 0 only
+    MIP_GENERATION_AUTO,        // Blitted on the GPU where the format and upload queue allow it, on the CPU otherwise
+    MIP_GENERATION_CPU,         // Always on the CPU, for formats that can't be blitted with linear filtering
+};
 
 
 struct ImageDesc {
@@ -24,6 +37,7 @@ struct ImageDesc {
     VkPhysicalDevice        physicalDevice;
     VkDevice                logicalDevice;
     VkQueue                 queue;
+    MemoryAllocator       * allocator;
                             // Core image properties
     uint32_t                width;
     uint32_t                height;
@@ -32,9 +46,16 @@ struct ImageDesc {
     VkImageUsageFlags       usage;
     VkImageAspectFlags      aspect;
     VkMemoryPropertyFlags   properties;
+                            // 0 is taken as 1, textures fill this in from mipGeneration
+    uint32_t                mipLevels;
                             // Texture-image
     char                  * fileName;
-    VkCommandBuffer         commandBuffer;
+    UploadContext         * uploadContext;
+    MipGeneration           mipGeneration;
+                            // Load the block-compressed <name>.ktx2 that Tools/TextureEncoder.cpp bakes next to an image
+                            // in its place, when there is one that's up to date and the device can sample its format
+    bool                    preferBaked;
+    MipFilter               mipFilter;      // For the levels generated on the CPU
                             // Texture-image sampler
                             // ...
 };
@@ -49,14 +70,17 @@ public:
 
     inline VkImage                  GetImageTEMP();
     inline VkImageView              GetImageViewTEMP();
+                                    // Of the memory bound to the image, 0 before it's created
+    inline VkDeviceSize             GetMemorySize() const;
 
 protected:
     VulkanDeleter<VkImage>          mImage;
     VulkanDeleter<VkImageView>      mImageView;
-    VulkanDeleter<VkDeviceMemory>   mImageMemory;
+    MemoryAllocator               * mAllocator;
+    Allocation                      mImageMemory;
 
     bool                            CreateImage(const ImageDesc& imageDesc);
-    bool                            CreateImage(const ImageDesc& imageDesc, VulkanDeleter<VkImage>& image, VulkanDeleter<VkDeviceMemory>& imageMemory);
+    bool                            CreateImage(const ImageDesc& imageDesc, VulkanDeleter<VkImage>& image, Allocation& imageMemory);
     bool                            CreateImageView(const ImageDesc& imageDesc);
 };
 
@@ -69,10 +93,15 @@ VkImageView Image::GetImageViewTEMP() {
     return mImageView;
 }
 
+VkDeviceSize Image::GetMemorySize() const {
+    return mImageMemory.size;
+}
+
 
 // ---
 
 
+// Whole image, one barrier - use a BarrierBatch to transition several images together
 void TransitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer commandBuffer);
 
 
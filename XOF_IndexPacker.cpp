@@ -0,0 +1,78 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_IndexPacker.cpp
+    Desc    :    Packs index ranges for the GPU at the narrowest width that fits,
+                 16-bit wherever a range allows it (optionally after rebasing it
+                 onto its lowest vertex), 32-bit otherwise.
+
+===============================================================================
+*/
+#include "XOF_IndexPacker.hpp"
+#include <algorithm>
+#include <cstring>
+
+
+// Primitive restart is never enabled, so 0xFFFF is an ordinary index
+static const uint32_t MAX_SHORT_INDEX = 0xFFFF;
+
+
+void PackIndices(const unsigned int *indices, const IndexRange *ranges, uint32_t rangeCount, bool allowShort,
+                 bool rebase, std::vector<uint8_t>& packed, PackedIndexRange *packedRanges, IndexPackingStats *stats) {
+    // Pick each range's width and place it first, so packed is sized once
+    uint64_t size = 0;
+    uint32_t shortRangeCount = 0;
+    uint64_t unpackedSize = 0;
+    for (uint32_t r = 0; r < rangeCount; ++r) {
+        const unsigned int *first = indices + ranges[r].baseIndex;
+        const unsigned int *last = first + ranges[r].indexCount;
+
+        uint32_t minIndex = 0;
+        uint32_t maxIndex = 0;
+        if (first != last) {
+            auto minMax = std::minmax_element(first, last);
+            minIndex = *minMax.first;
+            maxIndex = *minMax.second;
+        }
+
+        PackedIndexRange& packedRange = packedRanges[r];
+        packedRange.vertexOffset = rebase ? static_cast<int32_t>(minIndex) : 0;
+        packedRange.indexSize = (allowShort && (maxIndex - packedRange.vertexOffset <= MAX_SHORT_INDEX)) ?
+                                sizeof(uint16_t) : sizeof(uint32_t);
+
+        size = (size + packedRange.indexSize - 1) / packedRange.indexSize * packedRange.indexSize;
+        packedRange.firstIndex = static_cast<uint32_t>(size / packedRange.indexSize);
+        size += uint64_t(ranges[r].indexCount) * packedRange.indexSize;
+
+        shortRangeCount += (packedRange.indexSize == sizeof(uint16_t)) ? 1 : 0;
+        unpackedSize += uint64_t(ranges[r].indexCount) * sizeof(uint32_t);
+    }
+
+    packed.assign(size, 0);
+    for (uint32_t r = 0; r < rangeCount; ++r) {
+        const unsigned int *source = indices + ranges[r].baseIndex;
+        const PackedIndexRange& packedRange = packedRanges[r];
+        uint8_t *destination = packed.data() + uint64_t(packedRange.firstIndex) * packedRange.indexSize;
+        const uint32_t vertexOffset = static_cast<uint32_t>(packedRange.vertexOffset);
+
+        if (packedRange.indexSize == sizeof(uint16_t)) {
+            for (uint32_t i = 0; i < ranges[r].indexCount; ++i) {
+                uint16_t index = static_cast<uint16_t>(source[i] - vertexOffset);
+                memcpy(destination + i * sizeof(uint16_t), &index, sizeof(uint16_t));
+            }
+        } else {
+            for (uint32_t i = 0; i < ranges[r].indexCount; ++i) {
+                uint32_t index = source[i] - vertexOffset;
+                memcpy(destination + i * sizeof(uint32_t), &index, sizeof(uint32_t));
+            }
+        }
+    }
+
+    if (stats) {
+        stats->shortRangeCount = shortRangeCount;
+        stats->unpackedSize = unpackedSize;
+        stats->packedSize = size;
+    }
+}
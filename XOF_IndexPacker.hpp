@@ -0,0 +1,44 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_IndexPacker.hpp
+    Desc    :    Packs index ranges for the GPU at the narrowest width that fits,
+                 16-bit wherever a range allows it (optionally after rebasing it
+                 onto its lowest vertex), 32-bit otherwise.
+
+===============================================================================
+*/
+#ifndef XOF_INDEX_PACKER_HPP
+#define XOF_INDEX_PACKER_HPP
+
+
+#include "XOF_MeshOptimizer.hpp"
+#include <cstdint>
+#include <vector>
+
+
+// Where and how a range ended up in the packed data. The draw binds the index buffer with an indexSize
+// wide type and draws indexCount indices from firstIndex (in units of that type), adding vertexOffset.
+struct PackedIndexRange {
+    uint32_t                    indexSize;      // 2 or 4
+    uint32_t                    firstIndex;
+    int32_t                     vertexOffset;   // 0 unless rebased
+};
+
+struct IndexPackingStats {
+    uint32_t                    shortRangeCount;
+    uint64_t                    unpackedSize;   // Bytes with every index 32-bit
+    uint64_t                    packedSize;
+};
+
+
+// packed is overwritten with the ranges back to back, each aligned to its own index size. With rebase each
+// range's indices are made relative to its smallest one, so ranges of a large mesh can still go 16-bit.
+// packedRanges has rangeCount entries. stats may be null.
+void PackIndices(const unsigned int *indices, const IndexRange *ranges, uint32_t rangeCount, bool allowShort,
+                 bool rebase, std::vector<uint8_t>& packed, PackedIndexRange *packedRanges, IndexPackingStats *stats);
+
+
+#endif // XOF_INDEX_PACKER_HPP
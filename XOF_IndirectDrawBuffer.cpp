@@ -0,0 +1,166 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_IndirectDrawBuffer.cpp
+    Desc    :    A frame's draws as a table of VkDrawIndexedIndirectCommands, with
+                 each draw's data in a storage buffer the shaders index by draw.
+
+===============================================================================
+*/
+#include "XOF_IndirectDrawBuffer.hpp"
+#include <algorithm>
+
+
+IndirectDrawBuffer::IndirectDrawBuffer() {
+    mCommandOffset = 0;
+    mDrawDataOffset = 0;
+    mSliceSize = 0;
+    mIsCreated = false;
+}
+
+IndirectDrawBuffer::~IndirectDrawBuffer() {
+    Destroy();
+}
+
+bool IndirectDrawBuffer::Create(const IndirectDrawBufferDesc& desc) {
+    Destroy();
+
+    mDesc = desc;
+    mDesc.frameCount = std::max(mDesc.frameCount, 1u);
+    if (mDesc.maxDrawCount == 0) {
+        return false;
+    }
+
+    // The draw data is bound with dynamic offsets, so it and every slice start on the device's storage alignment
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(mDesc.physicalDevice, &properties);
+    VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, sizeof(uint32_t));
+    auto alignUp = [alignment](VkDeviceSize size) { return (size + alignment - 1) / alignment * alignment; };
+
+    mCommandOffset = INDIRECT_MAX_BATCH_COUNT * sizeof(uint32_t);
+    mDrawDataOffset = alignUp(mCommandOffset + VkDeviceSize(mDesc.maxDrawCount) * sizeof(VkDrawIndexedIndirectCommand));
+    mSliceSize = alignUp(mDrawDataOffset + GetDrawDataRange());
+
+    // Host-visible like the instances, the table is rebuilt every frame and each entry read once
+    BufferDesc bufferDesc;
+    bufferDesc.size = mSliceSize * mDesc.frameCount;
+    bufferDesc.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    bufferDesc.logicalDevice = mDesc.logicalDevice;
+    bufferDesc.physicalDevice = mDesc.physicalDevice;
+    bufferDesc.allocator = mDesc.allocator;
+
+    mBuffer.reset(new Buffer(bufferDesc));
+    mBuffer->Map();
+
+    mCommands.reserve(mDesc.maxDrawCount);
+    mDrawData.reserve(mDesc.maxDrawCount);
+
+    return (mIsCreated = true);
+}
+
+void IndirectDrawBuffer::Destroy() {
+    mBuffer.reset();
+    Clear();
+    mIsCreated = false;
+}
+
+void IndirectDrawBuffer::Clear() {
+    mCommands.clear();
+    mDrawData.clear();
+    mBatchStarts.clear();
+}
+
+bool IndirectDrawBuffer::BeginBatch() {
+    if (mBatchStarts.size() >= INDIRECT_MAX_BATCH_COUNT) {
+        return false;
+    }
+    mBatchStarts.push_back(static_cast<uint32_t>(mCommands.size()));
+    return true;
+}
+
+bool IndirectDrawBuffer::Add(const VkDrawIndexedIndirectCommand& command, const DrawData& data) {
+    if (mBatchStarts.empty() || mCommands.size() >= mDesc.maxDrawCount) {
+        return false;
+    }
+    mCommands.push_back(command);
+    mDrawData.push_back(data);
+    return true;
+}
+
+void IndirectDrawBuffer::Prepare(uint32_t frameIndex) {
+    VkDeviceSize sliceOffset = GetSliceOffset(frameIndex);
+
+    uint32_t counts[INDIRECT_MAX_BATCH_COUNT] = {};
+    for (uint32_t batch = 0; batch < GetBatchCount(); ++batch) {
+        counts[batch] = GetBatchEnd(batch) - mBatchStarts[batch];
+    }
+    mBuffer->WriteToBufferMemory(counts, sizeof(counts), sliceOffset);
+
+    if (!mCommands.empty()) {
+        mBuffer->WriteToBufferMemory(mCommands.data(), mCommands.size() * sizeof(VkDrawIndexedIndirectCommand),
+                                     sliceOffset + mCommandOffset);
+        mBuffer->WriteToBufferMemory(mDrawData.data(), mDrawData.size() * sizeof(DrawData), sliceOffset + mDrawDataOffset);
+    }
+}
+
+void IndirectDrawBuffer::RecordBatch(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t batch,
+                                     VkPipelineLayout layout, uint32_t drawOffsetPushConstant) const {
+    uint32_t first = mBatchStarts[batch];
+    uint32_t count = GetBatchEnd(batch) - first;
+    if (count == 0) {
+        return;
+    }
+
+    VkBuffer buffer = const_cast<Buffer&>(*mBuffer).GetBuffer();
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    VkDeviceSize commandOffset = GetSliceOffset(frameIndex) + mCommandOffset + VkDeviceSize(first) * stride;
+
+    int32_t drawOffset = static_cast<int32_t>(first);
+    vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, drawOffsetPushConstant, sizeof(int32_t), &drawOffset);
+
+    // A non-zero firstInstance is only valid in an indirect command with the feature, a direct draw takes any
+    bool isDirect = false;
+    if (!mDesc.drawIndirectFirstInstance) {
+        for (uint32_t i = first; i < first + count && !isDirect; ++i) {
+            isDirect = (mCommands[i].firstInstance != 0);
+        }
+    }
+    if (isDirect) {
+        for (uint32_t i = first; i < first + count; ++i, ++drawOffset) {
+            if (i > first) {
+                vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, drawOffsetPushConstant,
+                                   sizeof(int32_t), &drawOffset);
+            }
+            const VkDrawIndexedIndirectCommand& command = mCommands[i];
+            vkCmdDrawIndexed(commandBuffer, command.indexCount, command.instanceCount, command.firstIndex,
+                             command.vertexOffset, command.firstInstance);
+        }
+        return;
+    }
+
+#if defined(VK_KHR_draw_indirect_count)
+    if (mDesc.drawIndexedIndirectCount) {
+        // The count is read from the buffer, so whatever fills the slice (CPU or compute culling) can shrink
+        // the batch without the command buffer changing
+        VkDeviceSize countOffset = GetSliceOffset(frameIndex) + batch * sizeof(uint32_t);
+        reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(mDesc.drawIndexedIndirectCount)(
+            commandBuffer, buffer, commandOffset, buffer, countOffset, count, stride);
+        return;
+    }
+#endif
+    if (mDesc.multiDrawIndirect) {
+        vkCmdDrawIndexedIndirect(commandBuffer, buffer, commandOffset, count, stride);
+    } else {
+        // drawCount can only be 1, the draw's index goes through the push constant instead of gl_DrawIDARB
+        for (uint32_t i = 0; i < count; ++i, ++drawOffset) {
+            if (i > 0) {
+                vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, drawOffsetPushConstant,
+                                   sizeof(int32_t), &drawOffset);
+            }
+            vkCmdDrawIndexedIndirect(commandBuffer, buffer, commandOffset + VkDeviceSize(i) * stride, 1, stride);
+        }
+    }
+}
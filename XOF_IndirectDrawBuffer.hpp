@@ -0,0 +1,141 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_IndirectDrawBuffer.hpp
+    Desc    :    A frame's draws as a table of VkDrawIndexedIndirectCommands, with
+                 each draw's data in a storage buffer the shaders index by draw.
+
+===============================================================================
+*/
+#ifndef XOF_INDIRECT_DRAW_BUFFER_HPP
+#define XOF_INDIRECT_DRAW_BUFFER_HPP
+
+
+#include "XOF_Buffer.hpp"
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+
+// Batches a frame can be split into, one per index buffer binding
+static const uint32_t INDIRECT_MAX_BATCH_COUNT = 8;
+
+
+// Matches DrawData in the vertex shaders (std430), read as draws[drawOffset + gl_DrawIDARB]. The textures are
+// indices into the bindless table (XOF_TextureTable.hpp), INVALID_TEXTURE_INDEX where the draw has none.
+struct DrawData {
+    int32_t                     diffuseTexture;
+    int32_t                     normalTexture;
+    int32_t                     specularTexture;
+};
+
+
+struct IndirectDrawBufferDesc {
+                            IndirectDrawBufferDesc() { memset(this, 0x00, sizeof(IndirectDrawBufferDesc)); }
+
+                            // Renderer pointers
+    VkPhysicalDevice        physicalDevice;
+    VkDevice                logicalDevice;
+    MemoryAllocator       * allocator;
+                            // One copy of the table per frame in flight, so filling it never touches one in use
+    uint32_t                frameCount;
+                            // Draws a frame can hold - fixed, as the draw data's descriptor is written once
+    uint32_t                maxDrawCount;
+                            // Whether the device's multiDrawIndirect feature is enabled, without it every
+                            // draw is its own vkCmdDrawIndexedIndirect
+    bool                    multiDrawIndirect;
+                            // Whether the device's drawIndirectFirstInstance feature is enabled, without it a batch
+                            // with any draw that starts past instance 0 is recorded as direct draws instead
+    bool                    drawIndirectFirstInstance;
+                            // vkCmdDrawIndexedIndirectCountKHR when VK_KHR_draw_indirect_count is enabled (null = not,
+                            // also ignored when built against headers without the extension)
+    PFN_vkVoidFunction      drawIndexedIndirectCount;
+};
+
+
+class IndirectDrawBuffer {
+public:
+                                    IndirectDrawBuffer();
+                                    ~IndirectDrawBuffer();
+
+    bool                            Create(const IndirectDrawBufferDesc& desc);
+                                    // The GPU must be done with every frame that used the buffer
+    void                            Destroy();
+
+                                    // Starts filling the table again, with no batch begun
+    void                            Clear();
+                                    // Draws added from here on are recorded together by RecordBatch(), false when
+                                    // INDIRECT_MAX_BATCH_COUNT have been begun already
+    bool                            BeginBatch();
+                                    // False (and the draw dropped) once maxDrawCount draws have been added
+    bool                            Add(const VkDrawIndexedIndirectCommand& command, const DrawData& data);
+
+                                    // Once a frame before recording, after frameIndex's fence has been waited on. Copies
+                                    // the table and counts into that frame's slice.
+    void                            Prepare(uint32_t frameIndex);
+                                    // Draws the batch from frameIndex's slice. The int at drawOffsetPushConstant (vertex
+                                    // stage) gets the batch's first draw, gl_DrawIDARB restarts at 0 for every call.
+    void                            RecordBatch(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t batch,
+                                                VkPipelineLayout layout, uint32_t drawOffsetPushConstant) const;
+
+    inline uint32_t                 GetDrawCount() const;
+    inline uint32_t                 GetBatchCount() const;
+    inline VkBuffer                 GetBuffer();
+                                    // For a dynamic storage buffer descriptor - bind GetDrawDataOffset(),
+                                    // GetDrawDataRange() long, with a dynamic offset of GetSliceOffset(frameIndex)
+    inline VkDeviceSize             GetDrawDataOffset() const;
+    inline VkDeviceSize             GetDrawDataRange() const;
+    inline VkDeviceSize             GetSliceOffset(uint32_t frameIndex) const;
+
+private:
+    IndirectDrawBufferDesc          mDesc;
+
+    std::vector<VkDrawIndexedIndirectCommand>   mCommands;
+    std::vector<DrawData>           mDrawData;
+                                    // First draw of each batch, the batch runs up to the next one's
+    std::vector<uint32_t>           mBatchStarts;
+
+                                    // Per slice - the batches' draw counts, the commands, then the draw data
+    std::unique_ptr<Buffer>         mBuffer;
+    VkDeviceSize                    mCommandOffset;
+    VkDeviceSize                    mDrawDataOffset;
+    VkDeviceSize                    mSliceSize;
+
+    bool                            mIsCreated;
+
+    inline uint32_t                 GetBatchEnd(uint32_t batch) const;
+};
+
+
+inline uint32_t IndirectDrawBuffer::GetDrawCount() const {
+    return static_cast<uint32_t>(mCommands.size());
+}
+
+inline uint32_t IndirectDrawBuffer::GetBatchCount() const {
+    return static_cast<uint32_t>(mBatchStarts.size());
+}
+
+inline VkBuffer IndirectDrawBuffer::GetBuffer() {
+    return mBuffer->GetBuffer();
+}
+
+inline VkDeviceSize IndirectDrawBuffer::GetDrawDataOffset() const {
+    return mDrawDataOffset;
+}
+
+inline VkDeviceSize IndirectDrawBuffer::GetDrawDataRange() const {
+    return VkDeviceSize(mDesc.maxDrawCount) * sizeof(DrawData);
+}
+
+inline VkDeviceSize IndirectDrawBuffer::GetSliceOffset(uint32_t frameIndex) const {
+    return VkDeviceSize(frameIndex) * mSliceSize;
+}
+
+inline uint32_t IndirectDrawBuffer::GetBatchEnd(uint32_t batch) const {
+    return (batch + 1 < mBatchStarts.size()) ? mBatchStarts[batch + 1] : static_cast<uint32_t>(mCommands.size());
+}
+
+
+#endif // XOF_INDIRECT_DRAW_BUFFER_HPP
@@ -0,0 +1,173 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_InstanceBuffer.cpp
+    Desc    :    Per-instance transforms for drawing many copies of a mesh with a
+                 single draw per submesh, streamed at VK_VERTEX_INPUT_RATE_INSTANCE.
+
+===============================================================================
+*/
+#include "XOF_InstanceBuffer.hpp"
+#include <algorithm>
+
+
+static const uint32_t DEFAULT_INSTANCE_CAPACITY = 256;
+
+
+InstanceBuffer::InstanceBuffer() {
+    mCapacity = 0;
+    mVersion = 0;
+    mIsCreated = false;
+}
+
+InstanceBuffer::~InstanceBuffer() {
+    Destroy();
+}
+
+bool InstanceBuffer::Create(const InstanceBufferDesc& desc) {
+    Destroy();
+
+    mDesc = desc;
+    mDesc.frameCount = std::max(mDesc.frameCount, 1u);
+    mFrameVersions.assign(mDesc.frameCount, 0);
+    mVersion = 0;
+
+    CreateBuffer(mDesc.initialCapacity ? mDesc.initialCapacity : DEFAULT_INSTANCE_CAPACITY);
+
+    return (mIsCreated = true);
+}
+
+void InstanceBuffer::Destroy() {
+    mRetiredBuffers.clear();
+    mBuffer.reset();
+    mCapacity = 0;
+    Clear();
+    mIsCreated = false;
+}
+
+InstanceHandle InstanceBuffer::Add(const glm::mat4& model) {
+    InstanceHandle handle;
+    if (!mFreeHandles.empty()) {
+        handle = mFreeHandles.back();
+        mFreeHandles.pop_back();
+    } else {
+        handle = static_cast<InstanceHandle>(mHandleSlots.size());
+        mHandleSlots.push_back(INVALID_INSTANCE_HANDLE);
+    }
+
+    mHandleSlots[handle] = static_cast<uint32_t>(mInstances.size());
+    mSlotHandles.push_back(handle);
+    mInstances.push_back({ model });
+    ++mVersion;
+
+    return handle;
+}
+
+bool InstanceBuffer::Remove(InstanceHandle handle) {
+    if (handle >= mHandleSlots.size() || mHandleSlots[handle] == INVALID_INSTANCE_HANDLE) {
+        return false;
+    }
+
+    // Swap with the last so the instances stay packed
+    uint32_t slot = mHandleSlots[handle];
+    uint32_t lastSlot = static_cast<uint32_t>(mInstances.size()) - 1;
+    if (slot != lastSlot) {
+        mInstances[slot] = mInstances[lastSlot];
+        mSlotHandles[slot] = mSlotHandles[lastSlot];
+        mHandleSlots[mSlotHandles[slot]] = slot;
+    }
+    mInstances.pop_back();
+    mSlotHandles.pop_back();
+
+    mHandleSlots[handle] = INVALID_INSTANCE_HANDLE;
+    mFreeHandles.push_back(handle);
+    ++mVersion;
+
+    return true;
+}
+
+bool InstanceBuffer::Update(InstanceHandle handle, const glm::mat4& model) {
+    if (handle >= mHandleSlots.size() || mHandleSlots[handle] == INVALID_INSTANCE_HANDLE) {
+        return false;
+    }
+
+    mInstances[mHandleSlots[handle]].model = model;
+    ++mVersion;
+
+    return true;
+}
+
+void InstanceBuffer::Clear() {
+    mInstances.clear();
+    mHandleSlots.clear();
+    mSlotHandles.clear();
+    mFreeHandles.clear();
+    ++mVersion;
+}
+
+VkDeviceSize InstanceBuffer::Prepare(uint32_t frameIndex) {
+    // A frame comes round again once every other frame has, so frameCount calls later nothing uses a retired buffer
+    for (auto it = mRetiredBuffers.begin(); it != mRetiredBuffers.end();) {
+        if (--it->second == 0) {
+            it = mRetiredBuffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (mInstances.size() > mCapacity) {
+        mRetiredBuffers.push_back(std::make_pair(std::move(mBuffer), mDesc.frameCount));
+        CreateBuffer(std::max(static_cast<uint32_t>(mInstances.size()), mCapacity * 2));
+    }
+
+    VkDeviceSize sliceOffset = VkDeviceSize(frameIndex) * mCapacity * sizeof(InstanceData);
+    if (mFrameVersions[frameIndex] != mVersion) {
+        if (!mInstances.empty()) {
+            mBuffer->WriteToBufferMemory(mInstances.data(), mInstances.size() * sizeof(InstanceData), sliceOffset);
+        }
+        mFrameVersions[frameIndex] = mVersion;
+    }
+
+    return sliceOffset;
+}
+
+void InstanceBuffer::CreateBuffer(uint32_t capacity) {
+    // Host-visible and read straight from there like the uniforms - it's rewritten whenever anything moves,
+    // and per-instance fetches are few next to the vertices
+    BufferDesc bufferDesc;
+    bufferDesc.size = VkDeviceSize(capacity) * sizeof(InstanceData) * mDesc.frameCount;
+    bufferDesc.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    bufferDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    bufferDesc.logicalDevice = mDesc.logicalDevice;
+    bufferDesc.physicalDevice = mDesc.physicalDevice;
+    bufferDesc.allocator = mDesc.allocator;
+
+    mBuffer.reset(new Buffer(bufferDesc));
+    mBuffer->Map();
+    mCapacity = capacity;
+
+    // Nothing has been written to the new buffer yet
+    std::fill(mFrameVersions.begin(), mFrameVersions.end(), mVersion - 1);
+}
+
+VkVertexInputBindingDescription InstanceBuffer::GetBindingDescription(uint32_t binding) {
+    VkVertexInputBindingDescription bindingDesc = {};
+    bindingDesc.binding = binding;
+    bindingDesc.stride = sizeof(InstanceData);
+    bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    return bindingDesc;
+}
+
+std::array<VkVertexInputAttributeDescription, INSTANCE_ATTRIBUTE_COUNT> InstanceBuffer::GetAttributeDescriptions(uint32_t binding,
+                                                                                                                 uint32_t firstLocation) {
+    std::array<VkVertexInputAttributeDescription, INSTANCE_ATTRIBUTE_COUNT> attributeDescriptions = {};
+    for (uint32_t column = 0; column < INSTANCE_ATTRIBUTE_COUNT; ++column) {
+        attributeDescriptions[column].binding = binding;
+        attributeDescriptions[column].location = firstLocation + column;
+        attributeDescriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[column].offset = offsetof(InstanceData, model) + column * sizeof(glm::vec4);
+    }
+    return attributeDescriptions;
+}
@@ -0,0 +1,116 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_InstanceBuffer.hpp
+    Desc    :    Per-instance transforms for drawing many copies of a mesh with a
+                 single draw per submesh, streamed at VK_VERTEX_INPUT_RATE_INSTANCE.
+
+===============================================================================
+*/
+#ifndef XOF_INSTANCE_BUFFER_HPP
+#define XOF_INSTANCE_BUFFER_HPP
+
+
+#include "XOF_Buffer.hpp"
+#include <vulkan/vulkan.h>
+#include <array>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+
+// Stays valid until removed, after which it may be handed out again
+typedef uint32_t InstanceHandle;
+static const InstanceHandle INVALID_INSTANCE_HANDLE = ~0u;
+
+// Matches the instance inputs of the vertex shaders - the columns of the transform in four
+// consecutive locations
+static const uint32_t INSTANCE_ATTRIBUTE_COUNT = 4;
+
+
+struct InstanceData {
+    glm::mat4                   model;
+};
+
+
+struct InstanceBufferDesc {
+                            InstanceBufferDesc() { memset(this, 0x00, sizeof(InstanceBufferDesc)); }
+
+                            // Renderer pointers
+    VkPhysicalDevice        physicalDevice;
+    VkDevice                logicalDevice;
+    MemoryAllocator       * allocator;
+                            // One copy of the instances per frame in flight, so updates never touch one in use
+    uint32_t                frameCount;
+                            // Instances room is made for up front (0 picks a default), grows as needed
+    uint32_t                initialCapacity;
+};
+
+
+class InstanceBuffer {
+public:
+                                    InstanceBuffer();
+                                    ~InstanceBuffer();
+
+    bool                            Create(const InstanceBufferDesc& desc);
+                                    // The GPU must be done with every frame that used the buffer
+    void                            Destroy();
+
+    InstanceHandle                  Add(const glm::mat4& model);
+                                    // The last instance moves into the removed one's place, instance order isn't kept
+    bool                            Remove(InstanceHandle handle);
+    bool                            Update(InstanceHandle handle, const glm::mat4& model);
+    void                            Clear();
+
+                                    // Once a frame before recording, after frameIndex's fence has been waited on. Brings that
+                                    // frame's copy up to date and returns the offset to bind the buffer at.
+    VkDeviceSize                    Prepare(uint32_t frameIndex);
+
+    inline uint32_t                 GetCount() const;
+                                    // In draw order, instance i is drawn with gl_InstanceIndex i
+    inline const std::vector<InstanceData>& GetInstances() const;
+    inline VkBuffer                 GetBuffer();
+
+    static VkVertexInputBindingDescription  GetBindingDescription(uint32_t binding);
+    static std::array<VkVertexInputAttributeDescription, INSTANCE_ATTRIBUTE_COUNT>
+                                    GetAttributeDescriptions(uint32_t binding, uint32_t firstLocation);
+
+private:
+    InstanceBufferDesc              mDesc;
+
+    std::vector<InstanceData>       mInstances;
+                                    // Handle -> index into mInstances (INVALID_INSTANCE_HANDLE when free) and back
+    std::vector<uint32_t>           mHandleSlots;
+    std::vector<InstanceHandle>     mSlotHandles;
+    std::vector<InstanceHandle>     mFreeHandles;
+
+    std::unique_ptr<Buffer>         mBuffer;
+    uint32_t                        mCapacity;
+                                    // Bumped on every change, each frame's copy is rewritten when it's behind
+    uint64_t                        mVersion;
+    std::vector<uint64_t>           mFrameVersions;
+                                    // Outgrown buffers, freed once every frame that could still use them has come round again
+    std::vector<std::pair<std::unique_ptr<Buffer>, uint32_t>>   mRetiredBuffers;
+
+    bool                            mIsCreated;
+
+    void                            CreateBuffer(uint32_t capacity);
+};
+
+
+inline uint32_t InstanceBuffer::GetCount() const {
+    return static_cast<uint32_t>(mInstances.size());
+}
+
+inline const std::vector<InstanceData>& InstanceBuffer::GetInstances() const {
+    return mInstances;
+}
+
+inline VkBuffer InstanceBuffer::GetBuffer() {
+    return mBuffer->GetBuffer();
+}
+
+
+#endif // XOF_INSTANCE_BUFFER_HPP
@@ -0,0 +1,131 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_MappedFile.cpp
+    Desc    :    Read-only memory-mapped file, used for loading large assets without
+                 copying them through an intermediate buffer.
+
+===============================================================================
+*/
+#include "XOF_MappedFile.hpp"
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile() : mFileHandle(nullptr), mMappingHandle(nullptr), mData(nullptr), mSize(0) {}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const char *fileName) {
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    mFileHandle = file;
+    mMappingHandle = mapping;
+    mData = static_cast<const char*>(data);
+    mSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int file = open(fileName, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat fileStats;
+    if (fstat(file, &fileStats) != 0 || fileStats.st_size == 0) {
+        close(file);
+        return false;
+    }
+
+    void *data = mmap(nullptr, static_cast<size_t>(fileStats.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    close(file); // The mapping keeps its own reference to the file
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    madvise(data, static_cast<size_t>(fileStats.st_size), MADV_SEQUENTIAL);
+
+    mData = static_cast<const char*>(data);
+    mSize = static_cast<size_t>(fileStats.st_size);
+#endif
+
+    return true;
+}
+
+void MappedFile::Close() {
+    if (!mData) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(mData);
+    CloseHandle(static_cast<HANDLE>(mMappingHandle));
+    CloseHandle(static_cast<HANDLE>(mFileHandle));
+#else
+    munmap(const_cast<char*>(mData), mSize);
+#endif
+
+    mFileHandle = nullptr;
+    mMappingHandle = nullptr;
+    mData = nullptr;
+    mSize = 0;
+}
+
+
+// ---
+
+
+bool GetFileStats(const char *fileName, uint64_t& size, int64_t& modifiedTime) {
+#ifdef _WIN32
+    struct __stat64 fileStats;
+    if (_stat64(fileName, &fileStats) != 0) {
+        return false;
+    }
+#else
+    struct stat fileStats;
+    if (stat(fileName, &fileStats) != 0) {
+        return false;
+    }
+#endif
+
+    size = static_cast<uint64_t>(fileStats.st_size);
+    modifiedTime = static_cast<int64_t>(fileStats.st_mtime);
+    return true;
+}
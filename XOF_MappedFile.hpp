@@ -0,0 +1,65 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_MappedFile.hpp
+    Desc    :    Read-only memory-mapped file, used for loading large assets without
+                 copying them through an intermediate buffer.
+
+===============================================================================
+*/
+#ifndef XOF_MAPPED_FILE_HPP
+#define XOF_MAPPED_FILE_HPP
+
+
+#include <cstdint>
+#include <cstddef>
+
+
+class MappedFile {
+public:
+                            MappedFile();
+                            ~MappedFile();
+
+    bool                    Open(const char *fileName);
+    void                    Close();
+
+    inline bool             IsOpen() const;
+    inline const char     * GetData() const;
+    inline size_t           GetSize() const;
+
+private:
+                            // Platform handles, kept opaque so the header doesn't drag in windows.h
+    void                  * mFileHandle;
+    void                  * mMappingHandle;
+    const char            * mData;
+    size_t                  mSize;
+
+                            // Non-copyable, the mapping is released on destruction
+                            MappedFile(const MappedFile&);
+    MappedFile&             operator=(const MappedFile&);
+};
+
+
+inline bool MappedFile::IsOpen() const {
+    return mData != nullptr;
+}
+
+inline const char* MappedFile::GetData() const {
+    return mData;
+}
+
+inline size_t MappedFile::GetSize() const {
+    return mSize;
+}
+
+
+// ---
+
+
+// Size and last modification time (seconds since epoch) of a file on disk
+bool GetFileStats(const char *fileName, uint64_t& size, int64_t& modifiedTime);
+
+
+#endif // XOF_MAPPED_FILE_HPP
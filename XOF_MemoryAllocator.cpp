@@ -0,0 +1,480 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_MemoryAllocator.cpp
+    Desc    :    Sub-allocates buffer and image memory out of large per-memory-type
+                 blocks (TLSF), rather than one vkAllocateMemory per resource.
+
+===============================================================================
+*/
+#include "XOF_MemoryAllocator.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+// Smallest range worth tracking, smaller leftovers stay with the allocation they were split from
+static const VkDeviceSize MIN_ALLOCATION_SIZE = 256;
+
+
+static uint32_t BitScanForward(uint64_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return index;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+static uint32_t BitScanReverse(uint64_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, mask);
+    return index;
+#else
+    return 63 - __builtin_clzll(mask);
+#endif
+}
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+
+MemoryAllocator::MemoryAllocator() {
+    memset(&mStats, 0x00, sizeof(MemoryAllocatorStats));
+    mIsCreated = false;
+}
+
+MemoryAllocator::~MemoryAllocator() {
+    Destroy();
+}
+
+bool MemoryAllocator::Create(const MemoryAllocatorDesc& desc) {
+    Destroy();
+    mDesc = desc;
+
+    if (mDesc.cpuOnly) {
+        mMemoryProperties = mDesc.fakeMemoryProperties;
+        mBufferImageGranularity = std::max<VkDeviceSize>(mDesc.fakeBufferImageGranularity, 1);
+        mMaxAllocationCount = mDesc.fakeMaxAllocationCount ? mDesc.fakeMaxAllocationCount : 4096;
+    } else {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(mDesc.physicalDevice, &properties);
+        vkGetPhysicalDeviceMemoryProperties(mDesc.physicalDevice, &mMemoryProperties);
+        mBufferImageGranularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+        mMaxAllocationCount = properties.limits.maxMemoryAllocationCount;
+    }
+
+    // One pool per memory type and resource tiling
+    mPools.resize(mMemoryProperties.memoryTypeCount * RESOURCE_TILING_COUNT);
+    for (uint32_t i = 0; i < mPools.size(); ++i) {
+        mPools[i].memoryTypeIndex = i / RESOURCE_TILING_COUNT;
+        mPools[i].flBitmap = 0;
+        memset(mPools[i].slBitmap, 0x00, sizeof(mPools[i].slBitmap));
+        memset(mPools[i].freeLists, 0xFF, sizeof(mPools[i].freeLists));
+    }
+
+    return (mIsCreated = true);
+}
+
+void MemoryAllocator::Destroy() {
+    if (!mIsCreated) {
+        return;
+    }
+
+    for (auto& pool : mPools) {
+        for (uint32_t i = 0; i < pool.blocks.size(); ++i) {
+            DestroyBlock(pool, i);
+        }
+    }
+
+    mPools.clear();
+    mNodes.clear();
+    mUnusedNodes.clear();
+    memset(&mStats, 0x00, sizeof(MemoryAllocatorStats));
+    mIsCreated = false;
+}
+
+bool MemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                               ResourceTiling tiling, Allocation& allocation) {
+    uint32_t memoryTypeIndex;
+    if (!FindMemoryTypeIndex(requirements.memoryTypeBits, properties, memoryTypeIndex)) {
+        throw std::runtime_error("Failed to find suitable memory type!");
+        return false;
+    }
+
+    uint32_t poolIndex = GetPoolIndex(memoryTypeIndex, tiling);
+    Pool& pool = mPools[poolIndex];
+
+    VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+    VkDeviceSize size = std::max(requirements.size, MIN_ALLOCATION_SIZE);
+    VkDeviceSize preferredBlockSize = GetPreferredBlockSize(memoryTypeIndex);
+
+    uint32_t nodeIndex = INVALID_INDEX;
+    if (size > preferredBlockSize / 2) {
+        // Big resources get a block of their own rather than fragmenting the shared ones
+        CreateBlock(poolIndex, AlignUp(size, MIN_ALLOCATION_SIZE), true, nodeIndex);
+    } else {
+        // Searching with the worst-case alignment padding included means whatever we find is guaranteed to fit
+        nodeIndex = FindFreeNode(pool, size + alignment - 1);
+        if (nodeIndex == INVALID_INDEX) {
+            CreateBlock(poolIndex, preferredBlockSize, false, nodeIndex);
+        }
+    }
+
+    if (nodeIndex == INVALID_INDEX) {
+        throw std::runtime_error("Failed to sub-allocate device memory!");
+        return false;
+    }
+
+    // Fresh blocks hand back their node directly, it never goes through the free lists
+    if (mNodes[nodeIndex].isFree) {
+        RemoveFreeNode(pool, nodeIndex);
+    }
+    SplitNode(pool, nodeIndex, alignment, size);
+
+    const Node& node = mNodes[nodeIndex];
+    const Block& block = pool.blocks[node.block];
+
+    allocation.memory = block.memory;
+    allocation.offset = node.offset;
+    allocation.size = requirements.size;
+    allocation.mappedData = block.mappedData ? static_cast<char*>(block.mappedData) + node.offset : nullptr;
+    allocation.memoryTypeIndex = memoryTypeIndex;
+    allocation.pool = poolIndex;
+    allocation.node = nodeIndex;
+
+    ++mStats.allocationCount;
+    mStats.usedBytes += node.size;
+
+    return true;
+}
+
+void MemoryAllocator::Free(Allocation& allocation) {
+    if (!allocation.IsValid() || !mIsCreated) {
+        return;
+    }
+
+    Pool& pool = mPools[allocation.pool];
+    uint32_t nodeIndex = allocation.node;
+
+    --mStats.allocationCount;
+    mStats.usedBytes -= mNodes[nodeIndex].size;
+
+    // Coalesce with free physical neighbours
+    uint32_t prevIndex = mNodes[nodeIndex].prevPhysical;
+    if (prevIndex != INVALID_INDEX && mNodes[prevIndex].isFree) {
+        RemoveFreeNode(pool, prevIndex);
+        mNodes[prevIndex].size += mNodes[nodeIndex].size;
+        mNodes[prevIndex].nextPhysical = mNodes[nodeIndex].nextPhysical;
+        if (mNodes[nodeIndex].nextPhysical != INVALID_INDEX) {
+            mNodes[mNodes[nodeIndex].nextPhysical].prevPhysical = prevIndex;
+        }
+        ReleaseNode(nodeIndex);
+        nodeIndex = prevIndex;
+    }
+
+    uint32_t nextIndex = mNodes[nodeIndex].nextPhysical;
+    if (nextIndex != INVALID_INDEX && mNodes[nextIndex].isFree) {
+        RemoveFreeNode(pool, nextIndex);
+        mNodes[nodeIndex].size += mNodes[nextIndex].size;
+        mNodes[nodeIndex].nextPhysical = mNodes[nextIndex].nextPhysical;
+        if (mNodes[nextIndex].nextPhysical != INVALID_INDEX) {
+            mNodes[mNodes[nextIndex].nextPhysical].prevPhysical = nodeIndex;
+        }
+        ReleaseNode(nextIndex);
+    }
+
+    Node& node = mNodes[nodeIndex];
+    node.isFree = true;
+
+    // Give empty blocks back to the driver, but keep one shared block per pool around to avoid thrashing
+    bool blockIsEmpty = (node.prevPhysical == INVALID_INDEX) && (node.nextPhysical == INVALID_INDEX);
+    if (blockIsEmpty) {
+        uint32_t liveSharedBlocks = 0;
+        for (const auto& block : pool.blocks) {
+            liveSharedBlocks += (block.inUse && !block.dedicated) ? 1 : 0;
+        }
+
+        const Block& block = pool.blocks[node.block];
+        if (block.dedicated || liveSharedBlocks > 1) {
+            uint32_t blockIndex = node.block;
+            ReleaseNode(nodeIndex);
+            DestroyBlock(pool, blockIndex);
+            allocation = Allocation();
+            return;
+        }
+    }
+
+    InsertFreeNode(pool, nodeIndex);
+    allocation = Allocation();
+}
+
+bool MemoryAllocator::FindMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& typeIndex) const {
+    for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; ++i) {
+        if ((typeFilter & (1 << i)) && ((mMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+            typeIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+VkDeviceSize MemoryAllocator::GetPreferredBlockSize(uint32_t memoryTypeIndex) const {
+    VkDeviceSize blockSize = mDesc.blockSize ? mDesc.blockSize : DEFAULT_BLOCK_SIZE;
+    // Don't let a single block swallow a small heap (e.g. the 256MB host-visible device-local heap on some GPUs)
+    VkDeviceSize heapSize = mMemoryProperties.memoryHeaps[mMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+    if (heapSize > 0) {
+        blockSize = std::min(blockSize, AlignUp(heapSize / 8, MIN_ALLOCATION_SIZE));
+    }
+    return std::max(blockSize, MIN_ALLOCATION_SIZE * 4);
+}
+
+uint32_t MemoryAllocator::GetPoolIndex(uint32_t memoryTypeIndex, ResourceTiling tiling) const {
+    // Linear and optimal resources only have to be segregated when the device has a granularity restriction,
+    // keeping them in separate blocks satisfies bufferImageGranularity without having to inspect neighbours
+    ResourceTiling poolTiling = (mBufferImageGranularity > 1) ? tiling : RESOURCE_TILING_LINEAR;
+    return memoryTypeIndex * RESOURCE_TILING_COUNT + poolTiling;
+}
+
+bool MemoryAllocator::CreateBlock(uint32_t poolIndex, VkDeviceSize size, bool dedicated, uint32_t& nodeIndex) {
+    if (mStats.deviceAllocationCount >= mMaxAllocationCount) {
+        throw std::runtime_error("Exceeded maxMemoryAllocationCount!");
+        return false;
+    }
+
+    Pool& pool = mPools[poolIndex];
+
+    Block block = {};
+    block.size = size;
+    block.dedicated = dedicated;
+    block.inUse = true;
+
+    if (mDesc.cpuOnly) {
+        block.hostMemory = malloc(static_cast<size_t>(size));
+        if (!block.hostMemory) {
+            throw std::runtime_error("Failed to allocate host memory for block!");
+            return false;
+        }
+        block.mappedData = block.hostMemory;
+    } else {
+        VkMemoryAllocateInfo memAllocateInfo = {};
+        memAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAllocateInfo.allocationSize = size;
+        memAllocateInfo.memoryTypeIndex = pool.memoryTypeIndex;
+
+        if (vkAllocateMemory(mDesc.logicalDevice, &memAllocateInfo, nullptr, &block.memory) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate device memory block!");
+            return false;
+        }
+
+        // Host-visible blocks are mapped once for their whole lifetime (memory can't be mapped twice,
+        // so per-allocation mapping isn't an option once resources share a block)
+        if (mMemoryProperties.memoryTypes[pool.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            if (vkMapMemory(mDesc.logicalDevice, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mappedData) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to map device memory block!");
+                return false;
+            }
+        }
+    }
+
+    // Reuse a released slot if there is one
+    uint32_t blockIndex = static_cast<uint32_t>(pool.blocks.size());
+    for (uint32_t i = 0; i < pool.blocks.size(); ++i) {
+        if (!pool.blocks[i].inUse) {
+            blockIndex = i;
+            break;
+        }
+    }
+    if (blockIndex == pool.blocks.size()) {
+        pool.blocks.push_back(block);
+    } else {
+        pool.blocks[blockIndex] = block;
+    }
+
+    // The whole block starts off as a single free node
+    nodeIndex = AcquireNode();
+    Node& node = mNodes[nodeIndex];
+    node.offset = 0;
+    node.size = size;
+    node.block = blockIndex;
+    node.prevPhysical = INVALID_INDEX;
+    node.nextPhysical = INVALID_INDEX;
+
+    ++mStats.deviceAllocationCount;
+    mStats.reservedBytes += size;
+
+    return true;
+}
+
+void MemoryAllocator::DestroyBlock(Pool& pool, uint32_t blockIndex) {
+    Block& block = pool.blocks[blockIndex];
+    if (!block.inUse) {
+        return;
+    }
+
+    if (mDesc.cpuOnly) {
+        free(block.hostMemory);
+    } else {
+        if (block.mappedData) {
+            vkUnmapMemory(mDesc.logicalDevice, block.memory);
+        }
+        vkFreeMemory(mDesc.logicalDevice, block.memory, nullptr);
+    }
+
+    --mStats.deviceAllocationCount;
+    mStats.reservedBytes -= block.size;
+
+    block = Block();
+    block.inUse = false;
+}
+
+uint32_t MemoryAllocator::AcquireNode() {
+    uint32_t nodeIndex;
+    if (!mUnusedNodes.empty()) {
+        nodeIndex = mUnusedNodes.back();
+        mUnusedNodes.pop_back();
+    } else {
+        nodeIndex = static_cast<uint32_t>(mNodes.size());
+        mNodes.push_back(Node());
+    }
+
+    Node& node = mNodes[nodeIndex];
+    node.prevPhysical = node.nextPhysical = INVALID_INDEX;
+    node.prevFree = node.nextFree = INVALID_INDEX;
+    node.isFree = false;
+
+    return nodeIndex;
+}
+
+void MemoryAllocator::ReleaseNode(uint32_t nodeIndex) {
+    mUnusedNodes.push_back(nodeIndex);
+}
+
+static void MappingInsert(VkDeviceSize size, uint32_t& fl, uint32_t& sl, uint32_t slIndexLog2) {
+    fl = BitScanReverse(size);
+    // Ranges smaller than the second-level subdivision all share the first list of their class
+    sl = (fl < slIndexLog2) ? 0 : static_cast<uint32_t>((size >> (fl - slIndexLog2)) & ((1u << slIndexLog2) - 1));
+}
+
+void MemoryAllocator::InsertFreeNode(Pool& pool, uint32_t nodeIndex) {
+    uint32_t fl, sl;
+    MappingInsert(mNodes[nodeIndex].size, fl, sl, SL_INDEX_LOG2);
+
+    Node& node = mNodes[nodeIndex];
+    node.isFree = true;
+    node.prevFree = INVALID_INDEX;
+    node.nextFree = pool.freeLists[fl][sl];
+    if (node.nextFree != INVALID_INDEX) {
+        mNodes[node.nextFree].prevFree = nodeIndex;
+    }
+
+    pool.freeLists[fl][sl] = nodeIndex;
+    pool.flBitmap |= (uint64_t(1) << fl);
+    pool.slBitmap[fl] |= (1u << sl);
+}
+
+void MemoryAllocator::RemoveFreeNode(Pool& pool, uint32_t nodeIndex) {
+    uint32_t fl, sl;
+    MappingInsert(mNodes[nodeIndex].size, fl, sl, SL_INDEX_LOG2);
+
+    Node& node = mNodes[nodeIndex];
+    if (node.prevFree != INVALID_INDEX) {
+        mNodes[node.prevFree].nextFree = node.nextFree;
+    }
+    if (node.nextFree != INVALID_INDEX) {
+        mNodes[node.nextFree].prevFree = node.prevFree;
+    }
+
+    if (pool.freeLists[fl][sl] == nodeIndex) {
+        pool.freeLists[fl][sl] = node.nextFree;
+        if (node.nextFree == INVALID_INDEX) {
+            pool.slBitmap[fl] &= ~(1u << sl);
+            if (pool.slBitmap[fl] == 0) {
+                pool.flBitmap &= ~(uint64_t(1) << fl);
+            }
+        }
+    }
+
+    node.isFree = false;
+    node.prevFree = node.nextFree = INVALID_INDEX;
+}
+
+uint32_t MemoryAllocator::FindFreeNode(Pool& pool, VkDeviceSize size) const {
+    // Round the request up to the next second-level boundary so that any node in the list we land on is big enough
+    uint32_t fl = BitScanReverse(size);
+    if (fl >= SL_INDEX_LOG2) {
+        size += (VkDeviceSize(1) << (fl - SL_INDEX_LOG2)) - 1;
+    }
+
+    uint32_t sl;
+    MappingInsert(size, fl, sl, SL_INDEX_LOG2);
+
+    uint32_t slMap = pool.slBitmap[fl] & (~0u << sl);
+    if (slMap == 0) {
+        uint64_t flMap = (fl + 1 < FL_INDEX_COUNT) ? (pool.flBitmap & (~uint64_t(0) << (fl + 1))) : 0;
+        if (flMap == 0) {
+            return INVALID_INDEX;
+        }
+        fl = BitScanForward(flMap);
+        slMap = pool.slBitmap[fl];
+    }
+    sl = BitScanForward(slMap);
+
+    return pool.freeLists[fl][sl];
+}
+
+void MemoryAllocator::SplitNode(Pool& pool, uint32_t nodeIndex, VkDeviceSize alignment, VkDeviceSize size) {
+    // Leading padding needed to reach the requested alignment becomes its own free node
+    VkDeviceSize alignedOffset = AlignUp(mNodes[nodeIndex].offset, alignment);
+    VkDeviceSize padding = alignedOffset - mNodes[nodeIndex].offset;
+    if (padding > 0) {
+        uint32_t paddingIndex = AcquireNode();
+        Node& paddingNode = mNodes[paddingIndex];
+        Node& node = mNodes[nodeIndex];
+
+        paddingNode.offset = node.offset;
+        paddingNode.size = padding;
+        paddingNode.block = node.block;
+        paddingNode.prevPhysical = node.prevPhysical;
+        paddingNode.nextPhysical = nodeIndex;
+        if (node.prevPhysical != INVALID_INDEX) {
+            mNodes[node.prevPhysical].nextPhysical = paddingIndex;
+        }
+
+        node.prevPhysical = paddingIndex;
+        node.offset = alignedOffset;
+        node.size -= padding;
+        InsertFreeNode(pool, paddingIndex);
+    }
+
+    // Trailing remainder goes back to the free lists if it's worth tracking
+    if (mNodes[nodeIndex].size - size >= MIN_ALLOCATION_SIZE) {
+        uint32_t remainderIndex = AcquireNode();
+        Node& remainderNode = mNodes[remainderIndex];
+        Node& node = mNodes[nodeIndex];
+
+        remainderNode.offset = node.offset + size;
+        remainderNode.size = node.size - size;
+        remainderNode.block = node.block;
+        remainderNode.prevPhysical = nodeIndex;
+        remainderNode.nextPhysical = node.nextPhysical;
+        if (node.nextPhysical != INVALID_INDEX) {
+            mNodes[node.nextPhysical].prevPhysical = remainderIndex;
+        }
+
+        node.nextPhysical = remainderIndex;
+        node.size = size;
+        InsertFreeNode(pool, remainderIndex);
+    }
+
+    mNodes[nodeIndex].isFree = false;
+}
@@ -0,0 +1,160 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_MemoryAllocator.hpp
+    Desc    :    Sub-allocates buffer and image memory out of large per-memory-type
+                 blocks (TLSF), rather than one vkAllocateMemory per resource.
+
+===============================================================================
+*/
+#ifndef XOF_MEMORY_ALLOCATOR_HPP
+#define XOF_MEMORY_ALLOCATOR_HPP
+
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstring>
+
+
+// Buffers and linear images vs. optimally tiled images; the two have to be kept
+// bufferImageGranularity apart when they share a block
+enum ResourceTiling {
+    RESOURCE_TILING_LINEAR,
+    RESOURCE_TILING_OPTIMAL,
+    RESOURCE_TILING_COUNT
+};
+
+
+struct MemoryAllocatorDesc {
+                                        MemoryAllocatorDesc() { memset(this, 0x00, sizeof(MemoryAllocatorDesc)); }
+
+                                        // Renderer pointers
+    VkPhysicalDevice                    physicalDevice;
+    VkDevice                            logicalDevice;
+                                        // Preferred size of each device allocation (0 picks a default per heap)
+    VkDeviceSize                        blockSize;
+                                        // CPU-only mode - no device calls are made, memory types and limits come from the
+                                        // fake* fields and blocks are backed by host memory. Lets the sub-allocation logic
+                                        // be exercised and inspected without a GPU.
+    bool                                cpuOnly;
+    VkPhysicalDeviceMemoryProperties    fakeMemoryProperties;
+    VkDeviceSize                        fakeBufferImageGranularity;
+    uint32_t                            fakeMaxAllocationCount;
+};
+
+
+// Handle to a sub-allocation, owned by whoever requested it and returned via MemoryAllocator::Free
+struct Allocation {
+    VkDeviceMemory                      memory = VK_NULL_HANDLE;
+    VkDeviceSize                        offset = 0;
+    VkDeviceSize                        size = 0;
+                                        // Non-null for host-visible memory, blocks stay mapped for their whole lifetime
+    void                              * mappedData = nullptr;
+    uint32_t                            memoryTypeIndex = 0;
+    uint32_t                            pool = ~0u;
+    uint32_t                            node = ~0u;
+
+    bool                                IsValid() const { return node != ~0u; }
+};
+
+
+struct MemoryAllocatorStats {
+    uint32_t                            deviceAllocationCount;
+    uint32_t                            allocationCount;
+    VkDeviceSize                        reservedBytes;
+    VkDeviceSize                        usedBytes;
+};
+
+
+class MemoryAllocator {
+public:
+                                        MemoryAllocator();
+                                        ~MemoryAllocator();
+
+    bool                                Create(const MemoryAllocatorDesc& desc);
+    void                                Destroy();
+
+    bool                                Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                                 ResourceTiling tiling, Allocation& allocation);
+    void                                Free(Allocation& allocation);
+
+    bool                                FindMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& typeIndex) const;
+
+    inline const MemoryAllocatorStats&  GetStats() const;
+    inline bool                         IsCpuOnly() const;
+
+private:
+                                        // TLSF parameters - 64 first-level (power of two) classes, 16 linear second-level
+                                        // subdivisions each
+    static const uint32_t               SL_INDEX_LOG2 = 4;
+    static const uint32_t               SL_INDEX_COUNT = 1 << SL_INDEX_LOG2;
+    static const uint32_t               FL_INDEX_COUNT = 64;
+    static const uint32_t               INVALID_INDEX = ~0u;
+
+    struct Block {
+        VkDeviceMemory                  memory;
+        void                          * hostMemory;   // CPU-only mode backing store
+        void                          * mappedData;
+        VkDeviceSize                    size;
+        bool                            dedicated;
+        bool                            inUse;
+    };
+
+    // Nodes describe a range of a block, they're kept in host memory since device memory can't hold headers
+    struct Node {
+        VkDeviceSize                    offset;
+        VkDeviceSize                    size;
+        uint32_t                        block;
+        uint32_t                        prevPhysical;
+        uint32_t                        nextPhysical;
+        uint32_t                        prevFree;
+        uint32_t                        nextFree;
+        bool                            isFree;
+    };
+
+    struct Pool {
+        uint32_t                        memoryTypeIndex;
+        std::vector<Block>              blocks;
+        uint64_t                        flBitmap;
+        uint32_t                        slBitmap[FL_INDEX_COUNT];
+        uint32_t                        freeLists[FL_INDEX_COUNT][SL_INDEX_COUNT];
+    };
+
+    MemoryAllocatorDesc                 mDesc;
+    VkPhysicalDeviceMemoryProperties    mMemoryProperties;
+    VkDeviceSize                        mBufferImageGranularity;
+    uint32_t                            mMaxAllocationCount;
+    std::vector<Pool>                   mPools;
+    std::vector<Node>                   mNodes;
+    std::vector<uint32_t>               mUnusedNodes;
+    MemoryAllocatorStats                mStats;
+    bool                                mIsCreated;
+
+    VkDeviceSize                        GetPreferredBlockSize(uint32_t memoryTypeIndex) const;
+    uint32_t                            GetPoolIndex(uint32_t memoryTypeIndex, ResourceTiling tiling) const;
+
+    bool                                CreateBlock(uint32_t poolIndex, VkDeviceSize size, bool dedicated, uint32_t& nodeIndex);
+    void                                DestroyBlock(Pool& pool, uint32_t blockIndex);
+
+    uint32_t                            AcquireNode();
+    void                                ReleaseNode(uint32_t nodeIndex);
+
+    void                                InsertFreeNode(Pool& pool, uint32_t nodeIndex);
+    void                                RemoveFreeNode(Pool& pool, uint32_t nodeIndex);
+    uint32_t                            FindFreeNode(Pool& pool, VkDeviceSize size) const;
+    void                                SplitNode(Pool& pool, uint32_t nodeIndex, VkDeviceSize alignment, VkDeviceSize size);
+};
+
+
+inline const MemoryAllocatorStats& MemoryAllocator::GetStats() const {
+    return mStats;
+}
+
+inline bool MemoryAllocator::IsCpuOnly() const {
+    return mDesc.cpuOnly;
+}
+
+
+#endif // XOF_MEMORY_ALLOCATOR_HPP
@@ -10,14 +10,34 @@
 */
 #include "XOF_Mesh.hpp"
 #include "VulkanHelpers.hpp"
-// For loading
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-#include <unordered_map>
+#include "XOF_IndexPacker.hpp"
+#include "XOF_MeshCache.hpp"
+#include "XOF_MeshOptimizer.hpp"
+#include "XOF_MeshSimplifier.hpp"
+#include "XOF_ObjParser.hpp"
+#include "XOF_TangentGenerator.hpp"
+#include "XOF_ThreadPool.hpp"
+#include "XOF_VertexWelder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <glm/glm.hpp>
 // TEMP
 #include <iostream>
 
 
+// Recorded in the mesh cache, a cache processed differently is rebuilt
+enum MESH_PROCESS_FLAGS {
+    MESH_PROCESS_OPTIMIZED_INDICES = 1 << 0,
+    MESH_PROCESS_SHORT_INDICES = 1 << 1,
+    MESH_PROCESS_REBASED_INDICES = 1 << 2,
+    MESH_PROCESS_MESHLETS = 1 << 3,
+    // The requested LOD level count is stored from here up
+    MESH_PROCESS_LOD_LEVEL_SHIFT = 8
+};
+
+
 enum TEMP_TEXTURE_TYPES {
     DIFFUSE,
     NORMAL,
@@ -28,142 +48,401 @@ enum TEMP_TEXTURE_TYPES {
 
 Mesh::Mesh() {
     mIsLoaded = false;
+    mUploadToken = 0;
+    mGeometryPool = nullptr;
+    mGeometryAllocation = {};
+    mVertexLayout = &GetVertexLayoutInfo<FullVertexLayout>();
+    mLodErrors.assign( 1, 0.f );
 }
 
-Mesh::~Mesh() {}
+// Kept alive from ProcessSource() to CreateResources() - the contents' vertex/index views point into
+// either the cache mapping or the packed vectors
+struct Mesh::PendingLoad {
+    MappedFile              cacheFile;
+    MeshCacheContents       contents;
+    std::vector<uint8_t>    packedVertices;
+    std::vector<uint8_t>    packedIndices;
+};
+
+
+Mesh::~Mesh() {
+    if( mGeometryPool ) {
+        mGeometryPool->Free( mGeometryAllocation );
+    }
+}
 
 bool Mesh::Load( MeshDesc& desc ) {
-    tinyobj::attrib_t attributes;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
+    return ProcessSource( desc ) && CreateResources( desc );
+}
 
-    std::string error;
-    if ( !tinyobj::LoadObj( &attributes, &shapes, &materials, &error, desc.fileName, "../../../Resources/" ) ) {
-        std::cerr << "MESH FAILED TO LOAD: " << error << std::endl;
-        return false;
+bool Mesh::ProcessSource( const MeshDesc& desc ) {
+    // Prefer the processed cache next to the source, the vertex/index views then point straight into the
+    // mapping and are staged from there without ever being copied into mVertexData/mIndexData
+    if( desc.vertexLayout ) {
+        mVertexLayout = desc.vertexLayout;
     }
 
-    std::unordered_map<Vertex, unsigned int> uniqueVertices;
+    mPendingLoad.reset( new PendingLoad() );
+    MeshCacheContents& contents = mPendingLoad->contents;
+
+    std::string cachePath = std::string( desc.fileName ) + MESH_CACHE_EXTENSION;
+    MeshCacheKey cacheKey;
+    cacheKey.processFlags = ( desc.optimizeIndices ? MESH_PROCESS_OPTIMIZED_INDICES : 0 ) |
+                            ( desc.shortIndices ? MESH_PROCESS_SHORT_INDICES : 0 ) |
+                            ( desc.rebaseSubMeshIndices ? MESH_PROCESS_REBASED_INDICES : 0 ) |
+                            ( desc.buildMeshlets ? MESH_PROCESS_MESHLETS : 0 ) |
+                            ( desc.lodLevelCount << MESH_PROCESS_LOD_LEVEL_SHIFT );
+    cacheKey.vertexLayout = mVertexLayout->id;
+    cacheKey.vertexStride = mVertexLayout->stride;
+    // The cache stores the vertices and indices already packed, so only the source path ever packs them
+    std::vector<uint8_t>& packedVertices = mPendingLoad->packedVertices;
+    std::vector<uint8_t>& packedIndices = mPendingLoad->packedIndices;
+
+    if( ReadMeshCache( cachePath.c_str(), desc.fileName, cacheKey, mPendingLoad->cacheFile, contents ) ) {
+        // Submeshes are stored level after level, the full detail ones first
+        const uint32_t levelCount = contents.lodLevelCount + 1;
+        const uint32_t subMeshCount = static_cast<uint32_t>( contents.subMeshes.size() ) / levelCount;
+        std::vector<SubMesh> subMeshes( contents.subMeshes.size() );
+        for( unsigned int i = 0; i < contents.subMeshes.size(); ++i ) {
+            subMeshes[i].baseIndex = contents.subMeshes[i].baseIndex;
+            subMeshes[i].indexCount = contents.subMeshes[i].indexCount;
+            subMeshes[i].textureIndex = contents.subMeshes[i].textureIndex;
+            subMeshes[i].indexType = ( contents.subMeshes[i].indexSize == sizeof( uint16_t ) ) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+            subMeshes[i].firstIndex = contents.subMeshes[i].firstIndex;
+            subMeshes[i].vertexOffset = contents.subMeshes[i].vertexOffset;
+            subMeshes[i].boundsMin = glm::vec3( contents.subMeshes[i].boundsMin[0], contents.subMeshes[i].boundsMin[1], contents.subMeshes[i].boundsMin[2] );
+            subMeshes[i].boundsMax = glm::vec3( contents.subMeshes[i].boundsMax[0], contents.subMeshes[i].boundsMax[1], contents.subMeshes[i].boundsMax[2] );
+            subMeshes[i].boundsRadius = contents.subMeshes[i].boundsRadius;
+        }
+        mSubMeshes.assign( subMeshes.begin(), subMeshes.begin() + subMeshCount );
+        mLodSubMeshes.assign( subMeshes.begin() + subMeshCount, subMeshes.end() );
+        mLodErrors.assign( levelCount, 0.f );
+        for( unsigned int level = 0; level < levelCount && subMeshCount > 0; ++level ) {
+            mLodErrors[level] = contents.subMeshes[level * subMeshCount].lodError;
+        }
+        mMeshlets.assign( contents.meshlets, contents.meshlets + contents.meshletCount );
+
+        mDimensions.sizeAlongX = contents.sizeAlong[0];
+        mDimensions.sizeAlongY = contents.sizeAlong[1];
+        mDimensions.sizeAlongZ = contents.sizeAlong[2];
+        mDimensions.min = glm::vec3( contents.min[0], contents.min[1], contents.min[2] );
+        mDimensions.max = glm::vec3( contents.max[0], contents.max[1], contents.max[2] );
+    } else {
+        if( !LoadFromObj( desc.fileName, desc.optimizeIndices, desc.logStats, contents.textureNames ) ) {
+            mPendingLoad.reset();
+            return false;
+        }
 
-    for( const auto& shape : shapes ) {
-        for( const auto& index : shape.mesh.indices ) {
-            Vertex v;
+        contents.vertexCount = static_cast<uint32_t>( mVertexData.size() );
+        packedVertices.resize( size_t( contents.vertexCount ) * mVertexLayout->stride );
+        mVertexLayout->encode( mVertexData.data(), contents.vertexCount, packedVertices.data() );
+        contents.vertices = packedVertices.data();
 
-            v.pos = {
-                attributes.vertices[3 * index.vertex_index + 0],
-                attributes.vertices[3 * index.vertex_index + 1],
-                attributes.vertices[3 * index.vertex_index + 2]
-            };
+        // Submeshes are what gets drawn, a mesh without any still gets its indices uploaded as one range
+        std::vector<IndexRange> ranges( mSubMeshes.size() );
+        for( unsigned int i = 0; i < mSubMeshes.size(); ++i ) {
+            ranges[i].baseIndex = mSubMeshes[i].baseIndex;
+            ranges[i].indexCount = mSubMeshes[i].indexCount;
+        }
+        if( ranges.empty() ) {
+            ranges.push_back( { 0, static_cast<uint32_t>( mIndexData.size() ) } );
+        }
 
-            if( attributes.normals.size() > 0 ) {
-                v.normal = {
-                    attributes.normals[3 * index.normal_index + 0],
-                    attributes.normals[3 * index.normal_index + 1],
-                    attributes.normals[3 * index.normal_index + 2]
-                };
+        // Meshlets only ever subdivide submeshes, a mesh without any has nothing to draw them with
+        if( desc.buildMeshlets && !mSubMeshes.empty() ) {
+            BuildMeshlets( mVertexData.data(), static_cast<uint32_t>( mVertexData.size() ), mIndexData.data(), ranges.data(),
+                           static_cast<uint32_t>( ranges.size() ), mMeshlets );
+        }
+        contents.meshlets = mMeshlets.data();
+        contents.meshletCount = static_cast<uint32_t>( mMeshlets.size() );
+
+        // LOD indices are appended to mIndexData and index the same vertices
+        mLodErrors.assign( 1, 0.f );
+        if( desc.lodLevelCount > 0 && !mSubMeshes.empty() ) {
+            LodChainDesc lodDesc = DEFAULT_LOD_CHAIN_DESC;
+            lodDesc.maxLevelCount = desc.lodLevelCount;
+            std::vector<LodLevel> levels;
+            const uint32_t sourceTriangles = static_cast<uint32_t>( mIndexData.size() ) / 3;
+            BuildLodChain( mVertexData.data(), static_cast<uint32_t>( mVertexData.size() ), mIndexData, ranges.data(),
+                           static_cast<uint32_t>( ranges.size() ), lodDesc, &GetSharedThreadPool(), levels );
+
+            for( unsigned int level = 0; level < levels.size(); ++level ) {
+                for( unsigned int i = 0; i < mSubMeshes.size(); ++i ) {
+                    SubMesh subMesh = mSubMeshes[i];
+                    subMesh.baseIndex = levels[level].ranges[i].baseIndex;
+                    subMesh.indexCount = levels[level].ranges[i].indexCount;
+                    mLodSubMeshes.push_back( subMesh );
+                }
+                mLodErrors.push_back( levels[level].error );
+                if( desc.logStats ) {
+                    std::cout << "MESH LOD " << level + 1 << ": " << desc.fileName << " " << levels[level].triangleCount
+                              << " triangles (" << 100.f * levels[level].triangleCount / sourceTriangles << "%), error "
+                              << levels[level].error << std::endl;
+                }
             }
+        }
 
-            v.texCoord = {
-                attributes.texcoords[2 * index.texcoord_index + 0],
-                attributes.texcoords[2 * index.texcoord_index + 1]
-            };
+        // Every level's submeshes are packed, a level that repeats an earlier one's indices shares its packing
+        std::vector<SubMesh*> drawnSubMeshes;
+        for( auto& subMesh : mSubMeshes ) {
+            drawnSubMeshes.push_back( &subMesh );
+        }
+        for( auto& subMesh : mLodSubMeshes ) {
+            drawnSubMeshes.push_back( &subMesh );
+        }
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> packedRangeIds;
+        std::vector<uint32_t> drawnRangeIds( drawnSubMeshes.size() );
+        if( !mSubMeshes.empty() ) {
+            ranges.clear();
+            for( unsigned int i = 0; i < drawnSubMeshes.size(); ++i ) {
+                auto key = std::make_pair( drawnSubMeshes[i]->baseIndex, drawnSubMeshes[i]->indexCount );
+                auto found = packedRangeIds.insert( std::make_pair( key, static_cast<uint32_t>( ranges.size() ) ) );
+                if( found.second ) {
+                    ranges.push_back( { key.first, key.second } );
+                }
+                drawnRangeIds[i] = found.first->second;
+            }
+        }
+
+        std::vector<PackedIndexRange> packedRanges( ranges.size() );
+        IndexPackingStats packingStats;
+        PackIndices( mIndexData.data(), ranges.data(), static_cast<uint32_t>( ranges.size() ), desc.shortIndices,
+                     desc.rebaseSubMeshIndices, packedIndices, packedRanges.data(), &packingStats );
+        contents.indices = packedIndices.data();
+        contents.indexDataSize = packedIndices.size();
+        if( desc.logStats ) {
+            std::cout << "MESH INDICES PACKED: " << desc.fileName << " " << packingStats.shortRangeCount << "/" << ranges.size()
+                      << " ranges 16-bit, " << packingStats.unpackedSize / 1024 << "KB -> " << packingStats.packedSize / 1024
+                      << "KB" << std::endl;
+        }
 
-            if( uniqueVertices.count(v) == 0 ) {
-                uniqueVertices[v] = mVertexData.size();
-                mVertexData.push_back( v );
+        contents.lodLevelCount = static_cast<uint32_t>( mLodErrors.size() ) - 1;
+        contents.subMeshes.resize( drawnSubMeshes.size() );
+        for( unsigned int i = 0; i < drawnSubMeshes.size(); ++i ) {
+            SubMesh& subMesh = *drawnSubMeshes[i];
+            const PackedIndexRange& packedRange = packedRanges[drawnRangeIds[i]];
+            subMesh.indexType = ( packedRange.indexSize == sizeof( uint16_t ) ) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+            subMesh.firstIndex = packedRange.firstIndex;
+            subMesh.vertexOffset = packedRange.vertexOffset;
+
+            contents.subMeshes[i].baseIndex = subMesh.baseIndex;
+            contents.subMeshes[i].indexCount = subMesh.indexCount;
+            contents.subMeshes[i].textureIndex = subMesh.textureIndex;
+            contents.subMeshes[i].indexSize = packedRange.indexSize;
+            contents.subMeshes[i].firstIndex = packedRange.firstIndex;
+            contents.subMeshes[i].vertexOffset = packedRange.vertexOffset;
+            contents.subMeshes[i].lodError = mLodErrors[i / mSubMeshes.size()];
+            for( unsigned int c = 0; c < 3; ++c ) {
+                contents.subMeshes[i].boundsMin[c] = subMesh.boundsMin[c];
+                contents.subMeshes[i].boundsMax[c] = subMesh.boundsMax[c];
             }
+            contents.subMeshes[i].boundsRadius = subMesh.boundsRadius;
+        }
+
+        contents.sizeAlong[0] = mDimensions.sizeAlongX;
+        contents.sizeAlong[1] = mDimensions.sizeAlongY;
+        contents.sizeAlong[2] = mDimensions.sizeAlongZ;
+        for( unsigned int i = 0; i < 3; ++i ) {
+            contents.min[i] = mDimensions.min[i];
+            contents.max[i] = mDimensions.max[i];
+        }
 
-            mIndexData.push_back( uniqueVertices[v] );
+        // Not fatal, the next load just parses the source again
+        if( !WriteMeshCache( cachePath.c_str(), desc.fileName, cacheKey, contents ) ) {
+            std::cerr << "MESH CACHE COULD NOT BE WRITTEN: " << cachePath << std::endl;
         }
     }
 
-    // Calculate tangents
-    for( unsigned int i=0; i<mIndexData.size(); i+=3 ) {
-        Vertex v0 = mVertexData[mIndexData[i + 0]];
-        Vertex v1 = mVertexData[mIndexData[i + 1]];
-        Vertex v2 = mVertexData[mIndexData[i + 2]];
+    mSubMeshBounds.Clear();
+    for( const auto& subMesh : mSubMeshes ) {
+        mSubMeshBounds.Add( subMesh.boundsMin, subMesh.boundsMax, subMesh.boundsRadius );
+    }
 
-        glm::vec3 edge0 = v1.pos - v0.pos;
-        glm::vec3 edge1 = v2.pos - v0.pos;
+    return true;
+}
 
-        float uDelta0 = v1.texCoord.x - v0.texCoord.x;
-        float vDelta0 = v1.texCoord.y - v0.texCoord.y;
-        float uDelta1 = v2.texCoord.x - v0.texCoord.x;
-        float vDelta1 = v2.texCoord.y - v0.texCoord.y;
+bool Mesh::CreateResources( MeshDesc& desc ) {
+    if( !mPendingLoad ) {
+        return mIsLoaded;
+    }
+    const MeshCacheContents& contents = mPendingLoad->contents;
+
+    if( desc.logStats ) {
+        const uint32_t fullStride = GetVertexLayoutInfo<FullVertexLayout>().stride;
+        std::cout << "MESH VERTEX LAYOUT: " << desc.fileName << " " << mVertexLayout->name << ", " << mVertexLayout->stride
+                  << " bytes/vertex, " << static_cast<int>( fullStride - mVertexLayout->stride ) << " bytes/vertex saved vs Full ("
+                  << ( uint64_t( fullStride - mVertexLayout->stride ) * contents.vertexCount ) / 1024 << "KB)" << std::endl;
+    }
+
+    CreateTempMaterial( desc, &contents.textureNames[0] );
 
-        float f = 1.f / ( uDelta0 * vDelta1 - uDelta1 * vDelta0 );
+    // Uploads are staged (copied) straight away, so the source data can go as soon as they're recorded
+    bool isStaged = UploadToGeometryPool( desc, contents.vertices, contents.vertexCount, contents.indices, contents.indexDataSize ) ||
+                    ( GenerateVertexBuffer( desc, contents.vertices, contents.vertexCount ) &&
+                      GenerateIndexBuffer( desc, contents.indices, contents.indexDataSize ) );
+    mPendingLoad.reset();
 
-        glm::vec3 tangent;
-        tangent.x = f * ( vDelta1 * edge0.x -vDelta0 * edge1.x ); 
-        tangent.y = f * ( vDelta1 * edge0.y -vDelta0 * edge1.y ); 
-        tangent.z = f *    ( vDelta1 * edge0.z -vDelta0 * edge1.z );
+    return ( mIsLoaded = isStaged );
+}
 
-        mVertexData[mIndexData[i + 0]].tangent += tangent;
-        mVertexData[mIndexData[i + 1]].tangent += tangent;
-        mVertexData[mIndexData[i + 2]].tangent += tangent;
-#if 0
-        glm::vec3 biTangent;
-        biTangent.x = f * ( -uDelta1 * edge0.x - uDelta0 * edge1.x );
-        biTangent.y = f * ( -uDelta1 * edge0.y - uDelta0 * edge1.y );
-        biTangent.z = f * ( -uDelta1 * edge0.z - uDelta0 * edge1.z );
-#endif
+bool Mesh::LoadFromObj( const char *fileName, bool optimizeIndices, bool logStats, std::vector<std::string> *textureNames ) {
+    ThreadPool& pool = GetSharedThreadPool();
+
+    ObjData obj;
+    std::string error;
+    if( !ParseObj( fileName, "../../../Resources/", obj, error, &pool ) ) {
+        std::cerr << "MESH FAILED TO LOAD: " << error << std::endl;
+        return false;
+    }
+    // Missing material libraries aren't fatal, the affected submeshes just go untextured
+    if( !error.empty() ) {
+        std::cerr << "MESH LOADED WITH WARNINGS: " << error << std::endl;
     }
 
-    // Setup temp material
-    std::vector<std::string> texNames[TEMP_TEXTURE_TYPES::COUNT];
-    for (unsigned int i = 0; i < materials.size(); ++i) {
-        if (!(materials[i].diffuse_texname.empty())) {
-            texNames[DIFFUSE].push_back(std::string(materials[i].diffuse_texname));
-        }
-        if (!(materials[i].normal_texname.empty())) {
-            texNames[NORMAL].push_back(std::string(materials[i].normal_texname));
-        }
-        if(!(materials[i].specular_texname.empty())) {
-            texNames[SPECULAR].push_back(std::string(materials[i].specular_texname));
+    // Group the triangles by material, faces without one last, so each material is a single submesh whatever
+    // order the file's objects and usemtl switches put them in. Stable, the triangles of a material keep file order.
+    const uint32_t cornerCount = static_cast<uint32_t>( obj.indices.size() );
+    const uint32_t triangleCount = cornerCount / 3;
+    const uint32_t materialCount = static_cast<uint32_t>( obj.materials.size() );
+    std::vector<uint32_t> materialTriangleOffsets( materialCount + 2, 0 );
+    auto materialBucket = [&]( uint32_t t ) {
+        return ( obj.materialIds[t] >= 0 ) ? static_cast<uint32_t>( obj.materialIds[t] ) : materialCount;
+    };
+    for( uint32_t t = 0; t < triangleCount; ++t ) {
+        ++materialTriangleOffsets[materialBucket( t ) + 1];
+    }
+    for( uint32_t m = 0; m <= materialCount; ++m ) {
+        materialTriangleOffsets[m + 1] += materialTriangleOffsets[m];
+    }
+    std::vector<uint32_t> triangleOrder( triangleCount );
+    {
+        std::vector<uint32_t> cursor( materialTriangleOffsets.begin(), materialTriangleOffsets.end() - 1 );
+        for( uint32_t t = 0; t < triangleCount; ++t ) {
+            triangleOrder[cursor[materialBucket( t )]++] = t;
         }
     }
 
-    CreateTempMaterial(desc, &texNames[0]);
+    // Expand every face corner into a full vertex, then weld the identical ones back together
+    const uint32_t cornersPerRange = 64 * 1024;
+    std::vector<Vertex> corners( cornerCount );
+
+    pool.ParallelFor( ( cornerCount + cornersPerRange - 1 ) / cornersPerRange, [&]( uint32_t range ) {
+        uint32_t end = std::min( ( range + 1 ) * cornersPerRange, cornerCount );
+        for( uint32_t i = range * cornersPerRange; i < end; ++i ) {
+            const ObjIndex& index = obj.indices[triangleOrder[i / 3] * 3 + i % 3];
+            Vertex& v = corners[i];
+
+            v.pos = {
+                obj.positions[3 * index.position + 0],
+                obj.positions[3 * index.position + 1],
+                obj.positions[3 * index.position + 2]
+            };
 
-    // Setup per-material/texture submesh info 
-    // (only accounts for a single mesh in the file, can be moved to the per-shape loop above) 
-    mSubMeshes.resize(materials.size());
-    unsigned int indexCount = 0;
+            if( index.normal >= 0 ) {
+                v.normal = {
+                    obj.normals[3 * index.normal + 0],
+                    obj.normals[3 * index.normal + 1],
+                    obj.normals[3 * index.normal + 2]
+                };
+            }
 
-    for (unsigned int i = 0; i < materials.size(); ++i) {
-        mSubMeshes[i].baseIndex = indexCount * 3;
-        mSubMeshes[i].textureIndex = i;
-        while ((indexCount < shapes[0].mesh.material_ids.size()) && (shapes[0].mesh.material_ids[indexCount] == i)) {
-            ++indexCount;
+            if( index.texCoord >= 0 ) {
+                v.texCoord = {
+                    obj.texCoords[2 * index.texCoord + 0],
+                    obj.texCoords[2 * index.texCoord + 1]
+                };
+            }
         }
-        mSubMeshes[i].indexCount = (indexCount * 3) - mSubMeshes[i].baseIndex;
+    } );
+
+    WeldVertices( corners.data(), cornerCount, mVertexData, mIndexData, &pool );
+    std::vector<Vertex>().swap( corners );
+
+    GenerateTangents( mVertexData.data(), static_cast<uint32_t>( mVertexData.size() ), mIndexData.data(),
+                      static_cast<uint32_t>( mIndexData.size() ), &pool );
+
+    // Bounds
+    mDimensions.min = glm::vec3( std::numeric_limits<float>::max() );
+    mDimensions.max = glm::vec3( -std::numeric_limits<float>::max() );
+    for( const auto& vertex : mVertexData ) {
+        mDimensions.min = glm::min( mDimensions.min, vertex.pos );
+        mDimensions.max = glm::max( mDimensions.max, vertex.pos );
+    }
+    mDimensions.sizeAlongX = mDimensions.max.x - mDimensions.min.x;
+    mDimensions.sizeAlongY = mDimensions.max.y - mDimensions.min.y;
+    mDimensions.sizeAlongZ = mDimensions.max.z - mDimensions.min.z;
+
+    // Texture names for the temp material, one per material and type (empty where the material has none)
+    for (unsigned int i = 0; i < obj.materials.size(); ++i) {
+        textureNames[DIFFUSE].push_back(obj.materials[i].diffuseTexName);
+        textureNames[NORMAL].push_back(obj.materials[i].normalTexName);
+        textureNames[SPECULAR].push_back(obj.materials[i].specularTexName);
     }
 
-    if (!GenerateVertexBuffer(desc)) {
-        return mIsLoaded;
+    // Setup per-material/texture submesh info, the triangles were grouped by material above. Faces
+    // without a material get a submesh of their own, drawn untextured (textureIndex -1).
+    bool hasUnassignedFaces = materialTriangleOffsets[materialCount + 1] > materialTriangleOffsets[materialCount];
+    mSubMeshes.resize(materialCount + (hasUnassignedFaces ? 1 : 0));
+
+    for (unsigned int i = 0; i < mSubMeshes.size(); ++i) {
+        mSubMeshes[i].baseIndex = materialTriangleOffsets[i] * 3;
+        mSubMeshes[i].indexCount = (materialTriangleOffsets[i + 1] - materialTriangleOffsets[i]) * 3;
+        mSubMeshes[i].textureIndex = (i < materialCount) ? static_cast<int>(i) : -1;
     }
-    if (!GenerateIndexBuffer(desc)) {
-        return mIsLoaded;
+
+    if( optimizeIndices ) {
+        // Triangles are only reordered within their submesh, so the submesh ranges above stay valid
+        std::vector<IndexRange> ranges( mSubMeshes.size() );
+        for( unsigned int i = 0; i < mSubMeshes.size(); ++i ) {
+            ranges[i].baseIndex = mSubMeshes[i].baseIndex;
+            ranges[i].indexCount = mSubMeshes[i].indexCount;
+        }
+        if( ranges.empty() ) {
+            ranges.push_back( { 0, static_cast<uint32_t>( mIndexData.size() ) } );
+        }
+
+        MeshOptimizationStats stats;
+        OptimizeMesh( mVertexData, mIndexData, ranges.data(), static_cast<uint32_t>( ranges.size() ), &pool, &stats );
+        if( logStats ) {
+            std::cout << "MESH INDICES OPTIMIZED: " << fileName << " ACMR " << stats.before.acmr << " -> " << stats.after.acmr
+                      << ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << std::endl;
+        }
     }
 
-    return (mIsLoaded = true);
+    ComputeSubMeshBounds();
+
+    return true;
 }
 
-bool Mesh::GenerateVertexBuffer(MeshDesc& desc) {
-    VkDeviceSize bufferSize = sizeof(Vertex) * mVertexData.size();
+void Mesh::ComputeSubMeshBounds() {
+    for( auto& subMesh : mSubMeshes ) {
+        subMesh.boundsMin = glm::vec3( std::numeric_limits<float>::max() );
+        subMesh.boundsMax = glm::vec3( -std::numeric_limits<float>::max() );
+        for( uint32_t i = subMesh.baseIndex; i < subMesh.baseIndex + subMesh.indexCount; ++i ) {
+            subMesh.boundsMin = glm::min( subMesh.boundsMin, mVertexData[mIndexData[i]].pos );
+            subMesh.boundsMax = glm::max( subMesh.boundsMax, mVertexData[mIndexData[i]].pos );
+        }
 
-    // Setup staging buffer
-    BufferDesc stagingBufferDesc;
-    stagingBufferDesc.size = bufferSize;
-    stagingBufferDesc.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    stagingBufferDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    stagingBufferDesc.physicalDevice = desc.physicalDevice;
-    stagingBufferDesc.logicalDevice = desc.logicalDevice;
+        // Materials no face uses, there's nothing to draw either way
+        if( subMesh.indexCount == 0 ) {
+            subMesh.boundsMin = subMesh.boundsMax = glm::vec3( 0.f );
+            subMesh.boundsRadius = 0.f;
+            continue;
+        }
 
-    Buffer stagingBuffer(stagingBufferDesc);
+        // Sphere around the box's centre, as tight as that centre allows
+        glm::vec3 center = ( subMesh.boundsMin + subMesh.boundsMax ) * 0.5f;
+        float radiusSquared = 0.f;
+        for( uint32_t i = subMesh.baseIndex; i < subMesh.baseIndex + subMesh.indexCount; ++i ) {
+            glm::vec3 offset = mVertexData[mIndexData[i]].pos - center;
+            radiusSquared = std::max( radiusSquared, glm::dot( offset, offset ) );
+        }
+        subMesh.boundsRadius = std::sqrt( radiusSquared );
+    }
+}
 
-    // Map vertex data to staging buffer
-    stagingBuffer.WriteToBufferMemory(mVertexData.data(), bufferSize);
+bool Mesh::GenerateVertexBuffer(MeshDesc& desc, const void *vertices, uint32_t vertexCount) {
+    VkDeviceSize bufferSize = VkDeviceSize(mVertexLayout->stride) * vertexCount;
 
     // Setup device (GPU) local buffer
     BufferDesc bufferDesc;
@@ -172,30 +451,18 @@ bool Mesh::GenerateVertexBuffer(MeshDesc& desc) {
     bufferDesc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     bufferDesc.logicalDevice = desc.logicalDevice;
     bufferDesc.physicalDevice = desc.physicalDevice;
+    bufferDesc.allocator = desc.allocator;
 
     mVertexBuffer.Create(bufferDesc);
 
-    CopyBuffer(stagingBuffer, mVertexBuffer, bufferSize, desc.commandBuffer);
-    FlushAndResetCommandBuffer(desc.commandBuffer, desc.queue);
+    // Staged through the upload context's ring, the copy goes out with the next batch
+    mUploadToken = std::max(mUploadToken, desc.uploadContext->UploadBuffer(mVertexBuffer, vertices, bufferSize));
 
     return true;
 }
 
-bool Mesh::GenerateIndexBuffer(MeshDesc& desc) {
-    VkDeviceSize bufferSize = sizeof(mIndexData[0]) * mIndexData.size();
-
-    // Setup staging buffer
-    BufferDesc stagingBufferDesc;
-    stagingBufferDesc.size = bufferSize;
-    stagingBufferDesc.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    stagingBufferDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    stagingBufferDesc.physicalDevice = desc.physicalDevice;
-    stagingBufferDesc.logicalDevice = desc.logicalDevice;
-
-    Buffer stagingBuffer(stagingBufferDesc);
-
-    // Map index data to staging buffer
-    stagingBuffer.WriteToBufferMemory(mIndexData.data(), bufferSize);
+bool Mesh::GenerateIndexBuffer(MeshDesc& desc, const void *indices, uint64_t indexDataSize) {
+    VkDeviceSize bufferSize = indexDataSize;
 
     // Setup device (GPU) local buffer
     BufferDesc bufferDesc;
@@ -204,39 +471,87 @@ bool Mesh::GenerateIndexBuffer(MeshDesc& desc) {
     bufferDesc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     bufferDesc.logicalDevice = desc.logicalDevice;
     bufferDesc.physicalDevice = desc.physicalDevice;
+    bufferDesc.allocator = desc.allocator;
 
     mIndexBuffer.Create(bufferDesc);
 
-    CopyBuffer(stagingBuffer, mIndexBuffer, bufferSize, desc.commandBuffer);
-    FlushAndResetCommandBuffer(desc.commandBuffer, desc.queue);
+    // Staged through the upload context's ring, the copy goes out with the next batch
+    mUploadToken = std::max(mUploadToken, desc.uploadContext->UploadBuffer(mIndexBuffer, indices, bufferSize));
 
     return true;
 }
 
-void Mesh::CreateTempMaterial(MeshDesc& desc, std::vector<std::string> *textureNames) {
+bool Mesh::UploadToGeometryPool(MeshDesc& desc, const void *vertices, uint32_t vertexCount,
+                                const void *indices, uint64_t indexDataSize) {
+    GeometryPool *pool = desc.geometryPool;
+    if (!pool || pool->GetVertexStride() != mVertexLayout->stride) {
+        return false;
+    }
+    if (!pool->Allocate(vertexCount, indexDataSize, mGeometryAllocation)) {
+        if (desc.logStats) {
+            std::cout << "MESH GEOMETRY POOL FULL: " << desc.fileName << " gets buffers of its own" << std::endl;
+        }
+        return false;
+    }
+    mGeometryPool = pool;
+
+    VkDeviceSize vertexOffset = VkDeviceSize(mGeometryAllocation.firstVertex) * mVertexLayout->stride;
+    mUploadToken = std::max(mUploadToken, desc.uploadContext->UploadBuffer(pool->GetVertexBuffer(), vertices,
+                                                                           VkDeviceSize(mVertexLayout->stride) * vertexCount, vertexOffset));
+    mUploadToken = std::max(mUploadToken, desc.uploadContext->UploadBuffer(pool->GetIndexBuffer(), indices, indexDataSize,
+                                                                           mGeometryAllocation.indexOffset));
+
+    // The allocation's index offset is 4-byte aligned, so it's a whole number of indices of either width
+    auto rebase = [this](SubMesh& subMesh) {
+        uint32_t indexSize = (subMesh.indexType == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
+        subMesh.firstIndex += static_cast<uint32_t>(mGeometryAllocation.indexOffset / indexSize);
+        subMesh.vertexOffset += static_cast<int32_t>(mGeometryAllocation.firstVertex);
+    };
+    std::for_each(mSubMeshes.begin(), mSubMeshes.end(), rebase);
+    std::for_each(mLodSubMeshes.begin(), mLodSubMeshes.end(), rebase);
+
+    return true;
+}
+
+void Mesh::CreateTempMaterial(MeshDesc& desc, const std::vector<std::string> *textureNames) {
     mTempMaterial.vertexShader.Load(desc.vertexShaderConfig);
     mTempMaterial.fragmentShader.Load(desc.fragmentShaderConfig);
 
-    // I know the dynamic allocation here is FAR from perferable, 
-    // but I was tired and this was the last thing I had to do to get this working... (that's the explanation)
-    mTempMaterial.diffuseMaps.resize(textureNames[DIFFUSE].size());
-    for (unsigned int i = 0; i < textureNames[DIFFUSE].size(); ++i) {
-        std::string fileNameAndPath("../../../Resources/" + textureNames[DIFFUSE][i]);
-        desc.textureConfig.fileName = const_cast<char*>(fileNameAndPath.c_str());
-        mTempMaterial.diffuseMaps[i].reset(new Texture(desc.textureConfig));
+    // Through the cache the same file is only loaded once, however many materials and meshes use it. Without one
+    // the mesh still shares a file between its own materials.
+    TextureCache meshCache;
+    TextureCache& cache = desc.textureCache ? *desc.textureCache : meshCache;
+
+    std::vector<TextureHandle> *maps[] = { &mTempMaterial.diffuseMaps, &mTempMaterial.normalMaps, &mTempMaterial.specularMaps };
+    const unsigned int types[] = { DIFFUSE, NORMAL, SPECULAR };
+
+    // Every texture the materials reference goes in one batch, so the new ones are decoded in parallel
+    std::vector<std::string> fileNames;
+    std::vector<std::pair<unsigned int, unsigned int>> slots;
+    for (unsigned int t = 0; t < 3; ++t) {
+        const std::vector<std::string>& names = textureNames[types[t]];
+        maps[t]->assign(names.size(), nullptr);
+        for (unsigned int i = 0; i < names.size(); ++i) {
+            if (!names[i].empty()) {
+                fileNames.push_back("../../../Resources/" + names[i]);
+                slots.push_back(std::make_pair(t, i));
+            }
+        }
     }
 
-    mTempMaterial.normalMaps.resize(textureNames[NORMAL].size());
-    for (unsigned int i = 0; i < textureNames[NORMAL].size(); ++i) {
-        std::string fileNameAndPath("../../../Resources/" + textureNames[NORMAL][i]);
-        desc.textureConfig.fileName = const_cast<char*>(fileNameAndPath.c_str());
-        mTempMaterial.normalMaps[i].reset(new Texture(desc.textureConfig));
+    std::vector<ImageDesc> textureDescs(fileNames.size(), desc.textureConfig);
+    for (size_t i = 0; i < fileNames.size(); ++i) {
+        textureDescs[i].fileName = const_cast<char*>(fileNames[i].c_str());
     }
+    std::vector<TextureHandle> textures(fileNames.size());
+    cache.Acquire(textureDescs.data(), static_cast<uint32_t>(textures.size()), textures.data(), &GetSharedThreadPool());
 
-    mTempMaterial.specularMaps.resize(textureNames[SPECULAR].size());
-    for (unsigned int i = 0; i < textureNames[SPECULAR].size(); ++i) {
-        std::string fileNameAndPath("../../../Resources/" + textureNames[SPECULAR][i]);
-        desc.textureConfig.fileName = const_cast<char*>(fileNameAndPath.c_str());
-        mTempMaterial.specularMaps[i].reset(new Texture(desc.textureConfig));
+    for (size_t i = 0; i < textures.size(); ++i) {
+        if (!textures[i]) {
+            std::cerr << "TEXTURE FAILED TO LOAD: " << fileNames[i] << std::endl;
+            continue;
+        }
+        (*maps[slots[i].first])[slots[i].second] = textures[i];
+        mUploadToken = std::max(mUploadToken, textures[i]->GetUploadToken());
     }
 }
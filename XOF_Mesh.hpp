@@ -4,7 +4,7 @@
     XOF
     ===
     File    :    XOF_Mesh.hpp
-    Desc    :    Represents a mesh; uses Tinyobj for loading obj models.
+    Desc    :    Represents a mesh; obj models are loaded through ObjParser.
 
 ===============================================================================
 */
@@ -14,9 +14,16 @@
 
 #include "VertexDesc.hpp"
 #include "XOF_Buffer.hpp"
+#include "XOF_GeometryPool.hpp"
+#include "XOF_Meshlets.hpp"
+#include "XOF_MeshSimplifier.hpp"
+#include "XOF_TextureCache.hpp"
+#include "XOF_UploadContext.hpp"
+#include "XOF_VertexLayout.hpp"
 #include "Material.hpp"
 #include "VulkanHelpers.hpp"
 
+#include <memory>
 #include <vector>
 #include <glm/vec3.hpp>
 
@@ -25,9 +32,30 @@
 struct MeshDesc {
     VkPhysicalDevice    physicalDevice;
     VkDevice            logicalDevice;
-    VkCommandBuffer     commandBuffer;
-    VkQueue             queue;
+    MemoryAllocator   * allocator;
+    UploadContext     * uploadContext;
     const char        * fileName;
+    // Reorders the indices/vertices for the post-transform cache, overdraw and fetch locality
+    bool                optimizeIndices;
+    // Store submesh indices 16-bit wherever they fit, optionally rebased onto each submesh's lowest
+    // vertex (drawn with a vertexOffset) so submeshes of meshes with more than 64K vertices qualify too
+    bool                shortIndices;
+    bool                rebaseSubMeshIndices;
+    // Split the submeshes into meshlets for per-frame culling (see XOF_Meshlets.hpp)
+    bool                buildMeshlets;
+    // Simplified levels to build below the full detail one, 0 for none (see XOF_MeshSimplifier.hpp)
+    uint32_t            lodLevelCount;
+    // Print stats on what processing did to the mesh - loads run on the pool's threads, so leave this off
+    // outside of tuning
+    bool                logStats;
+    // How the vertex buffer is packed, must match the pipeline's vertex input (null = FullVertexLayout)
+    const VertexLayoutInfo * vertexLayout;
+    // Shared buffers to pack the vertices and indices into, so meshes drawn together need no rebinds (null = the
+    // mesh gets buffers of its own, as it also does when the pool is full or has a different vertex stride)
+    GeometryPool      * geometryPool;
+    // Where the material textures come from, shared with the other meshes using it (null = the mesh loads its
+    // own copy of every file it references)
+    TextureCache      * textureCache;
     // temporarily put fields to set up the material here 
     // (this will obviously introduce a bit of duplication in the fields used)
     ShaderDesc          vertexShaderConfig;
@@ -41,24 +69,60 @@ class Mesh {
 private:
     struct MeshDimensions;
     struct SubMesh;
+    struct PendingLoad;
     
 public:
                                         Mesh();
                                         ~Mesh();
 
     bool                                Load(MeshDesc& desc);
+                                        // Load() in two halves, so the bulk of it can run off the render thread.
+                                        // ProcessSource() reads the cache (or parses and processes the source) and
+                                        // touches no Vulkan objects, so is safe on a worker. CreateResources() then
+                                        // creates the buffers and material and stages their uploads, on the thread
+                                        // that records into desc.uploadContext.
+    bool                                ProcessSource(const MeshDesc& desc);
+    bool                                CreateResources(MeshDesc& desc);
     inline bool                         IsLoaded() const;
+                                        // Covers the vertex/index buffers and material textures, must be
+                                        // complete before the mesh is first drawn
+    inline UploadToken                  GetUploadToken() const;
 
     inline std::vector<Mesh::SubMesh>&  GetSubMeshData() const;
     inline unsigned int                 GetSubMeshCount() const;
+                                        // One per submesh, shared by every LOD level
+    inline const BoundsList&            GetSubMeshBounds() const;
 
     inline const Mesh::MeshDimensions&  GetDimensions() const;
 
+                                        // Level 0 is the full detail mesh, so there's always at least one
+    inline uint32_t                     GetLodCount() const;
+                                        // GetSubMeshCount() submeshes, level 0's are GetSubMeshData()
+    inline const Mesh::SubMesh        * GetLodSubMeshData( uint32_t level ) const;
+                                        // Relative to the radius of the mesh's bounds, 0 for level 0
+    inline float                        GetLodError( uint32_t level ) const;
+                                        // The coarsest level that stays under maxPixelError with the bounding sphere
+                                        // projected projectedRadius pixels tall
+    inline uint32_t                     SelectLod( float projectedRadius, float maxPixelError ) const;
+
+                                        // Empty unless MeshDesc::buildMeshlets, a meshlet's rangeIndex is its submesh
+                                        // and its baseIndex is into GetIndexData() like SubMesh::baseIndex
+    inline const std::vector<Meshlet>&  GetMeshlets() const;
+
+    inline const VertexLayoutInfo&      GetVertexLayout() const;
+
+                                        // Only populated when the mesh was parsed from source, cache loads stream
+                                        // straight from the mapped file into the GPU buffers. Always the full
+                                        // precision vertices, the vertex buffer holds them in GetVertexLayout()'s packing.
     inline std::vector<Vertex>&         GetVertexData() const;
+                                        // The LOD levels' indices follow the full detail ones
     inline std::vector<unsigned int>&   GetIndexData() const;
 
+                                        // The pool's when the mesh was packed into one, the submeshes' firstIndex and
+                                        // vertexOffset then already point at the mesh's part of them
     inline Buffer&                      GetVertexBuffer() const;
     inline Buffer&                      GetIndexBuffer() const;
+    inline bool                         IsPooled() const;
 
     inline  Material&                   GetTempMaterial() const;
 
@@ -74,24 +138,56 @@ private:
 
     // A whole mesh is built up as a collection of submeshes
     struct SubMesh {
-        uint32_t    baseIndex;
+        uint32_t    baseIndex;      // Into GetIndexData()
         uint32_t    indexCount;
-        int         textureIndex;
+        int         textureIndex;   // The material, -1 for none
+                    // Drawing from the index buffer - bind it with indexType, start at firstIndex (in
+                    // indexType units) and add vertexOffset
+        VkIndexType indexType;
+        uint32_t    firstIndex;
+        int32_t     vertexOffset;
+                    // Model space box around the submesh's vertices and the sphere around its centre. LOD
+                    // levels keep their full detail submesh's, which contain them.
+        glm::vec3   boundsMin;
+        glm::vec3   boundsMax;
+        float       boundsRadius;
     };
     std::vector<Mesh::SubMesh>          mSubMeshes;
+                                        // The submeshes' bounds again, laid out for CullBounds
+    BoundsList                          mSubMeshBounds;
+    std::vector<Meshlet>                mMeshlets;
+                                        // Level after level, GetSubMeshCount() each, starting at level 1
+    std::vector<Mesh::SubMesh>          mLodSubMeshes;
+    std::vector<float>                  mLodErrors;
+
+    const VertexLayoutInfo            * mVertexLayout;
 
     std::vector<Vertex>                 mVertexData;
     std::vector<unsigned int>           mIndexData;
     Buffer                              mVertexBuffer;
     Buffer                              mIndexBuffer;
+                                        // Set when the vertices and indices live in a GeometryPool instead
+    GeometryPool                      * mGeometryPool;
+    GeometryAllocation                  mGeometryAllocation;
     
     Material                            mTempMaterial;
 
     bool                                mIsLoaded;
-
-    bool                                GenerateVertexBuffer(MeshDesc& desc);
-    bool                                GenerateIndexBuffer(MeshDesc& desc);
-    void                                CreateTempMaterial(MeshDesc& desc, std::vector<std::string> *textureNames);
+    UploadToken                         mUploadToken;
+                                        // What ProcessSource() leaves for CreateResources(), released once staged
+    std::unique_ptr<PendingLoad>        mPendingLoad;
+
+                                        // Parses the source file into mVertexData/mIndexData/mSubMeshes/mDimensions
+    bool                                LoadFromObj(const char *fileName, bool optimizeIndices, bool logStats,
+                                                    std::vector<std::string> *textureNames);
+    void                                ComputeSubMeshBounds();
+    bool                                GenerateVertexBuffer(MeshDesc& desc, const void *vertices, uint32_t vertexCount);
+    bool                                GenerateIndexBuffer(MeshDesc& desc, const void *indices, uint64_t indexDataSize);
+                                        // Uploads into desc.geometryPool and rebases every level's submeshes onto the
+                                        // allocation, false (with nothing allocated) if the mesh doesn't fit
+    bool                                UploadToGeometryPool(MeshDesc& desc, const void *vertices, uint32_t vertexCount,
+                                                             const void *indices, uint64_t indexDataSize);
+    void                                CreateTempMaterial(MeshDesc& desc, const std::vector<std::string> *textureNames);
 };
 
 
@@ -99,6 +195,10 @@ bool Mesh::IsLoaded() const {
     return mIsLoaded;
 }
 
+inline UploadToken Mesh::GetUploadToken() const {
+    return mUploadToken;
+}
+
 inline unsigned int Mesh::GetSubMeshCount() const {
     return static_cast<unsigned int>( mSubMeshes.size() );
 }
@@ -107,10 +207,38 @@ inline std::vector<Mesh::SubMesh>& Mesh::GetSubMeshData() const {
     return const_cast<std::vector<Mesh::SubMesh>&>( mSubMeshes );
 }
 
+inline const BoundsList& Mesh::GetSubMeshBounds() const {
+    return mSubMeshBounds;
+}
+
 inline const Mesh::MeshDimensions& Mesh::GetDimensions() const {
     return mDimensions;
 }
 
+inline uint32_t Mesh::GetLodCount() const {
+    return static_cast<uint32_t>( mLodErrors.size() );
+}
+
+inline const Mesh::SubMesh* Mesh::GetLodSubMeshData( uint32_t level ) const {
+    return ( level == 0 ) ? mSubMeshes.data() : &mLodSubMeshes[( level - 1 ) * mSubMeshes.size()];
+}
+
+inline float Mesh::GetLodError( uint32_t level ) const {
+    return mLodErrors[level];
+}
+
+inline uint32_t Mesh::SelectLod( float projectedRadius, float maxPixelError ) const {
+    return ::SelectLod( mLodErrors.data(), GetLodCount(), projectedRadius, maxPixelError );
+}
+
+inline const std::vector<Meshlet>& Mesh::GetMeshlets() const {
+    return mMeshlets;
+}
+
+inline const VertexLayoutInfo& Mesh::GetVertexLayout() const {
+    return *mVertexLayout;
+}
+
 inline std::vector<Vertex>&    Mesh::GetVertexData() const {
     return const_cast<std::vector<Vertex>&>(mVertexData);
 }
@@ -120,11 +248,15 @@ inline std::vector<unsigned int>& Mesh::GetIndexData() const {
 }
 
 inline Buffer& Mesh::GetVertexBuffer() const {
-    return const_cast<Buffer&>(mVertexBuffer);
+    return mGeometryPool ? mGeometryPool->GetVertexBuffer() : const_cast<Buffer&>(mVertexBuffer);
 }
 
 inline Buffer& Mesh::GetIndexBuffer() const {
-    return const_cast<Buffer&>(mIndexBuffer);
+    return mGeometryPool ? mGeometryPool->GetIndexBuffer() : const_cast<Buffer&>(mIndexBuffer);
+}
+
+inline bool Mesh::IsPooled() const {
+    return mGeometryPool != nullptr;
 }
 
 inline Material& Mesh::GetTempMaterial() const {
@@ -0,0 +1,266 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_MeshCache.cpp
+    Desc    :    Binary .xofmesh cache - the fully processed output of a mesh load
+                 (vertices, indices, submeshes, meshlets, bounds, texture names), written after
+                 the first load and memory-mapped on later ones.
+
+===============================================================================
+*/
+#include "XOF_MeshCache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+
+static const char MESH_CACHE_MAGIC[8] = { 'X', 'O', 'F', 'M', 'E', 'S', 'H', '\0' };
+// Payloads are aligned so the mapped vertex/index arrays can be read in place
+static const uint64_t MESH_CACHE_PAYLOAD_ALIGNMENT = 16;
+
+
+struct MeshCacheHeader {
+    char                        magic[8];
+    uint32_t                    version;
+    uint32_t                    vertexStride;
+    uint32_t                    vertexLayout;
+    uint32_t                    processFlags;
+                                // Source validation
+    uint64_t                    sourceSize;
+    int64_t                     sourceModifiedTime;
+    uint64_t                    sourceHash;
+                                // Bounds
+    float                       sizeAlong[3];
+    float                       min[3];
+    float                       max[3];
+                                // Payload locations (byte offsets from the start of the file)
+    uint32_t                    vertexCount;
+    uint32_t                    subMeshCount;
+    uint64_t                    indexDataSize;
+    uint32_t                    meshletCount;
+    uint32_t                    lodLevelCount;
+    uint64_t                    vertexOffset;
+    uint64_t                    indexOffset;
+    uint64_t                    subMeshOffset;
+    uint64_t                    meshletOffset;
+    uint64_t                    textureNamesOffset;
+    uint64_t                    textureNamesSize;
+};
+
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// FNV-1a over 64-bit words, plenty to detect a changed source and fast enough to run over large files
+static uint64_t HashFileContents(const char *data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    const uint64_t prime = 1099511628211ull;
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(uint64_t));
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * prime;
+    }
+
+    return hash ^ size;
+}
+
+static bool HashFile(const char *fileName, uint64_t& hash) {
+    MappedFile file;
+    if (!file.Open(fileName)) {
+        return false;
+    }
+    hash = HashFileContents(file.GetData(), file.GetSize());
+    return true;
+}
+
+
+bool ReadMeshCache(const char *cachePath, const char *sourcePath, const MeshCacheKey& key, MappedFile& cacheFile,
+                   MeshCacheContents& contents) {
+    uint64_t sourceSize;
+    int64_t sourceModifiedTime;
+    if (!GetFileStats(sourcePath, sourceSize, sourceModifiedTime) || !cacheFile.Open(cachePath)) {
+        return false;
+    }
+
+    const char *data = cacheFile.GetData();
+    const uint64_t size = cacheFile.GetSize();
+
+    MeshCacheHeader header;
+    if (size < sizeof(MeshCacheHeader)) {
+        cacheFile.Close();
+        return false;
+    }
+    memcpy(&header, data, sizeof(MeshCacheHeader));
+
+    bool isValid = (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0) &&
+                   (header.version == MESH_CACHE_VERSION) &&
+                   (header.vertexStride == key.vertexStride) &&
+                   (header.vertexLayout == key.vertexLayout) &&
+                   (header.processFlags == key.processFlags) &&
+                   (header.sourceSize == sourceSize);
+
+    // Make sure every payload lies inside the file before anything is read out of it
+    isValid = isValid &&
+              (header.vertexOffset + uint64_t(header.vertexCount) * header.vertexStride <= size) &&
+              (header.indexOffset + header.indexDataSize <= size) &&
+              (header.subMeshOffset + uint64_t(header.subMeshCount) * sizeof(MeshCacheSubMesh) <= size) &&
+              (header.meshletOffset + uint64_t(header.meshletCount) * sizeof(Meshlet) <= size) &&
+              (header.textureNamesOffset + header.textureNamesSize <= size) &&
+              (header.vertexOffset % MESH_CACHE_PAYLOAD_ALIGNMENT == 0) &&
+              (header.indexOffset % MESH_CACHE_PAYLOAD_ALIGNMENT == 0) &&
+              (header.meshletOffset % MESH_CACHE_PAYLOAD_ALIGNMENT == 0);
+
+    // Timestamps change on checkout/copy without the content changing, fall back to comparing hashes
+    if (isValid && header.sourceModifiedTime != sourceModifiedTime) {
+        uint64_t sourceHash;
+        isValid = HashFile(sourcePath, sourceHash) && (sourceHash == header.sourceHash);
+    }
+
+    if (!isValid) {
+        cacheFile.Close();
+        return false;
+    }
+
+    contents.vertices = data + header.vertexOffset;
+    contents.vertexCount = header.vertexCount;
+    contents.indices = data + header.indexOffset;
+    contents.indexDataSize = header.indexDataSize;
+
+    contents.subMeshes.resize(header.subMeshCount);
+    if (header.subMeshCount > 0) {
+        memcpy(contents.subMeshes.data(), data + header.subMeshOffset, header.subMeshCount * sizeof(MeshCacheSubMesh));
+    }
+
+    contents.lodLevelCount = header.lodLevelCount;
+    if (header.subMeshCount % (header.lodLevelCount + 1) != 0) {
+        cacheFile.Close();
+        return false;
+    }
+    contents.meshlets = reinterpret_cast<const Meshlet*>(data + header.meshletOffset);
+    contents.meshletCount = header.meshletCount;
+
+    memcpy(contents.sizeAlong, header.sizeAlong, sizeof(contents.sizeAlong));
+    memcpy(contents.min, header.min, sizeof(contents.min));
+    memcpy(contents.max, header.max, sizeof(contents.max));
+
+    // Texture names - per type, a count followed by length-prefixed strings
+    const char *names = data + header.textureNamesOffset;
+    const char *namesEnd = names + header.textureNamesSize;
+    for (uint32_t type = 0; type < MESH_CACHE_TEXTURE_TYPE_COUNT; ++type) {
+        uint32_t count;
+        if (names + sizeof(uint32_t) > namesEnd) {
+            cacheFile.Close();
+            return false;
+        }
+        memcpy(&count, names, sizeof(uint32_t));
+        names += sizeof(uint32_t);
+
+        contents.textureNames[type].clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t length;
+            if (names + sizeof(uint32_t) > namesEnd) {
+                cacheFile.Close();
+                return false;
+            }
+            memcpy(&length, names, sizeof(uint32_t));
+            names += sizeof(uint32_t);
+
+            if (names + length > namesEnd) {
+                cacheFile.Close();
+                return false;
+            }
+            contents.textureNames[type].push_back(std::string(names, length));
+            names += length;
+        }
+    }
+
+    return true;
+}
+
+bool WriteMeshCache(const char *cachePath, const char *sourcePath, const MeshCacheKey& key, const MeshCacheContents& contents) {
+    MeshCacheHeader header;
+    memset(&header, 0x00, sizeof(MeshCacheHeader));
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.vertexStride = key.vertexStride;
+    header.vertexLayout = key.vertexLayout;
+    header.processFlags = key.processFlags;
+
+    if (!GetFileStats(sourcePath, header.sourceSize, header.sourceModifiedTime) || !HashFile(sourcePath, header.sourceHash)) {
+        return false;
+    }
+
+    memcpy(header.sizeAlong, contents.sizeAlong, sizeof(header.sizeAlong));
+    memcpy(header.min, contents.min, sizeof(header.min));
+    memcpy(header.max, contents.max, sizeof(header.max));
+
+    std::string textureNames;
+    for (uint32_t type = 0; type < MESH_CACHE_TEXTURE_TYPE_COUNT; ++type) {
+        uint32_t count = static_cast<uint32_t>(contents.textureNames[type].size());
+        textureNames.append(reinterpret_cast<const char*>(&count), sizeof(uint32_t));
+        for (const auto& name : contents.textureNames[type]) {
+            uint32_t length = static_cast<uint32_t>(name.size());
+            textureNames.append(reinterpret_cast<const char*>(&length), sizeof(uint32_t));
+            textureNames.append(name);
+        }
+    }
+
+    header.vertexCount = contents.vertexCount;
+    header.indexDataSize = contents.indexDataSize;
+    header.subMeshCount = static_cast<uint32_t>(contents.subMeshes.size());
+    header.meshletCount = contents.meshletCount;
+    header.lodLevelCount = contents.lodLevelCount;
+    header.vertexOffset = AlignUp(sizeof(MeshCacheHeader), MESH_CACHE_PAYLOAD_ALIGNMENT);
+    header.indexOffset = AlignUp(header.vertexOffset + uint64_t(header.vertexCount) * header.vertexStride, MESH_CACHE_PAYLOAD_ALIGNMENT);
+    header.subMeshOffset = AlignUp(header.indexOffset + header.indexDataSize, MESH_CACHE_PAYLOAD_ALIGNMENT);
+    header.meshletOffset = AlignUp(header.subMeshOffset + uint64_t(header.subMeshCount) * sizeof(MeshCacheSubMesh), MESH_CACHE_PAYLOAD_ALIGNMENT);
+    header.textureNamesOffset = header.meshletOffset + uint64_t(header.meshletCount) * sizeof(Meshlet);
+    header.textureNamesSize = textureNames.size();
+
+    // Write to a temporary and swap it in, so a failed write never leaves a truncated cache behind
+    std::string tempPath = std::string(cachePath) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        static const char zeroes[MESH_CACHE_PAYLOAD_ALIGNMENT] = {};
+        auto writeAt = [&file](uint64_t offset, const void *data, uint64_t size) {
+            uint64_t position = static_cast<uint64_t>(file.tellp());
+            if (position < offset) {
+                file.write(zeroes, offset - position);
+            }
+            file.write(static_cast<const char*>(data), size);
+        };
+
+        writeAt(0, &header, sizeof(MeshCacheHeader));
+        writeAt(header.vertexOffset, contents.vertices, uint64_t(header.vertexCount) * header.vertexStride);
+        writeAt(header.indexOffset, contents.indices, header.indexDataSize);
+        writeAt(header.subMeshOffset, contents.subMeshes.data(), uint64_t(header.subMeshCount) * sizeof(MeshCacheSubMesh));
+        writeAt(header.meshletOffset, contents.meshlets, uint64_t(header.meshletCount) * sizeof(Meshlet));
+        writeAt(header.textureNamesOffset, textureNames.data(), textureNames.size());
+
+        if (!file.good()) {
+            file.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::remove(cachePath);
+    if (std::rename(tempPath.c_str(), cachePath) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,84 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_MeshCache.hpp
+    Desc    :    Binary .xofmesh cache - the fully processed output of a mesh load
+                 (vertices, indices, submeshes, meshlets, bounds, texture names), written after
+                 the first load and memory-mapped on later ones.
+
+===============================================================================
+*/
+#ifndef XOF_MESH_CACHE_HPP
+#define XOF_MESH_CACHE_HPP
+
+
+#include "VertexDesc.hpp"
+#include "XOF_MappedFile.hpp"
+#include "XOF_Meshlets.hpp"
+#include <string>
+#include <vector>
+
+
+#define MESH_CACHE_EXTENSION ".xofmesh"
+
+// Bump whenever the layout of anything written to the cache changes (vertex layouts are keyed separately)
+static const uint32_t MESH_CACHE_VERSION = 9;
+static const uint32_t MESH_CACHE_TEXTURE_TYPE_COUNT = 3;
+
+
+// What the cached contents were produced for, a cache written under a different key is stale
+struct MeshCacheKey {
+                                // Opaque to the cache, how the contents were processed
+    uint32_t                    processFlags;
+                                // VertexLayoutInfo id/stride the vertices are encoded with
+    uint32_t                    vertexLayout;
+    uint32_t                    vertexStride;
+};
+
+
+struct MeshCacheSubMesh {
+    uint32_t                    baseIndex;
+    uint32_t                    indexCount;
+    int32_t                     textureIndex;
+                                // Where the submesh sits in the packed index data, see PackedIndexRange
+    uint32_t                    indexSize;
+    uint32_t                    firstIndex;
+    int32_t                     vertexOffset;
+                                // Error of the LOD level the submesh belongs to
+    float                       lodError;
+                                // Model space, see Mesh::SubMesh
+    float                       boundsMin[3];
+    float                       boundsMax[3];
+    float                       boundsRadius;
+};
+
+
+// Views of the cached data - point into the mapped cache file after a read, or at the
+// mesh's own data when writing
+struct MeshCacheContents {
+    const void                * vertices;     // Encoded with the key's vertex layout
+    uint32_t                    vertexCount;
+    const void                * indices;      // Packed, 16 and/or 32-bit per submesh
+    uint64_t                    indexDataSize;
+    std::vector<MeshCacheSubMesh> subMeshes;    // Every LOD level's in turn, the full detail ones first
+    uint32_t                    lodLevelCount;  // Not counting the full detail level
+    const Meshlet             * meshlets;     // rangeIndex is the submesh
+    uint32_t                    meshletCount;
+    float                       sizeAlong[3];
+    float                       min[3];
+    float                       max[3];
+    std::vector<std::string>    textureNames[MESH_CACHE_TEXTURE_TYPE_COUNT];
+};
+
+
+// Fails (without throwing) when the cache is missing, from another version or stale. A cache is
+// current when the source's size and mtime match, or failing that when the source's hash does.
+// The key has to match too. The vertex/index views stay valid for as long as cacheFile is open.
+bool ReadMeshCache(const char *cachePath, const char *sourcePath, const MeshCacheKey& key, MappedFile& cacheFile,
+                   MeshCacheContents& contents);
+bool WriteMeshCache(const char *cachePath, const char *sourcePath, const MeshCacheKey& key, const MeshCacheContents& contents);
+
+
+#endif // XOF_MESH_CACHE_HPP
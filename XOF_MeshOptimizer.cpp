@@ -0,0 +1,393 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_MeshOptimizer.cpp
+    Desc    :    Index/vertex reordering for the GPU - post-transform vertex cache
+                 (Forsyth), overdraw and vertex fetch locality - plus the cache
+                 statistics used to measure it.
+
+===============================================================================
+*/
+#include "XOF_MeshOptimizer.hpp"
+#include "XOF_ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+
+static const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+// Forsyth's tuning, from "Linear-Speed Vertex Cache Optimisation"
+static const uint32_t FORSYTH_CACHE_SIZE = 32;
+static const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_BOOST_SCALE = 2.f;
+static const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+static const uint32_t FORSYTH_MAX_TABULATED_VALENCE = 64;
+
+static const float OVERDRAW_THRESHOLD = 1.05f;
+
+
+// FIFO cache simulated with timestamps - a vertex is cached while fewer than cacheSize misses happened since its own
+struct FifoCache {
+    std::vector<uint32_t>       missTime;
+    uint32_t                    time;
+    uint32_t                    size;
+
+    FifoCache(uint32_t vertexCount, uint32_t cacheSize) : missTime(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+    inline bool Access(uint32_t v) {
+        if (time - missTime[v] > size) {
+            missTime[v] = time++;
+            return false;
+        }
+        return true;
+    }
+
+    inline void Reset() {
+        time += size + 1;
+    }
+};
+
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int *indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+    VertexCacheStats stats = { 0.f, 0.f };
+    if (indexCount < 3) {
+        return stats;
+    }
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> isReferenced(vertexCount, false);
+    uint32_t misses = 0;
+    uint32_t referencedCount = 0;
+
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        misses += cache.Access(indices[i]) ? 0 : 1;
+        if (!isReferenced[indices[i]]) {
+            isReferenced[indices[i]] = true;
+            ++referencedCount;
+        }
+    }
+
+    stats.acmr = static_cast<float>(misses) / (indexCount / 3);
+    stats.atvr = static_cast<float>(misses) / referencedCount;
+    return stats;
+}
+
+
+// ---
+
+
+struct ForsythScores {
+    float                       cache[FORSYTH_CACHE_SIZE];
+    float                       valence[FORSYTH_MAX_TABULATED_VALENCE];
+
+    ForsythScores() {
+        for (uint32_t i = 0; i < FORSYTH_CACHE_SIZE; ++i) {
+            // The most recent triangle's vertices score lower on purpose, the next triangle should move away from it
+            cache[i] = (i < 3) ? FORSYTH_LAST_TRIANGLE_SCORE
+                               : std::pow(1.f - static_cast<float>(i - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+        }
+        valence[0] = 0.f;
+        for (uint32_t i = 1; i < FORSYTH_MAX_TABULATED_VALENCE; ++i) {
+            valence[i] = FORSYTH_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -FORSYTH_VALENCE_BOOST_POWER);
+        }
+    }
+
+    inline float Score(int32_t cachePosition, uint32_t remainingTriangles) const {
+        if (remainingTriangles == 0) {
+            return -1.f;
+        }
+        float score = (cachePosition >= 0) ? cache[cachePosition] : 0.f;
+        score += (remainingTriangles < FORSYTH_MAX_TABULATED_VALENCE)
+                     ? valence[remainingTriangles]
+                     : FORSYTH_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -FORSYTH_VALENCE_BOOST_POWER);
+        return score;
+    }
+};
+
+void OptimizeVertexCache(unsigned int *indices, uint32_t indexCount, uint32_t vertexCount) {
+    static const ForsythScores scores;
+
+    const uint32_t triangleCount = indexCount / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    // Work in range-local vertex ids, the range may only touch a fraction of the mesh's vertices
+    std::vector<uint32_t> localIds(vertexCount, INVALID_INDEX);
+    std::vector<uint32_t> localIndices(triangleCount * 3);
+    std::vector<uint32_t> globalIds;
+    for (uint32_t i = 0; i < triangleCount * 3; ++i) {
+        uint32_t& localId = localIds[indices[i]];
+        if (localId == INVALID_INDEX) {
+            localId = static_cast<uint32_t>(globalIds.size());
+            globalIds.push_back(indices[i]);
+        }
+        localIndices[i] = localId;
+    }
+    const uint32_t localVertexCount = static_cast<uint32_t>(globalIds.size());
+
+    // Vertex -> triangle adjacency, each vertex's not yet emitted triangles are kept at the front of its slice
+    std::vector<uint32_t> adjacencyOffsets(localVertexCount + 1, 0);
+    for (uint32_t i = 0; i < triangleCount * 3; ++i) {
+        ++adjacencyOffsets[localIndices[i] + 1];
+    }
+    for (uint32_t v = 0; v < localVertexCount; ++v) {
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> remaining(localVertexCount, 0);
+    for (uint32_t i = 0; i < triangleCount * 3; ++i) {
+        uint32_t v = localIndices[i];
+        adjacency[adjacencyOffsets[v] + remaining[v]++] = i / 3;
+    }
+
+    std::vector<int32_t> cachePositions(localVertexCount, -1);
+    std::vector<float> vertexScores(localVertexCount);
+    for (uint32_t v = 0; v < localVertexCount; ++v) {
+        vertexScores[v] = scores.Score(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> isEmitted(triangleCount, false);
+    uint32_t bestTriangle = 0;
+    for (uint32_t t = 0; t < triangleCount; ++t) {
+        const uint32_t *triangle = &localIndices[t * 3];
+        triangleScores[t] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+        bestTriangle = (triangleScores[t] > triangleScores[bestTriangle]) ? t : bestTriangle;
+    }
+
+    // Room for the full cache plus the three vertices pushed in ahead of it
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t cacheCount = 0;
+    uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t nextUnemitted = 0;
+
+    for (uint32_t emitted = 0; emitted < triangleCount; ++emitted) {
+        if (bestTriangle == INVALID_INDEX) {
+            // Dead end - nothing in the cache has triangles left, carry on from the first triangle not yet emitted
+            while (isEmitted[nextUnemitted]) {
+                ++nextUnemitted;
+            }
+            bestTriangle = nextUnemitted;
+        }
+
+        const uint32_t *triangle = &localIndices[bestTriangle * 3];
+        for (uint32_t k = 0; k < 3; ++k) {
+            indices[emitted * 3 + k] = globalIds[triangle[k]];
+        }
+        isEmitted[bestTriangle] = true;
+
+        // Drop the triangle from its vertices' pending lists
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t v = triangle[k];
+            uint32_t *pending = &adjacency[adjacencyOffsets[v]];
+            for (uint32_t a = 0; a < remaining[v]; ++a) {
+                if (pending[a] == bestTriangle) {
+                    pending[a] = pending[--remaining[v]];
+                    break;
+                }
+            }
+        }
+
+        // The triangle's vertices move to the front of the LRU cache
+        uint32_t newCacheCount = 0;
+        for (uint32_t k = 0; k < 3; ++k) {
+            newCache[newCacheCount++] = triangle[k];
+        }
+        for (uint32_t c = 0; c < cacheCount; ++c) {
+            uint32_t v = cache[c];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                newCache[newCacheCount++] = v;
+            }
+        }
+
+        // Rescore everything whose cache position changed (including what just fell out) and propagate the
+        // difference to their remaining triangles
+        for (uint32_t c = 0; c < newCacheCount; ++c) {
+            uint32_t v = newCache[c];
+            cachePositions[v] = (c < FORSYTH_CACHE_SIZE) ? static_cast<int32_t>(c) : -1;
+            float score = scores.Score(cachePositions[v], remaining[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+
+            const uint32_t *pending = &adjacency[adjacencyOffsets[v]];
+            for (uint32_t a = 0; a < remaining[v]; ++a) {
+                triangleScores[pending[a]] += delta;
+            }
+        }
+
+        cacheCount = std::min(newCacheCount, FORSYTH_CACHE_SIZE);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        // Only triangles touching the cache are candidates, anything else scores lower anyway
+        bestTriangle = INVALID_INDEX;
+        float bestScore = -1.f;
+        for (uint32_t c = 0; c < cacheCount; ++c) {
+            uint32_t v = cache[c];
+            const uint32_t *pending = &adjacency[adjacencyOffsets[v]];
+            for (uint32_t a = 0; a < remaining[v]; ++a) {
+                if (triangleScores[pending[a]] > bestScore) {
+                    bestScore = triangleScores[pending[a]];
+                    bestTriangle = pending[a];
+                }
+            }
+        }
+    }
+}
+
+
+// ---
+
+
+void OptimizeOverdraw(unsigned int *indices, uint32_t indexCount, const Vertex *vertices, uint32_t vertexCount,
+                      float threshold) {
+    const uint32_t triangleCount = indexCount / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    FifoCache cache(vertexCount, VERTEX_CACHE_STATS_SIZE);
+
+    // Hard boundaries - triangles that miss on all three vertices, the cache optimiser started over there
+    // so the order can be changed at no cost
+    std::vector<uint32_t> hardBoundaries;
+    uint32_t totalMisses = 0;
+    for (uint32_t t = 0; t < triangleCount; ++t) {
+        uint32_t misses = 0;
+        for (uint32_t k = 0; k < 3; ++k) {
+            misses += cache.Access(indices[t * 3 + k]) ? 0 : 1;
+        }
+        if (t == 0 || misses == 3) {
+            hardBoundaries.push_back(t);
+        }
+        totalMisses += misses;
+    }
+    hardBoundaries.push_back(triangleCount);
+    const float maxClusterAcmr = threshold * static_cast<float>(totalMisses) / triangleCount;
+
+    // Soft boundaries - split the hard clusters further wherever that keeps the ACMR within the threshold
+    std::vector<uint32_t> clusterStarts;
+    for (size_t h = 0; h + 1 < hardBoundaries.size(); ++h) {
+        uint32_t clusterStart = hardBoundaries[h];
+        uint32_t clusterMisses = 0;
+        cache.Reset();
+        clusterStarts.push_back(clusterStart);
+
+        for (uint32_t t = hardBoundaries[h]; t < hardBoundaries[h + 1]; ++t) {
+            for (uint32_t k = 0; k < 3; ++k) {
+                clusterMisses += cache.Access(indices[t * 3 + k]) ? 0 : 1;
+            }
+            if (t + 1 < hardBoundaries[h + 1] && static_cast<float>(clusterMisses) / (t - clusterStart + 1) <= maxClusterAcmr) {
+                clusterStart = t + 1;
+                clusterMisses = 0;
+                cache.Reset();
+                clusterStarts.push_back(clusterStart);
+            }
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+    const uint32_t clusterCount = static_cast<uint32_t>(clusterStarts.size()) - 1;
+
+    // Area weighted centroid and normal per cluster
+    std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.f));
+    std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.f));
+    glm::vec3 meshCentroid(0.f);
+    float meshArea = 0.f;
+
+    for (uint32_t c = 0; c < clusterCount; ++c) {
+        float clusterArea = 0.f;
+        for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+            const glm::vec3& p0 = vertices[indices[t * 3 + 0]].pos;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);    // Length is twice the area
+            float area = glm::length(normal);
+            clusterCentroids[c] += (p0 + p1 + p2) * (area / 3.f);
+            clusterNormals[c] += normal;
+            clusterArea += area;
+        }
+
+        meshCentroid += clusterCentroids[c];
+        meshArea += clusterArea;
+        clusterCentroids[c] = (clusterArea > 0.f) ? clusterCentroids[c] * (1.f / clusterArea) : clusterCentroids[c];
+    }
+    meshCentroid = (meshArea > 0.f) ? meshCentroid * (1.f / meshArea) : meshCentroid;
+
+    // Clusters facing away from the centre of the mesh are the likely occluders, draw those first
+    std::vector<float> clusterSortKeys(clusterCount);
+    std::vector<uint32_t> clusterOrder(clusterCount);
+    for (uint32_t c = 0; c < clusterCount; ++c) {
+        clusterSortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+        clusterOrder[c] = c;
+    }
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+                     [&clusterSortKeys](uint32_t a, uint32_t b) { return clusterSortKeys[a] > clusterSortKeys[b]; });
+
+    std::vector<unsigned int> reordered;
+    reordered.reserve(triangleCount * 3);
+    for (uint32_t c : clusterOrder) {
+        reordered.insert(reordered.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+    }
+    std::copy(reordered.begin(), reordered.end(), indices);
+}
+
+
+// ---
+
+
+uint32_t OptimizeVertexFetch(std::vector<Vertex>& vertices, unsigned int *indices, uint32_t indexCount) {
+    std::vector<uint32_t> remap(vertices.size(), INVALID_INDEX);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        uint32_t& newIndex = remap[indices[i]];
+        if (newIndex == INVALID_INDEX) {
+            newIndex = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = newIndex;
+    }
+
+    vertices.swap(reordered);
+    return static_cast<uint32_t>(vertices.size());
+}
+
+
+// ---
+
+
+void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const IndexRange *ranges,
+                  uint32_t rangeCount, ThreadPool *pool, MeshOptimizationStats *stats) {
+    const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+    const uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+    if (stats) {
+        stats->before = AnalyzeVertexCache(indices.data(), indexCount, vertexCount);
+    }
+
+    auto optimizeRange = [&](uint32_t r) {
+        unsigned int *rangeIndices = indices.data() + ranges[r].baseIndex;
+        OptimizeVertexCache(rangeIndices, ranges[r].indexCount, vertexCount);
+        OptimizeOverdraw(rangeIndices, ranges[r].indexCount, vertices.data(), vertexCount, OVERDRAW_THRESHOLD);
+    };
+
+    if (pool) {
+        pool->ParallelFor(rangeCount, optimizeRange);
+    } else {
+        for (uint32_t r = 0; r < rangeCount; ++r) {
+            optimizeRange(r);
+        }
+    }
+
+    OptimizeVertexFetch(vertices, indices.data(), indexCount);
+
+    if (stats) {
+        stats->after = AnalyzeVertexCache(indices.data(), indexCount, static_cast<uint32_t>(vertices.size()));
+    }
+}
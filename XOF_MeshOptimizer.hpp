@@ -0,0 +1,68 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_MeshOptimizer.hpp
+    Desc    :    Index/vertex reordering for the GPU - post-transform vertex cache
+                 (Forsyth), overdraw and vertex fetch locality - plus the cache
+                 statistics used to measure it.
+
+===============================================================================
+*/
+#ifndef XOF_MESH_OPTIMIZER_HPP
+#define XOF_MESH_OPTIMIZER_HPP
+
+
+#include "VertexDesc.hpp"
+#include <cstdint>
+#include <vector>
+
+
+class ThreadPool;
+
+
+// FIFO cache size the statistics are simulated with, a fair stand-in for most current GPUs
+static const uint32_t VERTEX_CACHE_STATS_SIZE = 16;
+
+
+struct VertexCacheStats {
+    float                       acmr;   // Average cache miss ratio - transformed vertices per triangle (0.5 - 3)
+    float                       atvr;   // Average transform to vertex ratio - transformed vertices per referenced vertex (1 - 3)
+};
+
+// Triangles [baseIndex, baseIndex + indexCount) are reordered among themselves, never across ranges
+struct IndexRange {
+    uint32_t                    baseIndex;
+    uint32_t                    indexCount;
+};
+
+struct MeshOptimizationStats {
+    VertexCacheStats            before;
+    VertexCacheStats            after;
+};
+
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int *indices, uint32_t indexCount, uint32_t vertexCount,
+                                    uint32_t cacheSize = VERTEX_CACHE_STATS_SIZE);
+
+// Forsyth's linear-speed vertex cache optimisation, in place
+void OptimizeVertexCache(unsigned int *indices, uint32_t indexCount, uint32_t vertexCount);
+
+// Splits vertex cache optimised triangles into clusters and orders the clusters outward-facing first, so
+// occluders tend to be drawn before what they occlude. threshold is how much worse than the input's ACMR
+// the result is allowed to get (1.05 = 5%).
+void OptimizeOverdraw(unsigned int *indices, uint32_t indexCount, const Vertex *vertices, uint32_t vertexCount,
+                      float threshold);
+
+// Reorders vertices into first-use order and rewrites the indices to match, vertices no index uses are dropped.
+// Returns the new vertex count.
+uint32_t OptimizeVertexFetch(std::vector<Vertex>& vertices, unsigned int *indices, uint32_t indexCount);
+
+
+// All three passes, the first two per range (in parallel given a pool). stats may be null.
+void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const IndexRange *ranges,
+                  uint32_t rangeCount, ThreadPool *pool, MeshOptimizationStats *stats);
+
+
+#endif // XOF_MESH_OPTIMIZER_HPP
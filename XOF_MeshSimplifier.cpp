@@ -0,0 +1,392 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_MeshSimplifier.cpp
+    Desc    :    Quadric error edge collapse simplification, and the LOD chains
+                 built from it - simplified index buffers over the original
+                 vertices, one per level and index range.
+
+===============================================================================
+*/
+#include "XOF_MeshSimplifier.hpp"
+#include "XOF_ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <tuple>
+#include <glm/glm.hpp>
+
+
+static const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+// Collapses can't turn a surviving triangle's normal by more than ~75 degrees, which also keeps them from folding over
+static const float MAX_NORMAL_ROTATION_COS = 0.25f;
+// A level has to lose at least this much of the one before to be worth keeping
+static const float LOD_MIN_REDUCTION = 0.9f;
+
+
+// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix of Garland and Heckbert
+struct Quadric {
+    double                      aa, ab, ac, ad, bb, bc, bd, cc, cd, dd;
+
+    void                        AddPlane(double a, double b, double c, double d) {
+        aa += a * a; ab += a * b; ac += a * c; ad += a * d;
+        bb += b * b; bc += b * c; bd += b * d;
+        cc += c * c; cd += c * d;
+        dd += d * d;
+    }
+
+    void                        Add(const Quadric& q) {
+        aa += q.aa; ab += q.ab; ac += q.ac; ad += q.ad;
+        bb += q.bb; bc += q.bc; bd += q.bd;
+        cc += q.cc; cd += q.cd;
+        dd += q.dd;
+    }
+
+    double                      Evaluate(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double error = aa * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+                       bb * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+                       cc * z * z + 2.0 * cd * z +
+                       dd;
+        // Rounding can take it a hair below zero
+        return std::max(error, 0.0);
+    }
+};
+
+struct Collapse {
+    double                      error;
+    uint32_t                    from;
+    uint32_t                    to;
+};
+
+
+uint32_t SimplifyIndices(const Vertex *vertices, uint32_t vertexCount, const unsigned int *indices, uint32_t indexCount,
+                         uint32_t targetIndexCount, float maxError, unsigned int *destination, float *resultError) {
+    // Work on local ids of just the referenced vertices, so a submesh of a large mesh stays cheap
+    std::vector<uint32_t> localIds(vertexCount, INVALID_INDEX);
+    std::vector<uint32_t> globalIds;
+    std::vector<uint32_t> triangles(indexCount);
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        uint32_t& localId = localIds[indices[i]];
+        if (localId == INVALID_INDEX) {
+            localId = static_cast<uint32_t>(globalIds.size());
+            globalIds.push_back(indices[i]);
+        }
+        triangles[i] = localId;
+    }
+    const uint32_t localCount = static_cast<uint32_t>(globalIds.size());
+
+    std::vector<glm::vec3> positions(localCount);
+    for (uint32_t v = 0; v < localCount; ++v) {
+        positions[v] = vertices[globalIds[v]].pos;
+    }
+
+    // Vertices at the same position (split by a UV/normal seam) share one position id
+    std::vector<uint32_t> positionIds(localCount);
+    std::vector<uint8_t> isLocked(localCount, 0);
+    {
+        std::vector<uint32_t> order(localCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&positions](uint32_t a, uint32_t b) {
+            return std::tie(positions[a].x, positions[a].y, positions[a].z) < std::tie(positions[b].x, positions[b].y, positions[b].z);
+        });
+        for (uint32_t i = 0; i < localCount;) {
+            uint32_t end = i + 1;
+            while (end < localCount && positions[order[end]] == positions[order[i]]) {
+                ++end;
+            }
+            for (uint32_t j = i; j < end; ++j) {
+                positionIds[order[j]] = order[i];
+                // Seams are locked, collapsing one side would tear them open
+                isLocked[order[j]] = (end - i > 1) ? 1 : 0;
+            }
+            i = end;
+        }
+    }
+
+    // An edge without its twin is on an open border (a material boundary for a submesh), one with more than
+    // one copy is non-manifold - lock both kinds so neither cracks
+    {
+        std::vector<uint64_t> edges;
+        edges.reserve(indexCount);
+        for (uint32_t t = 0; t + 3 <= indexCount; t += 3) {
+            for (uint32_t c = 0; c < 3; ++c) {
+                uint64_t a = positionIds[triangles[t + c]];
+                uint64_t b = positionIds[triangles[t + (c + 1) % 3]];
+                if (a != b) {
+                    edges.push_back((a << 32) | b);
+                }
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        std::vector<uint8_t> isPositionLocked(localCount, 0);
+        for (size_t e = 0; e < edges.size(); ++e) {
+            uint64_t twin = (edges[e] << 32) | (edges[e] >> 32);
+            bool isDuplicate = (e > 0 && edges[e - 1] == edges[e]) || (e + 1 < edges.size() && edges[e + 1] == edges[e]);
+            if (isDuplicate || !std::binary_search(edges.begin(), edges.end(), twin)) {
+                isPositionLocked[edges[e] >> 32] = 1;
+                isPositionLocked[edges[e] & 0xFFFFFFFF] = 1;
+            }
+        }
+        for (uint32_t v = 0; v < localCount; ++v) {
+            isLocked[v] |= isPositionLocked[positionIds[v]];
+        }
+    }
+
+    // Every triangle's plane goes into the quadrics of its corners
+    std::vector<Quadric> quadrics(localCount, Quadric());
+    for (uint32_t t = 0; t + 3 <= indexCount; t += 3) {
+        const glm::vec3& p0 = positions[triangles[t + 0]];
+        glm::vec3 normal = glm::cross(positions[triangles[t + 1]] - p0, positions[triangles[t + 2]] - p0);
+        float length = glm::length(normal);
+        if (length == 0.f) {
+            continue;
+        }
+        normal = normal / length;
+        double d = -glm::dot(normal, p0);
+        for (uint32_t c = 0; c < 3; ++c) {
+            quadrics[triangles[t + c]].AddPlane(normal.x, normal.y, normal.z, d);
+        }
+    }
+
+    const double errorLimit = double(maxError) * maxError;
+    double largestError = 0.0;
+
+    std::vector<uint32_t> adjacencyOffsets(localCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(localCount);
+    std::vector<uint8_t> isTouched(localCount);
+
+    uint32_t currentCount = static_cast<uint32_t>(triangles.size()) / 3 * 3;
+    triangles.resize(currentCount);
+
+    // Passes of independent collapses, cheapest first, until the target or the error limit is reached
+    while (currentCount > targetIndexCount) {
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (uint32_t i = 0; i < currentCount; ++i) {
+            ++adjacencyOffsets[triangles[i] + 1];
+        }
+        std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+        adjacency.resize(currentCount);
+        {
+            std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (uint32_t i = 0; i < currentCount; ++i) {
+                adjacency[cursor[triangles[i]]++] = i / 3;
+            }
+        }
+
+        collapses.clear();
+        for (uint32_t t = 0; t < currentCount; t += 3) {
+            for (uint32_t c = 0; c < 3; ++c) {
+                uint32_t a = triangles[t + c];
+                uint32_t b = triangles[t + (c + 1) % 3];
+                if (!isLocked[a]) {
+                    double error = quadrics[a].Evaluate(positions[b]);
+                    if (error <= errorLimit) {
+                        collapses.push_back({ error, a, b });
+                    }
+                }
+                if (!isLocked[b]) {
+                    double error = quadrics[b].Evaluate(positions[a]);
+                    if (error <= errorLimit) {
+                        collapses.push_back({ error, b, a });
+                    }
+                }
+            }
+        }
+        if (collapses.empty()) {
+            break;
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+        std::iota(remap.begin(), remap.end(), 0);
+        std::fill(isTouched.begin(), isTouched.end(), 0);
+        uint32_t collapseCount = 0;
+        uint32_t remainingCount = currentCount;
+
+        for (const Collapse& collapse : collapses) {
+            if (remainingCount <= targetIndexCount) {
+                break;
+            }
+            if (isTouched[collapse.from] || isTouched[collapse.to]) {
+                continue;
+            }
+
+            // Moving from onto to mustn't flip (or badly twist) any triangle that survives it
+            uint32_t removedTriangles = 0;
+            bool isValid = true;
+            for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && isValid; ++a) {
+                const uint32_t *triangle = &triangles[adjacency[a] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                    ++removedTriangles;
+                    continue;
+                }
+
+                glm::vec3 corners[3];
+                for (uint32_t c = 0; c < 3; ++c) {
+                    corners[c] = positions[triangle[c]];
+                }
+                glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                for (uint32_t c = 0; c < 3; ++c) {
+                    if (triangle[c] == collapse.from) {
+                        corners[c] = positions[collapse.to];
+                    }
+                }
+                glm::vec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                isValid = glm::dot(before, after) > MAX_NORMAL_ROTATION_COS * glm::length(before) * glm::length(after);
+            }
+            if (!isValid) {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].Add(quadrics[collapse.from]);
+            largestError = std::max(largestError, collapse.error);
+            remainingCount -= removedTriangles * 3;
+            ++collapseCount;
+
+            // Nothing around the collapse can change again this pass, the adjacency would go stale
+            isTouched[collapse.from] = 1;
+            isTouched[collapse.to] = 1;
+            for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; ++a) {
+                const uint32_t *triangle = &triangles[adjacency[a] * 3];
+                isTouched[triangle[0]] = isTouched[triangle[1]] = isTouched[triangle[2]] = 1;
+            }
+        }
+
+        if (collapseCount == 0) {
+            break;
+        }
+
+        // Apply the pass and drop what collapsed to nothing
+        uint32_t writeCount = 0;
+        for (uint32_t t = 0; t < currentCount; t += 3) {
+            uint32_t a = remap[triangles[t + 0]];
+            uint32_t b = remap[triangles[t + 1]];
+            uint32_t c = remap[triangles[t + 2]];
+            if (positionIds[a] != positionIds[b] && positionIds[b] != positionIds[c] && positionIds[c] != positionIds[a]) {
+                triangles[writeCount++] = a;
+                triangles[writeCount++] = b;
+                triangles[writeCount++] = c;
+            }
+        }
+        currentCount = writeCount;
+    }
+
+    for (uint32_t i = 0; i < currentCount; ++i) {
+        destination[i] = globalIds[triangles[i]];
+    }
+    if (resultError) {
+        *resultError = static_cast<float>(std::sqrt(largestError));
+    }
+
+    return currentCount;
+}
+
+
+void BuildLodChain(const Vertex *vertices, uint32_t vertexCount, std::vector<unsigned int>& indices,
+                   const IndexRange *ranges, uint32_t rangeCount, const LodChainDesc& desc, ThreadPool *pool,
+                   std::vector<LodLevel>& levels) {
+    levels.clear();
+    if (vertexCount == 0) {
+        return;
+    }
+
+    // Errors are kept relative to the bounding radius, which is what LOD selection projects
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        boundsMin = glm::min(boundsMin, vertices[v].pos);
+        boundsMax = glm::max(boundsMax, vertices[v].pos);
+    }
+    const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.f;
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        radius = std::max(radius, glm::length(vertices[v].pos - center));
+    }
+    if (radius == 0.f) {
+        return;
+    }
+
+    // Each range's latest level - its indices, where they are and its accumulated error
+    std::vector<std::vector<unsigned int>> current(rangeCount);
+    std::vector<IndexRange> currentRanges(ranges, ranges + rangeCount);
+    std::vector<float> currentErrors(rangeCount, 0.f);
+    for (uint32_t r = 0; r < rangeCount; ++r) {
+        current[r].assign(indices.begin() + ranges[r].baseIndex, indices.begin() + ranges[r].baseIndex + ranges[r].indexCount);
+    }
+
+    std::vector<uint8_t> hasShrunk(rangeCount);
+
+    for (uint32_t level = 0; level < desc.maxLevelCount; ++level) {
+        auto simplifyRange = [&](uint32_t r) {
+            const uint32_t currentCount = static_cast<uint32_t>(current[r].size());
+            const uint32_t targetCount = static_cast<uint32_t>(currentCount / 3 * desc.reduction) * 3;
+            // The error budget is for the whole chain, each level only gets what the ones before left over
+            const float errorBudget = desc.maxError - currentErrors[r];
+
+            hasShrunk[r] = 0;
+            if (currentCount == 0 || errorBudget <= 0.f) {
+                return;
+            }
+
+            std::vector<unsigned int> simplified(currentCount);
+            float error;
+            uint32_t simplifiedCount = SimplifyIndices(vertices, vertexCount, current[r].data(), currentCount, targetCount,
+                                                       errorBudget * radius, simplified.data(), &error);
+            if (simplifiedCount > currentCount * LOD_MIN_REDUCTION) {
+                return;
+            }
+
+            simplified.resize(simplifiedCount);
+            OptimizeVertexCache(simplified.data(), simplifiedCount, vertexCount);
+            current[r].swap(simplified);
+            currentErrors[r] += error / radius;
+            hasShrunk[r] = 1;
+        };
+
+        if (pool) {
+            pool->ParallelFor(rangeCount, simplifyRange);
+        } else {
+            for (uint32_t r = 0; r < rangeCount; ++r) {
+                simplifyRange(r);
+            }
+        }
+
+        if (std::find(hasShrunk.begin(), hasShrunk.end(), 1) == hasShrunk.end()) {
+            break;
+        }
+
+        LodLevel lodLevel;
+        lodLevel.ranges.resize(rangeCount);
+        lodLevel.error = 0.f;
+        lodLevel.triangleCount = 0;
+        for (uint32_t r = 0; r < rangeCount; ++r) {
+            // A range that didn't shrink keeps pointing at its last level's indices
+            if (hasShrunk[r]) {
+                currentRanges[r].baseIndex = static_cast<uint32_t>(indices.size());
+                currentRanges[r].indexCount = static_cast<uint32_t>(current[r].size());
+                indices.insert(indices.end(), current[r].begin(), current[r].end());
+            }
+            lodLevel.ranges[r] = currentRanges[r];
+            lodLevel.error = std::max(lodLevel.error, currentErrors[r]);
+            lodLevel.triangleCount += currentRanges[r].indexCount / 3;
+        }
+        levels.push_back(lodLevel);
+    }
+}
+
+uint32_t SelectLod(const float *errors, uint32_t levelCount, float projectedRadius, float maxPixelError) {
+    // Errors only grow along the chain
+    uint32_t level = 0;
+    while (level + 1 < levelCount && errors[level + 1] * projectedRadius <= maxPixelError) {
+        ++level;
+    }
+    return level;
+}
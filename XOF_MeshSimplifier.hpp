@@ -0,0 +1,65 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_MeshSimplifier.hpp
+    Desc    :    Quadric error edge collapse simplification, and the LOD chains
+                 built from it - simplified index buffers over the original
+                 vertices, one per level and index range.
+
+===============================================================================
+*/
+#ifndef XOF_MESH_SIMPLIFIER_HPP
+#define XOF_MESH_SIMPLIFIER_HPP
+
+
+#include "VertexDesc.hpp"
+#include "XOF_MeshOptimizer.hpp"
+#include <cstdint>
+#include <vector>
+
+
+class ThreadPool;
+
+
+struct LodChainDesc {
+    uint32_t                    maxLevelCount;  // Not counting the source
+    float                       reduction;      // Target triangle ratio of each level to the one before (0.5 = half)
+    float                       maxError;       // Relative to the bounding radius of the vertices
+};
+
+static const LodChainDesc DEFAULT_LOD_CHAIN_DESC = { 4, 0.5f, 0.05f };
+
+
+// One simplified level - ranges[r] is the simplification of source range r
+struct LodLevel {
+    std::vector<IndexRange>     ranges;
+    float                       error;          // Largest over the ranges, relative to the bounding radius
+    uint32_t                    triangleCount;
+};
+
+
+// Collapses edges of the triangles in indices, cheapest quadric error first, until at most targetIndexCount
+// indices are left or the next collapse would move the surface further than maxError. Vertices are never
+// moved or created, the result indexes the same vertices. Open borders (material boundaries, when simplifying a
+// submesh on its own) and attribute seams (vertices sharing a position) are locked, so neither tears.
+// destination can alias indices. Returns the index count written, resultError (may be null) gets the
+// largest error of the collapses made.
+uint32_t SimplifyIndices(const Vertex *vertices, uint32_t vertexCount, const unsigned int *indices, uint32_t indexCount,
+                         uint32_t targetIndexCount, float maxError, unsigned int *destination, float *resultError);
+
+// Simplifies every range level after level, each from the one before, and appends the level's (vertex cache
+// optimised) indices to indices. The chain ends early once no range shrinks by much anymore. A range that
+// stopped shrinking repeats its last level, so every level has one range per source range. Ranges are
+// simplified in parallel given a pool.
+void BuildLodChain(const Vertex *vertices, uint32_t vertexCount, std::vector<unsigned int>& indices,
+                   const IndexRange *ranges, uint32_t rangeCount, const LodChainDesc& desc, ThreadPool *pool,
+                   std::vector<LodLevel>& levels);
+
+// The coarsest level whose error stays under maxPixelError on screen, for a bounding sphere projected
+// projectedRadius pixels tall. errors[0] is the source (0), errors[i] LodLevel i - 1's error.
+uint32_t SelectLod(const float *errors, uint32_t levelCount, float projectedRadius, float maxPixelError);
+
+
+#endif // XOF_MESH_SIMPLIFIER_HPP
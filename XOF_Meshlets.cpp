@@ -0,0 +1,168 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_Meshlets.cpp
+    Desc    :    Splits index ranges into small meshlets with a bounding sphere and
+                 a normal cone each, and culls them on the CPU against the frustum
+                 and the cone into compacted index ranges to draw.
+
+===============================================================================
+*/
+#include "XOF_Meshlets.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+// Sphere around the bounding box, then the cone of the triangles' face normals
+static void ComputeMeshletBounds(const Vertex *vertices, const unsigned int *indices, Meshlet& meshlet) {
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+        const glm::vec3& p = vertices[indices[meshlet.baseIndex + i]].pos;
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radiusSquared = 0.f;
+    for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+        glm::vec3 offset = vertices[indices[meshlet.baseIndex + i]].pos - center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+
+    // Front faces are counter-clockwise, so these point outward. Degenerate triangles are never rasterised,
+    // they don't constrain the cone.
+    const uint32_t triangleCount = meshlet.indexCount / 3;
+    auto faceNormal = [&](uint32_t t, glm::vec3& normal) {
+        const unsigned int *triangle = indices + meshlet.baseIndex + t * 3;
+        glm::vec3 p0 = vertices[triangle[0]].pos;
+        normal = glm::cross(vertices[triangle[1]].pos - p0, vertices[triangle[2]].pos - p0);
+        float length = glm::length(normal);
+        if (length == 0.f) {
+            return false;
+        }
+        normal = normal / length;
+        return true;
+    };
+
+    glm::vec3 axis(0.f);
+    glm::vec3 normal;
+    for (uint32_t t = 0; t < triangleCount; ++t) {
+        if (faceNormal(t, normal)) {
+            axis += normal;
+        }
+    }
+
+    float axisLength = glm::length(axis);
+    float minDot = -1.f;
+    if (axisLength > 0.f) {
+        axis = axis / axisLength;
+        minDot = 1.f;
+        for (uint32_t t = 0; t < triangleCount; ++t) {
+            if (faceNormal(t, normal)) {
+                minDot = std::min(minDot, glm::dot(normal, axis));
+            }
+        }
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        meshlet.center[i] = center[i];
+        meshlet.coneAxis[i] = (minDot > 0.f) ? axis[i] : 0.f;
+    }
+    meshlet.radius = std::sqrt(radiusSquared);
+    // Normals spread up to acos(minDot) from the axis, so all of them face away within 90 - that of the axis
+    meshlet.coneCutoff = (minDot > 0.f) ? std::sqrt(1.f - minDot * minDot) : 1.f;
+}
+
+
+void BuildMeshlets(const Vertex *vertices, uint32_t vertexCount, const unsigned int *indices, const IndexRange *ranges,
+                   uint32_t rangeCount, std::vector<Meshlet>& meshlets, uint32_t maxVertices, uint32_t maxTriangles) {
+    meshlets.clear();
+
+    // Which meshlet last used each vertex (plus one), to count the meshlet's unique vertices
+    std::vector<uint32_t> lastMeshlet(vertexCount, 0);
+
+    for (uint32_t r = 0; r < rangeCount; ++r) {
+        const uint32_t rangeEnd = ranges[r].baseIndex + ranges[r].indexCount;
+
+        Meshlet meshlet = {};
+        meshlet.baseIndex = ranges[r].baseIndex;
+        meshlet.rangeIndex = r;
+        uint32_t meshletStamp = static_cast<uint32_t>(meshlets.size()) + 1;
+
+        for (uint32_t i = ranges[r].baseIndex; i + 3 <= rangeEnd; i += 3) {
+            uint32_t newVertices = 0;
+            for (uint32_t c = 0; c < 3; ++c) {
+                // Repeated corners within the triangle only count once
+                bool repeated = (c > 0 && indices[i + c] == indices[i]) || (c > 1 && indices[i + c] == indices[i + 1]);
+                newVertices += (!repeated && lastMeshlet[indices[i + c]] != meshletStamp) ? 1 : 0;
+            }
+
+            if (meshlet.indexCount > 0 && (meshlet.vertexCount + newVertices > maxVertices ||
+                                           meshlet.indexCount / 3 + 1 > maxTriangles)) {
+                ComputeMeshletBounds(vertices, indices, meshlet);
+                meshlets.push_back(meshlet);
+
+                meshlet = {};
+                meshlet.baseIndex = i;
+                meshlet.rangeIndex = r;
+                meshletStamp = static_cast<uint32_t>(meshlets.size()) + 1;
+            }
+
+            for (uint32_t c = 0; c < 3; ++c) {
+                if (lastMeshlet[indices[i + c]] != meshletStamp) {
+                    lastMeshlet[indices[i + c]] = meshletStamp;
+                    ++meshlet.vertexCount;
+                }
+            }
+            meshlet.indexCount += 3;
+        }
+
+        if (meshlet.indexCount > 0) {
+            ComputeMeshletBounds(vertices, indices, meshlet);
+            meshlets.push_back(meshlet);
+        }
+    }
+}
+
+uint32_t CullMeshlets(const Meshlet *meshlets, uint32_t meshletCount, const Frustum& frustum, const glm::vec3& eye,
+                      std::vector<MeshletDrawRange>& drawRanges, MeshletCullStats *stats, const uint8_t *rangeVisibility) {
+    drawRanges.clear();
+    uint32_t frustumCulled = 0;
+    uint32_t coneCulled = 0;
+
+    for (uint32_t m = 0; m < meshletCount; ++m) {
+        const Meshlet& meshlet = meshlets[m];
+        glm::vec3 center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+
+        if ((rangeVisibility && !rangeVisibility[meshlet.rangeIndex]) || !IsSphereInFrustum(frustum, center, meshlet.radius)) {
+            ++frustumCulled;
+            continue;
+        }
+
+        glm::vec3 view = center - eye;
+        glm::vec3 axis(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+        if (glm::dot(view, axis) >= meshlet.coneCutoff * glm::length(view) + meshlet.radius) {
+            ++coneCulled;
+            continue;
+        }
+
+        // Meshlets of a range are contiguous, so runs of visible ones collapse into a single draw
+        if (!drawRanges.empty() && drawRanges.back().rangeIndex == meshlet.rangeIndex &&
+            drawRanges.back().baseIndex + drawRanges.back().indexCount == meshlet.baseIndex) {
+            drawRanges.back().indexCount += meshlet.indexCount;
+        } else {
+            drawRanges.push_back({ meshlet.rangeIndex, meshlet.baseIndex, meshlet.indexCount });
+        }
+    }
+
+    if (stats) {
+        stats->frustumCulled = frustumCulled;
+        stats->coneCulled = coneCulled;
+    }
+
+    return meshletCount - frustumCulled - coneCulled;
+}
@@ -0,0 +1,70 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_Meshlets.hpp
+    Desc    :    Splits index ranges into small meshlets with a bounding sphere and
+                 a normal cone each, and culls them on the CPU against the frustum
+                 and the cone into compacted index ranges to draw.
+
+===============================================================================
+*/
+#ifndef XOF_MESHLETS_HPP
+#define XOF_MESHLETS_HPP
+
+
+#include "VertexDesc.hpp"
+#include "XOF_Frustum.hpp"
+#include "XOF_MeshOptimizer.hpp"
+#include <cstdint>
+#include <vector>
+
+
+static const uint32_t MESHLET_MAX_VERTICES = 64;
+static const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+
+// Plain data, stored as is in the mesh cache
+struct Meshlet {
+    float                       center[3];
+    float                       radius;
+                                // Every triangle faces away from an eye with dot(center - eye, coneAxis) >=
+                                // coneCutoff * length(center - eye) + radius. A cutoff of 1 is never culled.
+    float                       coneAxis[3];
+    float                       coneCutoff;
+                                // Triangles [baseIndex, baseIndex + indexCount) of the source indices
+    uint32_t                    baseIndex;
+    uint32_t                    indexCount;
+    uint32_t                    rangeIndex;     // Which of the ranges it was built from
+    uint32_t                    vertexCount;
+};
+
+// Adjacent visible meshlets of the same range merged together
+struct MeshletDrawRange {
+    uint32_t                    rangeIndex;
+    uint32_t                    baseIndex;
+    uint32_t                    indexCount;
+};
+
+struct MeshletCullStats {
+    uint32_t                    frustumCulled;
+    uint32_t                    coneCulled;
+};
+
+
+// Cuts each range into meshlets in index order, so the indices themselves are left untouched - run it after
+// OptimizeMesh, whose cache-friendly order already keeps neighbouring triangles together.
+void BuildMeshlets(const Vertex *vertices, uint32_t vertexCount, const unsigned int *indices, const IndexRange *ranges,
+                   uint32_t rangeCount, std::vector<Meshlet>& meshlets, uint32_t maxVertices = MESHLET_MAX_VERTICES,
+                   uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+// frustum and eye have to be in the meshlets' (model) space. drawRanges is overwritten. Returns the number
+// of visible meshlets, stats may be null. Given rangeVisibility (see CullBounds), the meshlets of ranges
+// already culled whole are skipped and counted as frustum culled.
+uint32_t CullMeshlets(const Meshlet *meshlets, uint32_t meshletCount, const Frustum& frustum, const glm::vec3& eye,
+                      std::vector<MeshletDrawRange>& drawRanges, MeshletCullStats *stats,
+                      const uint8_t *rangeVisibility = nullptr);
+
+
+#endif // XOF_MESHLETS_HPP
@@ -0,0 +1,335 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_MipGenerator.cpp
+    Desc    :    CPU mip chain generation for RGBA8 images.
+
+                 The box filter averages 2x2 blocks, four output texels at a time
+                 in 16-bit lanes. The Kaiser filter runs separably through a float
+                 intermediate, one RGBA texel per register, with the taps for each
+                 output row and column worked out once per level.
+
+===============================================================================
+*/
+#include "XOF_MipGenerator.hpp"
+#include "XOF_ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XOF_MIPS_SSE 1
+#include <emmintrin.h>
+#endif
+
+
+static const uint32_t ROWS_PER_RANGE = 32;
+// Filter support either side of an output texel, in output texels
+static const float KAISER_RADIUS = 2.f;
+// Window shape, higher trades sharpness for less ringing
+static const float KAISER_ALPHA = 4.f;
+static const float PI = 3.14159265358979f;
+
+
+// Taps of a separable filter along one axis, tapCount per output texel (zero weight padding where fewer are needed)
+struct FilterAxis {
+    uint32_t                    tapCount;
+    std::vector<uint32_t>       indices;
+    std::vector<float>          weights;
+};
+
+
+template<typename Func>
+static void ForEachRowRange(uint32_t rowCount, ThreadPool *pool, const Func& func) {
+    uint32_t rangeCount = (rowCount + ROWS_PER_RANGE - 1) / ROWS_PER_RANGE;
+    auto runRange = [&](uint32_t range) {
+        func(range * ROWS_PER_RANGE, std::min((range + 1) * ROWS_PER_RANGE, rowCount));
+    };
+
+    if (pool && rangeCount > 1) {
+        pool->ParallelFor(rangeCount, runRange);
+    } else {
+        for (uint32_t range = 0; range < rangeCount; ++range) {
+            runRange(range);
+        }
+    }
+}
+
+uint32_t MipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t levelCount = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+        ++levelCount;
+    }
+    return levelCount;
+}
+
+size_t ComputeMipChainLayout(uint32_t width, uint32_t height, uint32_t levelCount, uint32_t bytesPerPixel,
+                             MipLevelDesc *levels) {
+    size_t offset = 0;
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        if (levels) {
+            levels[level].offset = offset;
+            levels[level].width = width;
+            levels[level].height = height;
+        }
+        offset += static_cast<size_t>(width) * height * bytesPerPixel;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+    return offset;
+}
+
+
+// --- Box
+
+
+// Source span of output texel i - two texels, three for the last one of an odd size, one for a size of one
+static inline void BoxSpan(uint32_t i, uint32_t srcSize, uint32_t dstSize, uint32_t& first, uint32_t& end) {
+    first = std::min(i * 2, srcSize - 1);
+    end = (i + 1 == dstSize) ? srcSize : i * 2 + 2;
+}
+
+// Any span, one output texel at a time
+static void BoxTexel(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight,
+                     uint32_t x, uint32_t y, uint8_t *dst) {
+    uint32_t x0, x1, y0, y1;
+    BoxSpan(x, srcWidth, dstWidth, x0, x1);
+    BoxSpan(y, srcHeight, dstHeight, y0, y1);
+
+    uint32_t sum[4] = { 0, 0, 0, 0 };
+    for (uint32_t sy = y0; sy < y1; ++sy) {
+        const uint8_t *row = src + (static_cast<size_t>(sy) * srcWidth + x0) * 4;
+        for (uint32_t sx = x0; sx < x1; ++sx, row += 4) {
+            sum[0] += row[0];
+            sum[1] += row[1];
+            sum[2] += row[2];
+            sum[3] += row[3];
+        }
+    }
+
+    uint32_t count = (x1 - x0) * (y1 - y0);
+    for (uint32_t c = 0; c < 4; ++c) {
+        dst[c] = static_cast<uint8_t>((sum[c] + count / 2) / count);
+    }
+}
+
+static void DownsampleBoxRows(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint8_t *dst,
+                              uint32_t dstWidth, uint32_t dstHeight, uint32_t rowBegin, uint32_t rowEnd) {
+    // Texels with a plain 2x2 span, an odd size leaves the last row/column to BoxTexel
+    uint32_t fullColumns = std::min(srcWidth / 2, dstWidth - ((srcWidth & 1) ? 1 : 0));
+    uint32_t fullRows = std::min(srcHeight / 2, dstHeight - ((srcHeight & 1) ? 1 : 0));
+
+    for (uint32_t y = rowBegin; y < rowEnd; ++y) {
+        uint8_t *out = dst + static_cast<size_t>(y) * dstWidth * 4;
+        if (y >= fullRows) {
+            for (uint32_t x = 0; x < dstWidth; ++x) {
+                BoxTexel(src, srcWidth, srcHeight, dstWidth, dstHeight, x, y, out + x * 4);
+            }
+            continue;
+        }
+
+        const uint8_t *row0 = src + static_cast<size_t>(y) * 2 * srcWidth * 4;
+        const uint8_t *row1 = row0 + static_cast<size_t>(srcWidth) * 4;
+        uint32_t x = 0;
+
+#ifdef XOF_MIPS_SSE
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i round = _mm_set1_epi16(2);
+
+        // Two source texels per half register -> sum them with the row below, then the neighbours with each other
+        auto sumPairs = [&](const uint8_t *a, const uint8_t *b) {
+            __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+            __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+            __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+            __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+            low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+            high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+            return _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(low, high), round), 2);
+        };
+
+        for (; x + 4 <= fullColumns; x += 4) {
+            __m128i first = sumPairs(row0 + x * 8, row1 + x * 8);
+            __m128i second = sumPairs(row0 + x * 8 + 16, row1 + x * 8 + 16);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(first, second));
+        }
+#endif
+
+        for (; x < fullColumns; ++x) {
+            const uint8_t *a = row0 + x * 8;
+            const uint8_t *b = row1 + x * 8;
+            for (uint32_t c = 0; c < 4; ++c) {
+                out[x * 4 + c] = static_cast<uint8_t>((a[c] + a[c + 4] + b[c] + b[c + 4] + 2) >> 2);
+            }
+        }
+        for (; x < dstWidth; ++x) {
+            BoxTexel(src, srcWidth, srcHeight, dstWidth, dstHeight, x, y, out + x * 4);
+        }
+    }
+}
+
+void DownsampleBox(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint8_t *dst, ThreadPool *pool) {
+    uint32_t dstWidth = std::max(srcWidth / 2, 1u);
+    uint32_t dstHeight = std::max(srcHeight / 2, 1u);
+
+    ForEachRowRange(dstHeight, pool, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        DownsampleBoxRows(src, srcWidth, srcHeight, dst, dstWidth, dstHeight, rowBegin, rowEnd);
+    });
+}
+
+
+// --- Kaiser
+
+
+// Zeroth order modified Bessel function of the first kind, the series converges quickly for the alphas we use
+static double BesselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    double halfXSquared = 0.25 * x * x;
+    for (uint32_t k = 1; k < 32 && term > sum * 1e-12; ++k) {
+        term *= halfXSquared / (static_cast<double>(k) * k);
+        sum += term;
+    }
+    return sum;
+}
+
+// t in output texels from the centre
+static double KaiserSinc(double t) {
+    if (std::fabs(t) >= KAISER_RADIUS) {
+        return 0.0;
+    }
+    double sinc = (t == 0.0) ? 1.0 : std::sin(PI * t) / (PI * t);
+    double ratio = t / KAISER_RADIUS;
+    return sinc * BesselI0(KAISER_ALPHA * std::sqrt(1.0 - ratio * ratio)) / BesselI0(KAISER_ALPHA);
+}
+
+static void BuildFilterAxis(uint32_t srcSize, uint32_t dstSize, FilterAxis& axis) {
+    double scale = static_cast<double>(srcSize) / dstSize;
+    double support = KAISER_RADIUS * scale;
+
+    axis.tapCount = static_cast<uint32_t>(std::ceil(2.0 * support)) + 1;
+    axis.indices.assign(static_cast<size_t>(dstSize) * axis.tapCount, 0);
+    axis.weights.assign(static_cast<size_t>(dstSize) * axis.tapCount, 0.f);
+
+    for (uint32_t i = 0; i < dstSize; ++i) {
+        // Texel centres sit at +0.5, in source texels
+        double centre = (i + 0.5) * scale;
+        int32_t first = static_cast<int32_t>(std::floor(centre - support));
+
+        double weights[64];
+        double total = 0.0;
+        uint32_t tapCount = std::min<uint32_t>(axis.tapCount, 64);
+        for (uint32_t tap = 0; tap < tapCount; ++tap) {
+            weights[tap] = KaiserSinc((first + static_cast<int32_t>(tap) + 0.5 - centre) / scale);
+            total += weights[tap];
+        }
+
+        // Taps off the edge clamp to it, normalised so flat areas stay flat
+        for (uint32_t tap = 0; tap < tapCount; ++tap) {
+            int32_t index = std::min(std::max(first + static_cast<int32_t>(tap), 0), static_cast<int32_t>(srcSize) - 1);
+            axis.indices[i * axis.tapCount + tap] = static_cast<uint32_t>(index);
+            axis.weights[i * axis.tapCount + tap] = static_cast<float>(weights[tap] / total);
+        }
+    }
+}
+
+void DownsampleKaiser(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint8_t *dst, ThreadPool *pool) {
+    uint32_t dstWidth = std::max(srcWidth / 2, 1u);
+    uint32_t dstHeight = std::max(srcHeight / 2, 1u);
+
+    FilterAxis horizontal, vertical;
+    BuildFilterAxis(srcWidth, dstWidth, horizontal);
+    BuildFilterAxis(srcHeight, dstHeight, vertical);
+
+    // Horizontal pass into floats, every source row
+    std::vector<float> intermediate(static_cast<size_t>(srcHeight) * dstWidth * 4);
+    ForEachRowRange(srcHeight, pool, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        for (uint32_t y = rowBegin; y < rowEnd; ++y) {
+            const uint8_t *in = src + static_cast<size_t>(y) * srcWidth * 4;
+            float *out = &intermediate[static_cast<size_t>(y) * dstWidth * 4];
+
+            for (uint32_t x = 0; x < dstWidth; ++x) {
+                const uint32_t *indices = &horizontal.indices[x * horizontal.tapCount];
+                const float *weights = &horizontal.weights[x * horizontal.tapCount];
+#ifdef XOF_MIPS_SSE
+                const __m128i zero = _mm_setzero_si128();
+                __m128 sum = _mm_setzero_ps();
+                for (uint32_t tap = 0; tap < horizontal.tapCount; ++tap) {
+                    int32_t texel;
+                    memcpy(&texel, in + indices[tap] * 4, sizeof(int32_t));
+                    __m128i wide = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(texel), zero), zero);
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_set1_ps(weights[tap])));
+                }
+                _mm_storeu_ps(out + x * 4, sum);
+#else
+                float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+                for (uint32_t tap = 0; tap < horizontal.tapCount; ++tap) {
+                    const uint8_t *texel = in + indices[tap] * 4;
+                    for (uint32_t c = 0; c < 4; ++c) {
+                        sum[c] += texel[c] * weights[tap];
+                    }
+                }
+                memcpy(out + x * 4, sum, sizeof(sum));
+#endif
+            }
+        }
+    });
+
+    // Vertical pass from the floats, rounded and clamped (the negative lobes can over/undershoot)
+    ForEachRowRange(dstHeight, pool, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        for (uint32_t y = rowBegin; y < rowEnd; ++y) {
+            const uint32_t *indices = &vertical.indices[y * vertical.tapCount];
+            const float *weights = &vertical.weights[y * vertical.tapCount];
+            uint8_t *out = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+            for (uint32_t x = 0; x < dstWidth; ++x) {
+#ifdef XOF_MIPS_SSE
+                __m128 sum = _mm_setzero_ps();
+                for (uint32_t tap = 0; tap < vertical.tapCount; ++tap) {
+                    const float *texel = &intermediate[(static_cast<size_t>(indices[tap]) * dstWidth + x) * 4];
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(texel), _mm_set1_ps(weights[tap])));
+                }
+                __m128i packed = _mm_cvtps_epi32(sum);
+                packed = _mm_packs_epi32(packed, packed);
+                packed = _mm_packus_epi16(packed, packed);
+                int32_t texel = _mm_cvtsi128_si32(packed);
+                memcpy(out + x * 4, &texel, sizeof(int32_t));
+#else
+                float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+                for (uint32_t tap = 0; tap < vertical.tapCount; ++tap) {
+                    const float *texel = &intermediate[(static_cast<size_t>(indices[tap]) * dstWidth + x) * 4];
+                    for (uint32_t c = 0; c < 4; ++c) {
+                        sum[c] += texel[c] * weights[tap];
+                    }
+                }
+                for (uint32_t c = 0; c < 4; ++c) {
+                    out[x * 4 + c] = static_cast<uint8_t>(std::min(std::max(std::nearbyint(sum[c]), 0.f), 255.f));
+                }
+#endif
+            }
+        }
+    });
+}
+
+
+// ---
+
+
+void GenerateMipChain(uint8_t *chain, uint32_t width, uint32_t height, uint32_t levelCount, MipFilter filter,
+                      ThreadPool *pool) {
+    std::vector<MipLevelDesc> levels(levelCount);
+    ComputeMipChainLayout(width, height, levelCount, 4, levels.data());
+
+    for (uint32_t level = 1; level < levelCount; ++level) {
+        const MipLevelDesc& source = levels[level - 1];
+        uint8_t *src = chain + source.offset;
+        uint8_t *dst = chain + levels[level].offset;
+
+        if (filter == MIP_FILTER_KAISER) {
+            DownsampleKaiser(src, source.width, source.height, dst, pool);
+        } else {
+            DownsampleBox(src, source.width, source.height, dst, pool);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_MipGenerator.hpp
+    Desc    :    CPU mip chain generation for RGBA8 images - for formats the GPU
+                 can't blit with linear filtering, uploads from a queue that can't
+                 blit at all, and offline baking.
+
+===============================================================================
+*/
+#ifndef XOF_MIP_GENERATOR_HPP
+#define XOF_MIP_GENERATOR_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+class ThreadPool;
+
+
+enum MipFilter {
+    MIP_FILTER_BOX,         // 2x2 average, cheap, slightly blurry
+    MIP_FILTER_KAISER,      // Kaiser windowed sinc, keeps more detail at the cost of some ringing
+};
+
+// Where a level lives in a packed chain, levels are stored back to back from the largest down
+struct MipLevelDesc {
+    size_t                      offset;
+    uint32_t                    width;
+    uint32_t                    height;
+};
+
+
+// Levels in a full chain down to 1x1
+uint32_t MipLevelCount(uint32_t width, uint32_t height);
+
+// Fills levels[0, levelCount) for a packed chain of bytesPerPixel texels, levels may be null.
+// Returns the size of the whole chain.
+size_t ComputeMipChainLayout(uint32_t width, uint32_t height, uint32_t levelCount, uint32_t bytesPerPixel,
+                             MipLevelDesc *levels);
+
+// Halves an RGBA8 image, dst is max(srcWidth / 2, 1) by max(srcHeight / 2, 1). An odd last row or column
+// is folded into its neighbour's average rather than dropped.
+void DownsampleBox(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint8_t *dst, ThreadPool *pool);
+void DownsampleKaiser(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint8_t *dst, ThreadPool *pool);
+
+// chain holds a packed RGBA8 chain (see ComputeMipChainLayout) with level 0 filled in, the rest of the
+// levels are generated from it, each from the one before. Rows are filtered in parallel given a pool.
+// The filters treat the values as linear, right for UNORM data but not quite for sRGB colour.
+void GenerateMipChain(uint8_t *chain, uint32_t width, uint32_t height, uint32_t levelCount, MipFilter filter,
+                      ThreadPool *pool);
+
+
+#endif // XOF_MIP_GENERATOR_HPP
@@ -0,0 +1,562 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_ObjParser.cpp
+    Desc    :    Multithreaded Wavefront OBJ/MTL parser - the file is memory-mapped,
+                 split into chunks at line boundaries and the chunks parsed in parallel.
+
+===============================================================================
+*/
+#include "XOF_ObjParser.hpp"
+#include "XOF_MappedFile.hpp"
+#include "XOF_ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+
+// Chunks smaller than this aren't worth a task of their own
+static const size_t MIN_CHUNK_SIZE = 1024 * 1024;
+// More chunks than threads so a chunk that's heavy on faces doesn't hold everything up
+static const uint32_t CHUNKS_PER_THREAD = 4;
+static const int32_t INHERIT_MATERIAL = -1;
+
+
+// Everything parsed out of one chunk. Negative (relative) OBJ indices can reach back into earlier
+// chunks, so they're stored relative to the chunk's own attribute counts and fixed up on merge.
+struct ObjChunk {
+    const char                * begin;
+    const char                * end;
+
+    std::vector<float>          positions;
+    std::vector<float>          texCoords;
+    std::vector<float>          normals;
+    std::vector<ObjIndex>       indices;
+                                // Corner * 3 + component of every index that is chunk-relative
+    std::vector<uint32_t>       relativeSlots;
+                                // Per triangle, index into materialNames or INHERIT_MATERIAL for faces before
+                                // the chunk's first usemtl (they continue whatever the previous chunk ended on)
+    std::vector<int32_t>        materials;
+    std::vector<std::string>    materialNames;
+                                // Material active at the end of the chunk, carried into the next one
+    int32_t                     finalMaterial;
+    std::vector<std::string>    materialLibraries;
+
+    std::string                 error;
+};
+
+
+// ---
+
+
+static inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static inline bool IsLineEnd(char c) {
+    return c == '\n' || c == '\r';
+}
+
+static inline const char* SkipSpaces(const char *p, const char *end) {
+    while (p < end && IsSpace(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+static inline const char* SkipLine(const char *p, const char *end) {
+    while (p < end && *p != '\n') {
+        ++p;
+    }
+    return (p < end) ? p + 1 : end;
+}
+
+static inline const char* ReadToken(const char *p, const char *end, std::string& token) {
+    p = SkipSpaces(p, end);
+    const char *tokenBegin = p;
+    while (p < end && !IsSpace(*p) && !IsLineEnd(*p)) {
+        ++p;
+    }
+    token.assign(tokenBegin, p);
+    return p;
+}
+
+// Rest of the line with surrounding whitespace trimmed
+static inline std::string ReadRestOfLine(const char *p, const char *end) {
+    p = SkipSpaces(p, end);
+    const char *lineEnd = p;
+    while (lineEnd < end && !IsLineEnd(*lineEnd)) {
+        ++lineEnd;
+    }
+    while (lineEnd > p && IsSpace(*(lineEnd - 1))) {
+        --lineEnd;
+    }
+    return std::string(p, lineEnd);
+}
+
+// Fast decimal float parsing - accumulates up to 19 significant digits as an integer and scales once,
+// an order of magnitude quicker than strtod and within an ulp of it for float output
+static const char* ParseFloat(const char *p, const char *end, float& value) {
+    static const double powersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    p = SkipSpaces(p, end);
+    const char *start = p;
+
+    bool isNegative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        isNegative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int32_t exponent = 0;
+    int32_t significantDigits = 0;
+    bool hasDigits = false;
+
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        hasDigits = true;
+        if (significantDigits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            significantDigits += (mantissa != 0) ? 1 : 0;
+        } else {
+            ++exponent;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+            hasDigits = true;
+            if (significantDigits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                significantDigits += (mantissa != 0) ? 1 : 0;
+                --exponent;
+            }
+        }
+    }
+
+    if (!hasDigits) {
+        // inf/nan and anything else unusual
+        char *strtodEnd;
+        std::string token(start, std::find_if(start, end, [](char c) { return IsSpace(c) || IsLineEnd(c); }));
+        value = strtof(token.c_str(), &strtodEnd);
+        return start + (strtodEnd - token.c_str());
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *exponentStart = p++;
+        bool exponentIsNegative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            exponentIsNegative = (*p == '-');
+            ++p;
+        }
+        if (p < end && *p >= '0' && *p <= '9') {
+            int32_t explicitExponent = 0;
+            for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+                explicitExponent = std::min(explicitExponent * 10 + (*p - '0'), 100000);
+            }
+            exponent += exponentIsNegative ? -explicitExponent : explicitExponent;
+        } else {
+            p = exponentStart;
+        }
+    }
+
+    double result = static_cast<double>(mantissa);
+    if (exponent < 0) {
+        result = (exponent >= -22) ? result / powersOf10[-exponent] : result * std::pow(10.0, exponent);
+    } else if (exponent > 0) {
+        result = (exponent <= 22) ? result * powersOf10[exponent] : result * std::pow(10.0, exponent);
+    }
+
+    value = static_cast<float>(isNegative ? -result : result);
+    return p;
+}
+
+static inline const char* ParseInt(const char *p, const char *end, int32_t& value, bool& isValid) {
+    bool isNegative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        isNegative = (*p == '-');
+        ++p;
+    }
+
+    isValid = (p < end && *p >= '0' && *p <= '9');
+    int64_t result = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        result = std::min<int64_t>(result * 10 + (*p - '0'), INT32_MAX);
+    }
+
+    value = static_cast<int32_t>(isNegative ? -result : result);
+    return p;
+}
+
+// OBJ indices are 1-based, negative ones count back from the most recent attribute
+static inline bool ResolveIndex(int32_t rawIndex, size_t localCount, uint32_t slot, int32_t& index, ObjChunk& chunk) {
+    if (rawIndex > 0) {
+        index = rawIndex - 1;
+        return true;
+    }
+    if (rawIndex < 0) {
+        index = static_cast<int32_t>(localCount) + rawIndex;
+        chunk.relativeSlots.push_back(slot);
+        return true;
+    }
+    return false;
+}
+
+static void ParseChunk(ObjChunk& chunk) {
+    const char *p = chunk.begin;
+    const char *end = chunk.end;
+
+    int32_t currentMaterial = INHERIT_MATERIAL;
+    std::vector<ObjIndex> polygon;
+    std::string token;
+
+    // Rough guess at the attribute split to cut down on reallocation
+    size_t estimatedLines = static_cast<size_t>(end - p) / 32;
+    chunk.positions.reserve(estimatedLines * 3 / 2);
+    chunk.indices.reserve(estimatedLines * 3 / 2);
+
+    while (p < end) {
+        p = SkipSpaces(p, end);
+        if (p >= end) {
+            break;
+        }
+
+        const char *lineStart = p;
+        char c = *p;
+
+        if (c == 'v' && p + 1 < end) {
+            char kind = p[1];
+            if (IsSpace(kind)) {
+                float x, y, z;
+                p = ParseFloat(p + 2, end, x);
+                p = ParseFloat(p, end, y);
+                p = ParseFloat(p, end, z);
+                chunk.positions.push_back(x);
+                chunk.positions.push_back(y);
+                chunk.positions.push_back(z);
+            } else if (kind == 't' && p + 2 < end && IsSpace(p[2])) {
+                float u, v;
+                p = ParseFloat(p + 3, end, u);
+                p = ParseFloat(p, end, v);
+                chunk.texCoords.push_back(u);
+                chunk.texCoords.push_back(v);
+            } else if (kind == 'n' && p + 2 < end && IsSpace(p[2])) {
+                float x, y, z;
+                p = ParseFloat(p + 3, end, x);
+                p = ParseFloat(p, end, y);
+                p = ParseFloat(p, end, z);
+                chunk.normals.push_back(x);
+                chunk.normals.push_back(y);
+                chunk.normals.push_back(z);
+            }
+        } else if (c == 'f' && p + 1 < end && IsSpace(p[1])) {
+            polygon.clear();
+            p += 2;
+
+            size_t positionCount = chunk.positions.size() / 3;
+            size_t texCoordCount = chunk.texCoords.size() / 2;
+            size_t normalCount = chunk.normals.size() / 3;
+
+            for (;;) {
+                p = SkipSpaces(p, end);
+                if (p >= end || IsLineEnd(*p)) {
+                    break;
+                }
+
+                // v, v/vt, v//vn or v/vt/vn - resolved later, the slots depend on the corner's final position
+                int32_t raw[3] = { 0, 0, 0 };
+                bool present[3] = { false, false, false };
+                bool isValid;
+
+                p = ParseInt(p, end, raw[0], isValid);
+                present[0] = isValid;
+                if (p < end && *p == '/') {
+                    ++p;
+                    if (p < end && *p != '/') {
+                        p = ParseInt(p, end, raw[1], present[1]);
+                    }
+                    if (p < end && *p == '/') {
+                        ++p;
+                        p = ParseInt(p, end, raw[2], present[2]);
+                    }
+                }
+
+                if (!present[0]) {
+                    chunk.error = "Malformed face: " + ReadRestOfLine(lineStart, end);
+                    return;
+                }
+
+                ObjIndex corner;
+                corner.position = raw[0];
+                corner.texCoord = present[1] ? raw[1] : 0;
+                corner.normal = present[2] ? raw[2] : 0;
+                polygon.push_back(corner);
+
+                // Skip anything trailing we don't understand in this token
+                while (p < end && !IsSpace(*p) && !IsLineEnd(*p)) {
+                    ++p;
+                }
+            }
+
+            // Fan triangulation
+            for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+                const ObjIndex *triangle[3] = { &polygon[0], &polygon[i], &polygon[i + 1] };
+                for (uint32_t k = 0; k < 3; ++k) {
+                    uint32_t slot = static_cast<uint32_t>(chunk.indices.size()) * 3;
+                    ObjIndex resolved = { -1, -1, -1 };
+
+                    if (!ResolveIndex(triangle[k]->position, positionCount, slot + 0, resolved.position, chunk)) {
+                        chunk.error = "Invalid vertex index: " + ReadRestOfLine(lineStart, end);
+                        return;
+                    }
+                    if (triangle[k]->texCoord != 0) {
+                        ResolveIndex(triangle[k]->texCoord, texCoordCount, slot + 1, resolved.texCoord, chunk);
+                    }
+                    if (triangle[k]->normal != 0) {
+                        ResolveIndex(triangle[k]->normal, normalCount, slot + 2, resolved.normal, chunk);
+                    }
+
+                    chunk.indices.push_back(resolved);
+                }
+                chunk.materials.push_back(currentMaterial);
+            }
+        } else if (c == 'u' && strncmp(p, "usemtl", std::min<size_t>(6, end - p)) == 0 && p + 6 < end && IsSpace(p[6])) {
+            std::string name = ReadRestOfLine(p + 6, end);
+            auto existing = std::find(chunk.materialNames.begin(), chunk.materialNames.end(), name);
+            currentMaterial = static_cast<int32_t>(existing - chunk.materialNames.begin());
+            if (existing == chunk.materialNames.end()) {
+                chunk.materialNames.push_back(name);
+            }
+        } else if (c == 'm' && strncmp(p, "mtllib", std::min<size_t>(6, end - p)) == 0 && p + 6 < end && IsSpace(p[6])) {
+            p += 6;
+            for (;;) {
+                p = ReadToken(p, end, token);
+                if (token.empty()) {
+                    break;
+                }
+                chunk.materialLibraries.push_back(token);
+            }
+        }
+        // Everything else (comments, o, g, s, l, ...) doesn't affect the output
+
+        p = SkipLine(p, end);
+    }
+
+    chunk.finalMaterial = currentMaterial;
+}
+
+static bool ParseMaterialLibrary(const std::string& fileName, std::vector<ObjMaterial>& materials,
+                                 std::unordered_map<std::string, int32_t>& materialLookup) {
+    std::ifstream file(fileName);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line, token;
+    ObjMaterial *material = nullptr;
+
+    // Texture statements can carry options (-bm 1.0 ...), the file name is always the last token
+    auto lastToken = [&token](const std::string& rest) {
+        const char *p = rest.c_str();
+        const char *end = p + rest.size();
+        std::string last;
+        for (;;) {
+            p = ReadToken(p, end, token);
+            if (token.empty()) {
+                break;
+            }
+            last = token;
+        }
+        return last;
+    };
+
+    while (std::getline(file, line)) {
+        // getline leaves the '\r' of CRLF files in place
+        while (!line.empty() && IsLineEnd(line.back())) {
+            line.pop_back();
+        }
+
+        const char *p = line.c_str();
+        const char *end = p + line.size();
+        p = ReadToken(p, end, token);
+
+        if (token == "newmtl") {
+            std::string name = ReadRestOfLine(p, end);
+            materialLookup[name] = static_cast<int32_t>(materials.size());
+            materials.push_back(ObjMaterial());
+            material = &materials.back();
+            material->name = name;
+        } else if (material && token == "map_Kd") {
+            material->diffuseTexName = lastToken(std::string(p, end));
+        } else if (material && token == "norm") {
+            material->normalTexName = lastToken(std::string(p, end));
+        } else if (material && token == "map_Ks") {
+            material->specularTexName = lastToken(std::string(p, end));
+        }
+    }
+
+    return true;
+}
+
+
+// ---
+
+
+bool ParseObj(const char *fileName, const char *materialBasePath, ObjData& data, std::string& error, ThreadPool *pool) {
+    MappedFile file;
+    if (!file.Open(fileName)) {
+        error = std::string("Unable to open ") + fileName;
+        return false;
+    }
+
+    // Split at line boundaries
+    const char *fileBegin = file.GetData();
+    const char *fileEnd = fileBegin + file.GetSize();
+    uint32_t threadCount = pool ? pool->GetThreadCount() : 1;
+    size_t targetChunkSize = std::max(MIN_CHUNK_SIZE, file.GetSize() / (threadCount * CHUNKS_PER_THREAD) + 1);
+
+    std::vector<ObjChunk> chunks;
+    for (const char *p = fileBegin; p < fileEnd;) {
+        const char *chunkEnd = (static_cast<size_t>(fileEnd - p) > targetChunkSize) ? SkipLine(p + targetChunkSize, fileEnd) : fileEnd;
+        chunks.push_back(ObjChunk());
+        chunks.back().begin = p;
+        chunks.back().end = chunkEnd;
+        p = chunkEnd;
+    }
+
+    uint32_t chunkCount = static_cast<uint32_t>(chunks.size());
+    auto parseChunk = [&chunks](uint32_t i) { ParseChunk(chunks[i]); };
+    if (pool) {
+        pool->ParallelFor(chunkCount, parseChunk);
+    } else {
+        for (uint32_t i = 0; i < chunkCount; ++i) {
+            parseChunk(i);
+        }
+    }
+
+    for (const auto& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            error = chunk.error;
+            return false;
+        }
+    }
+
+    // Materials
+    data.materials.clear();
+    std::unordered_map<std::string, int32_t> materialLookup;
+    for (const auto& chunk : chunks) {
+        for (const auto& library : chunk.materialLibraries) {
+            if (!ParseMaterialLibrary(std::string(materialBasePath) + library, data.materials, materialLookup)) {
+                error += "Unable to open material library " + library + "\n";
+            }
+        }
+    }
+
+    // Where each chunk's attributes/corners/triangles land in the merged arrays, plus the material
+    // each chunk starts with (whatever the previous chunk last switched to)
+    struct ChunkOffsets {
+        size_t      positions;
+        size_t      texCoords;
+        size_t      normals;
+        size_t      indices;
+        size_t      triangles;
+        int32_t     initialMaterial;
+    };
+    std::vector<ChunkOffsets> offsets(chunkCount + 1);
+    memset(&offsets[0], 0x00, sizeof(ChunkOffsets));
+    offsets[0].initialMaterial = -1;
+
+    std::vector<std::vector<int32_t>> chunkMaterialIds(chunkCount);
+    for (uint32_t i = 0; i < chunkCount; ++i) {
+        const ObjChunk& chunk = chunks[i];
+        offsets[i + 1].positions = offsets[i].positions + chunk.positions.size();
+        offsets[i + 1].texCoords = offsets[i].texCoords + chunk.texCoords.size();
+        offsets[i + 1].normals = offsets[i].normals + chunk.normals.size();
+        offsets[i + 1].indices = offsets[i].indices + chunk.indices.size();
+        offsets[i + 1].triangles = offsets[i].triangles + chunk.materials.size();
+
+        // Unknown material names map to -1, same as a face with no material
+        chunkMaterialIds[i].resize(chunk.materialNames.size());
+        for (size_t m = 0; m < chunk.materialNames.size(); ++m) {
+            auto material = materialLookup.find(chunk.materialNames[m]);
+            chunkMaterialIds[i][m] = (material != materialLookup.end()) ? material->second : -1;
+        }
+
+        // A chunk that never switches material continues whatever the previous one ended on
+        offsets[i + 1].initialMaterial = (chunk.finalMaterial == INHERIT_MATERIAL) ? offsets[i].initialMaterial
+                                                                                   : chunkMaterialIds[i][chunk.finalMaterial];
+    }
+
+    const ChunkOffsets& totals = offsets[chunkCount];
+    data.positions.resize(totals.positions);
+    data.texCoords.resize(totals.texCoords);
+    data.normals.resize(totals.normals);
+    data.indices.resize(totals.indices);
+    data.materialIds.resize(totals.triangles);
+
+    const int32_t positionCount = static_cast<int32_t>(totals.positions / 3);
+    const int32_t texCoordCount = static_cast<int32_t>(totals.texCoords / 2);
+    const int32_t normalCount = static_cast<int32_t>(totals.normals / 3);
+    std::atomic<bool> hasInvalidIndex(false);
+
+    auto mergeChunk = [&](uint32_t i) {
+        const ObjChunk& chunk = chunks[i];
+        const ChunkOffsets& offset = offsets[i];
+
+        std::copy(chunk.positions.begin(), chunk.positions.end(), data.positions.begin() + offset.positions);
+        std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), data.texCoords.begin() + offset.texCoords);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + offset.normals);
+
+        ObjIndex *indices = data.indices.data() + offset.indices;
+        std::copy(chunk.indices.begin(), chunk.indices.end(), indices);
+
+        // Relative indices were resolved against the chunk's own counts
+        for (uint32_t slot : chunk.relativeSlots) {
+            ObjIndex& corner = indices[slot / 3];
+            switch (slot % 3) {
+                case 0: corner.position += static_cast<int32_t>(offset.positions / 3); break;
+                case 1: corner.texCoord += static_cast<int32_t>(offset.texCoords / 2); break;
+                case 2: corner.normal += static_cast<int32_t>(offset.normals / 3); break;
+            }
+        }
+
+        for (size_t c = 0; c < chunk.indices.size(); ++c) {
+            const ObjIndex& corner = indices[c];
+            if (corner.position < 0 || corner.position >= positionCount ||
+                corner.texCoord < -1 || corner.texCoord >= texCoordCount ||
+                corner.normal < -1 || corner.normal >= normalCount) {
+                hasInvalidIndex = true;
+                break;
+            }
+        }
+
+        int32_t *materialIds = data.materialIds.data() + offset.triangles;
+        for (size_t t = 0; t < chunk.materials.size(); ++t) {
+            int32_t material = chunk.materials[t];
+            materialIds[t] = (material == INHERIT_MATERIAL) ? offset.initialMaterial : chunkMaterialIds[i][material];
+        }
+    };
+
+    if (pool) {
+        pool->ParallelFor(chunkCount, mergeChunk);
+    } else {
+        for (uint32_t i = 0; i < chunkCount; ++i) {
+            mergeChunk(i);
+        }
+    }
+
+    if (hasInvalidIndex) {
+        error += "Face references an attribute that doesn't exist\n";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,54 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_ObjParser.hpp
+    Desc    :    Multithreaded Wavefront OBJ/MTL parser - the file is memory-mapped,
+                 split into chunks at line boundaries and the chunks parsed in parallel.
+
+===============================================================================
+*/
+#ifndef XOF_OBJ_PARSER_HPP
+#define XOF_OBJ_PARSER_HPP
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+class ThreadPool;
+
+
+struct ObjMaterial {
+    std::string                 name;
+    std::string                 diffuseTexName;     // map_Kd
+    std::string                 normalTexName;      // norm
+    std::string                 specularTexName;    // map_Ks
+};
+
+// Zero-based indices into the attribute arrays, -1 when the face didn't specify one
+struct ObjIndex {
+    int32_t                     position;
+    int32_t                     texCoord;
+    int32_t                     normal;
+};
+
+struct ObjData {
+    std::vector<float>          positions;          // xyz
+    std::vector<float>          texCoords;          // uv
+    std::vector<float>          normals;            // xyz
+                                // Faces are fan-triangulated, three corners per triangle in file order
+    std::vector<ObjIndex>       indices;
+                                // Per triangle, index into materials or -1
+    std::vector<int32_t>        materialIds;
+    std::vector<ObjMaterial>    materials;
+};
+
+
+// materialBasePath is prepended to mtllib names. Passing a null pool parses on the calling thread only.
+bool ParseObj(const char *fileName, const char *materialBasePath, ObjData& data, std::string& error, ThreadPool *pool);
+
+
+#endif // XOF_OBJ_PARSER_HPP
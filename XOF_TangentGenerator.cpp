@@ -0,0 +1,209 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_TangentGenerator.cpp
+    Desc    :    Per-vertex tangent frame generation for indexed triangle lists.
+
+                 Runs in two parallel passes with no shared writes - per-triangle
+                 frames are computed four triangles at a time over triangle ranges,
+                 then each vertex gathers the frames of the triangles using it (in
+                 triangle order, so the sums don't depend on the thread count).
+
+===============================================================================
+*/
+#include "XOF_TangentGenerator.hpp"
+#include "XOF_ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XOF_TANGENTS_SSE 1
+#include <emmintrin.h>
+#endif
+
+
+// Multiple of 4 so only the last range has a scalar tail
+static const uint32_t TRIANGLES_PER_RANGE = 16 * 1024;
+static const uint32_t VERTICES_PER_RANGE = 16 * 1024;
+// UV-space triangles with less area than this have no meaningful tangent
+static const float DEGENERATE_UV_EPSILON = 1e-12f;
+static const float DEGENERATE_TANGENT_EPSILON = 1e-12f;
+
+
+// Unnormalised tangent/bitangent per triangle, one array per component
+struct TriangleFrames {
+    std::vector<float>          tx, ty, tz;
+    std::vector<float>          bx, by, bz;
+};
+
+
+template<typename Func>
+static void ForEachRange(uint32_t count, uint32_t rangeSize, ThreadPool *pool, const Func& func) {
+    uint32_t rangeCount = (count + rangeSize - 1) / rangeSize;
+    auto runRange = [&](uint32_t range) {
+        func(range * rangeSize, std::min((range + 1) * rangeSize, count));
+    };
+
+    if (pool) {
+        pool->ParallelFor(rangeCount, runRange);
+    } else {
+        for (uint32_t range = 0; range < rangeCount; ++range) {
+            runRange(range);
+        }
+    }
+}
+
+static void ComputeTriangleFrame(const Vertex *vertices, const unsigned int *triangle, TriangleFrames& frames, uint32_t t) {
+    const Vertex& v0 = vertices[triangle[0]];
+    const Vertex& v1 = vertices[triangle[1]];
+    const Vertex& v2 = vertices[triangle[2]];
+
+    glm::vec3 edge0 = v1.pos - v0.pos;
+    glm::vec3 edge1 = v2.pos - v0.pos;
+
+    float uDelta0 = v1.texCoord.x - v0.texCoord.x;
+    float vDelta0 = v1.texCoord.y - v0.texCoord.y;
+    float uDelta1 = v2.texCoord.x - v0.texCoord.x;
+    float vDelta1 = v2.texCoord.y - v0.texCoord.y;
+
+    float determinant = uDelta0 * vDelta1 - uDelta1 * vDelta0;
+    float f = (std::fabs(determinant) > DEGENERATE_UV_EPSILON) ? 1.f / determinant : 0.f;
+
+    frames.tx[t] = f * (vDelta1 * edge0.x - vDelta0 * edge1.x);
+    frames.ty[t] = f * (vDelta1 * edge0.y - vDelta0 * edge1.y);
+    frames.tz[t] = f * (vDelta1 * edge0.z - vDelta0 * edge1.z);
+    frames.bx[t] = f * (uDelta0 * edge1.x - uDelta1 * edge0.x);
+    frames.by[t] = f * (uDelta0 * edge1.y - uDelta1 * edge0.y);
+    frames.bz[t] = f * (uDelta0 * edge1.z - uDelta1 * edge0.z);
+}
+
+#ifdef XOF_TANGENTS_SSE
+// Same as ComputeTriangleFrame for triangles [t, t + 4), the inputs transposed into one register per component
+static void ComputeTriangleFrames4(const Vertex *vertices, const unsigned int *indices, TriangleFrames& frames, uint32_t t) {
+    alignas(16) float e0[3][4], e1[3][4], du0[4], dv0[4], du1[4], dv1[4];
+
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+        const unsigned int *triangle = &indices[(t + lane) * 3];
+        const Vertex& v0 = vertices[triangle[0]];
+        const Vertex& v1 = vertices[triangle[1]];
+        const Vertex& v2 = vertices[triangle[2]];
+
+        for (uint32_t c = 0; c < 3; ++c) {
+            e0[c][lane] = v1.pos[c] - v0.pos[c];
+            e1[c][lane] = v2.pos[c] - v0.pos[c];
+        }
+        du0[lane] = v1.texCoord.x - v0.texCoord.x;
+        dv0[lane] = v1.texCoord.y - v0.texCoord.y;
+        du1[lane] = v2.texCoord.x - v0.texCoord.x;
+        dv1[lane] = v2.texCoord.y - v0.texCoord.y;
+    }
+
+    __m128 uDelta0 = _mm_load_ps(du0);
+    __m128 vDelta0 = _mm_load_ps(dv0);
+    __m128 uDelta1 = _mm_load_ps(du1);
+    __m128 vDelta1 = _mm_load_ps(dv1);
+
+    __m128 determinant = _mm_sub_ps(_mm_mul_ps(uDelta0, vDelta1), _mm_mul_ps(uDelta1, vDelta0));
+    __m128 absDeterminant = _mm_andnot_ps(_mm_set1_ps(-0.f), determinant);
+    __m128 isValid = _mm_cmpgt_ps(absDeterminant, _mm_set1_ps(DEGENERATE_UV_EPSILON));
+    // Full precision divide, the masked out lanes may well be inf/nan
+    __m128 f = _mm_and_ps(isValid, _mm_div_ps(_mm_set1_ps(1.f), determinant));
+
+    float *tangent[3] = { &frames.tx[t], &frames.ty[t], &frames.tz[t] };
+    float *biTangent[3] = { &frames.bx[t], &frames.by[t], &frames.bz[t] };
+    for (uint32_t c = 0; c < 3; ++c) {
+        __m128 edge0 = _mm_load_ps(e0[c]);
+        __m128 edge1 = _mm_load_ps(e1[c]);
+        _mm_storeu_ps(tangent[c], _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(vDelta1, edge0), _mm_mul_ps(vDelta0, edge1))));
+        _mm_storeu_ps(biTangent[c], _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(uDelta0, edge1), _mm_mul_ps(uDelta1, edge0))));
+    }
+}
+#endif
+
+static glm::vec4 ResolveTangent(glm::vec3 normal, const glm::vec3& tangentSum, const glm::vec3& biTangentSum) {
+    // OBJ normals aren't guaranteed to be unit length
+    float normalLengthSquared = glm::dot(normal, normal);
+    if (normalLengthSquared > 0.f) {
+        normal = normal * (1.f / std::sqrt(normalLengthSquared));
+    }
+
+    // Gram-Schmidt, done once per vertex here rather than per pixel in the fragment shader
+    glm::vec3 tangent = tangentSum - normal * glm::dot(normal, tangentSum);
+    float lengthSquared = glm::dot(tangent, tangent);
+
+    if (!(lengthSquared > DEGENERATE_TANGENT_EPSILON)) {
+        // No usable UVs around this vertex, any tangent in the normal's plane will do
+        glm::vec3 axis = (std::fabs(normal.x) < 0.9f) ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+        tangent = glm::cross(normal, axis);
+        lengthSquared = glm::dot(tangent, tangent);
+        if (!(lengthSquared > DEGENERATE_TANGENT_EPSILON)) {
+            return glm::vec4(1.f, 0.f, 0.f, 1.f);
+        }
+    }
+
+    tangent = tangent * (1.f / std::sqrt(lengthSquared));
+    float handedness = (glm::dot(glm::cross(normal, tangent), biTangentSum) < 0.f) ? -1.f : 1.f;
+    return glm::vec4(tangent, handedness);
+}
+
+
+// ---
+
+
+void GenerateTangents(Vertex *vertices, uint32_t vertexCount, const unsigned int *indices, uint32_t indexCount,
+                      ThreadPool *pool) {
+    const uint32_t triangleCount = indexCount / 3;
+
+    TriangleFrames frames;
+    frames.tx.resize(triangleCount);
+    frames.ty.resize(triangleCount);
+    frames.tz.resize(triangleCount);
+    frames.bx.resize(triangleCount);
+    frames.by.resize(triangleCount);
+    frames.bz.resize(triangleCount);
+
+    ForEachRange(triangleCount, TRIANGLES_PER_RANGE, pool, [&](uint32_t begin, uint32_t end) {
+        uint32_t t = begin;
+#ifdef XOF_TANGENTS_SSE
+        for (; t + 4 <= end; t += 4) {
+            ComputeTriangleFrames4(vertices, indices, frames, t);
+        }
+#endif
+        for (; t < end; ++t) {
+            ComputeTriangleFrame(vertices, &indices[t * 3], frames, t);
+        }
+    });
+
+    // Vertex -> triangle adjacency (CSR), filled in triangle order
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t i = 0; i < triangleCount * 3; ++i) {
+        ++adjacencyOffsets[indices[i] + 1];
+    }
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (uint32_t i = 0; i < triangleCount * 3; ++i) {
+            adjacency[cursor[indices[i]]++] = i / 3;
+        }
+    }
+
+    ForEachRange(vertexCount, VERTICES_PER_RANGE, pool, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t v = begin; v < end; ++v) {
+            glm::vec3 tangentSum(0.f), biTangentSum(0.f);
+            for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; ++a) {
+                uint32_t t = adjacency[a];
+                tangentSum += glm::vec3(frames.tx[t], frames.ty[t], frames.tz[t]);
+                biTangentSum += glm::vec3(frames.bx[t], frames.by[t], frames.bz[t]);
+            }
+            vertices[v].tangent = ResolveTangent(vertices[v].normal, tangentSum, biTangentSum);
+        }
+    });
+}
@@ -0,0 +1,31 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_TangentGenerator.hpp
+    Desc    :    Per-vertex tangent frame generation for indexed triangle lists.
+
+===============================================================================
+*/
+#ifndef XOF_TANGENT_GENERATOR_HPP
+#define XOF_TANGENT_GENERATOR_HPP
+
+
+#include "VertexDesc.hpp"
+#include <cstdint>
+
+
+class ThreadPool;
+
+
+// Fills in Vertex::tangent from the positions, normals and texture coordinates. xyz is the tangent,
+// orthogonalised against the normal, w the handedness (+/-1) - the bitangent is w * cross(normal, tangent).
+// Triangles with degenerate UVs don't contribute, vertices left without a tangent get an arbitrary one
+// perpendicular to the normal. Passing a null pool generates on the calling thread only, the result is
+// the same either way.
+void GenerateTangents(Vertex *vertices, uint32_t vertexCount, const unsigned int *indices, uint32_t indexCount,
+                      ThreadPool *pool);
+
+
+#endif // XOF_TANGENT_GENERATOR_HPP
@@ -5,87 +5,89 @@
     ===
     File    :    XOF_Texture.cpp
     Desc    :    Represents a texture; loaded in using the stb header-based library.
+                 Decoding (XOF_TextureDecoder) and creating the image can be done
+                 separately, to decode many textures in parallel and upload them together.
 
 ===============================================================================
 */
 #include "XOF_Texture.hpp"
+#include "XOF_ThreadPool.hpp"
+#include <algorithm>
 #include <iostream>
 
-//STB_IMAGE_IMPLEMENTATION
-#include <stb/stb_image.h>
-
-
-static void CopyImage(VkImage srcImage, VkImage dstImage, uint32_t width, uint32_t height, VkCommandBuffer commandBuffer);
-
 
 Texture::Texture() { 
     mIsLoaded = false; 
+    mUploadToken = 0;
 }
 
 Texture::Texture(ImageDesc& imageDesc) {
+    mUploadToken = 0;
     mIsLoaded = Create(imageDesc);
 }
 
+Texture::Texture(ImageDesc& imageDesc, const DecodedTexture& decoded) {
+    mUploadToken = 0;
+    mIsLoaded = Create(imageDesc, decoded);
+}
+
 Texture::~Texture() {}
 
 bool Texture::Create(ImageDesc& imageDesc) {
+    PixelBufferPool& buffers = GetSharedPixelBufferPool();
+    DecodedTexture decoded;
+    DecodeTextures(&imageDesc, 1, buffers, &GetSharedThreadPool(), &decoded);
+    mIsLoaded = Create(imageDesc, decoded);
+    buffers.Release(decoded.data);
+
+    return mIsLoaded;
+}
+
+bool Texture::Create(ImageDesc& imageDesc, const DecodedTexture& decoded) {
+    mIsLoaded = false;
+    if (!decoded.isDecoded) {
+        return mIsLoaded;
+    }
+
     mImage.Set(imageDesc.logicalDevice, vkDestroyImage);
     mImageView.Set(imageDesc.logicalDevice, vkDestroyImageView);
-    mImageMemory.Set(imageDesc.logicalDevice, vkFreeMemory);
     mTempSampler.Set(imageDesc.logicalDevice, vkDestroySampler);
 
-    if (CreateTextureImage(imageDesc) && CreateTextureImageView(imageDesc) && CreateTextureSampler(imageDesc)) {
+    // Size, format and level count are filled in per texture, the caller's desc is usually shared between them
+    ImageDesc textureDesc(imageDesc);
+    if (CreateTextureImage(textureDesc, decoded) && CreateTextureImageView(textureDesc) && CreateTextureSampler(textureDesc)) {
         return (mIsLoaded = true);
     }
 
     return mIsLoaded;
 }
 
-bool Texture::CreateTextureImage(ImageDesc& imageDesc) {
-    int textureChannels;
-
-    stbi_uc *texturePixelData = stbi_load(imageDesc.fileName, (int*)&(imageDesc.width), (int*)&(imageDesc.height), &textureChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = imageDesc.width * imageDesc.height * 4;
+bool Texture::CreateTextureImage(ImageDesc& imageDesc, const DecodedTexture& decoded) {
+    imageDesc.width = decoded.width;
+    imageDesc.height = decoded.height;
+    imageDesc.format = decoded.format;
+    imageDesc.mipLevels = decoded.mipLevels;
+    if (decoded.isCompressed) {
+        imageDesc.tiling = VK_IMAGE_TILING_OPTIMAL;
+    }
 
-    if (!texturePixelData) {
+    ImageDesc imageCreateDesc(imageDesc);
+    if (decoded.blitMips) {
+        imageCreateDesc.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    if (!CreateImage(imageCreateDesc)) {
         return false;
-        throw std::runtime_error("Failed to load texture image!");
     }
 
-    // Create the staging texture
-    VulkanDeleter<VkImage> stagingImage;  stagingImage.Set(imageDesc.logicalDevice, vkDestroyImage);
-    VulkanDeleter<VkDeviceMemory> stagingImageMemory{ imageDesc.logicalDevice, vkFreeMemory };
-
-    //createimage()...
-    ImageDesc stagingImageDesc(imageDesc);
-    stagingImageDesc.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-    stagingImageDesc.tiling = VK_IMAGE_TILING_LINEAR;
-    stagingImageDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    CreateImage(stagingImageDesc, stagingImage, stagingImageMemory);
-
-    // Put the texture data into the staging image
-    void *data;
-    vkMapMemory(imageDesc.logicalDevice, stagingImageMemory, 0, imageSize, 0, &data);
-    memcpy(data, texturePixelData, imageSize);
-    vkUnmapMemory(imageDesc.logicalDevice, stagingImageMemory);
-
-    stbi_image_free(texturePixelData);
-
-    // Create the actual texture
-    CreateImage(imageDesc);
-
-    // Copy the staging image to the final texture image
-    TransitionImageLayout(stagingImage, VK_IMAGE_LAYOUT_PREINITIALIZED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, imageDesc.commandBuffer);
-    TransitionImageLayout(mImage, VK_IMAGE_LAYOUT_PREINITIALIZED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageDesc.commandBuffer); // <- TODO: Try VK_IMAGE_LAYOUT_UNDEFINED here
-    // ADDED - Try doing the transitions all at once rather than in individual buffers
-    FlushAndResetCommandBuffer(imageDesc.commandBuffer, imageDesc.queue);
-    // ---
-    CopyImage(stagingImage, mImage, imageDesc.width, imageDesc.height, imageDesc.commandBuffer);
-    //FlushSetupCommandBuffer(); // <- NOTE: SHOULD WE FLUSH AGAIN HERE TO BE SAFE?
-    // So we can sample the texture in a shader
-    TransitionImageLayout(mImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, imageDesc.commandBuffer);
-    // ADDED - Try doing the transitions all at once rather than in individual buffers
-    FlushAndResetCommandBuffer(imageDesc.commandBuffer, imageDesc.queue);
+    // Queue the copy, the pixels are staged straight away so they can be freed once this returns
+    if (decoded.blitMips) {
+        VkDeviceSize levelSize = VkDeviceSize(decoded.width) * decoded.height * 4;
+        mUploadToken = imageDesc.uploadContext->UploadImageAndBlitMips(mImage, decoded.data.data(), levelSize, decoded.width,
+            decoded.height, imageDesc.aspect, decoded.mipLevels);
+    } else {
+        mUploadToken = imageDesc.uploadContext->UploadImage(mImage, decoded.data.data(), decoded.data.size(), decoded.width,
+            decoded.height, imageDesc.aspect, decoded.mipLevels, decoded.levelOffsets.data());
+    }
 
     return true;
 }
@@ -113,7 +115,7 @@ bool Texture::CreateTextureSampler(const ImageDesc& imageDesc) {
     samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerCreateInfo.mipLodBias = 0.f;
     samplerCreateInfo.minLod = 0.f;
-    samplerCreateInfo.maxLod = 0.f;
+    samplerCreateInfo.maxLod = static_cast<float>(std::max(imageDesc.mipLevels, 1u));
 
     if (vkCreateSampler(imageDesc.logicalDevice, &samplerCreateInfo, nullptr, &mTempSampler) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create texture sampler!");
@@ -122,29 +124,3 @@ bool Texture::CreateTextureSampler(const ImageDesc& imageDesc) {
     return true;
 }
 
-
-// ---
-
-
-static void CopyImage(VkImage srcImage, VkImage dstImage, uint32_t width, uint32_t height, VkCommandBuffer commandBuffer) {
-    VkImageSubresourceLayers subResource{};
-    subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    subResource.mipLevel = 0;
-    subResource.baseArrayLayer = 0;
-    subResource.layerCount = 1;
-
-    VkImageCopy imageCopyRegion{};
-    imageCopyRegion.srcSubresource = subResource;
-    imageCopyRegion.dstSubresource = subResource;
-    imageCopyRegion.srcOffset = { 0, 0, 0 };
-    imageCopyRegion.dstOffset = { 0, 0, 0 };
-    imageCopyRegion.extent.width = width;
-    imageCopyRegion.extent.height = height;
-    imageCopyRegion.extent.depth = 1;
-
-    vkCmdCopyImage(commandBuffer,
-                   srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                   dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                   1
-                   &imageCopyRegion);
-}
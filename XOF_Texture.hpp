@@ -5,6 +5,8 @@
     ===
     File    :    XOF_Texture.hpp
     Desc    :    Represents a texture; loaded in using the stb header-based library.
+                 Decoding (XOF_TextureDecoder) and creating the image can be done
+                 separately, to decode many textures in parallel and upload them together.
 
 ===============================================================================
 */
@@ -13,16 +15,26 @@
 
 
 #include "XOF_Image.hpp"
+#include "XOF_TextureDecoder.hpp"
+#include "XOF_UploadContext.hpp"
+#include <memory>
 
 
 class Texture : public Image {
 public:
                                 Texture();
                                 Texture(ImageDesc& imageDesc);
+                                Texture(ImageDesc& imageDesc, const DecodedTexture& decoded);
                                 ~Texture();
 
+                                // Decodes imageDesc.fileName on the calling thread, then creates the texture from it
     bool                        Create(ImageDesc& imageDesc) override;
+                                // Render thread - the upload is queued in the upload context's current batch, decoded
+                                // can go back to its pool once this returns
+    bool                        Create(ImageDesc& imageDesc, const DecodedTexture& decoded);
     inline bool                 IsLoaded() const;
+                                // Must be complete before the texture is first sampled
+    inline UploadToken          GetUploadToken() const;
 
     inline VkSampler            GetSamplerTEMP();
 
@@ -31,8 +43,9 @@ private:
     VulkanDeleter<VkSampler>    mTempSampler;
 
     bool                        mIsLoaded;
+    UploadToken                 mUploadToken;
 
-    bool                        CreateTextureImage(ImageDesc& imageDesc);
+    bool                        CreateTextureImage(ImageDesc& imageDesc, const DecodedTexture& decoded);
     bool                        CreateTextureImageView(const ImageDesc& imageDesc);
     bool                        CreateTextureSampler(const ImageDesc& imageDesc);
 };
@@ -42,9 +55,17 @@ bool Texture::IsLoaded() const {
     return mIsLoaded;
 }
 
+UploadToken Texture::GetUploadToken() const {
+    return mUploadToken;
+}
+
 VkSampler Texture::GetSamplerTEMP() {
     return mTempSampler;
 }
 
 
+// Materials share their textures, through a TextureCache when they come from the same file
+typedef std::shared_ptr<Texture> TextureHandle;
+
+
 #endif // XOF_TEXTURE_HPP
@@ -0,0 +1,172 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_TextureCache.cpp
+    Desc    :    Shares textures between every mesh and material that uses the
+                 same file - each is loaded once and lives for as long as anything
+                 holds a handle to it.
+
+===============================================================================
+*/
+#include "XOF_TextureCache.hpp"
+#include "XOF_TextureDecoder.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+
+std::string GetCanonicalTexturePath(const char *fileName) {
+    std::string path(fileName ? fileName : "");
+    std::replace(path.begin(), path.end(), '\\', '/');
+#ifdef _WIN32
+    std::transform(path.begin(), path.end(), path.begin(), [](char c) {
+        return static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    });
+#endif
+
+    // A leading "/" or drive ("c:/") stays put, ".." can't climb above it
+    size_t rootLength = 0;
+    if (path.size() >= 2 && path[1] == ':') {
+        rootLength = 2;
+    }
+    if (rootLength < path.size() && path[rootLength] == '/') {
+        ++rootLength;
+    }
+    bool hasRoot = (rootLength > 0);
+
+    std::vector<std::string> segments;
+    size_t start = rootLength;
+    while (start <= path.size()) {
+        size_t end = std::min(path.find('/', start), path.size());
+        std::string segment = path.substr(start, end - start);
+        start = end + 1;
+
+        if (segment.empty() || segment == ".") {
+            continue;
+        }
+        if (segment == "..") {
+            if (!segments.empty() && segments.back() != "..") {
+                segments.pop_back();
+                continue;
+            }
+            if (hasRoot) {
+                continue;
+            }
+        }
+        segments.push_back(segment);
+    }
+
+    std::string canonical = path.substr(0, rootLength);
+    for (size_t i = 0; i < segments.size(); ++i) {
+        canonical += (i > 0) ? "/" + segments[i] : segments[i];
+    }
+    return canonical;
+}
+
+
+TextureCache::TextureCache() {
+    ResetStats();
+}
+
+TextureCache::~TextureCache() {}
+
+TextureHandle TextureCache::Acquire(const ImageDesc& desc) {
+    TextureHandle texture;
+    Acquire(&desc, 1, &texture, nullptr);
+    return texture;
+}
+
+void TextureCache::Acquire(const ImageDesc *descs, uint32_t count, TextureHandle *textures, ThreadPool *pool) {
+    // Sort out what's already loaded, and the first desc of each file that isn't
+    std::vector<std::string> keys(count);
+    std::vector<uint32_t> loads;
+    std::unordered_map<std::string, uint32_t> loadIndices;
+    for (uint32_t i = 0; i < count; ++i) {
+        keys[i] = MakeKey(descs[i]);
+        textures[i].reset();
+
+        auto found = mEntries.find(keys[i]);
+        if (found != mEntries.end() && (found->second.isFailed || !found->second.texture.expired())) {
+            continue;
+        }
+        if (loadIndices.insert(std::make_pair(keys[i], static_cast<uint32_t>(loads.size()))).second) {
+            loads.push_back(i);
+        }
+    }
+
+    // Loaded from the canonical path so the texture doesn't depend on which spelling got here first
+    std::vector<std::string> canonicalPaths(loads.size());
+    std::vector<ImageDesc> loadDescs(loads.size());
+    for (size_t i = 0; i < loads.size(); ++i) {
+        canonicalPaths[i] = GetCanonicalTexturePath(descs[loads[i]].fileName);
+        loadDescs[i] = descs[loads[i]];
+        loadDescs[i].fileName = const_cast<char*>(canonicalPaths[i].c_str());
+    }
+
+    // Phase one, decode every new file at once
+    PixelBufferPool& buffers = GetSharedPixelBufferPool();
+    std::vector<DecodedTexture> decoded(loads.size());
+    DecodeTextures(loadDescs.data(), static_cast<uint32_t>(loads.size()), buffers, pool, decoded.data());
+
+    // Phase two, create them in order - each buffer goes back to the pool as soon as it's staged
+    for (size_t i = 0; i < loads.size(); ++i) {
+        TextureHandle texture = std::make_shared<Texture>(loadDescs[i], decoded[i]);
+        buffers.Release(decoded[i].data);
+
+        ++mStats.missCount;
+        Entry& entry = mEntries[keys[loads[i]]];
+        if (texture->IsLoaded()) {
+            entry.texture = texture;
+            entry.memorySize = texture->GetMemorySize();
+            entry.isFailed = false;
+            textures[loads[i]] = texture;
+        } else {
+            ++mStats.failedCount;
+            entry.texture.reset();
+            entry.memorySize = 0;
+            entry.isFailed = true;
+        }
+    }
+
+    // Everything else is a hit, including repeats of the files just loaded
+    for (uint32_t i = 0; i < count; ++i) {
+        if (textures[i]) {
+            continue;
+        }
+        auto found = mEntries.find(keys[i]);
+        if (found->second.isFailed) {
+            continue;
+        }
+        textures[i] = found->second.texture.lock();
+        ++mStats.hitCount;
+        mStats.bytesSaved += found->second.memorySize;
+    }
+}
+
+void TextureCache::Trim() {
+    for (auto it = mEntries.begin(); it != mEntries.end();) {
+        it = it->second.texture.expired() ? mEntries.erase(it) : std::next(it);
+    }
+}
+
+uint32_t TextureCache::GetCount() const {
+    uint32_t count = 0;
+    for (const auto& entry : mEntries) {
+        count += entry.second.texture.expired() ? 0 : 1;
+    }
+    return count;
+}
+
+void TextureCache::ResetStats() {
+    memset(&mStats, 0x00, sizeof(TextureCacheStats));
+}
+
+std::string TextureCache::MakeKey(const ImageDesc& desc) {
+    // The path goes last, it's the only part that could hold a '|'
+    return std::to_string(desc.format) + "|" + std::to_string(desc.usage) + "|" + std::to_string(desc.tiling) + "|" +
+        std::to_string(desc.mipGeneration) + "|" + std::to_string(desc.mipFilter) + "|" + (desc.preferBaked ? "1" : "0") +
+        "|" + GetCanonicalTexturePath(desc.fileName);
+}
@@ -0,0 +1,80 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_TextureCache.hpp
+    Desc    :    Shares textures between every mesh and material that uses the
+                 same file - each is loaded once and lives for as long as anything
+                 holds a handle to it.
+
+===============================================================================
+*/
+#ifndef XOF_TEXTURE_CACHE_HPP
+#define XOF_TEXTURE_CACHE_HPP
+
+
+#include "XOF_Texture.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+
+class ThreadPool;
+
+
+struct TextureCacheStats {
+    uint32_t                    hitCount;       // Acquires handed a texture that was already loaded
+    uint32_t                    missCount;      // Acquires that had to load the file
+    uint32_t                    failedCount;    // Misses whose file didn't load
+    uint64_t                    bytesSaved;     // Image memory the hits would have taken up as copies of their own
+};
+
+
+// Lexically tidied path - separators made forward slashes, "." and "dir/.." segments dropped, lower case on
+// Windows - so different spellings of the same file share one entry. Symlinks aren't resolved.
+std::string GetCanonicalTexturePath(const char *fileName);
+
+
+// Entries are keyed by the canonical path plus what the desc asks for (format, usage, mips, baked), so the
+// same file loaded two ways is two textures. Only holds weak references, textures go when the last handle
+// does. Render thread only, like the texture creation it wraps (the decoding is spread over a pool).
+class TextureCache {
+public:
+                                TextureCache();
+                                ~TextureCache();
+
+                                // Null when the file doesn't load - it isn't tried again until the next Trim()
+    TextureHandle               Acquire(const ImageDesc& desc);
+                                // Same for count descs at once, in two phases - every file that isn't loaded yet is
+                                // decoded in parallel on the pool, then the textures are created and their uploads
+                                // queued one after another, all landing in the upload context's current batch
+    void                        Acquire(const ImageDesc *descs, uint32_t count, TextureHandle *textures, ThreadPool *pool);
+                                // Forgets the textures nobody holds anymore and the files that failed
+    void                        Trim();
+
+                                // Textures still alive
+    uint32_t                    GetCount() const;
+    inline const TextureCacheStats& GetStats() const;
+    void                        ResetStats();
+
+private:
+    struct Entry {
+        std::weak_ptr<Texture>  texture;
+        VkDeviceSize            memorySize;
+        bool                    isFailed;
+    };
+
+    std::unordered_map<std::string, Entry> mEntries;
+    TextureCacheStats           mStats;
+
+    static std::string          MakeKey(const ImageDesc& desc);
+};
+
+
+const TextureCacheStats& TextureCache::GetStats() const {
+    return mStats;
+}
+
+
+#endif // XOF_TEXTURE_CACHE_HPP
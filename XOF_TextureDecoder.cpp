@@ -0,0 +1,307 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_TextureDecoder.cpp
+    Desc    :    CPU side of texture loading - reads/decodes the file and builds
+                 any mips that aren't blitted, into pooled pixel buffers. Safe to run
+                 on any thread, many textures at once, ahead of Texture creating the
+                 images and queueing the uploads.
+
+===============================================================================
+*/
+#include "XOF_TextureDecoder.hpp"
+#include "XOF_MappedFile.hpp"
+#include "XOF_TextureFile.hpp"
+#include "XOF_ThreadPool.hpp"
+#include "XOF_UploadContext.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+
+PixelBufferPool::PixelBufferPool(size_t maxRetainedBytes) : mMaxRetainedBytes(maxRetainedBytes), mRetainedBytes(0) {}
+
+PixelBufferPool::~PixelBufferPool() {}
+
+std::vector<uint8_t> PixelBufferPool::Acquire(size_t size) {
+    std::vector<uint8_t> buffer;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // Best fit, failing that the largest so growing it frees the most for the heap to reuse
+        size_t best = mBuffers.size();
+        for (size_t i = 0; i < mBuffers.size(); ++i) {
+            if (best == mBuffers.size()) {
+                best = i;
+                continue;
+            }
+            size_t capacity = mBuffers[i].capacity();
+            size_t bestCapacity = mBuffers[best].capacity();
+            bool isBetter = (capacity >= size) ? (bestCapacity < size || capacity < bestCapacity) :
+                                                 (bestCapacity < size && capacity > bestCapacity);
+            if (isBetter) {
+                best = i;
+            }
+        }
+
+        if (best != mBuffers.size()) {
+            buffer.swap(mBuffers[best]);
+            mBuffers[best].swap(mBuffers.back());
+            mBuffers.pop_back();
+            mRetainedBytes -= buffer.capacity();
+        }
+    }
+
+    buffer.resize(size);
+    return buffer;
+}
+
+void PixelBufferPool::Release(std::vector<uint8_t>& buffer) {
+    std::vector<uint8_t> released;
+    released.swap(buffer);
+    if (released.capacity() == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mRetainedBytes + released.capacity() <= mMaxRetainedBytes) {
+        mRetainedBytes += released.capacity();
+        mBuffers.push_back(std::move(released));
+    }
+}
+
+void PixelBufferPool::Trim() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBuffers.clear();
+    mRetainedBytes = 0;
+}
+
+size_t PixelBufferPool::GetRetainedBytes() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mRetainedBytes;
+}
+
+PixelBufferPool& GetSharedPixelBufferPool() {
+    static PixelBufferPool pool;
+    return pool;
+}
+
+
+// ---
+
+
+// The pooled buffer the image being decoded on this thread should land in - stb's allocation of the decoded
+// size gets it, everything else stb allocates goes to the heap as usual
+struct StbDecodeTarget {
+    uint8_t                   * data;
+    size_t                      size;           // Of the decoded image, what stb asks for
+    size_t                      capacity;       // Of the buffer, the mips follow the image
+    bool                        isTaken;
+};
+
+static thread_local StbDecodeTarget tDecodeTarget = {};
+
+static void* StbDecodeMalloc(size_t size) {
+    StbDecodeTarget& target = tDecodeTarget;
+    if (target.data && !target.isTaken && size == target.size) {
+        target.isTaken = true;
+        return target.data;
+    }
+    return malloc(size);
+}
+
+static void* StbDecodeRealloc(void *p, size_t size) {
+    StbDecodeTarget& target = tDecodeTarget;
+    if (!p || p != target.data) {
+        return realloc(p, size);
+    }
+
+    if (size <= target.capacity) {
+        return p;
+    }
+    // Outgrew the pooled buffer, stb carries on in heap memory and the image gets copied in after all
+    void *moved = malloc(size);
+    if (moved) {
+        memcpy(moved, p, target.capacity);
+        target.isTaken = false;
+    }
+    return moved;
+}
+
+static void StbDecodeFree(void *p) {
+    StbDecodeTarget& target = tDecodeTarget;
+    if (p && p == target.data) {
+        target.isTaken = false;
+        return;
+    }
+    free(p);
+}
+
+// stb_image is built here and only here, so nothing else can build it with other allocator hooks or without
+// thread-local failure reasons
+#define STBI_MALLOC(size)           StbDecodeMalloc(size)
+#define STBI_REALLOC(p, size)       StbDecodeRealloc(p, size)
+#define STBI_FREE(p)                StbDecodeFree(p)
+#define STBI_THREAD_LOCALS
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+
+// ---
+
+
+// vkCmdBlitImage down the chain needs the format to be a blit source and destination, and linearly filterable
+static bool SupportsLinearBlit(VkPhysicalDevice physicalDevice, VkFormat format, VkImageTiling tiling) {
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+    VkFormatFeatureFlags features = (tiling == VK_IMAGE_TILING_OPTIMAL) ?
+        formatProperties.optimalTilingFeatures : formatProperties.linearTilingFeatures;
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+    return (features & required) == required;
+}
+
+// The baked file is only used while it's at least as new as the image it was made from
+static bool HasBakedTexture(const char *fileName, const std::string& bakedName) {
+    uint64_t sourceSize, bakedSize;
+    int64_t sourceModifiedTime, bakedModifiedTime;
+    if (!GetFileStats(bakedName.c_str(), bakedSize, bakedModifiedTime)) {
+        return false;
+    }
+    return !GetFileStats(fileName, sourceSize, sourceModifiedTime) || bakedModifiedTime >= sourceModifiedTime;
+}
+
+// KTX2/DDS, the mip chain comes from the file
+static bool DecodeTextureFile(const ImageDesc& desc, const char *fileName, PixelBufferPool& buffers, DecodedTexture& decoded) {
+    TextureFile textureFile;
+    textureFile.data = buffers.Acquire(0);
+    if (!LoadTextureFile(fileName, textureFile, decoded.error)) {
+        buffers.Release(textureFile.data);
+        return false;
+    }
+
+    // BC formats need the textureCompressionBC feature
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(desc.physicalDevice, textureFile.format, &formatProperties);
+    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        decoded.error = std::string(fileName) + ": format not supported";
+        buffers.Release(textureFile.data);
+        return false;
+    }
+
+    decoded.data.swap(textureFile.data);
+    decoded.format = textureFile.format;
+    decoded.width = textureFile.width;
+    decoded.height = textureFile.height;
+    decoded.mipLevels = static_cast<uint32_t>(textureFile.levels.size());
+    decoded.levelOffsets.resize(decoded.mipLevels);
+    for (uint32_t level = 0; level < decoded.mipLevels; ++level) {
+        decoded.levelOffsets[level] = textureFile.levels[level].offset;
+    }
+    decoded.blitMips = false;
+    decoded.isCompressed = true;
+
+    return true;
+}
+
+bool DecodeTexture(const ImageDesc& desc, PixelBufferPool& buffers, ThreadPool *pool, DecodedTexture& decoded) {
+    decoded.isDecoded = false;
+    decoded.error.clear();
+
+    if (IsTextureFileName(desc.fileName)) {
+        return (decoded.isDecoded = DecodeTextureFile(desc, desc.fileName, buffers, decoded));
+    }
+
+    // Falls back to decoding the image if the baked file can't be used
+    if (desc.preferBaked) {
+        std::string bakedName = GetBakedTextureName(desc.fileName);
+        if (HasBakedTexture(desc.fileName, bakedName) && DecodeTextureFile(desc, bakedName.c_str(), buffers, decoded)) {
+            return (decoded.isDecoded = true);
+        }
+        decoded.error.clear();
+    }
+
+    // The header first, so the buffer can be sized for the whole mip chain before the image is decoded into it
+    MappedFile file;
+    int width, height, channels;
+    if (!file.Open(desc.fileName)) {
+        decoded.error = std::string(desc.fileName) + ": can't open file";
+        return false;
+    }
+    const stbi_uc *fileData = reinterpret_cast<const stbi_uc*>(file.GetData());
+    int fileSize = static_cast<int>(std::min<size_t>(file.GetSize(), INT_MAX));
+    if (!stbi_info_from_memory(fileData, fileSize, &width, &height, &channels)) {
+        decoded.error = std::string(desc.fileName) + ": " + stbi_failure_reason();
+        return false;
+    }
+
+    decoded.format = desc.format;
+    decoded.width = static_cast<uint32_t>(width);
+    decoded.height = static_cast<uint32_t>(height);
+    decoded.isCompressed = false;
+
+    // Blit the mips on the GPU when we can, the upload queue may well be transfer-only though
+    decoded.mipLevels = (desc.mipGeneration == MIP_GENERATION_NONE) ? 1 : MipLevelCount(decoded.width, decoded.height);
+    decoded.blitMips = (decoded.mipLevels > 1) && (desc.mipGeneration == MIP_GENERATION_AUTO) && desc.uploadContext &&
+        desc.uploadContext->CanBlit() && SupportsLinearBlit(desc.physicalDevice, desc.format, desc.tiling);
+
+    uint32_t levelCount = decoded.blitMips ? 1 : decoded.mipLevels;
+    std::vector<MipLevelDesc> levels(levelCount);
+    decoded.data = buffers.Acquire(ComputeMipChainLayout(decoded.width, decoded.height, levelCount, 4, levels.data()));
+
+    // stb writes straight into level 0 when its allocations come through StbDecodeMalloc, otherwise (or if it
+    // needed the buffer for something else along the way) the image is copied in
+    size_t imageSize = static_cast<size_t>(decoded.width) * decoded.height * 4;
+    tDecodeTarget = { decoded.data.data(), imageSize, decoded.data.size(), false };
+    stbi_uc *pixels = stbi_load_from_memory(fileData, fileSize, &width, &height, &channels, STBI_rgb_alpha);
+    tDecodeTarget = StbDecodeTarget();
+
+    if (!pixels) {
+        decoded.error = std::string(desc.fileName) + ": " + stbi_failure_reason();
+        buffers.Release(decoded.data);
+        return false;
+    }
+    if (pixels != decoded.data.data()) {
+        memcpy(decoded.data.data(), pixels, imageSize);
+        stbi_image_free(pixels);
+    }
+
+    if (levelCount > 1) {
+        GenerateMipChain(decoded.data.data(), decoded.width, decoded.height, levelCount, desc.mipFilter, pool);
+    }
+
+    decoded.levelOffsets.resize(levelCount);
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        decoded.levelOffsets[level] = levels[level].offset;
+    }
+
+    return (decoded.isDecoded = true);
+}
+
+void DecodeTextures(const ImageDesc *descs, uint32_t count, PixelBufferPool& buffers, ThreadPool *pool,
+                    DecodedTexture *decoded) {
+    // One texture per task, the mip filtering inside each is spread over the same pool
+    if (pool && count > 1) {
+        pool->ParallelFor(count, [&](uint32_t i) {
+            DecodeTexture(descs[i], buffers, pool, decoded[i]);
+        });
+    } else {
+        for (uint32_t i = 0; i < count; ++i) {
+            DecodeTexture(descs[i], buffers, pool, decoded[i]);
+        }
+    }
+
+    // Logged once they're all done rather than from the workers, in order
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!decoded[i].isDecoded) {
+            std::cerr << "TEXTURE FAILED TO LOAD: " << decoded[i].error << std::endl;
+        }
+    }
+}
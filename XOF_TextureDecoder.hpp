@@ -0,0 +1,82 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_TextureDecoder.hpp
+    Desc    :    CPU side of texture loading - reads/decodes the file and builds
+                 any mips that aren't blitted, into pooled pixel buffers. Safe to run
+                 on any thread, many textures at once, ahead of Texture creating the
+                 images and queueing the uploads.
+
+===============================================================================
+*/
+#ifndef XOF_TEXTURE_DECODER_HPP
+#define XOF_TEXTURE_DECODER_HPP
+
+
+#include "XOF_Image.hpp"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+class ThreadPool;
+
+
+// Recycles the pixel buffers of decoded textures, a load of many textures reuses the memory of the ones
+// already uploaded instead of going back to the heap for each. Thread safe.
+class PixelBufferPool {
+public:
+                                // Buffers beyond maxRetainedBytes are freed on release rather than kept
+    explicit                    PixelBufferPool(size_t maxRetainedBytes = 256 * 1024 * 1024);
+                                ~PixelBufferPool();
+
+                                // size bytes, contents undefined - the smallest kept buffer that fits, if any does
+    std::vector<uint8_t>        Acquire(size_t size);
+    void                        Release(std::vector<uint8_t>& buffer);
+                                // Frees every kept buffer
+    void                        Trim();
+
+    size_t                      GetRetainedBytes() const;
+
+private:
+    std::vector<std::vector<uint8_t>> mBuffers;
+    size_t                      mMaxRetainedBytes;
+    size_t                      mRetainedBytes;
+    mutable std::mutex          mMutex;
+};
+
+// Shared by every texture load
+PixelBufferPool& GetSharedPixelBufferPool();
+
+
+// Everything Texture::Create needs to make the image and queue its upload
+struct DecodedTexture {
+    std::vector<uint8_t>        data;           // From the PixelBufferPool it was decoded with, give it back once uploaded
+    VkFormat                    format;
+    uint32_t                    width;
+    uint32_t                    height;
+    uint32_t                    mipLevels;      // Of the image
+                                // Where each level in data starts - only level 0 when the rest are to be blitted
+    std::vector<VkDeviceSize>   levelOffsets;
+    bool                        blitMips;
+    bool                        isCompressed;   // Came from a KTX2/DDS file, the image has to be optimally tiled
+    bool                        isDecoded;
+    std::string                 error;          // Why not, when it isn't
+};
+
+
+// Decodes desc.fileName the way Texture::Create would load it - a KTX2/DDS file as is, an image's baked
+// KTX2 when desc.preferBaked allows, otherwise the image itself with its mips per desc.mipGeneration.
+// CPU mips are filtered in parallel given a pool. Returns false with decoded.error set when nothing loads.
+// Nothing is logged, it may be running on a worker.
+bool DecodeTexture(const ImageDesc& desc, PixelBufferPool& buffers, ThreadPool *pool, DecodedTexture& decoded);
+// Decodes count textures, spread over the pool (one after another without one). decoded[i].isDecoded says
+// which made it, the failures are logged once all are done.
+void DecodeTextures(const ImageDesc *descs, uint32_t count, PixelBufferPool& buffers, ThreadPool *pool,
+                    DecodedTexture *decoded);
+
+
+#endif // XOF_TEXTURE_DECODER_HPP
@@ -0,0 +1,429 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_TextureFile.cpp
+    Desc    :    KTX2 and DDS containers for block-compressed mip chains.
+
+                 Both are read through a memory mapping and the levels copied out
+                 largest first, the order the upload wants them in. KTX2 files
+                 store theirs smallest first with a level index in front, DDS
+                 files largest first with nothing but the header to go on.
+
+===============================================================================
+*/
+#include "XOF_TextureFile.hpp"
+#include "XOF_MappedFile.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+
+static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+static const char KTX2_WRITER[] = "XOF TextureEncoder";
+
+static const uint32_t DDS_MAGIC = 0x20534444;               // "DDS "
+static const uint32_t DDS_HEADER_SIZE = 124;
+static const uint32_t DDS_HEADER_DX10_SIZE = 20;
+static const uint32_t DDSD_MIPMAPCOUNT = 0x00020000;
+static const uint32_t DDPF_FOURCC = 0x00000004;
+static const uint32_t DDSCAPS2_CUBEMAP = 0x00000200;
+static const uint32_t DDSCAPS2_VOLUME = 0x00200000;
+
+// Khronos data format descriptor colour models and channels for the basic descriptor block
+static const uint32_t KHR_DF_MODEL_BC1A = 128;
+static const uint32_t KHR_DF_MODEL_BC3 = 130;
+static const uint32_t KHR_DF_MODEL_BC5 = 132;
+static const uint32_t KHR_DF_MODEL_BC7 = 134;
+static const uint32_t KHR_DF_CHANNEL_COLOR = 0;
+static const uint32_t KHR_DF_CHANNEL_GREEN = 1;
+static const uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+static const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+static const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+static const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+
+
+struct Ktx2Header {
+    uint8_t                     identifier[12];
+    uint32_t                    vkFormat;
+    uint32_t                    typeSize;
+    uint32_t                    pixelWidth;
+    uint32_t                    pixelHeight;
+    uint32_t                    pixelDepth;
+    uint32_t                    layerCount;
+    uint32_t                    faceCount;
+    uint32_t                    levelCount;
+    uint32_t                    supercompressionScheme;
+                                // Index
+    uint32_t                    dfdByteOffset;
+    uint32_t                    dfdByteLength;
+    uint32_t                    kvdByteOffset;
+    uint32_t                    kvdByteLength;
+    uint64_t                    sgdByteOffset;
+    uint64_t                    sgdByteLength;
+};
+
+struct Ktx2LevelIndex {
+    uint64_t                    byteOffset;
+    uint64_t                    byteLength;
+    uint64_t                    uncompressedByteLength;
+};
+
+
+template<typename T>
+static T ReadValue(const char *data) {
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+static bool IsSrgbFormat(VkFormat format) {
+    return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+           format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+// Including the dot, empty when there's none
+static std::string GetLowerCaseExtension(const std::string& fileName) {
+    size_t dot = fileName.find_last_of('.');
+    size_t separator = fileName.find_last_of("/\\");
+    if (dot == std::string::npos || (separator != std::string::npos && dot < separator)) {
+        return std::string();
+    }
+
+    std::string extension = fileName.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) {
+        return static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    });
+    return extension;
+}
+
+// Lays out texture.levels for a chain of levelCount levels, returns the total size
+static size_t ComputeLevels(TextureFile& texture, uint32_t levelCount) {
+    uint32_t blockSize = GetTextureFileBlockSize(texture.format);
+    uint32_t width = texture.width;
+    uint32_t height = texture.height;
+    size_t offset = 0;
+
+    texture.levels.resize(levelCount);
+    for (TextureFileLevel& level : texture.levels) {
+        level.offset = offset;
+        level.size = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+        level.width = width;
+        level.height = height;
+        offset += level.size;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+    return offset;
+}
+
+uint32_t GetTextureFileBlockSize(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+bool IsTextureFileName(const std::string& fileName) {
+    std::string extension = GetLowerCaseExtension(fileName);
+    return extension == ".ktx2" || extension == ".dds";
+}
+
+std::string GetBakedTextureName(const std::string& sourceName) {
+    std::string extension = GetLowerCaseExtension(sourceName);
+    return sourceName.substr(0, sourceName.size() - extension.size()) + ".ktx2";
+}
+
+
+// --- KTX2
+
+
+bool LoadKtx2(const char *fileName, TextureFile& texture, std::string& error) {
+    MappedFile file;
+    if (!file.Open(fileName)) {
+        error = std::string("Unable to open ") + fileName;
+        return false;
+    }
+
+    const char *data = file.GetData();
+    size_t size = file.GetSize();
+    if (size < sizeof(Ktx2Header) || memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        error = std::string("Not a KTX2 file: ") + fileName;
+        return false;
+    }
+
+    Ktx2Header header = ReadValue<Ktx2Header>(data);
+    texture.format = static_cast<VkFormat>(header.vkFormat);
+    texture.width = header.pixelWidth;
+    texture.height = std::max(header.pixelHeight, 1u);
+
+    if (GetTextureFileBlockSize(texture.format) == 0) {
+        error = std::string("Unsupported KTX2 format (not BC1/BC3/BC5/BC7): ") + fileName;
+        return false;
+    }
+    if (header.supercompressionScheme != 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 ||
+        texture.width == 0) {
+        error = std::string("Unsupported KTX2 layout (supercompressed, 3D, array or cube): ") + fileName;
+        return false;
+    }
+
+    // A level count of 0 asks the loader to generate mips, which compressed data can't have done to it
+    uint32_t levelCount = std::max(header.levelCount, 1u);
+    size_t levelIndexEnd = sizeof(Ktx2Header) + static_cast<size_t>(levelCount) * sizeof(Ktx2LevelIndex);
+    if (levelCount > 32 || size < levelIndexEnd) {
+        error = std::string("Truncated KTX2 level index: ") + fileName;
+        return false;
+    }
+
+    texture.data.resize(ComputeLevels(texture, levelCount));
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        Ktx2LevelIndex index = ReadValue<Ktx2LevelIndex>(data + sizeof(Ktx2Header) + level * sizeof(Ktx2LevelIndex));
+        const TextureFileLevel& destination = texture.levels[level];
+        if (index.byteLength != destination.size || index.byteOffset > size || index.byteLength > size - index.byteOffset) {
+            error = std::string("Corrupt KTX2 level data: ") + fileName;
+            return false;
+        }
+        memcpy(&texture.data[destination.offset], data + index.byteOffset, destination.size);
+    }
+
+    return true;
+}
+
+bool WriteKtx2(const char *fileName, const TextureFile& texture, std::string& error) {
+    uint32_t blockSize = GetTextureFileBlockSize(texture.format);
+    uint32_t levelCount = static_cast<uint32_t>(texture.levels.size());
+    if (blockSize == 0 || levelCount == 0) {
+        error = "Only BC1/BC3/BC5/BC7 textures with at least one level can be written";
+        return false;
+    }
+
+    // Basic data format descriptor - one sample per 64 bits of block, BC3/BC5 have two
+    uint32_t colourModel = KHR_DF_MODEL_BC7;
+    std::vector<uint32_t> sampleChannels;
+    switch (texture.format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK: case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        colourModel = KHR_DF_MODEL_BC1A;
+        sampleChannels = { KHR_DF_CHANNEL_COLOR };
+        break;
+    case VK_FORMAT_BC3_UNORM_BLOCK: case VK_FORMAT_BC3_SRGB_BLOCK:
+        colourModel = KHR_DF_MODEL_BC3;
+        sampleChannels = { KHR_DF_CHANNEL_ALPHA, KHR_DF_CHANNEL_COLOR };
+        break;
+    case VK_FORMAT_BC5_UNORM_BLOCK: case VK_FORMAT_BC5_SNORM_BLOCK:
+        colourModel = KHR_DF_MODEL_BC5;
+        sampleChannels = { KHR_DF_CHANNEL_COLOR, KHR_DF_CHANNEL_GREEN };
+        break;
+    default:
+        sampleChannels = { KHR_DF_CHANNEL_COLOR };
+        break;
+    }
+
+    uint32_t sampleBits = blockSize * 8 / static_cast<uint32_t>(sampleChannels.size());
+    uint32_t descriptorBlockSize = 24 + 16 * static_cast<uint32_t>(sampleChannels.size());
+    std::vector<uint32_t> dfd;
+    dfd.push_back(4 + descriptorBlockSize);                         // dfdTotalSize
+    dfd.push_back(0);                                               // Khronos vendor, basic descriptor type
+    dfd.push_back(2 | (descriptorBlockSize << 16));                 // Version 2
+    dfd.push_back(colourModel | (KHR_DF_PRIMARIES_BT709 << 8) |
+        ((IsSrgbFormat(texture.format) ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+    dfd.push_back(3 | (3 << 8));                                    // 4x4x1x1 texel blocks, stored minus one
+    dfd.push_back(blockSize);                                       // bytesPlane0
+    dfd.push_back(0);
+    for (uint32_t s = 0; s < sampleChannels.size(); ++s) {
+        uint32_t channelType = sampleChannels[s] | ((texture.format == VK_FORMAT_BC5_SNORM_BLOCK) ? 0x40 : 0);
+        dfd.push_back((s * sampleBits) | ((sampleBits - 1) << 16) | (channelType << 24));
+        dfd.push_back(0);                                           // Sample position
+        dfd.push_back((texture.format == VK_FORMAT_BC5_SNORM_BLOCK) ? 0x80000000 : 0);
+        dfd.push_back((texture.format == VK_FORMAT_BC5_SNORM_BLOCK) ? 0x7FFFFFFF : 0xFFFFFFFF);
+    }
+
+    // Key/value data, just the writer
+    std::vector<uint8_t> kvd;
+    uint32_t keyValueLength = static_cast<uint32_t>(sizeof("KTXwriter") + sizeof(KTX2_WRITER));
+    kvd.resize(sizeof(uint32_t));
+    memcpy(kvd.data(), &keyValueLength, sizeof(uint32_t));
+    kvd.insert(kvd.end(), "KTXwriter", "KTXwriter" + sizeof("KTXwriter"));
+    kvd.insert(kvd.end(), KTX2_WRITER, KTX2_WRITER + sizeof(KTX2_WRITER));
+    kvd.resize((kvd.size() + 3) / 4 * 4, 0);
+
+    Ktx2Header header = {};
+    memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = static_cast<uint32_t>(texture.format);
+    header.typeSize = 1;
+    header.pixelWidth = texture.width;
+    header.pixelHeight = texture.height;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+    header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex));
+    header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+    // Levels go in smallest first, each aligned to the block size (a multiple of 4 as required)
+    std::vector<Ktx2LevelIndex> levelIndex(levelCount);
+    uint64_t offset = header.kvdByteOffset + header.kvdByteLength;
+    for (uint32_t level = levelCount; level-- > 0;) {
+        offset = (offset + blockSize - 1) / blockSize * blockSize;
+        levelIndex[level].byteOffset = offset;
+        levelIndex[level].byteLength = texture.levels[level].size;
+        levelIndex[level].uncompressedByteLength = texture.levels[level].size;
+        offset += texture.levels[level].size;
+    }
+
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        error = std::string("Unable to open ") + fileName + " for writing";
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Ktx2Header));
+    file.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(Ktx2LevelIndex));
+    file.write(reinterpret_cast<const char*>(dfd.data()), dfd.size() * sizeof(uint32_t));
+    file.write(reinterpret_cast<const char*>(kvd.data()), kvd.size());
+
+    uint64_t position = header.kvdByteOffset + header.kvdByteLength;
+    const char zeroes[16] = {};
+    for (uint32_t level = levelCount; level-- > 0;) {
+        file.write(zeroes, levelIndex[level].byteOffset - position);
+        file.write(reinterpret_cast<const char*>(&texture.data[texture.levels[level].offset]), texture.levels[level].size);
+        position = levelIndex[level].byteOffset + levelIndex[level].byteLength;
+    }
+
+    if (!file) {
+        error = std::string("Failed writing ") + fileName;
+        return false;
+    }
+    return true;
+}
+
+
+// --- DDS
+
+
+static VkFormat DxgiToVkFormat(uint32_t dxgiFormat) {
+    switch (dxgiFormat) {
+    case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;     // DXGI_FORMAT_BC1_UNORM
+    case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;      // DXGI_FORMAT_BC1_UNORM_SRGB
+    case 77: return VK_FORMAT_BC3_UNORM_BLOCK;          // DXGI_FORMAT_BC3_UNORM
+    case 78: return VK_FORMAT_BC3_SRGB_BLOCK;           // DXGI_FORMAT_BC3_UNORM_SRGB
+    case 83: return VK_FORMAT_BC5_UNORM_BLOCK;          // DXGI_FORMAT_BC5_UNORM
+    case 84: return VK_FORMAT_BC5_SNORM_BLOCK;          // DXGI_FORMAT_BC5_SNORM
+    case 98: return VK_FORMAT_BC7_UNORM_BLOCK;          // DXGI_FORMAT_BC7_UNORM
+    case 99: return VK_FORMAT_BC7_SRGB_BLOCK;           // DXGI_FORMAT_BC7_UNORM_SRGB
+    default: return VK_FORMAT_UNDEFINED;
+    }
+}
+
+static VkFormat FourCCToVkFormat(uint32_t fourCC) {
+    char code[5] = {};
+    memcpy(code, &fourCC, sizeof(uint32_t));
+    if (strcmp(code, "DXT1") == 0) {
+        return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    }
+    if (strcmp(code, "DXT5") == 0) {
+        return VK_FORMAT_BC3_UNORM_BLOCK;
+    }
+    if (strcmp(code, "ATI2") == 0 || strcmp(code, "BC5U") == 0) {
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    }
+    if (strcmp(code, "BC5S") == 0) {
+        return VK_FORMAT_BC5_SNORM_BLOCK;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+bool LoadDds(const char *fileName, TextureFile& texture, std::string& error) {
+    MappedFile file;
+    if (!file.Open(fileName)) {
+        error = std::string("Unable to open ") + fileName;
+        return false;
+    }
+
+    const char *data = file.GetData();
+    size_t size = file.GetSize();
+    if (size < 4 + DDS_HEADER_SIZE || ReadValue<uint32_t>(data) != DDS_MAGIC || ReadValue<uint32_t>(data + 4) != DDS_HEADER_SIZE) {
+        error = std::string("Not a DDS file: ") + fileName;
+        return false;
+    }
+
+    // DDS_HEADER fields, offsets from the start of the file
+    uint32_t flags = ReadValue<uint32_t>(data + 8);
+    texture.height = std::max(ReadValue<uint32_t>(data + 12), 1u);
+    texture.width = ReadValue<uint32_t>(data + 16);
+    uint32_t mipMapCount = ReadValue<uint32_t>(data + 28);
+    uint32_t pixelFormatFlags = ReadValue<uint32_t>(data + 80);
+    uint32_t fourCC = ReadValue<uint32_t>(data + 84);
+    uint32_t caps2 = ReadValue<uint32_t>(data + 112);
+
+    size_t dataOffset = 4 + DDS_HEADER_SIZE;
+    texture.format = VK_FORMAT_UNDEFINED;
+    if (pixelFormatFlags & DDPF_FOURCC) {
+        if (memcmp(&fourCC, "DX10", 4) == 0) {
+            if (size < dataOffset + DDS_HEADER_DX10_SIZE) {
+                error = std::string("Truncated DDS header: ") + fileName;
+                return false;
+            }
+            texture.format = DxgiToVkFormat(ReadValue<uint32_t>(data + dataOffset));
+            uint32_t arraySize = ReadValue<uint32_t>(data + dataOffset + 12);
+            if (arraySize > 1) {
+                error = std::string("DDS texture arrays aren't supported: ") + fileName;
+                return false;
+            }
+            dataOffset += DDS_HEADER_DX10_SIZE;
+        } else {
+            texture.format = FourCCToVkFormat(fourCC);
+        }
+    }
+
+    if (GetTextureFileBlockSize(texture.format) == 0) {
+        error = std::string("Unsupported DDS format (not BC1/BC3/BC5/BC7): ") + fileName;
+        return false;
+    }
+    if ((caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) || texture.width == 0) {
+        error = std::string("Unsupported DDS layout (cube or volume): ") + fileName;
+        return false;
+    }
+
+    uint32_t levelCount = (flags & DDSD_MIPMAPCOUNT) ? std::min(std::max(mipMapCount, 1u), 32u) : 1;
+    size_t dataSize = ComputeLevels(texture, levelCount);
+    if (size - dataOffset < dataSize) {
+        error = std::string("Truncated DDS level data: ") + fileName;
+        return false;
+    }
+
+    texture.data.assign(data + dataOffset, data + dataOffset + dataSize);
+    return true;
+}
+
+
+// ---
+
+
+bool LoadTextureFile(const char *fileName, TextureFile& texture, std::string& error) {
+    std::string extension = GetLowerCaseExtension(fileName);
+
+    if (extension == ".ktx2") {
+        return LoadKtx2(fileName, texture, error);
+    }
+    if (extension == ".dds") {
+        return LoadDds(fileName, texture, error);
+    }
+
+    error = std::string("Unknown texture container: ") + fileName;
+    return false;
+}
@@ -0,0 +1,57 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_TextureFile.hpp
+    Desc    :    KTX2 and DDS containers for block-compressed (BC1/BC3/BC5/BC7)
+                 mip chains - read by Texture, KTX2 written by Tools/TextureEncoder.cpp.
+
+===============================================================================
+*/
+#ifndef XOF_TEXTURE_FILE_HPP
+#define XOF_TEXTURE_FILE_HPP
+
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+struct TextureFileLevel {
+    size_t                      offset;         // Into TextureFile::data
+    size_t                      size;
+    uint32_t                    width;
+    uint32_t                    height;
+};
+
+// A 2D texture's levels, largest first and packed back to back in data
+struct TextureFile {
+    VkFormat                    format;
+    uint32_t                    width;
+    uint32_t                    height;
+    std::vector<TextureFileLevel> levels;
+    std::vector<uint8_t>        data;
+};
+
+
+// Bytes per 4x4 block of the BC formats we handle, 0 for anything else
+uint32_t GetTextureFileBlockSize(VkFormat format);
+
+// True for the extensions LoadTextureFile understands (.ktx2, .dds)
+bool IsTextureFileName(const std::string& fileName);
+// Where the encoder writes the compressed version of a source image - same name, .ktx2 extension
+std::string GetBakedTextureName(const std::string& sourceName);
+
+// Only uncompressed (no supercompression), single layer/face 2D textures in one of the BC formats are accepted
+bool LoadKtx2(const char *fileName, TextureFile& texture, std::string& error);
+bool LoadDds(const char *fileName, TextureFile& texture, std::string& error);
+// Picks the loader by extension
+bool LoadTextureFile(const char *fileName, TextureFile& texture, std::string& error);
+
+bool WriteKtx2(const char *fileName, const TextureFile& texture, std::string& error);
+
+
+#endif // XOF_TEXTURE_FILE_HPP
@@ -0,0 +1,147 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_TextureTable.cpp
+    Desc    :    Global bindless texture table - one descriptor set holding every
+                 registered texture, which shaders pick by integer index.
+
+===============================================================================
+*/
+#include "XOF_TextureTable.hpp"
+#include <stdexcept>
+
+
+TextureTable::TextureTable() {
+    mDescriptorSet = VK_NULL_HANDLE;
+    mNextIndex = 0;
+    mCount = 0;
+    mIsCreated = false;
+}
+
+TextureTable::~TextureTable() {
+    Destroy();
+}
+
+bool TextureTable::Create(const TextureTableDesc& desc) {
+    Destroy();
+
+    mDesc = desc;
+    if (mDesc.capacity == 0) {
+        return false;
+    }
+
+    // A single array binding, partially bound as most of it is empty and updatable while frames using it are in flight
+    VkDescriptorSetLayoutBinding textureBinding = {};
+    textureBinding.binding = 0;
+    textureBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    textureBinding.descriptorCount = mDesc.capacity;
+    textureBinding.stageFlags = mDesc.stageFlags;
+    textureBinding.pImmutableSamplers = nullptr;
+
+    VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsCreateInfo = {};
+    bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsCreateInfo.bindingCount = 1;
+    bindingFlagsCreateInfo.pBindingFlags = &bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+    layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+    layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    layoutCreateInfo.bindingCount = 1;
+    layoutCreateInfo.pBindings = &textureBinding;
+
+    mLayout.Set(mDesc.logicalDevice, vkDestroyDescriptorSetLayout);
+    if (vkCreateDescriptorSetLayout(mDesc.logicalDevice, &layoutCreateInfo, nullptr, &mLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create texture table descriptor set layout!");
+        return false;
+    }
+
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, mDesc.capacity };
+    VkDescriptorPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    poolCreateInfo.poolSizeCount = 1;
+    poolCreateInfo.pPoolSizes = &poolSize;
+    poolCreateInfo.maxSets = 1;
+
+    mPool.Set(mDesc.logicalDevice, vkDestroyDescriptorPool);
+    if (vkCreateDescriptorPool(mDesc.logicalDevice, &poolCreateInfo, nullptr, &mPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create texture table descriptor pool!");
+        return false;
+    }
+
+    VkDescriptorSetLayout layout = mLayout;
+    VkDescriptorSetAllocateInfo setAllocateInfo = {};
+    setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setAllocateInfo.descriptorPool = mPool;
+    setAllocateInfo.descriptorSetCount = 1;
+    setAllocateInfo.pSetLayouts = &layout;
+
+    if (vkAllocateDescriptorSets(mDesc.logicalDevice, &setAllocateInfo, &mDescriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate texture table descriptor set!");
+        return false;
+    }
+
+    return (mIsCreated = true);
+}
+
+void TextureTable::Destroy() {
+    if (!mIsCreated) {
+        return;
+    }
+
+    // The pool (and the set with it) and the layout are released on destruction or the next Create()
+    mDescriptorSet = VK_NULL_HANDLE;
+    mFreeIndices.clear();
+    mIsRegistered.clear();
+    mNextIndex = 0;
+    mCount = 0;
+    mIsCreated = false;
+}
+
+int32_t TextureTable::Register(VkImageView imageView, VkSampler sampler) {
+    int32_t index;
+    if (!mFreeIndices.empty()) {
+        index = mFreeIndices.back();
+        mFreeIndices.pop_back();
+    } else if (mNextIndex < mDesc.capacity) {
+        index = static_cast<int32_t>(mNextIndex++);
+        mIsRegistered.push_back(false);
+    } else {
+        return INVALID_TEXTURE_INDEX;
+    }
+
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = imageView;
+    imageInfo.sampler = sampler;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = mDescriptorSet;
+    write.dstBinding = 0;
+    write.dstArrayElement = static_cast<uint32_t>(index);
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(mDesc.logicalDevice, 1, &write, 0, nullptr);
+
+    mIsRegistered[index] = true;
+    ++mCount;
+    return index;
+}
+
+void TextureTable::Release(int32_t index) {
+    // A second release would hand the slot out twice
+    if (index < 0 || static_cast<uint32_t>(index) >= mNextIndex || !mIsRegistered[index]) {
+        return;
+    }
+    // Left as it is, nothing samples the slot until it's registered again
+    mIsRegistered[index] = false;
+    mFreeIndices.push_back(index);
+    --mCount;
+}
@@ -0,0 +1,90 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_TextureTable.hpp
+    Desc    :    Global bindless texture table - one descriptor set holding every
+                 registered texture, which shaders pick by integer index.
+
+===============================================================================
+*/
+#ifndef XOF_TEXTURE_TABLE_HPP
+#define XOF_TEXTURE_TABLE_HPP
+
+
+#include "VulkanHelpers.hpp"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+
+// Returned when the table is full, and what a draw's data holds for a texture it doesn't have
+static const int32_t INVALID_TEXTURE_INDEX = -1;
+
+
+struct TextureTableDesc {
+                            TextureTableDesc() { memset(this, 0x00, sizeof(TextureTableDesc)); }
+
+    VkDevice                logicalDevice;
+                            // Size of the descriptor array, must be within the device's update-after-bind sampler limits
+    uint32_t                capacity;
+                            // Stages the table is visible to
+    VkShaderStageFlags      stageFlags;
+};
+
+
+// Needs VK_EXT_descriptor_indexing with runtimeDescriptorArray, descriptorBindingPartiallyBound and
+// descriptorBindingSampledImageUpdateAfterBind enabled. Slots that were never written (or were released) are
+// never sampled, so don't have to be valid, and registering a texture never disturbs frames in flight.
+class TextureTable {
+public:
+                                    TextureTable();
+                                    ~TextureTable();
+
+    bool                            Create(const TextureTableDesc& desc);
+                                    // Forgets every registered texture, the GPU must be done with every frame that bound the table
+    void                            Destroy();
+
+                                    // The image must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL when sampled.
+                                    // INVALID_TEXTURE_INDEX when the table is full.
+    int32_t                         Register(VkImageView imageView, VkSampler sampler);
+                                    // The GPU must be done with the draws that sample it, the index may be handed out again.
+                                    // Releasing an index that isn't registered does nothing.
+    void                            Release(int32_t index);
+
+    inline uint32_t                 GetCount() const;
+    inline VkDescriptorSetLayout    GetLayout() const;
+                                    // Bound once, stays valid as textures come and go
+    inline VkDescriptorSet          GetDescriptorSet() const;
+
+private:
+    TextureTableDesc                mDesc;
+
+    VulkanDeleter<VkDescriptorSetLayout>    mLayout;
+    VulkanDeleter<VkDescriptorPool>         mPool;
+    VkDescriptorSet                 mDescriptorSet;
+
+    std::vector<int32_t>            mFreeIndices;
+    std::vector<bool>               mIsRegistered;  // Per index handed out so far
+    uint32_t                        mNextIndex;
+    uint32_t                        mCount;
+
+    bool                            mIsCreated;
+};
+
+
+inline uint32_t TextureTable::GetCount() const {
+    return mCount;
+}
+
+inline VkDescriptorSetLayout TextureTable::GetLayout() const {
+    return mLayout;
+}
+
+inline VkDescriptorSet TextureTable::GetDescriptorSet() const {
+    return mDescriptorSet;
+}
+
+
+#endif // XOF_TEXTURE_TABLE_HPP
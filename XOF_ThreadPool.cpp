@@ -0,0 +1,146 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_ThreadPool.cpp
+    Desc    :    Fixed-size worker pool for CPU-side asset processing (parsing,
+                 mesh processing, decoding).
+
+===============================================================================
+*/
+#include "XOF_ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+
+ThreadPool::ThreadPool() : mIsStopping(false) {}
+
+ThreadPool::~ThreadPool() {
+    Destroy();
+}
+
+bool ThreadPool::Create(uint32_t workerCount) {
+    Destroy();
+
+    if (workerCount == 0) {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = (hardwareThreads > 1) ? hardwareThreads - 1 : 1;
+    }
+
+    mIsStopping = false;
+    for (uint32_t i = 0; i < workerCount; ++i) {
+        mWorkers.push_back(std::thread(&ThreadPool::WorkerMain, this));
+    }
+
+    return true;
+}
+
+void ThreadPool::Destroy() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mIsStopping = true;
+    }
+    mTaskAvailable.notify_all();
+
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+    mWorkers.clear();
+    mTasks.clear();
+}
+
+std::future<void> ThreadPool::Submit(std::function<void()> task) {
+    auto packagedTask = std::make_shared<std::packaged_task<void()>>(std::move(task));
+    std::future<void> future = packagedTask->get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push_back([packagedTask]() { (*packagedTask)(); });
+    }
+    mTaskAvailable.notify_one();
+
+    return future;
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func) {
+    if (count == 0) {
+        return;
+    }
+    if (count == 1 || mWorkers.empty()) {
+        for (uint32_t i = 0; i < count; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    // Shared with the helpers - a helper can be picked up after the loop has already returned (all the work
+    // having been claimed by others) and must still find valid state
+    struct LoopState {
+        std::atomic<uint32_t>           next;
+        std::atomic<uint32_t>           finished;
+        std::mutex                      mutex;
+        std::condition_variable         done;
+        std::function<void(uint32_t)>   func;
+        uint32_t                        count;
+    };
+    auto state = std::make_shared<LoopState>();
+    state->next = 0;
+    state->finished = 0;
+    state->func = func;
+    state->count = count;
+
+    auto runLoop = [](LoopState& loop) {
+        uint32_t index;
+        while ((index = loop.next.fetch_add(1)) < loop.count) {
+            loop.func(index);
+            if (loop.finished.fetch_add(1) + 1 == loop.count) {
+                std::lock_guard<std::mutex> lock(loop.mutex);
+                loop.done.notify_all();
+            }
+        }
+    };
+
+    uint32_t helperCount = std::min(static_cast<uint32_t>(mWorkers.size()), count - 1);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (uint32_t i = 0; i < helperCount; ++i) {
+            mTasks.push_back([state, runLoop]() { runLoop(*state); });
+        }
+    }
+    mTaskAvailable.notify_all();
+
+    runLoop(*state);
+
+    // Only wait on iterations that are actually running, not on helpers that haven't started
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state]() { return state->finished.load() == state->count; });
+}
+
+void ThreadPool::WorkerMain() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mTaskAvailable.wait(lock, [this]() { return mIsStopping || !mTasks.empty(); });
+            if (mIsStopping && mTasks.empty()) {
+                return;
+            }
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        task();
+    }
+}
+
+
+// ---
+
+
+ThreadPool& GetSharedThreadPool() {
+    static ThreadPool pool;
+    static std::once_flag created;
+    std::call_once(created, []() { pool.Create(0); });
+    return pool;
+}
@@ -0,0 +1,66 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_ThreadPool.hpp
+    Desc    :    Fixed-size worker pool for CPU-side asset processing (parsing,
+                 mesh processing, decoding).
+
+===============================================================================
+*/
+#ifndef XOF_THREAD_POOL_HPP
+#define XOF_THREAD_POOL_HPP
+
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class ThreadPool {
+public:
+                                        ThreadPool();
+                                        ~ThreadPool();
+
+                                        // 0 sizes the pool to the hardware, leaving one core for the calling thread
+    bool                                Create(uint32_t workerCount);
+    void                                Destroy();
+
+    std::future<void>                   Submit(std::function<void()> task);
+
+                                        // Runs func(i) for every i in [0, count) and returns once they've all finished.
+                                        // The calling thread takes part, so this is safe to call from a pool task.
+    void                                ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func);
+
+                                        // Workers plus the calling thread
+    inline uint32_t                     GetThreadCount() const;
+
+private:
+    std::vector<std::thread>            mWorkers;
+    std::deque<std::function<void()>>   mTasks;
+    std::mutex                          mMutex;
+    std::condition_variable             mTaskAvailable;
+    bool                                mIsStopping;
+
+    void                                WorkerMain();
+};
+
+
+inline uint32_t ThreadPool::GetThreadCount() const {
+    return static_cast<uint32_t>(mWorkers.size()) + 1;
+}
+
+
+// ---
+
+
+// Lazily created pool shared by the asset loaders
+ThreadPool& GetSharedThreadPool();
+
+
+#endif // XOF_THREAD_POOL_HPP
@@ -0,0 +1,565 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_UploadContext.cpp
+    Desc    :    Batches buffer/image uploads through a shared staging ring and submits
+                 them together, handing back tokens to wait on before first use.
+
+===============================================================================
+*/
+#include "XOF_UploadContext.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+
+static const VkDeviceSize DEFAULT_STAGING_SIZE = 32 * 1024 * 1024;
+
+
+UploadContext::UploadContext() {
+    mIsCreated = false;
+}
+
+UploadContext::~UploadContext() {
+    Destroy();
+}
+
+bool UploadContext::Create(const UploadContextDesc& desc) {
+    Destroy();
+    mDesc = desc;
+
+    // Short-lived command buffers that are re-recorded for every batch
+    mCommandPool.Set(mDesc.logicalDevice, vkDestroyCommandPool);
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCreateInfo.queueFamilyIndex = mDesc.queueFamilyIndex;
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if (vkCreateCommandPool(mDesc.logicalDevice, &commandPoolCreateInfo, nullptr, &mCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create upload command pool!");
+        return false;
+    }
+
+    VkCommandBuffer commandBuffers[BATCH_COUNT];
+
+    VkCommandBufferAllocateInfo cbAllocateInfo = {};
+    cbAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cbAllocateInfo.commandPool = mCommandPool;
+    cbAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cbAllocateInfo.commandBufferCount = BATCH_COUNT;
+
+    if (vkAllocateCommandBuffers(mDesc.logicalDevice, &cbAllocateInfo, commandBuffers) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate upload command buffers!");
+        return false;
+    }
+
+    VkFenceCreateInfo fenceCreateInfo = {};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    for (uint32_t i = 0; i < BATCH_COUNT; ++i) {
+        Batch& batch = mBatches[i];
+        batch.commandBuffer = commandBuffers[i];
+        batch.fence.Set(mDesc.logicalDevice, vkDestroyFence);
+        if (vkCreateFence(mDesc.logicalDevice, &fenceCreateInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create upload fence!");
+            return false;
+        }
+        batch.token = 0;
+        batch.ringBytes = 0;
+        batch.isRecording = false;
+        batch.isInFlight = false;
+        batch.hasCommands = false;
+    }
+
+    mCurrentBatch = 0;
+    mNextToken = 1;
+    mTransfersOwnership = (mDesc.queueFamilyIndex != mDesc.ownerQueueFamilyIndex);
+    mPendingBufferAcquires.clear();
+    mPendingImageAcquires.clear();
+    mCompletedToken = 0;
+
+    // Mips are blitted at upload only if the upload queue is graphics capable
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(mDesc.physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(mDesc.physicalDevice, &queueFamilyCount, queueFamilies.data());
+    mCanBlit = (mDesc.queueFamilyIndex < queueFamilyCount) &&
+               (queueFamilies[mDesc.queueFamilyIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT);
+
+    // Staging ring - persistently mapped, batches carve out space at the head and give it back when their fence signals
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(mDesc.physicalDevice, &properties);
+    mCopyAlignment = std::max<VkDeviceSize>(properties.limits.optimalBufferCopyOffsetAlignment, 16);
+
+    mStagingRingSize = mDesc.stagingSize ? mDesc.stagingSize : DEFAULT_STAGING_SIZE;
+    mStagingRingHead = 0;
+    mStagingRingUsed = 0;
+
+    BufferDesc stagingDesc;
+    stagingDesc.size = mStagingRingSize;
+    stagingDesc.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    stagingDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    stagingDesc.logicalDevice = mDesc.logicalDevice;
+    stagingDesc.physicalDevice = mDesc.physicalDevice;
+    stagingDesc.allocator = mDesc.allocator;
+
+    mStagingRing.Create(stagingDesc);
+    mStagingRing.Map();
+
+    return (mIsCreated = true);
+}
+
+void UploadContext::Destroy() {
+    if (!mIsCreated) {
+        return;
+    }
+
+    WaitIdle();
+    mIsCreated = false;
+}
+
+UploadToken UploadContext::UploadBuffer(Buffer& dst, const void *data, VkDeviceSize size, VkDeviceSize dstOffset) {
+    VkBuffer stagingBuffer;
+    VkDeviceSize stagingOffset;
+    Batch& batch = AllocateStaging(data, size, stagingBuffer, stagingOffset);
+
+    VkBufferCopy copyRegion = {};
+    copyRegion.srcOffset = stagingOffset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(batch.commandBuffer, stagingBuffer, dst.GetBuffer(), 1, &copyRegion);
+
+    if (mTransfersOwnership) {
+        VkBufferMemoryBarrier release = {};
+        release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        release.dstAccessMask = 0;
+        release.srcQueueFamilyIndex = mDesc.queueFamilyIndex;
+        release.dstQueueFamilyIndex = mDesc.ownerQueueFamilyIndex;
+        release.buffer = dst.GetBuffer();
+        release.offset = dstOffset;
+        release.size = size;
+        batch.bufferReleases.push_back(release);
+    }
+
+    batch.hasCommands = true;
+    return batch.token;
+}
+
+UploadToken UploadContext::UploadImage(VkImage dst, const void *data, VkDeviceSize size, uint32_t width, uint32_t height,
+                                       VkImageAspectFlags aspect, uint32_t levelCount, const VkDeviceSize *levelOffsets,
+                                       uint32_t layerCount) {
+    OrderAfterPendingCopies(dst);
+
+    VkBuffer stagingBuffer;
+    VkDeviceSize stagingOffset;
+    Batch& batch = AllocateStaging(data, size, stagingBuffer, stagingOffset);
+
+    PendingImageCopy copy;
+    copy.image = dst;
+    copy.stagingBuffer = stagingBuffer;
+    copy.range.aspectMask = aspect;
+    copy.range.baseMipLevel = 0;
+    copy.range.levelCount = levelCount;
+    copy.range.baseArrayLayer = 0;
+    copy.range.layerCount = layerCount;
+    copy.firstRegion = static_cast<uint32_t>(batch.imageCopyRegions.size());
+    copy.regionCount = levelCount;
+
+    // One region per level covering all of its layers, the whole chain goes in a single copy
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        VkBufferImageCopy copyRegion = {};
+        copyRegion.bufferOffset = stagingOffset + (level ? levelOffsets[level] : 0);
+        copyRegion.bufferRowLength = 0;     // Tightly packed
+        copyRegion.bufferImageHeight = 0;
+        copyRegion.imageSubresource.aspectMask = aspect;
+        copyRegion.imageSubresource.mipLevel = level;
+        copyRegion.imageSubresource.baseArrayLayer = 0;
+        copyRegion.imageSubresource.layerCount = layerCount;
+        copyRegion.imageOffset = { 0, 0, 0 };
+        copyRegion.imageExtent = { std::max(width >> level, 1u), std::max(height >> level, 1u), 1 };
+        batch.imageCopyRegions.push_back(copyRegion);
+    }
+    batch.imageCopies.push_back(copy);
+
+    batch.hasCommands = true;
+    return batch.token;
+}
+
+UploadToken UploadContext::UploadImageAndBlitMips(VkImage dst, const void *data, VkDeviceSize size, uint32_t width,
+                                                  uint32_t height, VkImageAspectFlags aspect, uint32_t levelCount) {
+    if (!mCanBlit) {
+        throw std::runtime_error("Failed to generate mips, the upload queue can't blit!");
+    }
+
+    OrderAfterPendingCopies(dst);
+
+    VkBuffer stagingBuffer;
+    VkDeviceSize stagingOffset;
+    Batch& batch = AllocateStaging(data, size, stagingBuffer, stagingOffset);
+
+    // Every level starts out as a copy/blit destination
+    VkImageSubresourceRange range = {};
+    range.aspectMask = aspect;
+    range.baseMipLevel = 0;
+    range.levelCount = levelCount;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    BarrierBatch barriers;
+    barriers.AddImageTransition(dst, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
+    barriers.Record(batch.commandBuffer);
+
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.bufferOffset = stagingOffset;
+    copyRegion.bufferRowLength = 0;     // Tightly packed
+    copyRegion.bufferImageHeight = 0;
+    copyRegion.imageSubresource.aspectMask = aspect;
+    copyRegion.imageSubresource.mipLevel = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageOffset = { 0, 0, 0 };
+    copyRegion.imageExtent = { width, height, 1 };
+
+    vkCmdCopyBufferToImage(batch.commandBuffer, stagingBuffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+    // Each level is blitted from the one above once that has been written, which then becomes a source
+    range.levelCount = 1;
+
+    int32_t levelWidth = static_cast<int32_t>(width);
+    int32_t levelHeight = static_cast<int32_t>(height);
+    for (uint32_t level = 1; level < levelCount; ++level) {
+        range.baseMipLevel = level - 1;
+        barriers.AddImageTransition(dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, range);
+        barriers.Record(batch.commandBuffer);
+
+        VkImageBlit blit = {};
+        blit.srcSubresource.aspectMask = aspect;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+        blit.srcOffsets[1] = { levelWidth, levelHeight, 1 };
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+        blit.dstSubresource = blit.srcSubresource;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstOffsets[1] = { levelWidth, levelHeight, 1 };
+
+        vkCmdBlitImage(batch.commandBuffer, dst, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit, VK_FILTER_LINEAR);
+    }
+
+    // All but the last level were read from, the last was only written - both released in one barrier
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = dst;
+    barrier.subresourceRange = range;
+    if (levelCount > 1) {
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = levelCount - 1;
+        ReleaseImage(batch, barrier, barriers);
+    }
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.subresourceRange.baseMipLevel = levelCount - 1;
+    barrier.subresourceRange.levelCount = 1;
+    ReleaseImage(batch, barrier, barriers);
+    barriers.Record(batch.commandBuffer);
+
+    batch.hasCommands = true;
+    return batch.token;
+}
+
+UploadToken UploadContext::Flush() {
+    Batch& batch = mBatches[mCurrentBatch];
+    if (!batch.isRecording) {
+        return mNextToken - 1;
+    }
+
+    // Before the releases below, the copies queue some of their own
+    RecordImageCopies(batch);
+
+    if (mTransfersOwnership) {
+        // Hand everything in the batch over to the owner family in one go, a transfer-only queue
+        // can't name graphics stages so the destination is left at bottom-of-pipe
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            0, nullptr,
+            static_cast<uint32_t>(batch.bufferReleases.size()), batch.bufferReleases.data(),
+            static_cast<uint32_t>(batch.imageReleases.size()), batch.imageReleases.data());
+    } else {
+        // Make the copies visible to whatever reads the resources first, the renderer only waits on the fence
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            1, &barrier, 0, nullptr,
+            0, nullptr);
+    }
+
+    if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record upload command buffer!");
+    }
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+    if (vkQueueSubmit(mDesc.queue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to submit upload command buffer!");
+    }
+
+    batch.isRecording = false;
+    batch.isInFlight = true;
+    ++mNextToken;
+    mCurrentBatch = (mCurrentBatch + 1) % BATCH_COUNT;
+
+    return batch.token;
+}
+
+bool UploadContext::IsComplete(UploadToken token) {
+    if (token <= mCompletedToken) {
+        return true;
+    }
+
+    // Retire whatever has finished without blocking, oldest first so the completed token only moves forward
+    for (uint32_t i = 0; i < BATCH_COUNT; ++i) {
+        Batch& batch = mBatches[(mCurrentBatch + i) % BATCH_COUNT];
+        if (!batch.isInFlight) {
+            continue;
+        }
+        if (vkGetFenceStatus(mDesc.logicalDevice, batch.fence) != VK_SUCCESS) {
+            break;
+        }
+        RetireBatch(batch);
+    }
+
+    return (token <= mCompletedToken);
+}
+
+void UploadContext::Wait(UploadToken token) {
+    if (token <= mCompletedToken) {
+        return;
+    }
+
+    const Batch& currentBatch = mBatches[mCurrentBatch];
+    if (currentBatch.isRecording && token >= currentBatch.token) {
+        Flush();
+    }
+
+    while ((token > mCompletedToken) && RetireOldestBatch()) {}
+}
+
+void UploadContext::WaitIdle() {
+    Flush();
+    while (RetireOldestBatch()) {}
+}
+
+void UploadContext::RecordAcquireBarriers(VkCommandBuffer commandBuffer) {
+    if (mPendingBufferAcquires.empty() && mPendingImageAcquires.empty()) {
+        return;
+    }
+
+    // The batches' fences have already been waited on, which orders these after the matching releases
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr,
+        static_cast<uint32_t>(mPendingBufferAcquires.size()), mPendingBufferAcquires.data(),
+        static_cast<uint32_t>(mPendingImageAcquires.size()), mPendingImageAcquires.data());
+
+    mPendingBufferAcquires.clear();
+    mPendingImageAcquires.clear();
+}
+
+UploadContext::Batch& UploadContext::BeginBatch() {
+    Batch& batch = mBatches[mCurrentBatch];
+
+    // All batches are in flight, the slot we're about to reuse belongs to the oldest one
+    if (batch.isInFlight) {
+        RetireBatch(batch);
+    }
+
+    if (!batch.isRecording) {
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin upload command buffer!");
+        }
+
+        batch.token = mNextToken;
+        batch.ringBytes = 0;
+        batch.hasCommands = false;
+        batch.isRecording = true;
+    }
+
+    return batch;
+}
+
+void UploadContext::RetireBatch(Batch& batch) {
+    VkFence fence = batch.fence;
+    vkWaitForFences(mDesc.logicalDevice, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    vkResetFences(mDesc.logicalDevice, 1, &fence);
+
+    mStagingRingUsed -= batch.ringBytes;
+    if (mStagingRingUsed == 0) {
+        mStagingRingHead = 0;
+    }
+
+    // The matching acquires can only be recorded once the releases are known to have executed
+    for (auto& release : batch.bufferReleases) {
+        release.srcAccessMask = 0;
+        release.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        mPendingBufferAcquires.push_back(release);
+    }
+    for (auto& release : batch.imageReleases) {
+        release.srcAccessMask = 0;
+        release.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        mPendingImageAcquires.push_back(release);
+    }
+    batch.bufferReleases.clear();
+    batch.imageReleases.clear();
+
+    batch.dedicatedStaging.clear();
+    batch.ringBytes = 0;
+    batch.isInFlight = false;
+    mCompletedToken = std::max(mCompletedToken, batch.token);
+}
+
+bool UploadContext::RetireOldestBatch() {
+    for (uint32_t i = 0; i < BATCH_COUNT; ++i) {
+        Batch& batch = mBatches[(mCurrentBatch + i) % BATCH_COUNT];
+        if (batch.isInFlight) {
+            RetireBatch(batch);
+            return true;
+        }
+    }
+    return false;
+}
+
+UploadContext::Batch& UploadContext::AllocateStaging(const void *data, VkDeviceSize size, VkBuffer& stagingBuffer, VkDeviceSize& stagingOffset) {
+    // Too big for the ring - give it a staging buffer of its own that lives as long as the batch
+    if (size > mStagingRingSize) {
+        BufferDesc stagingDesc;
+        stagingDesc.size = size;
+        stagingDesc.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        stagingDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        stagingDesc.logicalDevice = mDesc.logicalDevice;
+        stagingDesc.physicalDevice = mDesc.physicalDevice;
+        stagingDesc.allocator = mDesc.allocator;
+
+        std::unique_ptr<Buffer> dedicatedStaging(new Buffer(stagingDesc));
+        dedicatedStaging->WriteToBufferMemory(const_cast<void*>(data), static_cast<size_t>(size));
+
+        stagingBuffer = dedicatedStaging->GetBuffer();
+        stagingOffset = 0;
+
+        Batch& batch = BeginBatch();
+        batch.dedicatedStaging.push_back(std::move(dedicatedStaging));
+        return batch;
+    }
+
+    // Find room at the head of the ring, wrapping to the start if the tail end is too small.
+    // When the ring is full, submit what we have and retire the oldest batches until there's space.
+    VkDeviceSize offset, requiredBytes;
+    for (;;) {
+        offset = (mStagingRingHead + mCopyAlignment - 1) / mCopyAlignment * mCopyAlignment;
+        if (offset + size > mStagingRingSize) {
+            requiredBytes = (mStagingRingSize - mStagingRingHead) + size;
+            offset = 0;
+        } else {
+            requiredBytes = (offset - mStagingRingHead) + size;
+        }
+
+        if (mStagingRingUsed + requiredBytes <= mStagingRingSize) {
+            break;
+        }
+
+        if (mBatches[mCurrentBatch].isRecording) {
+            Flush();
+        } else if (!RetireOldestBatch()) {
+            throw std::runtime_error("Failed to find space in the staging ring!");
+        }
+    }
+
+    mStagingRingHead = offset + size;
+    mStagingRingUsed += requiredBytes;
+
+    memcpy(static_cast<char*>(mStagingRing.GetMappedMemory()) + offset, data, static_cast<size_t>(size));
+
+    stagingBuffer = mStagingRing.GetBuffer();
+    stagingOffset = offset;
+
+    Batch& batch = BeginBatch();
+    batch.ringBytes += requiredBytes;
+    return batch;
+}
+
+void UploadContext::ReleaseImage(Batch& batch, VkImageMemoryBarrier& barrier, BarrierBatch& barriers) {
+    // So we can sample the texture in a shader. With a dedicated transfer queue the layout change is
+    // part of the ownership transfer, the acquire on the owner's side has to specify the same layouts.
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    if (mTransfersOwnership) {
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = mDesc.queueFamilyIndex;
+        barrier.dstQueueFamilyIndex = mDesc.ownerQueueFamilyIndex;
+        batch.imageReleases.push_back(barrier);
+    } else {
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers.AddImageBarrier(barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+}
+
+void UploadContext::RecordImageCopies(Batch& batch) {
+    if (batch.imageCopies.empty()) {
+        return;
+    }
+
+    // Previous contents don't matter, the whole image is overwritten
+    BarrierBatch barriers;
+    for (const PendingImageCopy& copy : batch.imageCopies) {
+        barriers.AddImageTransition(copy.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.range);
+    }
+    barriers.Record(batch.commandBuffer);
+
+    for (const PendingImageCopy& copy : batch.imageCopies) {
+        vkCmdCopyBufferToImage(batch.commandBuffer, copy.stagingBuffer, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            copy.regionCount, &batch.imageCopyRegions[copy.firstRegion]);
+    }
+
+    for (const PendingImageCopy& copy : batch.imageCopies) {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = copy.image;
+        barrier.subresourceRange = copy.range;
+        ReleaseImage(batch, barrier, barriers);
+    }
+    barriers.Record(batch.commandBuffer);
+
+    batch.imageCopies.clear();
+    batch.imageCopyRegions.clear();
+}
+
+void UploadContext::OrderAfterPendingCopies(VkImage image) {
+    Batch& batch = mBatches[mCurrentBatch];
+    for (const PendingImageCopy& copy : batch.imageCopies) {
+        if (copy.image == image) {
+            RecordImageCopies(batch);
+            return;
+        }
+    }
+}
@@ -0,0 +1,159 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_UploadContext.hpp
+    Desc    :    Batches buffer/image uploads through a shared staging ring and submits
+                 them together, handing back tokens to wait on before first use.
+
+===============================================================================
+*/
+#ifndef XOF_UPLOAD_CONTEXT_HPP
+#define XOF_UPLOAD_CONTEXT_HPP
+
+
+#include "VulkanHelpers.hpp"
+#include "XOF_BarrierBatch.hpp"
+#include "XOF_Buffer.hpp"
+#include "XOF_MemoryAllocator.hpp"
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+
+// Identifies the batch an upload was recorded into, 0 is always complete
+typedef uint64_t UploadToken;
+
+
+struct UploadContextDesc {
+                            UploadContextDesc() { memset(this, 0x00, sizeof(UploadContextDesc)); }
+
+                            // Renderer pointers
+    VkPhysicalDevice        physicalDevice;
+    VkDevice                logicalDevice;
+                            // Queue the copies are submitted on, ideally from a transfer-only family
+    VkQueue                 queue;
+    uint32_t                queueFamilyIndex;
+                            // Family that uses the uploaded resources - when it differs from queueFamilyIndex
+                            // ownership is released after the copy and has to be re-acquired with RecordAcquireBarriers()
+    uint32_t                ownerQueueFamilyIndex;
+    MemoryAllocator       * allocator;
+                            // Size of the staging ring (0 picks a default), uploads larger than
+                            // this get a staging buffer of their own
+    VkDeviceSize            stagingSize;
+};
+
+
+class UploadContext {
+public:
+                                    UploadContext();
+                                    ~UploadContext();
+
+    bool                            Create(const UploadContextDesc& desc);
+    void                            Destroy();
+
+    UploadToken                     UploadBuffer(Buffer& dst, const void *data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+                                    // Leaves the image in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. data holds levelCount mip
+                                    // levels from width x height down, level i at levelOffsets[i] (only needed past level 0),
+                                    // each level's layerCount layers back to back. The copy is recorded at flush together with
+                                    // the batch's other image copies, one barrier before them all and one after.
+    UploadToken                     UploadImage(VkImage dst, const void *data, VkDeviceSize size, uint32_t width, uint32_t height,
+                                                VkImageAspectFlags aspect, uint32_t levelCount = 1,
+                                                const VkDeviceSize *levelOffsets = nullptr, uint32_t layerCount = 1);
+                                    // Uploads level 0 only and blits it down the other levelCount - 1 with linear filtering.
+                                    // Only when CanBlit(), dst needs TRANSFER_SRC usage and a format that can be blitted
+                                    // with VK_FILTER_LINEAR.
+    UploadToken                     UploadImageAndBlitMips(VkImage dst, const void *data, VkDeviceSize size, uint32_t width,
+                                                           uint32_t height, VkImageAspectFlags aspect, uint32_t levelCount);
+
+                                    // Submits whatever has been recorded since the last flush, doesn't block
+    UploadToken                     Flush();
+    bool                            IsComplete(UploadToken token);
+                                    // Flushes first if the token belongs to the batch still being recorded
+    void                            Wait(UploadToken token);
+    void                            WaitIdle();
+
+                                    // Records the ownership acquire barriers for every batch that has completed since the
+                                    // last call, must go into a command buffer for the owner family before the resources
+                                    // are used. No-op when uploads share the owner's family.
+    void                            RecordAcquireBarriers(VkCommandBuffer commandBuffer);
+    inline bool                     TransfersOwnership() const;
+                                    // Blits need a graphics capable queue, a dedicated transfer queue can only copy
+    inline bool                     CanBlit() const;
+
+private:
+    static const uint32_t           BATCH_COUNT = 3;
+
+    struct PendingImageCopy {
+        VkImage                                     image;
+        VkBuffer                                    stagingBuffer;
+        VkImageSubresourceRange                     range;
+        uint32_t                                    firstRegion;    // Into Batch::imageCopyRegions
+        uint32_t                                    regionCount;
+    };
+
+    struct Batch {
+        VkCommandBuffer                             commandBuffer;
+        VulkanDeleter<VkFence>                      fence;
+        UploadToken                                 token;
+        VkDeviceSize                                ringBytes;
+        bool                                        isRecording;
+        bool                                        isInFlight;
+        bool                                        hasCommands;
+                                                    // Oversized uploads that didn't fit in the ring
+        std::vector<std::unique_ptr<Buffer>>        dedicatedStaging;
+                                                    // Queue family ownership releases, recorded together at flush
+        std::vector<VkBufferMemoryBarrier>          bufferReleases;
+        std::vector<VkImageMemoryBarrier>           imageReleases;
+                                                    // UploadImage copies not recorded yet
+        std::vector<PendingImageCopy>               imageCopies;
+        std::vector<VkBufferImageCopy>              imageCopyRegions;
+    };
+
+    UploadContextDesc               mDesc;
+    VulkanDeleter<VkCommandPool>    mCommandPool;
+    Batch                           mBatches[BATCH_COUNT];
+    uint32_t                        mCurrentBatch;
+    UploadToken                     mNextToken;
+    UploadToken                     mCompletedToken;
+
+    Buffer                          mStagingRing;
+    VkDeviceSize                    mStagingRingSize;
+    VkDeviceSize                    mStagingRingHead;
+    VkDeviceSize                    mStagingRingUsed;
+    VkDeviceSize                    mCopyAlignment;
+
+    bool                            mTransfersOwnership;
+    bool                            mCanBlit;
+    std::vector<VkBufferMemoryBarrier>  mPendingBufferAcquires;
+    std::vector<VkImageMemoryBarrier>   mPendingImageAcquires;
+
+    bool                            mIsCreated;
+
+    Batch&                          BeginBatch();
+    void                            RetireBatch(Batch& batch);
+    bool                            RetireOldestBatch();
+                                    // Copies data into staging memory and returns the batch the copy must be recorded into
+    Batch&                          AllocateStaging(const void *data, VkDeviceSize size, VkBuffer& stagingBuffer, VkDeviceSize& stagingOffset);
+                                    // Moves the levels in barrier's range from its oldLayout to SHADER_READ_ONLY_OPTIMAL
+                                    // as part of barriers, or queues that as part of the ownership release
+    void                            ReleaseImage(Batch& batch, VkImageMemoryBarrier& barrier, BarrierBatch& barriers);
+                                    // Transitions, copies and releases every pending image copy of the batch
+    void                            RecordImageCopies(Batch& batch);
+                                    // Records the batch's pending copies first if one of them writes image, so a later
+                                    // upload to the same image lands after it
+    void                            OrderAfterPendingCopies(VkImage image);
+};
+
+
+inline bool UploadContext::TransfersOwnership() const {
+    return mTransfersOwnership;
+}
+
+inline bool UploadContext::CanBlit() const {
+    return mCanBlit;
+}
+
+
+#endif // XOF_UPLOAD_CONTEXT_HPP
@@ -0,0 +1,110 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_VertexLayout.cpp
+    Desc    :    Compile-time vertex buffer layouts - the attributes are declared
+                 once and the stride, Vulkan input descriptions, packing from the
+                 full precision Vertex, equality and hashing all follow from them.
+
+===============================================================================
+*/
+#include "XOF_VertexLayout.hpp"
+#include <algorithm>
+#include <cmath>
+
+
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(uint32_t));
+
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x007FFFFF;
+
+    if (exponent == 0xFF) {
+        // inf stays inf, nan stays (quiet) nan
+        return sign | 0x7C00 | (mantissa ? 0x0200 : 0);
+    }
+
+    int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+    if (halfExponent >= 0x1F) {
+        return sign | 0x7C00;
+    }
+
+    if (halfExponent <= 0) {
+        // Subnormal (or too small, flushed to zero)
+        if (halfExponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x00800000;
+        uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t halfMantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        // Round to nearest even
+        if (remainder > halfway || (remainder == halfway && (halfMantissa & 1))) {
+            ++halfMantissa;
+        }
+        return sign | static_cast<uint16_t>(halfMantissa);
+    }
+
+    uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+    // Round to nearest even, a carry out of the mantissa correctly bumps the exponent (up to inf)
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        ++half;
+    }
+    return sign | static_cast<uint16_t>(half);
+}
+
+void OctahedralEncode(const float *v, float& x, float& y) {
+    float length = std::fabs(v[0]) + std::fabs(v[1]) + std::fabs(v[2]);
+    if (length == 0.f) {
+        x = y = 0.f;
+        return;
+    }
+
+    x = v[0] / length;
+    y = v[1] / length;
+
+    // Fold the lower hemisphere over the diagonals
+    if (v[2] < 0.f) {
+        float foldedX = (1.f - std::fabs(y)) * (x >= 0.f ? 1.f : -1.f);
+        float foldedY = (1.f - std::fabs(x)) * (y >= 0.f ? 1.f : -1.f);
+        x = foldedX;
+        y = foldedY;
+    }
+}
+
+int16_t FloatToSnorm16(float value) {
+    value = std::min(std::max(value, -1.f), 1.f);
+    return static_cast<int16_t>(std::floor(value * 32767.f + 0.5f));
+}
+
+uint16_t FloatToUnorm16(float value) {
+    value = std::min(std::max(value, 0.f), 1.f);
+    return static_cast<uint16_t>(std::floor(value * 65535.f + 0.5f));
+}
+
+uint32_t HashVertexBytes(const void *data, uint32_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = size;
+
+    for (uint32_t i = 0; i + sizeof(uint32_t) <= size; i += sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, bytes + i, sizeof(uint32_t));
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+
+    // MurmurHash3 finaliser
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+
+    return static_cast<uint32_t>(hash);
+}
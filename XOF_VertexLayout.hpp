@@ -0,0 +1,296 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_VertexLayout.hpp
+    Desc    :    Compile-time vertex buffer layouts - the attributes are declared
+                 once and the stride, Vulkan input descriptions, packing from the
+                 full precision Vertex, equality and hashing all follow from them.
+
+===============================================================================
+*/
+#ifndef XOF_VERTEX_LAYOUT_HPP
+#define XOF_VERTEX_LAYOUT_HPP
+
+
+#include "VertexDesc.hpp"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+enum VertexSemantic {
+    VERTEX_SEMANTIC_POSITION,
+    VERTEX_SEMANTIC_COLOUR,
+    VERTEX_SEMANTIC_NORMAL,
+    VERTEX_SEMANTIC_TANGENT,
+    VERTEX_SEMANTIC_TEXCOORD
+};
+
+
+// Where each semantic lives in the full precision Vertex the loaders work with
+template<VertexSemantic Semantic> struct VertexSource;
+
+template<> struct VertexSource<VERTEX_SEMANTIC_POSITION> {
+    static const uint32_t COMPONENTS = 3;
+    static const float* Get(const Vertex& v) { return &v.pos.x; }
+};
+
+template<> struct VertexSource<VERTEX_SEMANTIC_COLOUR> {
+    static const uint32_t COMPONENTS = 3;
+    static const float* Get(const Vertex& v) { return &v.colour.x; }
+};
+
+template<> struct VertexSource<VERTEX_SEMANTIC_NORMAL> {
+    static const uint32_t COMPONENTS = 3;
+    static const float* Get(const Vertex& v) { return &v.normal.x; }
+};
+
+template<> struct VertexSource<VERTEX_SEMANTIC_TANGENT> {
+    static const uint32_t COMPONENTS = 4;
+    static const float* Get(const Vertex& v) { return &v.tangent.x; }
+};
+
+template<> struct VertexSource<VERTEX_SEMANTIC_TEXCOORD> {
+    static const uint32_t COMPONENTS = 2;
+    static const float* Get(const Vertex& v) { return &v.texCoord.x; }
+};
+
+
+// ---
+
+
+uint16_t FloatToHalf(float value);
+// Unit vector -> point in [-1, 1]^2 (octahedral mapping), a zero vector maps to the origin
+void OctahedralEncode(const float *v, float& x, float& y);
+int16_t FloatToSnorm16(float value);
+uint16_t FloatToUnorm16(float value);
+uint32_t HashVertexBytes(const void *data, uint32_t size);
+
+
+// Encodings - the Vulkan format an attribute is fetched as, its size and how it's packed from the
+// Vertex's floats. INPUT_COMPONENTS must match the semantic it's used with.
+struct VertexFloat2 {
+    static const VkFormat   FORMAT = VK_FORMAT_R32G32_SFLOAT;
+    static const uint32_t   SIZE = 8;
+    static const uint32_t   INPUT_COMPONENTS = 2;
+    static void             Encode(const float *in, uint8_t *out) { memcpy(out, in, SIZE); }
+};
+
+struct VertexFloat3 {
+    static const VkFormat   FORMAT = VK_FORMAT_R32G32B32_SFLOAT;
+    static const uint32_t   SIZE = 12;
+    static const uint32_t   INPUT_COMPONENTS = 3;
+    static void             Encode(const float *in, uint8_t *out) { memcpy(out, in, SIZE); }
+};
+
+struct VertexFloat4 {
+    static const VkFormat   FORMAT = VK_FORMAT_R32G32B32A32_SFLOAT;
+    static const uint32_t   SIZE = 16;
+    static const uint32_t   INPUT_COMPONENTS = 4;
+    static void             Encode(const float *in, uint8_t *out) { memcpy(out, in, SIZE); }
+};
+
+// xyz as half floats, w = 1 (there's no 3 component 16-bit format worth relying on). Positions need
+// to stay within +/-65504, with 11 bits of precision relative to their magnitude.
+struct VertexHalf4 {
+    static const VkFormat   FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+    static const uint32_t   SIZE = 8;
+    static const uint32_t   INPUT_COMPONENTS = 3;
+    static void             Encode(const float *in, uint8_t *out) {
+        uint16_t packed[4] = { FloatToHalf(in[0]), FloatToHalf(in[1]), FloatToHalf(in[2]), 0x3C00 };
+        memcpy(out, packed, SIZE);
+    }
+};
+
+// Unit vector, octahedral encoded
+struct VertexOctSnorm16x2 {
+    static const VkFormat   FORMAT = VK_FORMAT_R16G16_SNORM;
+    static const uint32_t   SIZE = 4;
+    static const uint32_t   INPUT_COMPONENTS = 3;
+    static void             Encode(const float *in, uint8_t *out) {
+        float x, y;
+        OctahedralEncode(in, x, y);
+        int16_t packed[2] = { FloatToSnorm16(x), FloatToSnorm16(y) };
+        memcpy(out, packed, SIZE);
+    }
+};
+
+// Tangent with handedness - xyz octahedral encoded into xy, the sign of w into z
+struct VertexOctSnorm16x4 {
+    static const VkFormat   FORMAT = VK_FORMAT_R16G16B16A16_SNORM;
+    static const uint32_t   SIZE = 8;
+    static const uint32_t   INPUT_COMPONENTS = 4;
+    static void             Encode(const float *in, uint8_t *out) {
+        float x, y;
+        OctahedralEncode(in, x, y);
+        int16_t packed[4] = { FloatToSnorm16(x), FloatToSnorm16(y), FloatToSnorm16(in[3] < 0.f ? -1.f : 1.f), 0 };
+        memcpy(out, packed, SIZE);
+    }
+};
+
+// Texture coordinates in [0, 1], anything outside is clamped (so no tiling through UVs > 1)
+struct VertexUnorm16x2 {
+    static const VkFormat   FORMAT = VK_FORMAT_R16G16_UNORM;
+    static const uint32_t   SIZE = 4;
+    static const uint32_t   INPUT_COMPONENTS = 2;
+    static void             Encode(const float *in, uint8_t *out) {
+        uint16_t packed[2] = { FloatToUnorm16(in[0]), FloatToUnorm16(in[1]) };
+        memcpy(out, packed, SIZE);
+    }
+};
+
+
+template<VertexSemantic Semantic, uint32_t Location, typename Encoding>
+struct VertexAttribute {
+    static const VertexSemantic SEMANTIC = Semantic;
+    static const uint32_t       LOCATION = Location;
+    typedef Encoding            EncodingType;
+
+    static_assert(Encoding::INPUT_COMPONENTS == VertexSource<Semantic>::COMPONENTS, "Encoding doesn't fit the semantic");
+    static_assert(Encoding::SIZE % 4 == 0, "Attributes must stay 4-byte aligned");
+};
+
+
+// Attributes are packed back to back in declaration order
+template<typename... Attributes> struct VertexAttributeList;
+
+template<> struct VertexAttributeList<> {
+    static const uint32_t   SIZE = 0;
+    static const uint32_t   COUNT = 0;
+
+    static constexpr uint32_t Id(uint32_t hash) { return hash; }
+    static void             Encode(const Vertex&, uint8_t*) {}
+    static void             Describe(VkVertexInputAttributeDescription*, uint32_t, uint32_t) {}
+};
+
+template<typename First, typename... Rest> struct VertexAttributeList<First, Rest...> {
+    typedef VertexAttributeList<Rest...>    Tail;
+    typedef typename First::EncodingType    Encoding;
+
+    static const uint32_t   SIZE = Encoding::SIZE + Tail::SIZE;
+    static const uint32_t   COUNT = 1 + Tail::COUNT;
+
+    // FNV-1a over (semantic, location, format) of every attribute
+    static constexpr uint32_t Id(uint32_t hash) {
+        return Tail::Id(((((hash ^ static_cast<uint32_t>(First::SEMANTIC)) * 16777619u) ^ First::LOCATION) * 16777619u ^
+                         static_cast<uint32_t>(Encoding::FORMAT)) * 16777619u);
+    }
+
+    static void             Encode(const Vertex& v, uint8_t *out) {
+        Encoding::Encode(VertexSource<First::SEMANTIC>::Get(v), out);
+        Tail::Encode(v, out + Encoding::SIZE);
+    }
+
+    static void             Describe(VkVertexInputAttributeDescription *descriptions, uint32_t binding, uint32_t offset) {
+        descriptions->binding = binding;
+        descriptions->location = First::LOCATION;
+        descriptions->format = Encoding::FORMAT;
+        descriptions->offset = offset;
+        Tail::Describe(descriptions + 1, binding, offset + Encoding::SIZE);
+    }
+};
+
+
+// Runtime view of a layout, for code that shouldn't be templated on it (Mesh, the mesh cache)
+struct VertexLayoutInfo {
+    const char                                    * name;
+    uint32_t                                        id;
+    uint32_t                                        stride;
+    void                                         (* encode)(const Vertex *vertices, uint32_t count, void *out);
+    VkVertexInputBindingDescription                 bindingDescription;
+    std::vector<VkVertexInputAttributeDescription>  attributeDescriptions;
+};
+
+
+template<typename... Attributes>
+class VertexLayout {
+public:
+    typedef VertexAttributeList<Attributes...>  List;
+
+    static const uint32_t   STRIDE = List::SIZE;
+    static const uint32_t   ATTRIBUTE_COUNT = List::COUNT;
+    static const uint32_t   ID = List::Id(2166136261u);
+
+    // A vertex as it sits in the vertex buffer
+    struct Packed {
+        uint8_t             bytes[STRIDE];
+
+        bool                operator==(const Packed& p) const { return memcmp(bytes, p.bytes, STRIDE) == 0; }
+    };
+
+    struct Hash {
+        size_t              operator()(const Packed& p) const { return HashVertexBytes(p.bytes, STRIDE); }
+    };
+
+    static VkVertexInputBindingDescription GetBindingDescription() {
+        VkVertexInputBindingDescription bindingDesc = {};
+        bindingDesc.binding = 0;
+        bindingDesc.stride = STRIDE;
+        bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDesc;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> GetVertexInputAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> attributeDescriptions = {};
+        List::Describe(attributeDescriptions.data(), 0, 0);
+        return attributeDescriptions;
+    }
+
+    static void             Encode(const Vertex& v, Packed& out) {
+        List::Encode(v, out.bytes);
+    }
+
+    static void             EncodeVertices(const Vertex *vertices, uint32_t count, void *out) {
+        uint8_t *bytes = static_cast<uint8_t*>(out);
+        for (uint32_t i = 0; i < count; ++i) {
+            List::Encode(vertices[i], bytes + i * STRIDE);
+        }
+    }
+};
+
+
+template<typename Layout>
+const VertexLayoutInfo& GetVertexLayoutInfo() {
+    static const VertexLayoutInfo info = []() {
+        VertexLayoutInfo layoutInfo;
+        layoutInfo.name = Layout::GetName();
+        layoutInfo.id = Layout::ID;
+        layoutInfo.stride = Layout::STRIDE;
+        layoutInfo.encode = &Layout::EncodeVertices;
+        layoutInfo.bindingDescription = Layout::GetBindingDescription();
+        auto attributeDescriptions = Layout::GetVertexInputAttributeDescriptions();
+        layoutInfo.attributeDescriptions.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+        return layoutInfo;
+    }();
+    return info;
+}
+
+
+// ---
+
+
+// Everything at full precision, what Shader0.vert expects
+struct FullVertexLayout : public VertexLayout<
+    VertexAttribute<VERTEX_SEMANTIC_POSITION,   0, VertexFloat3>,
+    VertexAttribute<VERTEX_SEMANTIC_COLOUR,     1, VertexFloat3>,
+    VertexAttribute<VERTEX_SEMANTIC_NORMAL,     2, VertexFloat3>,
+    VertexAttribute<VERTEX_SEMANTIC_TANGENT,    3, VertexFloat4>,
+    VertexAttribute<VERTEX_SEMANTIC_TEXCOORD,   4, VertexFloat2>> {
+    static const char* GetName() { return "Full"; }
+};
+
+// Quantized, what Shader0Compact.vert expects. Drops colour (the OBJ path never fills it in). Lossy, so not
+// a drop-in for Full - UVs are clamped to [0, 1] and positions step by a unit or more past +/-2048.
+struct CompactVertexLayout : public VertexLayout<
+    VertexAttribute<VERTEX_SEMANTIC_POSITION,   0, VertexHalf4>,
+    VertexAttribute<VERTEX_SEMANTIC_NORMAL,     2, VertexOctSnorm16x2>,
+    VertexAttribute<VERTEX_SEMANTIC_TANGENT,    3, VertexOctSnorm16x4>,
+    VertexAttribute<VERTEX_SEMANTIC_TEXCOORD,   4, VertexUnorm16x2>> {
+    static const char* GetName() { return "Compact"; }
+};
+
+
+#endif // XOF_VERTEX_LAYOUT_HPP
@@ -0,0 +1,200 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_VertexWelder.cpp
+    Desc    :    Vertex welding - collapses identical per-corner vertices into a
+                 unique vertex list plus indices, using a flat open-addressing table.
+
+===============================================================================
+*/
+#include "XOF_VertexWelder.hpp"
+#include "XOF_ThreadPool.hpp"
+#include "XOF_VertexLayout.hpp"
+#include <algorithm>
+#include <cstring>
+
+
+static const uint32_t EMPTY_SLOT = 0xFFFFFFFF;
+static const uint32_t MIN_TABLE_SIZE = 16;
+// Below this the serial path wins, hashing/bucketing costs more than the welding itself
+static const uint32_t MIN_CORNERS_TO_SHARD = 64 * 1024;
+static const uint32_t CORNERS_PER_RANGE = 16 * 1024;
+static const uint32_t MAX_SHARD_COUNT = 64;
+
+
+uint32_t HashVertex(const Vertex& v) {
+    return HashVertexBytes(&v, sizeof(Vertex));
+}
+
+
+// ---
+
+
+VertexWelder::VertexWelder() : mMask(0), mCount(0) {}
+
+void VertexWelder::Reserve(uint32_t vertexCount) {
+    // Kept at most half full so probe sequences stay short
+    uint32_t capacity = MIN_TABLE_SIZE;
+    while (capacity < vertexCount * 2ull) {
+        capacity *= 2;
+    }
+
+    if (capacity > mSlots.size()) {
+        Rehash(capacity);
+    }
+}
+
+void VertexWelder::Clear() {
+    Slot empty = { 0, EMPTY_SLOT };
+    std::fill(mSlots.begin(), mSlots.end(), empty);
+    mCount = 0;
+}
+
+uint32_t VertexWelder::FindOrInsert(const Vertex& v, uint32_t hash, const Vertex *entries, uint32_t newIndex) {
+    if ((mCount + 1) * 2ull > mSlots.size()) {
+        Rehash(std::max(MIN_TABLE_SIZE, static_cast<uint32_t>(mSlots.size()) * 2));
+    }
+
+    for (uint32_t slot = hash & mMask;; slot = (slot + 1) & mMask) {
+        Slot& candidate = mSlots[slot];
+        if (candidate.index == EMPTY_SLOT) {
+            candidate.hash = hash;
+            candidate.index = newIndex;
+            ++mCount;
+            return newIndex;
+        }
+        if (candidate.hash == hash && memcmp(&entries[candidate.index], &v, sizeof(Vertex)) == 0) {
+            return candidate.index;
+        }
+    }
+}
+
+void VertexWelder::Rehash(uint32_t capacity) {
+    std::vector<Slot> oldSlots(capacity, Slot{ 0, EMPTY_SLOT });
+    oldSlots.swap(mSlots);
+    mMask = capacity - 1;
+
+    // The stored hashes are enough to reinsert, no need to look at the vertices again
+    for (const Slot& slot : oldSlots) {
+        if (slot.index == EMPTY_SLOT) {
+            continue;
+        }
+        uint32_t newSlot = slot.hash & mMask;
+        while (mSlots[newSlot].index != EMPTY_SLOT) {
+            newSlot = (newSlot + 1) & mMask;
+        }
+        mSlots[newSlot] = slot;
+    }
+}
+
+
+// ---
+
+
+static void WeldVerticesSerial(const Vertex *corners, uint32_t cornerCount, std::vector<Vertex>& vertices,
+                               std::vector<unsigned int>& indices) {
+    VertexWelder welder;
+    welder.Reserve(cornerCount);
+
+    for (uint32_t i = 0; i < cornerCount; ++i) {
+        uint32_t newIndex = static_cast<uint32_t>(vertices.size());
+        uint32_t index = welder.FindOrInsert(corners[i], HashVertex(corners[i]), vertices.data(), newIndex);
+        if (index == newIndex) {
+            vertices.push_back(corners[i]);
+        }
+        indices[i] = index;
+    }
+}
+
+// Each shard owns a slice of the hash space, so identical corners always meet in the same shard and the
+// shards can weld independently. Shards only find each corner's first occurrence, final indices are then
+// handed out in corner order so the result matches the serial path exactly.
+static void WeldVerticesSharded(const Vertex *corners, uint32_t cornerCount, std::vector<Vertex>& vertices,
+                                std::vector<unsigned int>& indices, ThreadPool& pool) {
+    uint32_t shardBits = 0;
+    while ((1u << shardBits) < std::min(pool.GetThreadCount() * 2, MAX_SHARD_COUNT)) {
+        ++shardBits;
+    }
+    const uint32_t shardCount = 1u << shardBits;
+    // The table indexes with the low bits, so shard on the high ones
+    auto shardOf = [shardBits](uint32_t hash) { return (shardBits > 0) ? hash >> (32 - shardBits) : 0; };
+
+    const uint32_t rangeCount = (cornerCount + CORNERS_PER_RANGE - 1) / CORNERS_PER_RANGE;
+    std::vector<uint32_t> hashes(cornerCount);
+    std::vector<uint32_t> rangeShardCounts(rangeCount * shardCount, 0);
+
+    pool.ParallelFor(rangeCount, [&](uint32_t range) {
+        uint32_t begin = range * CORNERS_PER_RANGE;
+        uint32_t end = std::min(begin + CORNERS_PER_RANGE, cornerCount);
+        uint32_t *counts = &rangeShardCounts[range * shardCount];
+        for (uint32_t i = begin; i < end; ++i) {
+            hashes[i] = HashVertex(corners[i]);
+            ++counts[shardOf(hashes[i])];
+        }
+    });
+
+    // Counting sort of the corners by shard, ranges kept in order so each shard sees its corners in corner order
+    std::vector<uint32_t> shardBegin(shardCount + 1, 0);
+    std::vector<uint32_t> rangeShardOffsets(rangeCount * shardCount);
+    uint32_t offset = 0;
+    for (uint32_t shard = 0; shard < shardCount; ++shard) {
+        shardBegin[shard] = offset;
+        for (uint32_t range = 0; range < rangeCount; ++range) {
+            rangeShardOffsets[range * shardCount + shard] = offset;
+            offset += rangeShardCounts[range * shardCount + shard];
+        }
+    }
+    shardBegin[shardCount] = offset;
+
+    std::vector<uint32_t> sortedCorners(cornerCount);
+    pool.ParallelFor(rangeCount, [&](uint32_t range) {
+        uint32_t begin = range * CORNERS_PER_RANGE;
+        uint32_t end = std::min(begin + CORNERS_PER_RANGE, cornerCount);
+        uint32_t *offsets = &rangeShardOffsets[range * shardCount];
+        for (uint32_t i = begin; i < end; ++i) {
+            sortedCorners[offsets[shardOf(hashes[i])]++] = i;
+        }
+    });
+
+    // firstCorner[i] is the earliest corner identical to corner i (i itself for a first occurrence)
+    std::vector<uint32_t> firstCorner(cornerCount);
+    std::vector<uint32_t> shardUniqueCounts(shardCount);
+    pool.ParallelFor(shardCount, [&](uint32_t shard) {
+        VertexWelder welder;
+        welder.Reserve(shardBegin[shard + 1] - shardBegin[shard]);
+        for (uint32_t k = shardBegin[shard]; k < shardBegin[shard + 1]; ++k) {
+            uint32_t i = sortedCorners[k];
+            firstCorner[i] = welder.FindOrInsert(corners[i], hashes[i], corners, i);
+        }
+        shardUniqueCounts[shard] = welder.GetCount();
+    });
+
+    uint32_t uniqueCount = 0;
+    for (uint32_t count : shardUniqueCounts) {
+        uniqueCount += count;
+    }
+    vertices.reserve(vertices.size() + uniqueCount);
+
+    for (uint32_t i = 0; i < cornerCount; ++i) {
+        if (firstCorner[i] == i) {
+            indices[i] = static_cast<unsigned int>(vertices.size());
+            vertices.push_back(corners[i]);
+        } else {
+            indices[i] = indices[firstCorner[i]];
+        }
+    }
+}
+
+void WeldVertices(const Vertex *corners, uint32_t cornerCount, std::vector<Vertex>& vertices,
+                  std::vector<unsigned int>& indices, ThreadPool *pool) {
+    vertices.clear();
+    indices.resize(cornerCount);
+
+    if (pool && pool->GetThreadCount() > 1 && cornerCount >= MIN_CORNERS_TO_SHARD) {
+        WeldVerticesSharded(corners, cornerCount, vertices, indices, *pool);
+    } else {
+        WeldVerticesSerial(corners, cornerCount, vertices, indices);
+    }
+}
@@ -0,0 +1,77 @@
+/*
+===============================================================================
+
+    XOF
+    ===
+    File    :    XOF_VertexWelder.hpp
+    Desc    :    Vertex welding - collapses identical per-corner vertices into a
+                 unique vertex list plus indices, using a flat open-addressing table.
+
+===============================================================================
+*/
+#ifndef XOF_VERTEX_WELDER_HPP
+#define XOF_VERTEX_WELDER_HPP
+
+
+#include "VertexDesc.hpp"
+#include <cstdint>
+#include <vector>
+
+
+class ThreadPool;
+
+
+// Vertices are welded on their exact bits, so the struct can't have padding (and -0.0/0.0 stay distinct)
+static_assert(sizeof(Vertex) % sizeof(uint32_t) == 0, "Vertex is hashed a 32-bit word at a time");
+
+
+// Hashes every bit of the vertex, unlike std::hash<Vertex> which only looks at pos/colour/texCoord
+uint32_t HashVertex(const Vertex& v);
+
+
+// Open-addressing (linear probing) table of indices into a caller-owned vertex array. The
+// table never touches the vertices beyond comparing against them, so it can index into any
+// array - the welded output, or the corners themselves when sharding.
+class VertexWelder {
+public:
+                                        VertexWelder();
+
+                                        // Sizes the table so vertexCount entries fit without it having to grow
+    void                                Reserve(uint32_t vertexCount);
+    void                                Clear();
+
+                                        // Index of the entry matching v, or newIndex once v has been inserted under it
+                                        // (the caller must then make entries[newIndex] == v). One probe sequence either way.
+    uint32_t                            FindOrInsert(const Vertex& v, uint32_t hash, const Vertex *entries, uint32_t newIndex);
+
+    inline uint32_t                     GetCount() const;
+
+private:
+    struct Slot {
+        uint32_t                        hash;
+        uint32_t                        index;
+    };
+    std::vector<Slot>                   mSlots;
+    uint32_t                            mMask;
+    uint32_t                            mCount;
+
+    void                                Rehash(uint32_t capacity);
+};
+
+
+inline uint32_t VertexWelder::GetCount() const {
+    return mCount;
+}
+
+
+// ---
+
+
+// Welds corners[0..cornerCount) into vertices/indices, vertices coming out in first-use order. With
+// a pool big inputs are hashed in parallel and welded in shards (split on the hash), the output
+// being identical to the serial path.
+void WeldVertices(const Vertex *corners, uint32_t cornerCount, std::vector<Vertex>& vertices,
+                  std::vector<unsigned int>& indices, ThreadPool *pool);
+
+
+#endif // XOF_VERTEX_WELDER_HPP
@@ -1,10 +1,28 @@
 #include "VulkanApp.hpp"
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 
 
-int main() {
+int main( int argc, char **argv ) {
     VulkanApp app;
 
+    // --frames-in-flight <n> : 2 favours latency, 3 favours throughput
+    // --instance-grid <n>    : draws n x n copies of the mesh
+    // --per-object-draws     : a draw per copy rather than instancing them
+    // --instance-benchmark   : times the grid drawn both ways, prints the results and exits
+    for( int i=1; i<argc; ++i ) {
+        if( strcmp( argv[i], "--frames-in-flight" ) == 0 && i + 1 < argc ) {
+            app.SetFramesInFlight( static_cast<uint32_t>( atoi( argv[++i] ) ) );
+        } else if( strcmp( argv[i], "--instance-grid" ) == 0 && i + 1 < argc ) {
+            app.SetInstanceGridSize( static_cast<uint32_t>( atoi( argv[++i] ) ) );
+        } else if( strcmp( argv[i], "--per-object-draws" ) == 0 ) {
+            app.SetPerObjectDraws( true );
+        } else if( strcmp( argv[i], "--instance-benchmark" ) == 0 ) {
+            app.SetInstanceBenchmark( true );
+        }
+    }
+
     try {
         app.Run();
     } catch( const std::runtime_error e ) {